@@ -55,8 +55,11 @@ connection::do_read()
 
             if (result == request_parser::good)
             {
-                request_handler_.handle_request(request_, reply_);
-                do_write();
+                request_handler_.async_handle_request(request_, reply_,
+                                                      [this, self]()
+                                                      {
+                                                          do_write();
+                                                      });
             }
             else if (result == request_parser::bad)
             {
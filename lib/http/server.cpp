@@ -57,6 +57,18 @@ server::addRoute(const std::string& routeName, routeHandler callback)
     mRoutes[routeName] = callback;
 }
 
+bool
+server::hasRoute(const std::string& routeName) const
+{
+    return mRoutes.find(routeName) != mRoutes.end();
+}
+
+void
+server::setDispatcher(dispatcher d)
+{
+    mDispatcher = d;
+}
+
 void
 server::do_accept()
 {
@@ -87,20 +99,60 @@ server::~server()
 
 void
 server::handle_request(const request& req, reply& rep)
+{
+    std::string command;
+    std::string params;
+    if (!parse_request(req, command, params))
+    {
+        rep = reply::stock_reply(reply::bad_request);
+        return;
+    }
+    fill_reply(command, params, rep);
+}
+
+void
+server::async_handle_request(const request& req, reply& rep,
+                             std::function<void()> done)
+{
+    std::string command;
+    std::string params;
+    if (!parse_request(req, command, params))
+    {
+        rep = reply::stock_reply(reply::bad_request);
+        io_service_.post(done);
+        return;
+    }
+
+    // the connection owning `rep` is kept alive by `done`
+    auto task = [this, command, params, &rep, done]()
+    {
+        fill_reply(command, params, rep);
+        io_service_.post(done);
+    };
+    if (mDispatcher)
+    {
+        mDispatcher(command, task);
+    }
+    else
+    {
+        task();
+    }
+}
+
+bool
+server::parse_request(const request& req, std::string& command,
+                      std::string& params)
 {
     // Decode url to path.
     std::string request_path;
     if (!url_decode(req.uri, request_path))
     {
-        rep = reply::stock_reply(reply::bad_request);
-        return;
+        return false;
     }
 
     if (request_path.size() && request_path[0] == '/')
         request_path = request_path.substr(1);
 
-    std::string command;
-    std::string params;
     auto pos = request_path.find('?');
     if (pos == std::string::npos)
         command = request_path;
@@ -109,10 +161,19 @@ server::handle_request(const request& req, reply& rep)
         command = request_path.substr(0, pos);
         params = request_path.substr(pos);
     }
+    return true;
+}
 
-    if (mRoutes.find(command) != mRoutes.end())
+void
+server::fill_reply(const std::string& command, const std::string& params,
+                   reply& rep)
+{
+    // routes are only added before the server is run, so they can be
+    // looked up from any thread
+    auto route = mRoutes.find(command);
+    if (route != mRoutes.end())
     {
-        mRoutes[command](params, rep.content);
+        route->second(params, rep.content);
 
         rep.status = reply::ok;
         rep.headers.resize(2);
@@ -123,9 +184,10 @@ server::handle_request(const request& req, reply& rep)
     }
     else
     {
-        if(mRoutes.find("404") != mRoutes.end())
+        auto notFound = mRoutes.find("404");
+        if(notFound != mRoutes.end())
         {
-            mRoutes["404"](params, rep.content);
+            notFound->second(params, rep.content);
 
             rep.status = reply::ok;
             rep.headers.resize(2);
@@ -30,6 +30,10 @@ class server
 
 public:
     typedef std::function<void(const std::string&, std::string&)> routeHandler;
+    /// Runs `task`, which answers a request for `command`, on the thread of
+    /// its choice; the default is to run it at once, on the server's thread.
+    typedef std::function<void(const std::string& command,
+                               std::function<void()> task)> dispatcher;
     server(const server&) = delete;
     server& operator=(const server&) = delete;
 
@@ -43,15 +47,30 @@ public:
 
     void addRoute(const std::string& routeName, routeHandler callback);
     void add404(routeHandler callback);
+    void setDispatcher(dispatcher d);
+    bool hasRoute(const std::string& routeName) const;
 
+    /// Answers `req` at once.
     void handle_request(const request& req, reply& rep);
 
+    /// Answers `req` through the dispatcher, then calls `done` on the
+    /// server's io_service.
+    void async_handle_request(const request& req, reply& rep,
+                              std::function<void()> done);
+
     static void parseParams(const std::string& params, std::map<std::string, std::string>& retMap);
 
 private:
     /// Perform an asynchronous accept operation.
     void do_accept();
 
+    /// Split the path of `req` into a command and its parameters.
+    static bool parse_request(const request& req, std::string& command,
+                              std::string& params);
+
+    void fill_reply(const std::string& command, const std::string& params,
+                    reply& rep);
+
     /// Perform URL-decoding on a string. Returns false if the encoding was
     /// invalid.
     static bool url_decode(const std::string& in, std::string& out);
@@ -72,6 +91,7 @@ private:
     asio::ip::tcp::socket socket_;
 
     std::map<std::string, routeHandler> mRoutes;
+    dispatcher mDispatcher;
 };
 
 } // namespace server
@@ -99,6 +99,13 @@ namespace cache {
             }
         }
 
+        template<typename F>
+        void for_each(const F &f) const {
+            for (auto const& kv : _cache_items_list) {
+                f(kv.second);
+            }
+        }
+
         void clear() {
             _cache_items_map.clear();
             _cache_items_list.clear();
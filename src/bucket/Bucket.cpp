@@ -535,6 +535,14 @@ checkDBAgainstBuckets(medida::MetricsRegistry& metrics,
     }
 
     // Step 4: confirm size of datasets matches size of datasets in DB.
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        compareSizes("account", state->countEntries(ACCOUNT), nAccounts);
+        compareSizes("trustline", state->countEntries(TRUSTLINE), nTrustLines);
+        compareSizes("offer", state->countEntries(OFFER), nOffers);
+        compareSizes("data", state->countEntries(DATA), nData);
+        return;
+    }
     soci::session& sess = db.getSession();
     compareSizes("account", AccountFrame::countObjects(sess), nAccounts);
     compareSizes("trustline", TrustFrame::countObjects(sess), nTrustLines);
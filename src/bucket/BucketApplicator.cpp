@@ -51,8 +51,8 @@ BucketApplicator::advance()
             break;
         }
     }
+    mDb.resetPreparedStatements();
     sqlTx.commit();
-    mDb.clearPreparedStatementCache();
 
     if (!mIn || (mSize & 0xfff) == 0xfff)
     {
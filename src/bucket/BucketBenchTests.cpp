@@ -0,0 +1,442 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+// ASIO is somewhat particular about when it gets included -- it wants to be the
+// first to include <windows.h> -- so we try to include it before everything
+// else.
+#include "util/asio.h"
+
+#include "bucket/Bucket.h"
+#include "bucket/BucketApplicator.h"
+#include "bucket/BucketList.h"
+#include "bucket/BucketManager.h"
+#include "crypto/SHA.h"
+#include "database/Database.h"
+#include "ledger/EntryFrame.h"
+#include "lib/catch.hpp"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "main/test.h"
+#include "util/Fs.h"
+#include "util/Logging.h"
+#include "util/Timer.h"
+#include "util/types.h"
+#include "medida/metrics_registry.h"
+#include "medida/stats/snapshot.h"
+#include "medida/timer.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <random>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+/**
+ * Benchmarks of bucket storage: Bucket::fresh, Bucket::merge with shadows,
+ * the spill cascades of BucketList::addBatch and BucketApplicator, over
+ * synthetic entry mixes. They are hidden, run them with
+ *
+ *   stellar-core --test [bucket-bench]
+ *
+ * The largest bucket built, in entries, is taken from BUCKET_BENCH_ENTRIES
+ * (default 1000000; sizes go up by tenfold from 10000) and the number of
+ * ledgers added to the bucket list from BUCKET_BENCH_LEDGERS (default 1024).
+ * Entries are generated from a fixed seed so runs can be compared.
+ */
+
+using namespace stellar;
+
+namespace BucketBenchTests
+{
+
+enum EntryMix
+{
+    // mostly new accounts, a few balance updates
+    ACCOUNT_HEAVY,
+    // offers created and taken in about equal numbers
+    OFFER_CHURN,
+    // many trustlines per account, updated often
+    TRUSTLINE_HEAVY
+};
+
+static std::vector<EntryMix> const kMixes = {ACCOUNT_HEAVY, OFFER_CHURN,
+                                             TRUSTLINE_HEAVY};
+
+static char const*
+mixName(EntryMix mix)
+{
+    switch (mix)
+    {
+    case ACCOUNT_HEAVY:
+        return "account-heavy";
+    case OFFER_CHURN:
+        return "offer-churn";
+    default:
+        return "trustline-heavy";
+    }
+}
+
+static size_t
+benchScale(char const* name, size_t def)
+{
+    char const* s = getenv(name);
+    return s ? static_cast<size_t>(std::stoull(s)) : def;
+}
+
+static size_t
+peakRSSKiB()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss) / 1024;
+#else
+    return static_cast<size_t>(usage.ru_maxrss);
+#endif
+#endif
+}
+
+static size_t
+fileSize(std::shared_ptr<Bucket> const& b)
+{
+    if (b->getFilename().empty())
+    {
+        return 0;
+    }
+    std::ifstream in(b->getFilename(), std::ifstream::ate |
+                                           std::ifstream::binary);
+    return static_cast<size_t>(in.tellg());
+}
+
+static double
+seconds(std::chrono::nanoseconds ns)
+{
+    return std::chrono::duration<double>(ns).count();
+}
+
+static void
+report(std::string const& what, EntryMix mix, size_t entries, size_t bytes,
+       std::chrono::nanoseconds elapsed)
+{
+    double s = seconds(elapsed);
+    CLOG(INFO, "Bucket") << what << " " << mixName(mix) << ": " << entries
+                         << " entries, " << bytes << " bytes in " << s
+                         << "s = " << (s > 0 ? entries / s : 0)
+                         << " entries/s, " << (s > 0 ? bytes / s : 0)
+                         << " bytes/s, peak RSS " << peakRSSKiB() << "KiB";
+}
+
+// Deterministic source of ledger entries: entry `i` of a mix always has the
+// same key, so batches can update or delete earlier entries.
+class SyntheticEntries
+{
+    EntryMix mMix;
+    uint64_t mNext{0};
+    std::default_random_engine mRand{0};
+
+    static AccountID
+    account(uint64_t i)
+    {
+        AccountID id;
+        id.type(PUBLIC_KEY_TYPE_ED25519);
+        id.ed25519() = sha256(ByteSlice(&i, sizeof(i)));
+        return id;
+    }
+
+    static Asset
+    asset(uint64_t i)
+    {
+        Asset a;
+        a.type(ASSET_TYPE_CREDIT_ALPHANUM4);
+        strToAssetCode(a.alphaNum4().assetCode, "A" + std::to_string(i));
+        a.alphaNum4().issuer = account(~i);
+        return a;
+    }
+
+    LedgerEntry
+    entry(uint64_t i, uint32_t ledger) const
+    {
+        LedgerEntry e;
+        e.lastModifiedLedgerSeq = ledger;
+        switch (mMix)
+        {
+        case ACCOUNT_HEAVY:
+        {
+            e.data.type(ACCOUNT);
+            auto& a = e.data.account();
+            a.accountID = account(i);
+            a.balance = 1000000000 + ledger;
+            a.seqNum = static_cast<SequenceNumber>(ledger) << 32;
+            a.thresholds[0] = 1;
+            break;
+        }
+        case OFFER_CHURN:
+        {
+            e.data.type(OFFER);
+            auto& o = e.data.offer();
+            o.sellerID = account(i % 1000);
+            o.offerID = i + 1;
+            o.selling.type(ASSET_TYPE_NATIVE);
+            o.buying = asset(i % 16);
+            o.amount = 1000 + ledger;
+            o.price.n = 1 + static_cast<int32_t>(i % 100);
+            o.price.d = 100;
+            break;
+        }
+        default:
+        {
+            e.data.type(TRUSTLINE);
+            auto& tl = e.data.trustLine();
+            tl.accountID = account(i / 16);
+            tl.asset = asset(i % 16);
+            tl.limit = INT64_MAX;
+            tl.balance = ledger;
+            tl.flags = AUTHORIZED_FLAG;
+            break;
+        }
+        }
+        return e;
+    }
+
+  public:
+    explicit SyntheticEntries(EntryMix mix) : mMix(mix)
+    {
+    }
+
+    // Percentages of each batch that update and delete earlier entries; the
+    // rest are new entries.
+    void
+    batch(size_t n, uint32_t ledger, std::vector<LedgerEntry>& live,
+          std::vector<LedgerKey>& dead)
+    {
+        static std::map<EntryMix, std::pair<int, int>> const kShares = {
+            {ACCOUNT_HEAVY, {18, 2}},
+            {OFFER_CHURN, {10, 40}},
+            {TRUSTLINE_HEAVY, {28, 2}}};
+        auto shares = kShares.at(mMix);
+
+        std::uniform_int_distribution<int> pct(0, 99);
+        for (size_t k = 0; k < n; ++k)
+        {
+            int r = pct(mRand);
+            if (mNext == 0 || r >= shares.first + shares.second)
+            {
+                live.emplace_back(entry(mNext++, ledger));
+                continue;
+            }
+            auto old =
+                std::uniform_int_distribution<uint64_t>(0, mNext - 1)(mRand);
+            if (r < shares.first)
+            {
+                live.emplace_back(entry(old, ledger));
+            }
+            else
+            {
+                dead.emplace_back(LedgerEntryKey(entry(old, ledger)));
+            }
+        }
+    }
+};
+}
+
+using namespace BucketBenchTests;
+
+TEST_CASE("bucket fresh benchmark", "[bucket-bench][bench][hide]")
+{
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    size_t maxEntries = benchScale("BUCKET_BENCH_ENTRIES", 1000000);
+
+    for (auto mix : kMixes)
+    {
+        for (size_t n = 10000; n <= maxEntries; n *= 10)
+        {
+            SyntheticEntries gen(mix);
+            std::vector<LedgerEntry> live;
+            std::vector<LedgerKey> dead;
+            gen.batch(n, 1, live, dead);
+
+            auto start = std::chrono::steady_clock::now();
+            auto b = Bucket::fresh(app->getBucketManager(), live, dead);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            report("fresh", mix, n, fileSize(b), elapsed);
+        }
+    }
+}
+
+TEST_CASE("bucket merge benchmark", "[bucket-bench][bench][hide]")
+{
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    auto& bm = app->getBucketManager();
+    size_t maxEntries = benchScale("BUCKET_BENCH_ENTRIES", 1000000);
+
+    for (auto mix : kMixes)
+    {
+        for (size_t n = 10000; n <= maxEntries; n *= 10)
+        {
+            // as in the bucket list: an old level's worth of entries, a
+            // newer and smaller one overriding some of them, and shadows
+            // from the levels above holding newer versions of a few
+            SyntheticEntries gen(mix);
+            std::vector<LedgerEntry> live;
+            std::vector<LedgerKey> dead;
+            gen.batch(n, 1, live, dead);
+            auto oldBucket = Bucket::fresh(bm, live, dead);
+            live.clear();
+            dead.clear();
+            gen.batch(n / 4, 2, live, dead);
+            auto newBucket = Bucket::fresh(bm, live, dead);
+            std::vector<std::shared_ptr<Bucket>> shadows;
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                live.clear();
+                dead.clear();
+                gen.batch(n / 64, 3 + i, live, dead);
+                shadows.push_back(Bucket::fresh(bm, live, dead));
+            }
+            live.clear();
+            dead.clear();
+
+            size_t in = fileSize(oldBucket) + fileSize(newBucket);
+            auto start = std::chrono::steady_clock::now();
+            auto merged = Bucket::merge(bm, oldBucket, newBucket, shadows);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            auto counts = merged->countLiveAndDeadEntries();
+            report("merge", mix, counts.first + counts.second, in, elapsed);
+        }
+    }
+}
+
+TEST_CASE("bucket list addBatch benchmark", "[bucket-bench][bench][hide]")
+{
+    size_t const batchSize = 1000;
+    uint32_t ledgers =
+        static_cast<uint32_t>(benchScale("BUCKET_BENCH_LEDGERS", 1024));
+
+    for (auto mix : kMixes)
+    {
+        VirtualClock clock;
+        Application::pointer app =
+            Application::create(clock, getTestConfig());
+        auto& bm = app->getBucketManager();
+        SyntheticEntries gen(mix);
+
+        // addBatch latency by the deepest level spilling in that ledger: the
+        // spill cascade commits the merges started for each level and starts
+        // new ones
+        std::map<size_t, medida::Timer*> spillTimers;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 1; i <= ledgers; ++i)
+        {
+            std::vector<LedgerEntry> live;
+            std::vector<LedgerKey> dead;
+            gen.batch(batchSize, i, live, dead);
+
+            size_t deepest = 0;
+            while (deepest + 1 < BucketList::kNumLevels &&
+                   BucketList::levelShouldSpill(i, deepest))
+            {
+                ++deepest;
+            }
+            auto& t = spillTimers[deepest];
+            if (!t)
+            {
+                t = &app->getMetrics().NewTimer(
+                    {"bucket-bench", "spill", "level-" +
+                                                  std::to_string(deepest)});
+            }
+            {
+                auto scope = t->TimeScope();
+                bm.addBatch(*app, i, live, dead);
+            }
+            clock.crank(false);
+            if ((i & 0xff) == 0xff)
+            {
+                bm.forgetUnreferencedBuckets();
+            }
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        auto& bl = bm.getBucketList();
+        size_t bytes = 0;
+        for (size_t level = 0; level < BucketList::kNumLevels; ++level)
+        {
+            bytes += fileSize(bl.getLevel(level).getCurr());
+            bytes += fileSize(bl.getLevel(level).getSnap());
+        }
+        report("addBatch", mix, ledgers * batchSize, bytes, elapsed);
+        for (auto const& t : spillTimers)
+        {
+            CLOG(INFO, "Bucket")
+                << "addBatch " << mixName(mix) << " spilling to level "
+                << t.first << ": " << t.second->count() << " ledgers, p50 "
+                << t.second->GetSnapshot().getMedian() << "ms, p99 "
+                << t.second->GetSnapshot().get99thPercentile() << "ms, max "
+                << t.second->max() << "ms";
+        }
+
+        // the merges above ran in the background, overlapped with later
+        // ledgers: redo each level's next merge from the final state, in the
+        // foreground, to see its cost alone
+        for (size_t level = 1; level < BucketList::kNumLevels; ++level)
+        {
+            auto curr = bl.getLevel(level).getCurr();
+            auto snap = bl.getLevel(level - 1).getSnap();
+            std::vector<std::shared_ptr<Bucket>> shadows;
+            for (size_t j = 0; j + 1 < level; ++j)
+            {
+                shadows.push_back(bl.getLevel(j).getCurr());
+                shadows.push_back(bl.getLevel(j).getSnap());
+            }
+            size_t in = fileSize(curr) + fileSize(snap);
+            if (in == 0)
+            {
+                break;
+            }
+            auto mergeStart = std::chrono::steady_clock::now();
+            auto merged = Bucket::merge(bm, curr, snap, shadows);
+            auto mergeElapsed = std::chrono::steady_clock::now() - mergeStart;
+            auto counts = merged->countLiveAndDeadEntries();
+            report("level " + std::to_string(level) + " merge", mix,
+                   counts.first + counts.second, in, mergeElapsed);
+        }
+    }
+}
+
+TEST_CASE("bucket applicator benchmark", "[bucket-bench][bench][hide]")
+{
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    app->start();
+    size_t maxEntries =
+        std::min<size_t>(benchScale("BUCKET_BENCH_ENTRIES", 1000000), 100000);
+
+    // entries must be loadable into the database: account and trustline
+    // mixes only, with no deletions, as when catching up to a fresh state
+    for (auto mix : {ACCOUNT_HEAVY, TRUSTLINE_HEAVY})
+    {
+        SyntheticEntries gen(mix);
+        std::vector<LedgerEntry> live;
+        std::vector<LedgerKey> dead;
+        gen.batch(maxEntries, 1, live, dead);
+        dead.clear();
+        auto b = Bucket::fresh(app->getBucketManager(), live, dead);
+        auto counts = b->countLiveAndDeadEntries();
+
+        auto start = std::chrono::steady_clock::now();
+        BucketApplicator applicator(app->getDatabase(), b);
+        while (applicator)
+        {
+            applicator.advance();
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        report("apply", mix, counts.first, fileSize(b), elapsed);
+    }
+}
@@ -27,7 +27,9 @@ namespace stellar
 
 static std::mutex gVerifySigCacheMutex;
 static cache::lru_cache<Hash, bool> gVerifySigCache(0xffff);
-static std::unique_ptr<SHA256> gHasher = SHA256::create();
+// Cache keys are computed outside of the mutex, and signatures are verified
+// from worker threads (see TxSetFrame::checkValid): one hasher per thread.
+static thread_local std::unique_ptr<SHA256> gHasher = SHA256::create();
 static uint64_t gVerifyCacheHit = 0;
 static uint64_t gVerifyCacheMiss = 0;
 static uint64_t gVerifyCacheIgnore = 0;
@@ -30,6 +30,9 @@
 #include "medida/timer.h"
 #include "medida/counter.h"
 
+#include <soci-sqlite3.h>
+
+#include <algorithm>
 #include <stdexcept>
 #include <vector>
 #include <sstream>
@@ -54,6 +57,13 @@ bool Database::gDriversRegistered = false;
 
 static unsigned long const SCHEMA_VERSION = 4;
 
+// Number of distinct prepared statements kept open on the main session. The
+// set of queries issued during ledger close is small and fixed, so this only
+// needs to be large enough to hold it plus the occasional ad-hoc query.
+static size_t const PREPARED_STATEMENT_CACHE_SIZE = 512;
+
+size_t const Database::ENTRY_CACHE_SIZE = 4096;
+
 static void
 setSerializable(soci::session& sess)
 {
@@ -78,9 +88,16 @@ Database::Database(Application& app)
     : mApp(app)
     , mQueryMeter(
           app.getMetrics().NewMeter({"database", "query", "exec"}, "query"))
+    , mStatements(PREPARED_STATEMENT_CACHE_SIZE)
     , mStatementsSize(
           app.getMetrics().NewCounter({"database", "memory", "statements"}))
-    , mEntryCache(4096)
+    , mStatementsPrepared(app.getMetrics().NewMeter(
+          {"database", "statement", "prepare"}, "statement"))
+    , mStatementCacheHit(app.getMetrics().NewMeter(
+          {"database", "statement", "cache-hit"}, "statement"))
+    , mStatementCacheMiss(app.getMetrics().NewMeter(
+          {"database", "statement", "cache-miss"}, "statement"))
+    , mEntryCache(ENTRY_CACHE_SIZE)
     , mExcludedQueryTime(0)
     , mExcludedTotalTime(0)
     , mLastIdleQueryTime(0)
@@ -100,6 +117,10 @@ Database::Database(Application& app)
     {
         setSerializable(mSession);
     }
+    if (app.getConfig().IN_MEMORY_LEDGER_STATE)
+    {
+        mLedgerState = make_unique<InMemoryLedgerState>();
+    }
 }
 
 void
@@ -246,15 +267,39 @@ Database::canUsePool() const
     return !(mApp.getConfig().DATABASE == ("sqlite3://:memory:"));
 }
 
+void
+Database::resetPreparedStatements()
+{
+    if (!isSqlite())
+    {
+        return;
+    }
+    // A sqlite statement that has returned a row but not been stepped to
+    // completion keeps its cursor, and with it a read transaction, open
+    // until it is next executed or finalized. Reset (rather than finalize)
+    // every cached statement so the handles survive the transaction boundary.
+    mStatements.for_each([](std::shared_ptr<soci::statement> const& st)
+                         {
+                             auto be =
+                                 dynamic_cast<soci::sqlite3_statement_backend*>(
+                                     st->get_backend());
+                             if (be && be->stmt_)
+                             {
+                                 sqlite_api::sqlite3_reset(be->stmt_);
+                                 be->databaseReady_ = true;
+                             }
+                         });
+}
+
 void
 Database::clearPreparedStatementCache()
 {
     // Flush all prepared statements; in sqlite they represent open cursors
     // and will conflict with any DROP TABLE commands issued below
-    for (auto st : mStatements)
-    {
-        st.second->clean_up(true);
-    }
+    mStatements.for_each([](std::shared_ptr<soci::statement> const& st)
+                         {
+                             st->clean_up(true);
+                         });
     mStatements.clear();
     mStatementsSize.set_count(mStatements.size());
 }
@@ -278,6 +323,10 @@ Database::initialize()
     TransactionFrame::dropAll(*this);
     HistoryManager::dropAll(*this);
     BucketManager::dropAll(mApp);
+    if (mLedgerState)
+    {
+        mLedgerState->clear();
+    }
     putSchemaVersion(1);
 }
 
@@ -319,12 +368,58 @@ Database::getPool()
     return *mPool;
 }
 
+size_t
+Database::deleteOldEntriesHelper(soci::session& sess, std::string const& table,
+                                 std::string const& column, uint32_t ledgerSeq,
+                                 uint32_t count)
+{
+    assert(count > 0);
+    int oldest;
+    soci::indicator oldestIndicator;
+    sess << "SELECT MIN(" << column << ") FROM " << table,
+        soci::into(oldest, oldestIndicator);
+    if (oldestIndicator != soci::indicator::i_ok ||
+        static_cast<uint32_t>(oldest) > ledgerSeq)
+    {
+        return 0;
+    }
+
+    uint32_t last = static_cast<uint32_t>(
+        std::min<uint64_t>(uint64_t(oldest) + count - 1, ledgerSeq));
+    soci::statement st = (sess.prepare << "DELETE FROM " << table << " WHERE "
+                                       << column << " <= :v1",
+                          soci::use(last));
+    st.execute(true);
+    return static_cast<size_t>(st.get_affected_rows());
+}
+
 cache::lru_cache<std::string, std::shared_ptr<LedgerEntry const>>&
 Database::getEntryCache()
 {
     return mEntryCache;
 }
 
+// set by setThreadLedgerState, for the database it was called on
+static thread_local Database* gThreadStateDatabase = nullptr;
+static thread_local InMemoryLedgerState* gThreadState = nullptr;
+
+InMemoryLedgerState*
+Database::getInMemoryLedgerState()
+{
+    if (gThreadState && gThreadStateDatabase == this)
+    {
+        return gThreadState;
+    }
+    return mLedgerState.get();
+}
+
+void
+Database::setThreadLedgerState(InMemoryLedgerState* layer)
+{
+    gThreadStateDatabase = layer ? this : nullptr;
+    gThreadState = layer;
+}
+
 class SQLLogContext : NonCopyable
 {
     std::string mName;
@@ -364,20 +459,24 @@ class SQLLogContext : NonCopyable
 StatementContext
 Database::getPreparedStatement(std::string const& query)
 {
-    auto i = mStatements.find(query);
     std::shared_ptr<soci::statement> p;
-    if (i == mStatements.end())
+    if (mStatements.exists(query))
     {
+        mStatementCacheHit.Mark();
+        p = mStatements.get(query);
+    }
+    else
+    {
+        mStatementCacheMiss.Mark();
+        mStatementsPrepared.Mark();
         p = std::make_shared<soci::statement>(mSession);
         p->alloc();
         p->prepare(query);
-        mStatements.insert(std::make_pair(query, p));
+        // Evicted statements are finalized once the last StatementContext
+        // borrowing them (if any) goes away.
+        mStatements.put(query, p);
         mStatementsSize.set_count(mStatements.size());
     }
-    else
-    {
-        p = i->second;
-    }
     StatementContext sc(p);
     return sc;
 }
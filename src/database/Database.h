@@ -8,6 +8,7 @@
 #include <set>
 #include <soci.h>
 #include "overlay/StellarXDR.h"
+#include "ledger/InMemoryLedgerState.h"
 #include "medida/timer_context.h"
 #include "util/NonCopyable.h"
 #include "util/lrucache.hpp"
@@ -89,12 +90,18 @@ class Database : NonMovableOrCopyable
     soci::session mSession;
     std::unique_ptr<soci::connection_pool> mPool;
 
-    std::map<std::string, std::shared_ptr<soci::statement>> mStatements;
+    cache::lru_cache<std::string, std::shared_ptr<soci::statement>>
+        mStatements;
     medida::Counter& mStatementsSize;
+    medida::Meter& mStatementsPrepared;
+    medida::Meter& mStatementCacheHit;
+    medida::Meter& mStatementCacheMiss;
 
     cache::lru_cache<std::string, std::shared_ptr<LedgerEntry const>>
         mEntryCache;
 
+    std::unique_ptr<InMemoryLedgerState> mLedgerState;
+
     // Helpers for maintaining the total query time and calculating
     // idle percentage.
     std::set<std::string> mEntityTypes;
@@ -139,11 +146,21 @@ class Database : NonMovableOrCopyable
     // Return a helper object that borrows, from the Database, a prepared
     // statement handle for the provided query. The prepared statement handle
     // is ceated if necessary before borrowing, and reset (unbound from data)
-    // when the statement context is destroyed.
+    // when the statement context is destroyed. Handles are kept in a bounded
+    // LRU cache and live across SQL transactions (and so across ledgers).
     StatementContext getPreparedStatement(std::string const& query);
 
+    // Release any open cursors or locks held by cached prepared statements
+    // without closing their handles. Call this around SQL transaction
+    // boundaries (commit, rollback); on SQLite a partially-stepped statement
+    // otherwise keeps its read snapshot (and WAL checkpointing) pinned. This
+    // is a no-op on postgresql, where prepared statements are not tied to
+    // transactions.
+    void resetPreparedStatements();
+
     // Purge all cached prepared statements, closing their handles with the
-    // database.
+    // database. Only needed before schema changes (DROP TABLE and friends),
+    // which SQLite refuses while statements are open against a table.
     void clearPreparedStatementCache();
 
     // Return metric-gathering timers for various families of SQL operation.
@@ -189,12 +206,33 @@ class Database : NonMovableOrCopyable
     // threads. Throws an error if !canUsePool().
     soci::connection_pool& getPool();
 
+    // Deletes the rows of `table` whose `column`, a ledger sequence number,
+    // is at most `ledgerSeq`; those of the oldest `count` ledgers at most.
+    // Returns the number of rows deleted: 0 once none are left.
+    static size_t deleteOldEntriesHelper(soci::session& sess,
+                                         std::string const& table,
+                                         std::string const& column,
+                                         uint32_t ledgerSeq, uint32_t count);
+
     // Access the LedgerEntry cache. Note: clients are responsible for
     // invalidating entries in this cache as they perform statements
     // against the database. It's kept here only for ease of access.
     typedef cache::lru_cache<std::string, std::shared_ptr<LedgerEntry const>>
         EntryCache;
     EntryCache& getEntryCache();
+    // Number of entries the LedgerEntry cache holds.
+    static size_t const ENTRY_CACHE_SIZE;
+
+    // The ledger entries, when they are kept in memory rather than in SQL
+    // (Config::IN_MEMORY_LEDGER_STATE), otherwise nullptr. Frames check this
+    // before issuing SQL against the ledger tables.
+    InMemoryLedgerState* getInMemoryLedgerState();
+
+    // Makes getInMemoryLedgerState return `layer`, a layer over the ledger
+    // state, on the calling thread only, until called again with nullptr.
+    // Lets transactions be applied on worker threads, each into its own
+    // layer.
+    void setThreadLedgerState(InMemoryLedgerState* layer);
 };
 
 class DBTimeExcluder : NonCopyable
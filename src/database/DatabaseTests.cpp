@@ -12,6 +12,8 @@
 #include "util/Timer.h"
 #include "util/TmpDir.h"
 #include "lib/catch.hpp"
+#include "medida/metrics_registry.h"
+#include "medida/meter.h"
 #include <random>
 
 using namespace stellar;
@@ -326,6 +328,53 @@ TEST_CASE("postgres performance", "[db][pgperf][hide]")
 
 #endif
 
+TEST_CASE("prepared statements survive transactions", "[db]")
+{
+    Config const& cfg = getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE);
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+
+    auto& db = app->getDatabase();
+    auto& session = db.getSession();
+    auto& prepares = app->getMetrics().NewMeter(
+        {"database", "statement", "prepare"}, "statement");
+    auto& hits = app->getMetrics().NewMeter(
+        {"database", "statement", "cache-hit"}, "statement");
+
+    session << "CREATE TABLE test (x INTEGER)";
+    session << "INSERT INTO test (x) VALUES (1)";
+    session << "INSERT INTO test (x) VALUES (2)";
+
+    std::string const q = "SELECT x FROM test ORDER BY x";
+    auto preparesBefore = prepares.count();
+    auto hitsBefore = hits.count();
+
+    for (int i = 0; i < 3; ++i)
+    {
+        soci::transaction tx(session);
+        int x = 0;
+        {
+            // Only step to the first row, leaving the cursor open.
+            auto prep = db.getPreparedStatement(q);
+            auto& st = prep.statement();
+            st.exchange(soci::into(x));
+            st.define_and_bind();
+            st.execute(true);
+        }
+        CHECK(x == 1);
+        session << "UPDATE test SET x = x + 0";
+        db.resetPreparedStatements();
+        tx.commit();
+    }
+
+    CHECK(prepares.count() == preparesBefore + 1);
+    CHECK(hits.count() == hitsBefore + 2);
+
+    // Schema changes still need the cache flushed on sqlite.
+    db.clearPreparedStatementCache();
+    session << "DROP TABLE test";
+}
+
 TEST_CASE("schema test", "[db]")
 {
     Config const& cfg = getTestConfig(0, Config::TESTDB_IN_MEMORY_SQLITE);
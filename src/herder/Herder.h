@@ -97,6 +97,12 @@ class Herder
     // We are learning about a new envelope.
     virtual void recvSCPEnvelope(SCPEnvelope const& envelope) = 0;
 
+    // A ledger was closed, creating or modifying `live` and deleting `dead`
+    // entries.
+    virtual void ledgerStateChanged(uint32_t ledgerSeq,
+                                    std::vector<LedgerEntry> const& live,
+                                    std::vector<LedgerKey> const& dead) = 0;
+
     // a peer needs our SCP state
     virtual void sendSCPStateToPeer(uint32 ledgerSeq, PeerPtr peer) = 0;
 
@@ -131,6 +137,8 @@ class Herder
                                          uint32_t ledgerCount,
                                          XDROutputFileStream& scpHistory);
     static void dropAll(Database& db);
-    static void deleteOldEntries(Database& db, uint32_t ledgerSeq);
+    // see Database::deleteOldEntriesHelper
+    static size_t deleteOldEntries(soci::session& sess, uint32_t ledgerSeq,
+                                   uint32_t count);
 };
 }
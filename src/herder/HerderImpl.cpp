@@ -101,7 +101,7 @@ HerderImpl::SCPMetrics::SCPMetrics(Application& app)
 HerderImpl::HerderImpl(Application& app)
     : mSCP(*this, app.getConfig().NODE_SEED, app.getConfig().NODE_IS_VALIDATOR,
            app.getConfig().QUORUM_SET)
-    , mPendingTransactions(4)
+    , mTransactionQueue(app)
     , mPendingEnvelopes(app, *this)
     , mLastSlotSaved(0)
     , mLastStateChange(app.getClock().now())
@@ -109,6 +109,7 @@ HerderImpl::HerderImpl(Application& app)
     , mLastTrigger(app.getClock().now())
     , mTriggerTimer(app)
     , mRebroadcastTimer(app)
+    , mSpeculationTimer(app)
     , mApp(app)
     , mLedgerManager(app.getLedgerManager())
     , mSCPMetrics(app)
@@ -487,34 +488,6 @@ HerderImpl::updateSCPCounters()
         mSCP.getCumulativeStatemtCount());
 }
 
-static uint64_t
-countTxs(HerderImpl::AccountTxMap const& acc)
-{
-    uint64_t sz = 0;
-    for (auto const& a : acc)
-    {
-        sz += a.second->mTransactions.size();
-    }
-    return sz;
-}
-
-static std::shared_ptr<HerderImpl::TxMap>
-findOrAdd(HerderImpl::AccountTxMap& acc, AccountID const& aid)
-{
-    std::shared_ptr<HerderImpl::TxMap> txmap = nullptr;
-    auto i = acc.find(aid);
-    if (i == acc.end())
-    {
-        txmap = std::make_shared<HerderImpl::TxMap>();
-        acc.insert(std::make_pair(aid, txmap));
-    }
-    else
-    {
-        txmap = i->second;
-    }
-    return txmap;
-}
-
 void
 HerderImpl::logQuorumInformation(uint64 index)
 {
@@ -777,8 +750,8 @@ HerderImpl::combineCandidates(uint64 slotIndex,
                                 << " invalid transactions";
 
         // post to avoid triggering SCP handling code recursively
-        mApp.getClock().getIOService().post(
-            [this, bestTxSet]()
+        mApp.getClock().postAction(
+            Scheduler::CONSENSUS, [this, bestTxSet]()
             {
                 mPendingEnvelopes.recvTxSet(bestTxSet->getContentsHash(),
                                             bestTxSet);
@@ -870,80 +843,28 @@ HerderImpl::emitEnvelope(SCPEnvelope const& envelope)
     startRebroadcastTimer();
 }
 
-void
-HerderImpl::TxMap::addTx(TransactionFramePtr tx)
-{
-    auto const& h = tx->getFullHash();
-    if (mTransactions.find(h) != mTransactions.end())
-    {
-        return;
-    }
-    mTransactions.insert(std::make_pair(h, tx));
-    mMaxSeq = std::max(tx->getSeqNum(), mMaxSeq);
-    mTotalFees += tx->getFee();
-}
-
-void
-HerderImpl::TxMap::recalculate()
-{
-    mMaxSeq = 0;
-    mTotalFees = 0;
-    for (auto const& pair : mTransactions)
-    {
-        mMaxSeq = std::max(pair.second->getSeqNum(), mMaxSeq);
-        mTotalFees += pair.second->getFee();
-    }
-}
-
 Herder::TransactionSubmitStatus
 HerderImpl::recvTransaction(TransactionFramePtr tx)
 {
     soci::transaction sqltx(mApp.getDatabase().getSession());
     mApp.getDatabase().setCurrentTransactionReadOnly();
 
-    auto const& acc = tx->getSourceID();
-    auto const& txID = tx->getFullHash();
+    auto status = mTransactionQueue.tryAdd(tx);
 
-    // determine if we have seen this tx before and if not if it has the right
-    // seq num
-    int64_t totFee = tx->getFee();
-    SequenceNumber highSeq = 0;
+    if (status == TX_STATUS_PENDING && Logging::logTrace("Herder"))
+        CLOG(TRACE, "Herder") << "recv transaction "
+                              << hexAbbrev(tx->getFullHash()) << " for "
+                              << PubKeyUtils::toShortString(tx->getSourceID());
 
-    for (auto& map : mPendingTransactions)
-    {
-        auto i = map.find(acc);
-        if (i != map.end())
-        {
-            auto& txmap = i->second;
-            auto j = txmap->mTransactions.find(txID);
-            if (j != txmap->mTransactions.end())
-            {
-                return TX_STATUS_DUPLICATE;
-            }
-            totFee += txmap->mTotalFees;
-            highSeq = std::max(highSeq, txmap->mMaxSeq);
-        }
-    }
-
-    if (!tx->checkValid(mApp, highSeq))
-    {
-        return TX_STATUS_ERROR;
-    }
-
-    if (tx->getSourceAccount().getBalanceAboveReserve(mLedgerManager) < totFee)
-    {
-        tx->getResult().result.code(txINSUFFICIENT_BALANCE);
-        return TX_STATUS_ERROR;
-    }
-
-    if (Logging::logTrace("Herder"))
-        CLOG(TRACE, "Herder") << "recv transaction " << hexAbbrev(txID) << " for "
-                              << PubKeyUtils::toShortString(acc);
-
-    auto txmap = findOrAdd(mPendingTransactions[0], acc);
-    txmap->addTx(tx);
+    return status;
+}
 
-    return TX_STATUS_PENDING;
+void
+HerderImpl::ledgerStateChanged(uint32_t ledgerSeq,
+                               std::vector<LedgerEntry> const& live,
+                               std::vector<LedgerKey> const& dead)
+{
+    mTransactionQueue.ledgerStateChanged(ledgerSeq, live, dead);
 }
 
 void
@@ -1168,49 +1089,6 @@ HerderImpl::ledgerClosed()
                                  &VirtualTimer::onFailureNoop);
 }
 
-void
-HerderImpl::removeReceivedTxs(std::vector<TransactionFramePtr> const& dropTxs)
-{
-    for (auto& m : mPendingTransactions)
-    {
-        if (m.empty())
-        {
-            continue;
-        }
-
-        std::set<std::shared_ptr<TxMap>> toRecalculate;
-
-        for (auto const& tx : dropTxs)
-        {
-            auto const& acc = tx->getSourceID();
-            auto const& txID = tx->getFullHash();
-            auto i = m.find(acc);
-            if (i != m.end())
-            {
-                auto& txs = i->second->mTransactions;
-                auto j = txs.find(txID);
-                if (j != txs.end())
-                {
-                    txs.erase(j);
-                    if (txs.empty())
-                    {
-                        m.erase(i);
-                    }
-                    else
-                    {
-                        toRecalculate.insert(i->second);
-                    }
-                }
-            }
-        }
-
-        for (auto txm : toRecalculate)
-        {
-            txm->recalculate();
-        }
-    }
-}
-
 void
 HerderImpl::recvSCPQuorumSet(Hash const& hash, const SCPQuorumSet& qset)
 {
@@ -1262,17 +1140,7 @@ HerderImpl::getCurrentLedgerSeq() const
 SequenceNumber
 HerderImpl::getMaxSeqInPendingTxs(AccountID const& acc)
 {
-    SequenceNumber highSeq = 0;
-    for (auto const& m : mPendingTransactions)
-    {
-        auto i = m.find(acc);
-        if (i == m.end())
-        {
-            continue;
-        }
-        highSeq = std::max(i->second->mMaxSeq, highSeq);
-    }
-    return highSeq;
+    return mTransactionQueue.getMaxSeq(acc);
 }
 
 // called to take a position during the next round
@@ -1289,24 +1157,11 @@ HerderImpl::triggerNextLedger(uint32_t ledgerSeqToTrigger)
     updateSCPCounters();
 
     // our first choice for this round's set is all the tx we have collected
-    // during last ledger close
+    // during last ledger close; the queue only revalidates the accounts that
+    // changed since
     auto const& lcl = mLedgerManager.getLastClosedLedgerHeader();
-    TxSetFramePtr proposedSet = std::make_shared<TxSetFrame>(lcl.hash);
-
-    for (auto const& m : mPendingTransactions)
-    {
-        for (auto const& pair : m)
-        {
-            for (auto const& tx : pair.second->mTransactions)
-            {
-                proposedSet->add(tx.second);
-            }
-        }
-    }
-
     std::vector<TransactionFramePtr> removed;
-    proposedSet->trimInvalid(mApp, removed);
-    removeReceivedTxs(removed);
+    TxSetFramePtr proposedSet = mTransactionQueue.toTxSet(lcl.hash, removed);
 
     proposedSet->surgePricingFilter(mLedgerManager);
 
@@ -1451,23 +1306,67 @@ void
 HerderImpl::startedBallotProtocol(uint64 slotIndex, SCPBallot const& ballot)
 {
     mSCPMetrics.mStartBallotProtocol.Mark();
+    speculativelyClose(slotIndex, ballot);
 }
 void
 HerderImpl::acceptedBallotPrepared(uint64 slotIndex, SCPBallot const& ballot)
 {
     mSCPMetrics.mAcceptedBallotPrepared.Mark();
+    speculativelyClose(slotIndex, ballot);
 }
 
 void
 HerderImpl::confirmedBallotPrepared(uint64 slotIndex, SCPBallot const& ballot)
 {
     mSCPMetrics.mConfirmedBallotPrepared.Mark();
+    speculativelyClose(slotIndex, ballot);
 }
 
 void
 HerderImpl::acceptedCommit(uint64 slotIndex, SCPBallot const& ballot)
 {
     mSCPMetrics.mAcceptedCommit.Mark();
+    speculativelyClose(slotIndex, ballot);
+}
+
+void
+HerderImpl::speculativelyClose(uint64 slotIndex, SCPBallot const& ballot)
+{
+    if (!mApp.getConfig().SPECULATIVE_LEDGER_CLOSE)
+    {
+        return;
+    }
+
+    // resetting the timer drops any speculation still pending: only the
+    // latest ballot is worth applying
+    Value value = ballot.value;
+    mSpeculationTimer.expires_from_now(std::chrono::nanoseconds(0));
+    mSpeculationTimer.async_wait(
+        [this, slotIndex, value]()
+        {
+            if (slotIndex != mLedgerManager.getLedgerNum())
+            {
+                return;
+            }
+            StellarValue b;
+            try
+            {
+                xdr::xdr_from_opaque(value, b);
+            }
+            catch (...)
+            {
+                return;
+            }
+            TxSetFramePtr txSet = mPendingEnvelopes.getTxSet(b.txSetHash);
+            if (!txSet)
+            {
+                return;
+            }
+            LedgerCloseData ledgerData(static_cast<uint32>(slotIndex), txSet,
+                                       b);
+            mLedgerManager.speculativelyCloseLedger(ledgerData);
+        },
+        &VirtualTimer::onFailureNoop);
 }
 
 void
@@ -1624,29 +1523,17 @@ void
 HerderImpl::updatePendingTransactions(
     std::vector<TransactionFramePtr> const& applied)
 {
-    // remove all these tx from mPendingTransactions
-    removeReceivedTxs(applied);
-
-    // drop the highest level
-    mPendingTransactions.erase(--mPendingTransactions.end());
-
-    // shift entries up
-    mPendingTransactions.emplace_front();
+    // remove all these tx from the queue, age and expire the others
+    mTransactionQueue.removeAppliedAndShift(applied);
 
     // rebroadcast entries, sorted in apply-order to maximize chances of
     // propagation
     {
         Hash h;
         TxSetFrame toBroadcast(h);
-        for (auto const& l : mPendingTransactions)
+        for (auto const& tx : mTransactionQueue.getTransactions())
         {
-            for (auto const& pair : l)
-            {
-                for (auto const& tx : pair.second->mTransactions)
-                {
-                    toBroadcast.add(tx.second);
-                }
-            }
+            toBroadcast.add(tx);
         }
         for (auto tx : toBroadcast.sortForApply())
         {
@@ -1655,10 +1542,11 @@ HerderImpl::updatePendingTransactions(
         }
     }
 
-    mSCPMetrics.mHerderPendingTxs0.set_count(countTxs(mPendingTransactions[0]));
-    mSCPMetrics.mHerderPendingTxs1.set_count(countTxs(mPendingTransactions[1]));
-    mSCPMetrics.mHerderPendingTxs2.set_count(countTxs(mPendingTransactions[2]));
-    mSCPMetrics.mHerderPendingTxs3.set_count(countTxs(mPendingTransactions[3]));
+    auto byAge = mTransactionQueue.sizeByAge();
+    mSCPMetrics.mHerderPendingTxs0.set_count(byAge[0]);
+    mSCPMetrics.mHerderPendingTxs1.set_count(byAge[1]);
+    mSCPMetrics.mHerderPendingTxs2.set_count(byAge[2]);
+    mSCPMetrics.mHerderPendingTxs3.set_count(byAge[3]);
 }
 
 void
@@ -1914,12 +1802,13 @@ Herder::dropAll(Database& db)
                        ")";
 }
 
-void
-Herder::deleteOldEntries(Database& db, uint32_t ledgerSeq)
+size_t
+Herder::deleteOldEntries(soci::session& sess, uint32_t ledgerSeq,
+                         uint32_t count)
 {
-    db.getSession() << "DELETE FROM scphistory WHERE ledgerseq <= "
-                    << ledgerSeq;
-    db.getSession() << "DELETE FROM scpquorums WHERE lastledgerseq <= "
-                    << ledgerSeq;
+    return Database::deleteOldEntriesHelper(sess, "scphistory", "ledgerseq",
+                                            ledgerSeq, count) +
+           Database::deleteOldEntriesHelper(sess, "scpquorums",
+                                            "lastledgerseq", ledgerSeq, count);
 }
 }
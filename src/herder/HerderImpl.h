@@ -12,6 +12,7 @@
 #include "scp/SCP.h"
 #include "util/Timer.h"
 #include "PendingEnvelopes.h"
+#include "herder/TransactionQueue.h"
 
 namespace medida
 {
@@ -98,6 +99,10 @@ class HerderImpl : public Herder, public SCPDriver
 
     void recvSCPEnvelope(SCPEnvelope const& envelope) override;
 
+    void ledgerStateChanged(uint32_t ledgerSeq,
+                            std::vector<LedgerEntry> const& live,
+                            std::vector<LedgerKey> const& dead) override;
+
     void sendSCPStateToPeer(uint32 ledgerSeq, PeerPtr peer) override;
 
     void recvSCPQuorumSet(Hash const& hash, const SCPQuorumSet& qset) override;
@@ -123,20 +128,9 @@ class HerderImpl : public Herder, public SCPDriver
     void dumpQuorumInfo(Json::Value& ret, NodeID const& id, bool summary,
                         uint64 index) override;
 
-    struct TxMap
-    {
-        SequenceNumber mMaxSeq{0};
-        int64_t mTotalFees{0};
-        std::unordered_map<Hash, TransactionFramePtr> mTransactions;
-        void addTx(TransactionFramePtr);
-        void recalculate();
-    };
-    typedef std::unordered_map<AccountID, std::shared_ptr<TxMap>> AccountTxMap;
-
   private:
     void logQuorumInformation(uint64 index);
     void ledgerClosed();
-    void removeReceivedTxs(std::vector<TransactionFramePtr> const& txs);
 
     void saveSCPHistory(uint64 index);
 
@@ -159,11 +153,9 @@ class HerderImpl : public Herder, public SCPDriver
     // this slot
     bool isSlotCompatibleWithCurrentState(uint64 slotIndex);
 
-    // 0- tx we got during ledger close
-    // 1- one ledger ago. rebroadcast
-    // 2- two ledgers ago. rebroadcast
-    // ...
-    std::deque<AccountTxMap> mPendingTransactions;
+    // transactions received and not yet included in a ledger
+    // (rebroadcast every ledger until they are, or age out)
+    TransactionQueue mTransactionQueue;
 
     void
     updatePendingTransactions(std::vector<TransactionFramePtr> const& applied);
@@ -231,6 +223,12 @@ class HerderImpl : public Herder, public SCPDriver
 
     VirtualTimer mRebroadcastTimer;
 
+    // speculatively closes the ledger with the value of `ballot` once the
+    // current SCP message is processed (see
+    // LedgerManager::speculativelyCloseLedger)
+    void speculativelyClose(uint64 slotIndex, SCPBallot const& ballot);
+    VirtualTimer mSpeculationTimer;
+
     uint32_t mLedgerSeqNominating;
     Value mCurrentValue;
 
@@ -3,6 +3,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "herder/HerderImpl.h"
+#include "herder/TransactionQueue.h"
 #include "scp/SCP.h"
 #include "main/Application.h"
 #include "main/Config.h"
@@ -19,6 +20,7 @@
 #include "ledger/LedgerHeaderFrame.h"
 #include "simulation/Simulation.h"
 #include "overlay/OverlayManager.h"
+#include "util/Logging.h"
 
 #include "xdrpp/marshal.h"
 
@@ -302,6 +304,285 @@ TEST_CASE("txset", "[herder]")
     }
 }
 
+TEST_CASE("txset with many accounts", "[herder]")
+{
+    // enough accounts for the set to be checked on worker threads, reading
+    // through the connection pool of an on-disk database
+    Config cfg(getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE));
+
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+
+    Hash const& networkID = app->getNetworkID();
+    app->start();
+
+    auto root = TestAccount::createRoot(*app);
+
+    const int nbAccounts = 32;
+    const int nbTransactions = 3;
+    const int64_t paymentAmount = app->getLedgerManager().getMinBalance(0);
+
+    std::vector<TestAccount> accounts;
+    for (int i = 0; i < nbAccounts - 1; i++)
+    {
+        accounts.emplace_back(root.create("A" + std::to_string(i),
+                                          paymentAmount * 10));
+    }
+    // can just pay the fees of its transactions
+    accounts.emplace_back(root.create(
+        "poor", paymentAmount +
+                    nbTransactions * app->getLedgerManager().getTxFee()));
+
+    TxSetFramePtr txSet = std::make_shared<TxSetFrame>(
+        app->getLedgerManager().getLastClosedLedgerHeader().hash);
+    for (auto& a : accounts)
+    {
+        for (int j = 0; j < nbTransactions; j++)
+        {
+            txSet->add(createPaymentTx(networkID, a, root,
+                                       a.nextSequenceNumber(), paymentAmount));
+        }
+    }
+    txSet->sortForHash();
+
+    REQUIRE(txSet->checkValid(*app));
+    std::vector<TransactionFramePtr> removed;
+    txSet->trimInvalid(*app, removed);
+    REQUIRE(removed.empty());
+    REQUIRE(txSet->size() == nbAccounts * nbTransactions);
+
+    SECTION("invalid chains")
+    {
+        // sequence gap for the first account, unknown source account and
+        // insufficient balance for the last one
+        auto& first = accounts.front();
+        txSet->add(createPaymentTx(networkID, first, root,
+                                   first.getLastSequenceNumber() + 2,
+                                   paymentAmount));
+        txSet->add(createPaymentTx(networkID, getAccount("nobody"), root, 1,
+                                   paymentAmount));
+        auto& last = accounts.back();
+        txSet->add(createPaymentTx(networkID, last, root,
+                                   last.nextSequenceNumber(), paymentAmount));
+        txSet->sortForHash();
+        REQUIRE(!txSet->checkValid(*app));
+
+        txSet->trimInvalid(*app, removed);
+        REQUIRE(txSet->checkValid(*app));
+        REQUIRE(txSet->size() == (nbAccounts - 1) * nbTransactions);
+        for (auto const& tx : txSet->mTransactions)
+        {
+            REQUIRE(!(tx->getSourceID() == last.getPublicKey()));
+        }
+    }
+}
+
+TEST_CASE("txset hashing benchmark", "[herder-bench][bench][hide]")
+{
+    Hash networkID = sha256(getTestConfig().NETWORK_PASSPHRASE);
+    size_t const nbAccounts = 1000;
+    size_t const nbTransactions = 10000;
+
+    std::vector<SecretKey> accounts;
+    for (size_t i = 0; i < nbAccounts; i++)
+    {
+        accounts.emplace_back(SecretKey::random());
+    }
+    std::vector<TransactionFramePtr> txs;
+    for (size_t i = 0; i < nbTransactions; i++)
+    {
+        auto& source = accounts[i % nbAccounts];
+        txs.emplace_back(createPaymentTx(networkID, source, accounts[0],
+                                         i / nbAccounts + 1, 100));
+    }
+
+    LOG(INFO) << "Benchmarking a set of " << nbTransactions
+              << " transactions from " << nbAccounts << " accounts";
+
+    auto txSet = std::make_shared<TxSetFrame>(sha256("previous ledger"));
+    {
+        TIMED_SCOPE(timerBlkObj, "build");
+        for (auto& tx : txs)
+        {
+            txSet->add(tx);
+        }
+        txSet->sortForHash();
+    }
+    Hash setHash;
+    {
+        TIMED_SCOPE(timerBlkObj, "hash");
+        setHash = txSet->getContentsHash();
+    }
+    std::vector<TransactionFramePtr> applyOrder;
+    {
+        TIMED_SCOPE(timerBlkObj, "sortForApply");
+        applyOrder = txSet->sortForApply();
+    }
+    REQUIRE(applyOrder.size() == nbTransactions);
+
+    // frames decoded afresh must agree with the cached encodings
+    TransactionSet xdrSet;
+    txSet->toXDR(xdrSet);
+    TxSetFrame fromWire(networkID, xdrSet);
+    REQUIRE(fromWire.getContentsHash() == setHash);
+    auto wireOrder = fromWire.sortForApply();
+    for (size_t i = 0; i < nbTransactions; i++)
+    {
+        REQUIRE(wireOrder[i]->getFullHash() == applyOrder[i]->getFullHash());
+        REQUIRE(wireOrder[i]->getContentsHash() ==
+                applyOrder[i]->getContentsHash());
+    }
+}
+
+TEST_CASE("transaction queue", "[herder]")
+{
+    Config cfg(getTestConfig());
+
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+
+    Hash const& networkID = app->getNetworkID();
+    app->start();
+
+    auto& lm = app->getLedgerManager();
+    auto& db = app->getDatabase();
+
+    auto root = TestAccount::createRoot(*app);
+    auto destAccount = root.create("destAccount", 500000000);
+    auto accountB = root.create("accountB", 5000000000);
+
+    TransactionQueue queue(*app);
+    auto add = [&](TransactionFramePtr tx)
+    {
+        soci::transaction sqltx(db.getSession());
+        return queue.tryAdd(tx);
+    };
+    auto lclHash = [&]()
+    {
+        return lm.getLastClosedLedgerHeader().hash;
+    };
+
+    auto tx1 = createPaymentTx(networkID, root, destAccount,
+                               root.nextSequenceNumber(), 100);
+    auto tx2 = createPaymentTx(networkID, root, destAccount,
+                               root.nextSequenceNumber(), 100);
+
+    REQUIRE(add(tx1) == Herder::TX_STATUS_PENDING);
+    REQUIRE(add(tx2) == Herder::TX_STATUS_PENDING);
+    REQUIRE(queue.size() == 2);
+    REQUIRE(queue.getMaxSeq(root.getPublicKey()) == tx2->getSeqNum());
+
+    SECTION("duplicate")
+    {
+        REQUIRE(add(tx2) == Herder::TX_STATUS_DUPLICATE);
+        REQUIRE(queue.size() == 2);
+    }
+
+    SECTION("sequence gap")
+    {
+        root.nextSequenceNumber();
+        auto tx4 = createPaymentTx(networkID, root, destAccount,
+                                   root.nextSequenceNumber(), 100);
+        REQUIRE(add(tx4) == Herder::TX_STATUS_ERROR);
+        REQUIRE(queue.size() == 2);
+    }
+
+    SECTION("tx set")
+    {
+        std::vector<TransactionFramePtr> trimmed;
+        auto txSet = queue.toTxSet(lclHash(), trimmed);
+        REQUIRE(trimmed.empty());
+        REQUIRE(txSet->mTransactions.size() == 2);
+        REQUIRE(txSet->checkValid(*app));
+    }
+
+    SECTION("applied and aged out")
+    {
+        queue.removeAppliedAndShift({tx1});
+        REQUIRE(queue.size() == 1);
+        REQUIRE(queue.sizeByAge()[1] == 1);
+        REQUIRE(queue.getMaxSeq(root.getPublicKey()) == tx2->getSeqNum());
+
+        // tx1 never made it to the database: tx2 now has a sequence gap
+        std::vector<TransactionFramePtr> trimmed;
+        auto txSet = queue.toTxSet(lclHash(), trimmed);
+        REQUIRE(trimmed.size() == 1);
+        REQUIRE(txSet->mTransactions.empty());
+        REQUIRE(queue.size() == 0);
+        REQUIRE(queue.getMaxSeq(root.getPublicKey()) == 0);
+    }
+
+    SECTION("expiry")
+    {
+        for (uint32_t i = 0; i < TransactionQueue::PENDING_DEPTH - 1; i++)
+        {
+            queue.removeAppliedAndShift({});
+            REQUIRE(queue.size() == 2);
+        }
+        queue.removeAppliedAndShift({});
+        REQUIRE(queue.size() == 0);
+        REQUIRE(queue.getMaxSeq(root.getPublicKey()) == 0);
+    }
+
+    SECTION("eviction when full")
+    {
+        lm.getCurrentLedgerHeader().maxTxSetSize = 1;
+        size_t const maxSize = TransactionQueue::QUEUE_SIZE_MULTIPLIER;
+        while (queue.size() < maxSize)
+        {
+            REQUIRE(add(createPaymentTx(networkID, root, destAccount,
+                                        root.nextSequenceNumber(), 100)) ==
+                    Herder::TX_STATUS_PENDING);
+        }
+
+        auto cheap = createPaymentTx(networkID, accountB, destAccount,
+                                     accountB.getLastSequenceNumber() + 1,
+                                     100);
+        REQUIRE(add(cheap) == Herder::TX_STATUS_ERROR);
+        REQUIRE(cheap->getResultCode() == txINSUFFICIENT_FEE);
+
+        auto rich = createPaymentTx(networkID, accountB, destAccount,
+                                    accountB.nextSequenceNumber(), 100);
+        rich->getEnvelope().tx.fee = rich->getEnvelope().tx.fee * 2;
+        reSignTransaction(*rich, accountB);
+        REQUIRE(add(rich) == Herder::TX_STATUS_PENDING);
+        REQUIRE(queue.size() == maxSize);
+        REQUIRE(queue.getMaxSeq(root.getPublicKey()) ==
+                root.getLastSequenceNumber() - 1);
+    }
+
+    SECTION("eviction goes by the last transaction of each chain")
+    {
+        lm.getCurrentLedgerHeader().maxTxSetSize = 1;
+        size_t const maxSize = TransactionQueue::QUEUE_SIZE_MULTIPLIER;
+        // signed again once the fee is set, so that it and the hashes the
+        // queue keys it by cover the fee paid
+        auto withFee = [&](TestAccount& from, TestAccount& to,
+                           int64_t multiplier)
+        {
+            auto tx = createPaymentTx(networkID, from, to,
+                                      from.nextSequenceNumber(), 100);
+            tx->getEnvelope().tx.fee = tx->getEnvelope().tx.fee * multiplier;
+            reSignTransaction(*tx, from);
+            return tx;
+        };
+
+        // root's chain ends with its best paying transaction
+        REQUIRE(add(withFee(root, destAccount, 3)) ==
+                Herder::TX_STATUS_PENDING);
+        REQUIRE(add(withFee(accountB, destAccount, 2)) ==
+                Herder::TX_STATUS_PENDING);
+        REQUIRE(queue.size() == maxSize);
+
+        REQUIRE(add(withFee(destAccount, accountB, 4)) ==
+                Herder::TX_STATUS_PENDING);
+        REQUIRE(queue.size() == maxSize);
+        REQUIRE(queue.getMaxSeq(accountB.getPublicKey()) == 0);
+        REQUIRE(queue.getMaxSeq(root.getPublicKey()) ==
+                root.getLastSequenceNumber());
+    }
+}
+
 // under surge
 // over surge
 // make sure it drops the correct txs
@@ -373,6 +654,7 @@ TEST_CASE("surge", "[herder]")
             auto tx = createPaymentTx(networkID, accountB, destAccount,
                                       accountB.nextSequenceNumber(), n + 10);
             tx->getEnvelope().tx.fee = tx->getEnvelope().tx.fee * 2;
+            reSignTransaction(*tx, accountB);
             txSet->add(tx);
         }
         txSet->sortForHash();
@@ -393,12 +675,16 @@ TEST_CASE("surge", "[herder]")
             auto tx = createPaymentTx(networkID, root, destAccount, root.nextSequenceNumber(),
                                       n + 10);
             tx->getEnvelope().tx.fee = tx->getEnvelope().tx.fee * 2;
+            reSignTransaction(*tx, root);
             txSet->add(tx);
 
             tx = createPaymentTx(networkID, accountB, destAccount,
                                  accountB.nextSequenceNumber(), n + 10);
             if (n != 1)
+            {
                 tx->getEnvelope().tx.fee = tx->getEnvelope().tx.fee * 3;
+                reSignTransaction(*tx, accountB);
+            }
             txSet->add(tx);
         }
         txSet->sortForHash();
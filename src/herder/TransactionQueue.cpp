@@ -0,0 +1,482 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/asio.h"
+#include "herder/TransactionQueue.h"
+#include "crypto/Hex.h"
+#include "database/Database.h"
+#include "ledger/LedgerManager.h"
+#include "main/Application.h"
+#include "util/Logging.h"
+
+#include <algorithm>
+
+namespace stellar
+{
+
+using xdr::operator==;
+
+uint32_t const TransactionQueue::PENDING_DEPTH = 4;
+uint32_t const TransactionQueue::QUEUE_SIZE_MULTIPLIER = 4;
+
+TransactionQueue::TransactionQueue(Application& app)
+    : mApp(app)
+    , mSize(0)
+    , mLastLedgerSeq(0)
+    , mBaseFee(0)
+    , mBaseReserve(0)
+    , mLedgerVersion(0)
+{
+}
+
+size_t
+TransactionQueue::maxSize() const
+{
+    return QUEUE_SIZE_MULTIPLIER * mApp.getLedgerManager().getMaxTxSetSize();
+}
+
+size_t
+TransactionQueue::size() const
+{
+    return mSize;
+}
+
+std::vector<size_t>
+TransactionQueue::sizeByAge() const
+{
+    std::vector<size_t> res(PENDING_DEPTH, 0);
+    for (auto const& acc : mAccounts)
+    {
+        for (auto const& qtx : acc.second.mTransactions)
+        {
+            res[qtx.mAge]++;
+        }
+    }
+    return res;
+}
+
+SequenceNumber
+TransactionQueue::getMaxSeq(AccountID const& acc) const
+{
+    auto i = mAccounts.find(acc);
+    if (i == mAccounts.end() || i->second.mTransactions.empty())
+    {
+        return 0;
+    }
+    return i->second.mTransactions.back().mTx->getSeqNum();
+}
+
+std::vector<TransactionFramePtr>
+TransactionQueue::getTransactions() const
+{
+    std::vector<TransactionFramePtr> res;
+    res.reserve(mSize);
+    for (auto const& acc : mAccounts)
+    {
+        for (auto const& qtx : acc.second.mTransactions)
+        {
+            res.push_back(qtx.mTx);
+        }
+    }
+    return res;
+}
+
+void
+TransactionQueue::invalidateAll()
+{
+    for (auto& acc : mAccounts)
+    {
+        acc.second.mValid = false;
+    }
+}
+
+void
+TransactionQueue::addDependencies(AccountID const& acc, AccountTxQueue& q,
+                                  TransactionFramePtr const& tx)
+{
+    auto const& env = tx->getEnvelope();
+    if (env.tx.timeBounds)
+    {
+        q.mHasTimeBounds = true;
+    }
+    for (auto const& op : env.tx.operations)
+    {
+        if (op.sourceAccount && !(*op.sourceAccount == acc))
+        {
+            if (q.mDependencies.insert(*op.sourceAccount).second)
+            {
+                mDependents[*op.sourceAccount].insert(acc);
+            }
+        }
+    }
+}
+
+// The fee ratio, times the base fee all transactions share: orders chains
+// the same way, and stays put when the base fee changes.
+static double
+feePerOperation(TransactionFramePtr const& tx)
+{
+    auto ops = std::max<size_t>(1, tx->getEnvelope().tx.operations.size());
+    return (double)tx->getFee() / (double)ops;
+}
+
+// Called whenever the last transaction of a chain changes.
+void
+TransactionQueue::indexTail(AccountID const& acc, AccountTxQueue& q)
+{
+    if (q.mIndexed)
+    {
+        mByTailFee.erase(q.mTail);
+        q.mIndexed = false;
+    }
+    if (!q.mTransactions.empty())
+    {
+        q.mTail = mByTailFee.emplace(
+            feePerOperation(q.mTransactions.back().mTx), acc);
+        q.mIndexed = true;
+    }
+}
+
+void
+TransactionQueue::dropFrom(AccountID const& acc, AccountTxQueue& q,
+                           std::deque<QueuedTransaction>::iterator from,
+                           std::vector<TransactionFramePtr>* dropped)
+{
+    if (from == q.mTransactions.end())
+    {
+        return;
+    }
+    for (auto it = from; it != q.mTransactions.end(); ++it)
+    {
+        q.mTotalFees -= it->mTx->getFee();
+        mKnown.erase(it->mTx->getFullHash());
+        --mSize;
+        if (dropped)
+        {
+            dropped->push_back(it->mTx);
+        }
+    }
+    q.mTransactions.erase(from, q.mTransactions.end());
+    indexTail(acc, q);
+}
+
+void
+TransactionQueue::eraseAccount(AccountID const& acc)
+{
+    auto i = mAccounts.find(acc);
+    if (i == mAccounts.end())
+    {
+        return;
+    }
+    assert(i->second.mTransactions.empty() && !i->second.mIndexed);
+    for (auto const& dep : i->second.mDependencies)
+    {
+        auto j = mDependents.find(dep);
+        if (j != mDependents.end())
+        {
+            j->second.erase(acc);
+            if (j->second.empty())
+            {
+                mDependents.erase(j);
+            }
+        }
+    }
+    mAccounts.erase(i);
+}
+
+// Find the chain whose last transaction pays the lowest fee ratio and, if the
+// incoming transaction pays strictly more, evict that last transaction; repeat
+// until there is room. The chain of tx's own source account is never a
+// candidate as evicting its tail would leave tx with a sequence gap.
+bool
+TransactionQueue::makeRoomFor(TransactionFramePtr const& tx)
+{
+    double ratio = feePerOperation(tx);
+
+    while (mSize >= maxSize())
+    {
+        auto lowest = mByTailFee.begin();
+        if (lowest != mByTailFee.end() && lowest->second == tx->getSourceID())
+        {
+            ++lowest;
+        }
+        if (lowest == mByTailFee.end() || lowest->first >= ratio)
+        {
+            return false;
+        }
+        AccountID acc = lowest->second;
+        auto i = mAccounts.find(acc);
+        assert(i != mAccounts.end());
+        auto& q = i->second;
+        CLOG(DEBUG, "Herder") << "Transaction queue full, evicting "
+                              << hexAbbrev(
+                                     q.mTransactions.back().mTx->getFullHash());
+        dropFrom(acc, q, --q.mTransactions.end(), nullptr);
+        if (q.mTransactions.empty())
+        {
+            eraseAccount(acc);
+        }
+    }
+    return true;
+}
+
+Herder::TransactionSubmitStatus
+TransactionQueue::tryAdd(TransactionFramePtr tx)
+{
+    auto const& acc = tx->getSourceID();
+
+    if (mKnown.find(tx->getFullHash()) != mKnown.end())
+    {
+        return Herder::TX_STATUS_DUPLICATE;
+    }
+
+    SequenceNumber highSeq = 0;
+    int64_t totFee = tx->getFee();
+    auto i = mAccounts.find(acc);
+    if (i != mAccounts.end() && !i->second.mTransactions.empty())
+    {
+        highSeq = i->second.mTransactions.back().mTx->getSeqNum();
+        totFee += i->second.mTotalFees;
+    }
+
+    if (!tx->checkValid(mApp, highSeq))
+    {
+        return Herder::TX_STATUS_ERROR;
+    }
+
+    auto& lm = mApp.getLedgerManager();
+    if (tx->getSourceAccount().getBalanceAboveReserve(lm) < totFee)
+    {
+        tx->getResult().result.code(txINSUFFICIENT_BALANCE);
+        return Herder::TX_STATUS_ERROR;
+    }
+
+    if (mSize >= maxSize() && !makeRoomFor(tx))
+    {
+        tx->getResult().result.code(txINSUFFICIENT_FEE);
+        return Herder::TX_STATUS_ERROR;
+    }
+
+    auto& q = mAccounts[acc];
+    q.mTransactions.push_back({tx, 0});
+    q.mTotalFees += tx->getFee();
+    indexTail(acc, q);
+    addDependencies(acc, q, tx);
+    mKnown.insert(tx->getFullHash());
+    ++mSize;
+
+    return Herder::TX_STATUS_PENDING;
+}
+
+void
+TransactionQueue::removeAppliedAndShift(
+    std::vector<TransactionFramePtr> const& applied)
+{
+    for (auto const& tx : applied)
+    {
+        auto i = mAccounts.find(tx->getSourceID());
+        if (i == mAccounts.end())
+        {
+            continue;
+        }
+        auto& txs = i->second.mTransactions;
+        auto j = std::find_if(txs.begin(), txs.end(),
+                              [&](QueuedTransaction const& qtx)
+                              {
+                                  return qtx.mTx->getFullHash() ==
+                                         tx->getFullHash();
+                              });
+        if (j != txs.end())
+        {
+            i->second.mTotalFees -= j->mTx->getFee();
+            mKnown.erase(j->mTx->getFullHash());
+            --mSize;
+            txs.erase(j);
+            indexTail(i->first, i->second);
+            // the source account's sequence number moved, whatever is left
+            // needs to be checked again
+            i->second.mValid = false;
+        }
+    }
+
+    std::vector<AccountID> emptied;
+    for (auto& acc : mAccounts)
+    {
+        auto& q = acc.second;
+        // ages are non-increasing along a chain, so the expired transactions
+        // are a prefix of it; what remains has a sequence gap until the
+        // account catches up, and gets trimmed on revalidation
+        auto it = q.mTransactions.begin();
+        while (it != q.mTransactions.end() && it->mAge + 1 >= PENDING_DEPTH)
+        {
+            q.mTotalFees -= it->mTx->getFee();
+            mKnown.erase(it->mTx->getFullHash());
+            --mSize;
+            ++it;
+        }
+        if (it != q.mTransactions.begin())
+        {
+            q.mTransactions.erase(q.mTransactions.begin(), it);
+            indexTail(acc.first, q);
+            q.mValid = false;
+        }
+        for (auto& qtx : q.mTransactions)
+        {
+            qtx.mAge++;
+        }
+        if (q.mTransactions.empty())
+        {
+            emptied.push_back(acc.first);
+        }
+    }
+    for (auto const& acc : emptied)
+    {
+        eraseAccount(acc);
+    }
+}
+
+void
+TransactionQueue::ledgerStateChanged(uint32_t ledgerSeq,
+                                     std::vector<LedgerEntry> const& live,
+                                     std::vector<LedgerKey> const& dead)
+{
+    if (ledgerSeq != mLastLedgerSeq + 1)
+    {
+        // we missed some ledgers (catchup, restart); can't tell what changed
+        invalidateAll();
+    }
+    mLastLedgerSeq = ledgerSeq;
+
+    auto touch = [this](AccountID const& id)
+    {
+        auto i = mAccounts.find(id);
+        if (i != mAccounts.end())
+        {
+            i->second.mValid = false;
+        }
+        auto j = mDependents.find(id);
+        if (j != mDependents.end())
+        {
+            for (auto const& acc : j->second)
+            {
+                auto k = mAccounts.find(acc);
+                if (k != mAccounts.end())
+                {
+                    k->second.mValid = false;
+                }
+            }
+        }
+    };
+
+    for (auto const& e : live)
+    {
+        if (e.data.type() == ACCOUNT)
+        {
+            touch(e.data.account().accountID);
+        }
+    }
+    for (auto const& k : dead)
+    {
+        if (k.type() == ACCOUNT)
+        {
+            touch(k.account().accountID);
+        }
+    }
+}
+
+// Same checks as TxSetFrame::trimInvalid, restricted to one chain: the first
+// transaction that fails validation is dropped along with everything after
+// it (their sequence numbers can't line up anymore), and the whole chain is
+// dropped if the account can't pay for it.
+void
+TransactionQueue::validateChain(AccountID const& acc, AccountTxQueue& q,
+                                std::vector<TransactionFramePtr>& trimmed)
+{
+    SequenceNumber lastSeq = 0;
+    TransactionFramePtr lastTx;
+    int64_t totFee = 0;
+
+    auto it = q.mTransactions.begin();
+    for (; it != q.mTransactions.end(); ++it)
+    {
+        if (!it->mTx->checkValid(mApp, lastSeq))
+        {
+            break;
+        }
+        totFee += it->mTx->getFee();
+        lastTx = it->mTx;
+        lastSeq = it->mTx->getSeqNum();
+    }
+    dropFrom(acc, q, it, &trimmed);
+
+    if (lastTx)
+    {
+        int64_t newBalance = lastTx->getSourceAccount().getBalance() - totFee;
+        if (newBalance < lastTx->getSourceAccount().getMinimumBalance(
+                             mApp.getLedgerManager()))
+        {
+            dropFrom(acc, q, q.mTransactions.begin(), &trimmed);
+        }
+    }
+
+    q.mHasTimeBounds = false;
+    for (auto const& qtx : q.mTransactions)
+    {
+        if (qtx.mTx->getEnvelope().tx.timeBounds)
+        {
+            q.mHasTimeBounds = true;
+        }
+    }
+    q.mValid = true;
+}
+
+TxSetFramePtr
+TransactionQueue::toTxSet(Hash const& lclHash,
+                          std::vector<TransactionFramePtr>& trimmed)
+{
+    auto& lm = mApp.getLedgerManager();
+    auto const& header = lm.getCurrentLedgerHeader();
+    if (lm.getLastClosedLedgerNum() != mLastLedgerSeq ||
+        header.baseFee != mBaseFee || header.baseReserve != mBaseReserve ||
+        header.ledgerVersion != mLedgerVersion)
+    {
+        invalidateAll();
+        mLastLedgerSeq = lm.getLastClosedLedgerNum();
+        mBaseFee = header.baseFee;
+        mBaseReserve = header.baseReserve;
+        mLedgerVersion = header.ledgerVersion;
+    }
+
+    auto proposedSet = std::make_shared<TxSetFrame>(lclHash);
+    std::vector<AccountID> emptied;
+    {
+        soci::transaction sqltx(mApp.getDatabase().getSession());
+        mApp.getDatabase().setCurrentTransactionReadOnly();
+
+        for (auto& acc : mAccounts)
+        {
+            auto& q = acc.second;
+            if (!q.mValid || q.mHasTimeBounds)
+            {
+                validateChain(acc.first, q, trimmed);
+            }
+            if (q.mTransactions.empty())
+            {
+                emptied.push_back(acc.first);
+            }
+            for (auto const& qtx : q.mTransactions)
+            {
+                proposedSet->add(qtx.mTx);
+            }
+        }
+    }
+    for (auto const& acc : emptied)
+    {
+        eraseAccount(acc);
+    }
+
+    proposedSet->sortForHash();
+    return proposedSet;
+}
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "herder/Herder.h"
+#include "herder/TxSetFrame.h"
+#include "transactions/TransactionFrame.h"
+#include "util/HashOfHash.h"
+
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace stellar
+{
+class Application;
+
+/*
+ * Transactions received by the Herder and waiting to be included in a ledger,
+ * indexed by source account.
+ *
+ * Each account holds a chain of transactions with consecutive sequence
+ * numbers, together with the total fee the chain commits the account to. A
+ * chain is checked against the database when transactions are added and
+ * afterwards only when a closed ledger changes something it depends on: one
+ * of the accounts it reads (transaction and operation source accounts), the
+ * ledger parameters (base fee, base reserve, protocol version), or the close
+ * time for transactions carrying time bounds. Building a transaction set is
+ * then O(accounts touched by the last ledger) in database work rather than
+ * O(pending transactions).
+ *
+ * Memory is bounded: the queue holds at most QUEUE_SIZE_MULTIPLIER ledgers
+ * worth of transactions (as per maxTxSetSize). When full, the last
+ * transaction of the chain whose last transaction pays the lowest fee ratio
+ * is evicted, if that is lower than what the incoming transaction pays;
+ * chains are indexed by that ratio so that this is O(log accounts).
+ * Transactions not included in a ledger after PENDING_DEPTH ledger closes
+ * are dropped.
+ */
+class TransactionQueue
+{
+  public:
+    static uint32_t const PENDING_DEPTH;
+    static uint32_t const QUEUE_SIZE_MULTIPLIER;
+
+    explicit TransactionQueue(Application& app);
+
+    // Validates `tx` against the chain of its source account and appends it.
+    // Callers are expected to hold a (read-only) SQL transaction.
+    Herder::TransactionSubmitStatus tryAdd(TransactionFramePtr tx);
+
+    // Removes the transactions that made it into a ledger, ages the others
+    // and drops the ones that have been pending for PENDING_DEPTH ledgers.
+    void removeAppliedAndShift(std::vector<TransactionFramePtr> const& applied);
+
+    // Records which accounts ledger `ledgerSeq` created, modified or deleted,
+    // so that chains depending on them are revalidated.
+    void ledgerStateChanged(uint32_t ledgerSeq,
+                            std::vector<LedgerEntry> const& live,
+                            std::vector<LedgerKey> const& dead);
+
+    // Revalidates stale chains, dropping (and returning in `trimmed`) the
+    // transactions that are no longer valid, and returns a set built out of
+    // everything left, sorted for hashing.
+    TxSetFramePtr toTxSet(Hash const& lclHash,
+                          std::vector<TransactionFramePtr>& trimmed);
+
+    std::vector<TransactionFramePtr> getTransactions() const;
+
+    // Return the highest sequence number queued for `acc`, or 0 if none.
+    SequenceNumber getMaxSeq(AccountID const& acc) const;
+
+    size_t size() const;
+
+    // Number of queued transactions, indexed by age (in ledgers).
+    std::vector<size_t> sizeByAge() const;
+
+  private:
+    struct QueuedTransaction
+    {
+        TransactionFramePtr mTx;
+        uint32_t mAge;
+    };
+
+    // fee per operation of the last transaction of a chain -> its account
+    typedef std::multimap<double, AccountID> TailIndex;
+
+    struct AccountTxQueue
+    {
+        // consecutive sequence numbers, oldest first
+        std::deque<QueuedTransaction> mTransactions;
+        // entry in mByTailFee, if mIndexed
+        TailIndex::iterator mTail;
+        bool mIndexed{false};
+        int64_t mTotalFees{0};
+        // accounts other than the source account read during validation
+        std::unordered_set<AccountID> mDependencies;
+        bool mHasTimeBounds{false};
+        // false when something the chain depends on changed since it was
+        // last validated
+        bool mValid{true};
+    };
+
+    Application& mApp;
+    std::unordered_map<AccountID, AccountTxQueue> mAccounts;
+    // reverse index of AccountTxQueue::mDependencies
+    std::unordered_map<AccountID, std::unordered_set<AccountID>> mDependents;
+    TailIndex mByTailFee;
+    std::unordered_set<Hash> mKnown;
+    size_t mSize;
+
+    // the last ledger reported through ledgerStateChanged and the ledger
+    // parameters chains were last validated with
+    uint32_t mLastLedgerSeq;
+    uint32_t mBaseFee;
+    uint32_t mBaseReserve;
+    uint32_t mLedgerVersion;
+
+    size_t maxSize() const;
+    void invalidateAll();
+    void addDependencies(AccountID const& acc, AccountTxQueue& q,
+                         TransactionFramePtr const& tx);
+    void indexTail(AccountID const& acc, AccountTxQueue& q);
+    void dropFrom(AccountID const& acc, AccountTxQueue& q,
+                  std::deque<QueuedTransaction>::iterator from,
+                  std::vector<TransactionFramePtr>* dropped);
+    void eraseAccount(AccountID const& acc);
+    void validateChain(AccountID const& acc, AccountTxQueue& q,
+                       std::vector<TransactionFramePtr>& trimmed);
+    bool makeRoomFor(TransactionFramePtr const& tx);
+};
+}
@@ -11,7 +11,11 @@
 #include "main/Application.h"
 #include "main/Config.h"
 #include "database/Database.h"
+#include "ledger/AccountFrame.h"
+#include "util/ParallelLoop.h"
 #include <algorithm>
+#include <atomic>
+#include <thread>
 
 #include "xdrpp/printer.h"
 
@@ -57,24 +61,6 @@ TxSetFrame::sortForHash()
     mHashIsValid = false;
 }
 
-// We want to XOR the tx hash with the set hash.
-// This way people can't predict the order that txs will be applied in
-struct ApplyTxSorter
-{
-    Hash const& mSetHash;
-    ApplyTxSorter(Hash const& h) : mSetHash(h)
-    {
-    }
-
-    bool operator()(TransactionFramePtr const& tx1,
-                    TransactionFramePtr const& tx2) const
-    {
-        // need to use the hash of whole tx here since multiple txs could have
-        // the same Contents
-        return lessThanXored(tx1->getFullHash(), tx2->getFullHash(), mSetHash);
-    }
-};
-
 static bool
 SeqSorter(TransactionFramePtr const& tx1, TransactionFramePtr const& tx2)
 {
@@ -117,15 +103,35 @@ TxSetFrame::sortForApply()
 
     retList.clear();
 
+    // randomize each batch using the hash of the transaction set
+    // as a way to randomize even more: we XOR the tx hash with the set hash,
+    // this way people can't predict the order that txs will be applied in.
+    // Need to use the hash of whole tx here since multiple txs could have the
+    // same Contents. Keys are computed once per tx rather than per comparison.
+    Hash const& setHash = getContentsHash();
+    vector<pair<Hash, TransactionFramePtr>> keyed;
     for (auto& batch : txBatches)
     {
-        // randomize each batch using the hash of the transaction set
-        // as a way to randomize even more
-        ApplyTxSorter s(getContentsHash());
-        std::sort(batch.begin(), batch.end(), s);
-        for (auto tx : batch)
+        keyed.clear();
+        keyed.reserve(batch.size());
+        for (auto& tx : batch)
+        {
+            Hash key = tx->getFullHash();
+            for (size_t i = 0; i < key.size(); i++)
+            {
+                key[i] ^= setHash[i];
+            }
+            keyed.emplace_back(key, tx);
+        }
+        std::sort(keyed.begin(), keyed.end(),
+                  [](pair<Hash, TransactionFramePtr> const& a,
+                     pair<Hash, TransactionFramePtr> const& b)
+                  {
+                      return a.first < b.first;
+                  });
+        for (auto& k : keyed)
         {
-            retList.push_back(tx);
+            retList.push_back(k.second);
         }
     }
 
@@ -185,58 +191,212 @@ TxSetFrame::surgePricingFilter(LedgerManager const& lm)
     }
 }
 
-// TODO.3 this and checkValid share a lot of code
-void
-TxSetFrame::trimInvalid(Application& app,
-                        std::vector<TransactionFramePtr>& trimmed)
+// Below this many source accounts, handing chains over to worker threads
+// costs more than it saves.
+static size_t const MIN_ACCOUNTS_FOR_PARALLEL_CHECK = 8;
+
+// Validates the transactions of a single source account, sorted by sequence
+// number. When `trimming`, carries on past invalid transactions and collects
+// them in `invalid` (along with the whole chain if the account can't pay for
+// the ones left); otherwise stops and logs at the first problem. Reads
+// accounts from `accounts` when given, from the main database session
+// otherwise.
+bool
+TxSetFrame::checkAccountChain(Application& app,
+                              vector<TransactionFramePtr> const& chain,
+                              TransactionFrame::AccountEntries const* accounts,
+                              bool trimming,
+                              vector<TransactionFramePtr>& invalid) const
 {
-    soci::transaction sqltx(app.getDatabase().getSession());
-    app.getDatabase().setCurrentTransactionReadOnly();
+    TransactionFramePtr lastTx;
+    SequenceNumber lastSeq = 0;
+    int64_t totFee = 0;
+    for (auto& tx : chain)
+    {
+        bool valid = accounts ? tx->checkValid(app, lastSeq, *accounts)
+                              : tx->checkValid(app, lastSeq);
+        if (!valid)
+        {
+            if (!trimming)
+            {
+                CLOG(DEBUG, "Herder")
+                    << "bad txSet: " << hexAbbrev(mPreviousLedgerHash)
+                    << " tx invalid"
+                    << " lastSeq:" << lastSeq
+                    << " tx: " << xdr::xdr_to_string(tx->getEnvelope())
+                    << " result: " << tx->getResultCode();
+                return false;
+            }
+            invalid.push_back(tx);
+            continue;
+        }
+        totFee += tx->getFee();
 
-    sortForHash();
+        lastTx = tx;
+        lastSeq = tx->getSeqNum();
+    }
+    if (lastTx)
+    {
+        // make sure account can pay the fee for all these tx
+        int64_t newBalance = lastTx->getSourceAccount().getBalance() - totFee;
+        if (newBalance < lastTx->getSourceAccount().getMinimumBalance(
+                             app.getLedgerManager()))
+        {
+            if (!trimming)
+            {
+                CLOG(DEBUG, "Herder")
+                    << "bad txSet: " << hexAbbrev(mPreviousLedgerHash)
+                    << " account can't pay fee"
+                    << " tx:" << xdr::xdr_to_string(lastTx->getEnvelope());
+                return false;
+            }
+            invalid.insert(invalid.end(), chain.begin(), chain.end());
+        }
+    }
+    return invalid.empty();
+}
+
+// Runs checkAccountChain over every chain, on the main thread and, for large
+// enough sets when the database has a connection pool, on worker threads
+// loading accounts through pooled sessions. Accounts are independent at
+// validation time, so chains can be checked in any order. Unless `trimming`,
+// stops at the first invalid chain. Returns whether all chains are valid.
+bool
+TxSetFrame::checkAccountChains(
+    Application& app, vector<vector<TransactionFramePtr>> const& chains,
+    bool trimming, vector<vector<TransactionFramePtr>>& invalid) const
+{
+    invalid.clear();
+    invalid.resize(chains.size());
+    auto loop = make_shared<ParallelLoop>(chains.size());
+    std::atomic<bool> failed{false};
+
+    auto& db = app.getDatabase();
+    size_t nWorkers = 0;
+    // accounts held in memory are read faster than workers could be handed
+    // the chains
+    if (chains.size() >= MIN_ACCOUNTS_FOR_PARALLEL_CHECK && db.canUsePool() &&
+        !db.getInMemoryLedgerState())
+    {
+        nWorkers = std::min<size_t>(std::thread::hardware_concurrency(),
+                                    chains.size() - 1);
+    }
+
+    auto runChains = [&](TransactionFrame::AccountEntries* accounts,
+                         soci::session* sess)
+    {
+        size_t i;
+        while (loop->next(i))
+        {
+            if (sess)
+            {
+                for (auto const& tx : chains[i])
+                {
+                    for (auto const& id : tx->getValidationAccounts())
+                    {
+                        if (accounts->find(id) == accounts->end())
+                        {
+                            auto acc = AccountFrame::loadAccount(id, *sess);
+                            (*accounts)[id] =
+                                acc ? make_shared<LedgerEntry const>(
+                                          acc->mEntry)
+                                    : nullptr;
+                        }
+                    }
+                }
+            }
+            if (!checkAccountChain(app, chains[i], accounts, trimming,
+                                   invalid[i]))
+            {
+                failed = true;
+                if (!trimming)
+                {
+                    loop->stop();
+                }
+            }
+        }
+    };
+
+    if (nWorkers != 0)
+    {
+        auto& pool = db.getPool();
+        bool readOnly = !db.isSqlite();
+        loop->help(app.getWorkerIOService(), nWorkers,
+                   [&pool, readOnly, runChains]()
+                   {
+                       size_t pos;
+                       if (!pool.try_lease(pos, 0))
+                       {
+                           return;
+                       }
+                       try
+                       {
+                           auto& sess = pool.at(pos);
+                           soci::transaction sqltx(sess);
+                           if (readOnly)
+                           {
+                               sess << "SET TRANSACTION READ ONLY";
+                           }
+                           TransactionFrame::AccountEntries accounts;
+                           runChains(&accounts, &sess);
+                       }
+                       catch (...)
+                       {
+                           pool.give_back(pos);
+                           throw;
+                       }
+                       pool.give_back(pos);
+                   });
+    }
+
+    loop->run([&]()
+              {
+                  runChains(nullptr, nullptr);
+              });
+    return !failed;
+}
 
+// Groups the transactions by source account, ordered by sequence number.
+static vector<vector<TransactionFramePtr>>
+accountChains(vector<TransactionFramePtr> const& txs)
+{
     map<AccountID, vector<TransactionFramePtr>> accountTxMap;
 
-    for (auto tx : mTransactions)
+    for (auto tx : txs)
     {
         accountTxMap[tx->getSourceID()].push_back(tx);
     }
 
+    vector<vector<TransactionFramePtr>> res;
+    res.reserve(accountTxMap.size());
     for (auto& item : accountTxMap)
     {
         // order by sequence number
         std::sort(item.second.begin(), item.second.end(), SeqSorter);
+        res.emplace_back(std::move(item.second));
+    }
+    return res;
+}
 
-        TransactionFramePtr lastTx;
-        SequenceNumber lastSeq = 0;
-        int64_t totFee = 0;
-        for (auto& tx : item.second)
-        {
-            if (!tx->checkValid(app, lastSeq))
-            {
-                trimmed.push_back(tx);
-                removeTx(tx);
-                continue;
-            }
-            totFee += tx->getFee();
+void
+TxSetFrame::trimInvalid(Application& app,
+                        std::vector<TransactionFramePtr>& trimmed)
+{
+    soci::transaction sqltx(app.getDatabase().getSession());
+    app.getDatabase().setCurrentTransactionReadOnly();
 
-            lastTx = tx;
-            lastSeq = tx->getSeqNum();
-        }
-        if (lastTx)
+    sortForHash();
+
+    auto chains = accountChains(mTransactions);
+    vector<vector<TransactionFramePtr>> invalid;
+    checkAccountChains(app, chains, true, invalid);
+
+    for (auto const& txs : invalid)
+    {
+        for (auto& tx : txs)
         {
-            // make sure account can pay the fee for all these tx
-            int64_t newBalance =
-                lastTx->getSourceAccount().getBalance() - totFee;
-            if (newBalance < lastTx->getSourceAccount().getMinimumBalance(
-                                 app.getLedgerManager()))
-            {
-                for (auto& tx : item.second)
-                {
-                    trimmed.push_back(tx);
-                    removeTx(tx);
-                }
-            }
+            trimmed.push_back(tx);
+            removeTx(tx);
         }
     }
 }
@@ -271,8 +431,6 @@ TxSetFrame::checkValid(Application& app) const
         return false;
     }
 
-    map<AccountID, vector<TransactionFramePtr>> accountTxMap;
-
     Hash lastHash;
     for (auto tx : mTransactions)
     {
@@ -284,54 +442,12 @@ TxSetFrame::checkValid(Application& app) const
                 << " not sorted correctly";
             return false;
         }
-        accountTxMap[tx->getSourceID()].push_back(tx);
         lastHash = tx->getFullHash();
     }
 
-    for (auto& item : accountTxMap)
-    {
-        // order by sequence number
-        std::sort(item.second.begin(), item.second.end(), SeqSorter);
-
-        TransactionFramePtr lastTx;
-        SequenceNumber lastSeq = 0;
-        int64_t totFee = 0;
-        for (auto& tx : item.second)
-        {
-            if (!tx->checkValid(app, lastSeq))
-            {
-                CLOG(DEBUG, "Herder")
-                    << "bad txSet: " << hexAbbrev(mPreviousLedgerHash)
-                    << " tx invalid"
-                    << " lastSeq:" << lastSeq
-                    << " tx: " << xdr::xdr_to_string(tx->getEnvelope())
-                    << " result: " << tx->getResultCode();
-
-                return false;
-            }
-            totFee += tx->getFee();
-
-            lastTx = tx;
-            lastSeq = tx->getSeqNum();
-        }
-        if (lastTx)
-        {
-            // make sure account can pay the fee for all these tx
-            int64_t newBalance =
-                lastTx->getSourceAccount().getBalance() - totFee;
-            if (newBalance < lastTx->getSourceAccount().getMinimumBalance(
-                                 app.getLedgerManager()))
-            {
-                CLOG(DEBUG, "Herder")
-                    << "bad txSet: " << hexAbbrev(mPreviousLedgerHash)
-                    << " account can't pay fee"
-                    << " tx:" << xdr::xdr_to_string(lastTx->getEnvelope());
-
-                return false;
-            }
-        }
-    }
-    return true;
+    auto chains = accountChains(mTransactions);
+    vector<vector<TransactionFramePtr>> invalid;
+    return checkAccountChains(app, chains, false, invalid);
 }
 
 void
@@ -353,7 +469,7 @@ TxSetFrame::getContentsHash()
         hasher->add(mPreviousLedgerHash);
         for (unsigned int n = 0; n < mTransactions.size(); n++)
         {
-            hasher->add(xdr::xdr_to_opaque(mTransactions[n]->getEnvelope()));
+            hasher->add(mTransactions[n]->getEnvelopeBytes());
         }
         mHash = hasher->finish();
         mHashIsValid = true;
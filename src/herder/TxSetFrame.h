@@ -21,6 +21,17 @@ class TxSetFrame
 
     Hash mPreviousLedgerHash;
 
+    bool checkAccountChain(Application& app,
+                           std::vector<TransactionFramePtr> const& chain,
+                           TransactionFrame::AccountEntries const* accounts,
+                           bool trimming,
+                           std::vector<TransactionFramePtr>& invalid) const;
+    bool checkAccountChains(
+        Application& app,
+        std::vector<std::vector<TransactionFramePtr>> const& chains,
+        bool trimming,
+        std::vector<std::vector<TransactionFramePtr>>& invalid) const;
+
   public:
     std::vector<TransactionFramePtr> mTransactions;
 
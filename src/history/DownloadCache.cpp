@@ -0,0 +1,291 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "history/DownloadCache.h"
+#include "crypto/Hex.h"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "util/Fs.h"
+#include "util/Logging.h"
+
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <set>
+#include <vector>
+
+namespace stellar
+{
+
+static char const* kJournalOpPut = "put";
+static char const* kJournalOpVerify = "verify";
+static char const* kJournalOpDrop = "drop";
+
+DownloadCache::DownloadCache(Application& app)
+    : mDir(app.getConfig().HISTORY_CACHE_DIR_PATH.empty()
+               ? ""
+               : app.getConfig().HISTORY_CACHE_DIR_PATH + "/" +
+                     binToHex(app.getNetworkID()))
+    , mHit(app.getMetrics().NewMeter({"history", "cache", "hit"}, "file"))
+    , mMiss(app.getMetrics().NewMeter({"history", "cache", "miss"}, "file"))
+{
+    if (isEnabled())
+    {
+        load();
+    }
+}
+
+bool
+DownloadCache::isEnabled() const
+{
+    return !mDir.empty();
+}
+
+bool
+DownloadCache::isCacheable(std::string const& remote)
+{
+    std::string suf(".xdr.gz");
+    return remote.size() >= suf.size() &&
+           std::equal(suf.rbegin(), suf.rend(), remote.rbegin());
+}
+
+std::string
+DownloadCache::entryName(std::string const& archive, std::string const& remote)
+{
+    return archive + "/" + remote;
+}
+
+std::string
+DownloadCache::cachePath(std::string const& entry) const
+{
+    return mDir + "/" + entry;
+}
+
+std::string
+DownloadCache::journalPath() const
+{
+    return mDir + "/journal";
+}
+
+void
+DownloadCache::load()
+{
+    if (!fs::exists(mDir) && !fs::mkpath(mDir))
+    {
+        throw std::runtime_error("Unable to create history cache directory: " +
+                                 mDir);
+    }
+
+    {
+        std::ifstream in(journalPath());
+        std::string op, entry;
+        while (in >> op >> entry)
+        {
+            if (op == kJournalOpPut)
+            {
+                mEntries[entry] = false;
+            }
+            else if (op == kJournalOpVerify)
+            {
+                auto i = mEntries.find(entry);
+                if (i != mEntries.end())
+                {
+                    i->second = true;
+                }
+            }
+            else if (op == kJournalOpDrop)
+            {
+                mEntries.erase(entry);
+            }
+        }
+    }
+
+    std::vector<std::string> missing;
+    for (auto const& e : mEntries)
+    {
+        if (!fs::exists(cachePath(e.first)))
+        {
+            missing.push_back(e.first);
+        }
+    }
+    for (auto const& m : missing)
+    {
+        mEntries.erase(m);
+    }
+
+    // rewrite the journal without the history of each entry
+    auto tmp = journalPath() + ".tmp";
+    {
+        std::ofstream out(tmp, std::ofstream::trunc);
+        for (auto const& e : mEntries)
+        {
+            out << kJournalOpPut << " " << e.first << "\n";
+            if (e.second)
+            {
+                out << kJournalOpVerify << " " << e.first << "\n";
+            }
+        }
+        if (!out)
+        {
+            throw std::runtime_error("Unable to write history cache journal " +
+                                     tmp);
+        }
+    }
+    if (std::rename(tmp.c_str(), journalPath().c_str()) != 0)
+    {
+        throw std::runtime_error("Unable to rename history cache journal " +
+                                 tmp);
+    }
+
+    mJournal.open(journalPath(), std::ofstream::app);
+    CLOG(INFO, "History") << "History cache " << mDir << " holds "
+                          << mEntries.size() << " files";
+}
+
+void
+DownloadCache::append(std::string const& op, std::string const& entry)
+{
+    // flushed line by line: the journal must not claim files the cache does
+    // not have, but may miss the last few after a crash
+    mJournal << op << " " << entry << std::endl;
+}
+
+void
+DownloadCache::drop(std::string const& entry)
+{
+    mEntries.erase(entry);
+    append(kJournalOpDrop, entry);
+    std::remove(cachePath(entry).c_str());
+}
+
+bool
+DownloadCache::fetch(std::string const& archive, std::string const& remote,
+                     std::string const& local)
+{
+    if (!isEnabled() || !isCacheable(remote))
+    {
+        return false;
+    }
+    auto entry = entryName(archive, remote);
+    auto i = mEntries.find(entry);
+    if (i == mEntries.end())
+    {
+        mMiss.Mark();
+        return false;
+    }
+    if (!fs::linkOrCopy(cachePath(entry), local))
+    {
+        drop(entry);
+        mMiss.Mark();
+        return false;
+    }
+    CLOG(DEBUG, "History") << "Found " << entry << " in history cache";
+    mUsed[remote] = entry;
+    mHit.Mark();
+    return true;
+}
+
+void
+DownloadCache::store(std::string const& archive, std::string const& remote,
+                     std::string const& local)
+{
+    if (!isEnabled() || !isCacheable(remote))
+    {
+        return;
+    }
+    auto entry = entryName(archive, remote);
+    auto path = cachePath(entry);
+    auto dir = path.substr(0, path.rfind('/'));
+    if (!fs::exists(dir) && !fs::mkpath(dir))
+    {
+        CLOG(WARNING, "History") << "Unable to create history cache directory "
+                                 << dir;
+        return;
+    }
+    // link or copy under a temporary name first, so that the cache never
+    // holds partial files
+    auto tmp = path + ".tmp";
+    if (!fs::linkOrCopy(local, tmp) ||
+        std::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        CLOG(WARNING, "History") << "Unable to add " << remote
+                                 << " to history cache";
+        std::remove(tmp.c_str());
+        return;
+    }
+    mEntries[entry] = false;
+    mUsed[remote] = entry;
+    append(kJournalOpPut, entry);
+}
+
+void
+DownloadCache::markVerified(std::string const& remote)
+{
+    auto u = mUsed.find(remote);
+    if (u == mUsed.end())
+    {
+        return;
+    }
+    auto i = mEntries.find(u->second);
+    if (i != mEntries.end() && !i->second)
+    {
+        i->second = true;
+        append(kJournalOpVerify, i->first);
+    }
+}
+
+bool
+DownloadCache::isVerified(std::string const& archive,
+                          std::string const& remote) const
+{
+    auto i = mEntries.find(entryName(archive, remote));
+    return i != mEntries.end() && i->second;
+}
+
+void
+DownloadCache::releaseUsed()
+{
+    mUsed.clear();
+}
+
+void
+DownloadCache::dropUsed()
+{
+    // a failure does not say which file caused it: a file verified on its
+    // own may still not fit the rest of the chain, so none is kept
+    std::set<std::string> dropped;
+    for (auto const& u : mUsed)
+    {
+        dropped.insert(u.second);
+    }
+    for (auto const& e : mEntries)
+    {
+        if (!e.second)
+        {
+            dropped.insert(e.first);
+        }
+    }
+    mUsed.clear();
+    if (!dropped.empty())
+    {
+        CLOG(INFO, "History") << "Dropping " << dropped.size()
+                              << " files from history cache";
+    }
+    for (auto const& d : dropped)
+    {
+        if (mEntries.find(d) != mEntries.end())
+        {
+            drop(d);
+        }
+    }
+}
+
+size_t
+DownloadCache::size() const
+{
+    return mEntries.size();
+}
+}
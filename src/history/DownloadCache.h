@@ -0,0 +1,90 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include <fstream>
+#include <map>
+#include <string>
+
+namespace medida
+{
+class Meter;
+}
+
+namespace stellar
+{
+
+class Application;
+
+/**
+ * Local copy of files downloaded from history archives, kept in
+ * HISTORY_CACHE_DIR_PATH under the network ID, the name of the archive they
+ * came from and their name in it, so that a catchup interrupted by a
+ * restart, or a catchup done again over the same history, does not download
+ * them again; a file is never reused for another network or archive.
+ *
+ * Only XDR files are cached: archives never rewrite them once published
+ * (buckets are even named by the hash of their contents), unlike the
+ * history archive state files.
+ *
+ * The cache keeps a journal of its entries, each marked as verified once
+ * the file checked out against the trusted ledger chain (hash chain of
+ * ledger headers, hashes of transaction sets and buckets). When a catchup
+ * fails, every entry it used, verified or not, is dropped along with the
+ * entries that are not verified, so that no file that may have caused the
+ * failure is used again.
+ *
+ * Ledgers applied during catchup are tracked by the last closed ledger
+ * stored in the database, from which a restarted catchup starts.
+ */
+class DownloadCache
+{
+    std::string mDir;
+    // "<archive>/<remote>" -> verified
+    std::map<std::string, bool> mEntries;
+    // remote -> entry fetched or stored for it by the running catchup
+    std::map<std::string, std::string> mUsed;
+    std::ofstream mJournal;
+
+    medida::Meter& mHit;
+    medida::Meter& mMiss;
+
+    static std::string entryName(std::string const& archive,
+                                 std::string const& remote);
+    std::string cachePath(std::string const& entry) const;
+    std::string journalPath() const;
+    void load();
+    void append(std::string const& op, std::string const& entry);
+    void drop(std::string const& entry);
+
+  public:
+    explicit DownloadCache(Application& app);
+
+    bool isEnabled() const;
+    static bool isCacheable(std::string const& remote);
+
+    // Puts the file cached for name `remote` in `archive` at `local`;
+    // returns false if there is none.
+    bool fetch(std::string const& archive, std::string const& remote,
+               std::string const& local);
+
+    // Adds `local`, downloaded as name `remote` from `archive`, to the
+    // cache.
+    void store(std::string const& archive, std::string const& remote,
+               std::string const& local);
+
+    // Marks the entry the running catchup used for `remote` as verified.
+    void markVerified(std::string const& remote);
+    bool isVerified(std::string const& archive,
+                    std::string const& remote) const;
+
+    // Called when a catchup ends: on success, keeps the entries it used; on
+    // failure, drops them, and every unverified entry.
+    void releaseUsed();
+    void dropUsed();
+
+    size_t size() const;
+};
+}
@@ -278,12 +278,23 @@ HistoryArchiveState::HistoryArchiveState(uint32_t ledgerSeq,
     }
 }
 
+size_t const HistoryArchive::DEFAULT_MAX_CONCURRENT_UPLOADS = 4;
+
 HistoryArchive::HistoryArchive(std::string const& name,
                                std::string const& getCmd,
                                std::string const& putCmd,
-                               std::string const& mkdirCmd)
-    : mName(name), mGetCmd(getCmd), mPutCmd(putCmd), mMkdirCmd(mkdirCmd)
+                               std::string const& mkdirCmd,
+                               size_t maxConcurrentUploads)
+    : mName(name)
+    , mGetCmd(getCmd)
+    , mPutCmd(putCmd)
+    , mMkdirCmd(mkdirCmd)
+    , mMaxConcurrentUploads(maxConcurrentUploads)
 {
+    if (mMaxConcurrentUploads == 0)
+    {
+        throw std::invalid_argument("max_uploads must be positive");
+    }
 }
 
 HistoryArchive::~HistoryArchive()
@@ -314,6 +325,12 @@ HistoryArchive::getName() const
     return mName;
 }
 
+size_t
+HistoryArchive::getMaxConcurrentUploads() const
+{
+    return mMaxConcurrentUploads;
+}
+
 std::string
 HistoryArchive::getFileCmd(std::string const& remote,
                            std::string const& local) const
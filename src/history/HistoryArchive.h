@@ -132,16 +132,23 @@ class HistoryArchive : public std::enable_shared_from_this<HistoryArchive>
     std::string mGetCmd;
     std::string mPutCmd;
     std::string mMkdirCmd;
+    size_t mMaxConcurrentUploads;
 
   public:
+    static size_t const DEFAULT_MAX_CONCURRENT_UPLOADS;
+
     HistoryArchive(std::string const& name, std::string const& getCmd,
-                   std::string const& putCmd, std::string const& mkdirCmd);
+                   std::string const& putCmd, std::string const& mkdirCmd,
+                   size_t maxConcurrentUploads = DEFAULT_MAX_CONCURRENT_UPLOADS);
     ~HistoryArchive();
     bool hasGetCmd() const;
     bool hasPutCmd() const;
     bool hasMkdirCmd() const;
     std::string const& getName() const;
 
+    // Number of files published to this archive at the same time.
+    size_t getMaxConcurrentUploads() const;
+
     std::string getFileCmd(std::string const& remote,
                            std::string const& local) const;
     std::string putFileCmd(std::string const& local,
@@ -178,6 +178,7 @@ class Bucket;
 class BucketList;
 class Config;
 class Database;
+class DownloadCache;
 class HistoryArchive;
 struct StateSnapshot;
 
@@ -358,6 +359,10 @@ class HistoryManager
     // transit).
     virtual std::string const& getTmpDir() = 0;
 
+    // Return the cache of files downloaded from history archives (see
+    // HISTORY_CACHE_DIR_PATH).
+    virtual DownloadCache& getDownloadCache() = 0;
+
     // Return the path of `basename` situated inside the HistoryManager's
     // tmpdir.
     virtual std::string localFilename(std::string const& basename) = 0;
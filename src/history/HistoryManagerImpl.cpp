@@ -13,6 +13,7 @@
 #include "bucket/BucketManager.h"
 #include "ledger/LedgerManager.h"
 #include "overlay/StellarXDR.h"
+#include "history/DownloadCache.h"
 #include "history/HistoryArchive.h"
 #include "history/HistoryManagerImpl.h"
 #include "history/HistoryWork.h"
@@ -27,6 +28,7 @@
 #include "crypto/Hex.h"
 #include "lib/util/format.h"
 #include "medida/metrics_registry.h"
+#include "medida/counter.h"
 #include "medida/meter.h"
 #include "xdrpp/marshal.h"
 #include "util/Math.h"
@@ -220,6 +222,7 @@ HistoryManagerImpl::HistoryManagerImpl(Application& app)
           app.getMetrics().NewMeter({"history", "publish", "success"}, "event"))
     , mPublishFailure(
           app.getMetrics().NewMeter({"history", "publish", "failure"}, "event"))
+    , mPublishLag(app.getMetrics().NewCounter({"history", "publish", "lag"}))
     , mCatchupStart(
           app.getMetrics().NewMeter({"history", "catchup", "start"}, "event"))
     , mCatchupSuccess(
@@ -306,10 +309,18 @@ HistoryManagerImpl::logAndUpdateStatus(bool contiguous)
             CLOG(INFO, "History") << current;
             mApp.getStatusManager().setStatusMessage(StatusCategory::HISTORY, current);
         }
+
+        auto work = mCatchupWork ? mCatchupWork : mPublishWork;
+        StatusProgress progress;
+        uint64_t eta;
+        work->getProgress(progress.mDone, progress.mTotal);
+        progress.mETA = work->getETA(eta) ? static_cast<int64_t>(eta) : -1;
+        mApp.getStatusManager().setProgress(StatusCategory::HISTORY, progress);
     }
     else
     {
         mApp.getStatusManager().removeStatusMessage(StatusCategory::HISTORY);
+        mApp.getStatusManager().removeProgress(StatusCategory::HISTORY);
     }
 }
 
@@ -337,6 +348,16 @@ HistoryManagerImpl::getTmpDir()
     return mWorkDir->getName();
 }
 
+DownloadCache&
+HistoryManagerImpl::getDownloadCache()
+{
+    if (!mDownloadCache)
+    {
+        mDownloadCache = make_unique<DownloadCache>(mApp);
+    }
+    return *mDownloadCache;
+}
+
 std::string
 HistoryManagerImpl::localFilename(std::string const& basename)
 {
@@ -518,6 +539,7 @@ HistoryManagerImpl::queueCurrentHistory()
 void
 HistoryManagerImpl::takeSnapshotAndPublish(HistoryArchiveState const& has)
 {
+    updatePublishLag();
     if (mPublishWork)
     {
         mPublishDelay.Mark();
@@ -554,6 +576,14 @@ HistoryManagerImpl::publishQueuedHistory()
     return 0;
 }
 
+void
+HistoryManagerImpl::updatePublishLag()
+{
+    auto oldest = getMinLedgerQueuedToPublish();
+    auto lcl = mApp.getLedgerManager().getLastClosedLedgerNum();
+    mPublishLag.set_count(oldest == 0 || oldest > lcl ? 0 : lcl - oldest);
+}
+
 std::vector<HistoryArchiveState>
 HistoryManagerImpl::getPublishQueueStates()
 {
@@ -618,11 +648,12 @@ HistoryManagerImpl::historyPublished(uint32_t ledgerSeq, bool success)
     {
         this->mPublishFailure.Mark();
     }
+    updatePublishLag();
     mPublishWork.reset();
-    mApp.getClock().getIOService().post([this]()
-                                        {
-                                            this->publishQueuedHistory();
-                                        });
+    mApp.getClock().postAction(Scheduler::LEDGER, [this]()
+                               {
+                                   this->publishQueuedHistory();
+                               });
 }
 
 void
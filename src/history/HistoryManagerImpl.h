@@ -10,6 +10,7 @@
 
 namespace medida
 {
+class Counter;
 class Meter;
 }
 
@@ -17,12 +18,14 @@ namespace stellar
 {
 
 class Application;
+class DownloadCache;
 class Work;
 
 class HistoryManagerImpl : public HistoryManager
 {
     Application& mApp;
     std::unique_ptr<TmpDir> mWorkDir;
+    std::unique_ptr<DownloadCache> mDownloadCache;
     std::shared_ptr<Work> mPublishWork;
     std::shared_ptr<Work> mCatchupWork;
 
@@ -32,6 +35,9 @@ class HistoryManagerImpl : public HistoryManager
     medida::Meter& mPublishStart;
     medida::Meter& mPublishSuccess;
     medida::Meter& mPublishFailure;
+    // ledgers between the last closed ledger and the oldest checkpoint
+    // waiting to be published
+    medida::Counter& mPublishLag;
 
     medida::Meter& mCatchupStart;
     medida::Meter& mCatchupSuccess;
@@ -59,6 +65,8 @@ class HistoryManagerImpl : public HistoryManager
 
     void takeSnapshotAndPublish(HistoryArchiveState const& has);
 
+    void updatePublishLag();
+
     bool hasAnyWritableHistoryArchive() override;
 
     uint32_t getMinLedgerQueuedToPublish() override;
@@ -94,6 +102,8 @@ class HistoryManagerImpl : public HistoryManager
 
     std::string const& getTmpDir() override;
 
+    DownloadCache& getDownloadCache() override;
+
     std::string localFilename(std::string const& basename) override;
 
     uint64_t getPublishSkipCount() override;
@@ -4,6 +4,8 @@
 #include "util/asio.h"
 #include "main/Application.h"
 #include "history/HistoryManager.h"
+#include "history/DownloadCache.h"
+#include "history/FileTransferInfo.h"
 #include "history/HistoryArchive.h"
 #include "history/HistoryWork.h"
 #include "main/test.h"
@@ -23,8 +25,15 @@
 #include "process/ProcessManager.h"
 #include "util/NonCopyable.h"
 #include "herder/LedgerCloseData.h"
+#include "herder/TxSetFrame.h"
+#include "ledger/LedgerHeaderFrame.h"
+#include "transactions/TransactionFrame.h"
+#include "util/XDRStream.h"
 #include "work/WorkManager.h"
 #include "work/WorkParent.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
 #include <cstdio>
 #include <xdrpp/autocheck.h>
 #include <fstream>
@@ -603,6 +612,78 @@ TEST_CASE_METHOD(HistoryTests, "History publish", "[history]")
     generateAndPublishInitialHistory(1);
 }
 
+TEST_CASE_METHOD(HistoryTests, "History transactions streaming", "[history]")
+{
+    app.start();
+    for (size_t i = 0; i < 10; ++i)
+    {
+        generateRandomLedger();
+    }
+
+    auto& db = app.getDatabase();
+    auto& networkID = app.getNetworkID();
+    uint32_t lcl =
+        app.getLedgerManager().getLastClosedLedgerHeader().header.ledgerSeq;
+
+    auto checkStream = [&](uint32_t verifyEvery)
+    {
+        TmpDir dir(app.getTmpDirManager().tmpDir("txstream"));
+        std::string txFile = dir.getName() + "/tx.xdr";
+        std::string resFile = dir.getName() + "/res.xdr";
+        size_t nTxs;
+        {
+            XDROutputFileStream txOut, resOut;
+            txOut.open(txFile);
+            resOut.open(resFile);
+            nTxs = TransactionFrame::copyTransactionsToStream(
+                networkID, db, db.getSession(), 0, lcl + 1, txOut, resOut,
+                verifyEvery);
+        }
+        REQUIRE(nTxs > 0);
+
+        XDRInputFileStream txIn, resIn;
+        txIn.open(txFile);
+        resIn.open(resFile);
+        TransactionHistoryEntry tx;
+        TransactionHistoryResultEntry res;
+        size_t nRead = 0;
+        while (txIn.readOne(tx))
+        {
+            REQUIRE(resIn.readOne(res));
+            REQUIRE(tx.ledgerSeq == res.ledgerSeq);
+
+            auto header = LedgerHeaderFrame::loadBySequence(
+                tx.ledgerSeq, db, db.getSession());
+            REQUIRE(header);
+            REQUIRE(tx.txSet.previousLedgerHash ==
+                    header->mHeader.previousLedgerHash);
+            TxSetFrame txSet(networkID, tx.txSet);
+            REQUIRE(txSet.getContentsHash() ==
+                    header->mHeader.scpValue.txSetHash);
+
+            REQUIRE(res.txResultSet ==
+                    TransactionFrame::getTransactionHistoryResults(
+                        db, tx.ledgerSeq));
+            nRead += tx.txSet.txs.size();
+        }
+        REQUIRE(!resIn.readOne(res));
+        REQUIRE(nRead == nTxs);
+    };
+
+    SECTION("every transaction verified")
+    {
+        checkStream(1);
+    }
+    SECTION("sampled verification")
+    {
+        checkStream(4);
+    }
+    SECTION("no verification")
+    {
+        checkStream(0);
+    }
+}
+
 static std::string
 resumeModeName(HistoryManager::CatchupMode mode)
 {
@@ -907,6 +988,192 @@ TEST_CASE_METHOD(S3HistoryTests, "Publish/catchup via s3", "[hide][s3]")
         "s3");
 }
 
+class TwoArchivesConfigurator : public Configurator
+{
+    TmpDirConfigurator mFirst;
+    TmpDirManager mArchtmp;
+    TmpDir mSecond;
+
+  public:
+    TwoArchivesConfigurator()
+        : mArchtmp("archtmp2"), mSecond(mArchtmp.tmpDir("archive"))
+    {
+    }
+
+    std::string
+    getArchiveDirName() const override
+    {
+        return mFirst.getArchiveDirName();
+    }
+
+    std::string
+    getSecondArchiveDirName() const
+    {
+        return mSecond.getName();
+    }
+
+    Config&
+    configure(Config& cfg, bool writable) const override
+    {
+        mFirst.configure(cfg, writable);
+
+        std::string d = mSecond.getName();
+        std::string getCmd = "cp " + d + "/{0} {1}";
+        std::string putCmd = "";
+        std::string mkdirCmd = "";
+        if (writable)
+        {
+            putCmd = "cp {0} " + d + "/{1}";
+            mkdirCmd = "mkdir -p " + d + "/{0}";
+        }
+
+        // one upload at a time, to exercise the queueing of uploads
+        cfg.HISTORY["test2"] = std::make_shared<HistoryArchive>(
+            "test2", getCmd, putCmd, mkdirCmd, 1);
+        return cfg;
+    }
+};
+
+class TwoArchivesHistoryTests : public HistoryTests
+{
+  public:
+    TwoArchivesHistoryTests()
+        : HistoryTests(std::make_shared<TwoArchivesConfigurator>())
+    {
+        CHECK(HistoryManager::initializeHistoryArchive(app, "test2"));
+    }
+};
+
+TEST_CASE_METHOD(TwoArchivesHistoryTests, "Publish to several archives",
+                 "[history]")
+{
+    generateAndPublishInitialHistory(2);
+
+    auto configurator =
+        std::dynamic_pointer_cast<TwoArchivesConfigurator>(mConfigurator);
+    HistoryArchiveState has1, has2;
+    has1.load(configurator->getArchiveDirName() + "/" +
+              HistoryArchiveState::wellKnownRemoteName());
+    has2.load(configurator->getSecondArchiveDirName() + "/" +
+              HistoryArchiveState::wellKnownRemoteName());
+    CHECK(has1.currentLedger > 0);
+    CHECK(has1.toString() == has2.toString());
+
+    auto& timer1 = app.getMetrics().NewTimer({"history", "upload", "test"});
+    auto& timer2 = app.getMetrics().NewTimer({"history", "upload", "test2"});
+    CHECK(timer1.count() > 0);
+    CHECK(timer1.count() == timer2.count());
+
+    catchupNewApplication(app.getLedgerManager().getLastClosedLedgerNum(),
+                          Config::TESTDB_IN_MEMORY_SQLITE,
+                          HistoryManager::CATCHUP_COMPLETE, "two-archives");
+}
+
+class CachingConfigurator : public Configurator
+{
+    TmpDirConfigurator mArchive;
+    TmpDirManager mCachetmp;
+    TmpDir mCache;
+
+  public:
+    CachingConfigurator()
+        : mCachetmp("cachetmp"), mCache(mCachetmp.tmpDir("cache"))
+    {
+    }
+
+    std::string
+    getArchiveDirName() const override
+    {
+        return mArchive.getArchiveDirName();
+    }
+
+    Config&
+    configure(Config& cfg, bool writable) const override
+    {
+        mArchive.configure(cfg, writable);
+        if (!writable)
+        {
+            // shared by all catching up applications
+            cfg.HISTORY_CACHE_DIR_PATH = mCache.getName();
+        }
+        return cfg;
+    }
+};
+
+class CachingHistoryTests : public HistoryTests
+{
+  public:
+    CachingHistoryTests()
+        : HistoryTests(std::make_shared<CachingConfigurator>())
+    {
+    }
+};
+
+TEST_CASE_METHOD(CachingHistoryTests, "Catchup from download cache",
+                 "[history]")
+{
+    generateAndPublishInitialHistory(3);
+    auto initLedger = app.getLedgerManager().getLastClosedLedgerNum();
+
+    auto app2 = catchupNewApplication(initLedger,
+                                      Config::TESTDB_IN_MEMORY_SQLITE,
+                                      HistoryManager::CATCHUP_COMPLETE, "app2");
+    auto& cache2 = app2->getHistoryManager().getDownloadCache();
+    auto& hit2 = app2->getMetrics().NewMeter({"history", "cache", "hit"},
+                                             "file");
+    auto& miss2 = app2->getMetrics().NewMeter({"history", "cache", "miss"},
+                                              "file");
+    CHECK(hit2.count() == 0);
+    CHECK(miss2.count() > 0);
+    CHECK(cache2.size() == miss2.count());
+
+    auto first = app2->getHistoryManager().getCheckpointFrequency() - 1;
+    CHECK(cache2.isVerified("test", fs::remoteName(HISTORY_FILE_TYPE_LEDGER,
+                                                   fs::hexStr(first),
+                                                   "xdr.gz")));
+
+    // a second catchup over the same history gets everything from the
+    // journaled cache
+    auto app3 = catchupNewApplication(initLedger,
+                                      Config::TESTDB_IN_MEMORY_SQLITE,
+                                      HistoryManager::CATCHUP_COMPLETE, "app3");
+    auto& hit3 = app3->getMetrics().NewMeter({"history", "cache", "hit"},
+                                             "file");
+    auto& miss3 = app3->getMetrics().NewMeter({"history", "cache", "miss"},
+                                              "file");
+    CHECK(hit3.count() == miss2.count());
+    CHECK(miss3.count() == 0);
+    CHECK(app3->getLedgerManager().getLastClosedLedgerHeader().hash ==
+          app2->getLedgerManager().getLastClosedLedgerHeader().hash);
+
+    SECTION("files used by a failed catchup are dropped")
+    {
+        auto& cache3 = app3->getHistoryManager().getDownloadCache();
+        std::string remote = fs::remoteName(HISTORY_FILE_TYPE_LEDGER,
+                                            fs::hexStr(0xffffffff), "xdr.gz");
+        std::string junk = app3->getHistoryManager().localFilename("junk");
+        {
+            std::ofstream out(junk);
+            out << "junk";
+        }
+        auto before = cache3.size();
+        cache3.store("test", remote, junk);
+        CHECK(cache3.size() == before + 1);
+        // entries belong to the archive they came from
+        CHECK(!cache3.fetch("test2", remote, junk + ".other"));
+        cache3.markVerified(remote);
+        CHECK(cache3.isVerified("test", remote));
+        // verified or not, what the failed catchup used is gone, while what
+        // app3's successful catchup verified is kept
+        cache3.dropUsed();
+        CHECK(cache3.size() <= before);
+        CHECK(!cache3.fetch("test", remote, junk + ".fetched"));
+        CHECK(cache3.isVerified("test", fs::remoteName(HISTORY_FILE_TYPE_LEDGER,
+                                                       fs::hexStr(first),
+                                                       "xdr.gz")));
+    }
+}
+
 TEST_CASE("persist publish queue", "[history]")
 {
     Config cfg(getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE));
@@ -9,6 +9,7 @@
 #include "crypto/SHA.h"
 #include "herder/LedgerCloseData.h"
 #include "herder/TxSetFrame.h"
+#include "history/DownloadCache.h"
 #include "history/FileTransferInfo.h"
 #include "history/HistoryManager.h"
 #include "history/HistoryWork.h"
@@ -21,17 +22,21 @@
 #include "util/make_unique.h"
 #include "xdr/Stellar-ledger.h"
 #include "xdrpp/printer.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
 
 #include "lib/util/format.h"
 
 #include <fstream>
+#include <set>
 
 namespace stellar
 {
 
-static std::string
-fmtProgress(Application& app, std::string const& task, uint32_t first,
-            uint32_t last, uint32_t curr)
+// Checkpoints of [first, last] up to and including `curr`, and in total.
+static void
+checkpointProgress(Application& app, uint32_t first, uint32_t last,
+                   uint32_t curr, uint64_t& done, uint64_t& total)
 {
     auto step = app.getHistoryManager().getCheckpointFrequency();
     if (curr > last)
@@ -50,8 +55,16 @@ fmtProgress(Application& app, std::string const& task, uint32_t first,
     {
         last = first;
     }
-    auto done = 1 + ((curr - first) / step);
-    auto total = 1 + ((last - first) / step);
+    done = 1 + ((curr - first) / step);
+    total = 1 + ((last - first) / step);
+}
+
+static std::string
+fmtProgress(Application& app, std::string const& task, uint32_t first,
+            uint32_t last, uint32_t curr)
+{
+    uint64_t done, total;
+    checkpointProgress(app, first, last, curr, done, total);
     auto pct = (100 * done) / total;
     return fmt::format("{:s} {:d}/{:d} ({:d}%)", task, done, total, pct);
 }
@@ -95,6 +108,7 @@ GetRemoteFileWork::GetRemoteFileWork(
     , mLocal(local)
     , mArchive(archive)
 {
+    mResource = RESOURCE_NETWORK;
 }
 
 void
@@ -107,15 +121,35 @@ GetRemoteFileWork::getCommand(std::string& cmdLine, std::string& outFile)
     }
     assert(archive);
     assert(archive->hasGetCmd());
+    mArchiveName = archive->getName();
+    if (mApp.getHistoryManager().getDownloadCache().fetch(mArchiveName,
+                                                          mRemote, mLocal))
+    {
+        // no command: done
+        mFromCache = true;
+        return;
+    }
     cmdLine = archive->getFileCmd(mRemote, mLocal);
 }
 
 void
 GetRemoteFileWork::onReset()
 {
+    mFromCache = false;
     std::remove(mLocal.c_str());
 }
 
+Work::State
+GetRemoteFileWork::onSuccess()
+{
+    if (!mFromCache)
+    {
+        mApp.getHistoryManager().getDownloadCache().store(mArchiveName,
+                                                          mRemote, mLocal);
+    }
+    return RunCommandWork::onSuccess();
+}
+
 PutRemoteFileWork::PutRemoteFileWork(
     Application& app, WorkParent& parent, std::string const& local,
     std::string const& remote, std::shared_ptr<HistoryArchive const> archive)
@@ -126,6 +160,7 @@ PutRemoteFileWork::PutRemoteFileWork(
 {
     assert(mArchive);
     assert(mArchive->hasPutCmd());
+    mResource = RESOURCE_NETWORK;
 }
 
 void
@@ -142,6 +177,7 @@ MakeRemoteDirWork::MakeRemoteDirWork(
     , mArchive(archive)
 {
     assert(mArchive);
+    mResource = RESOURCE_NETWORK;
 }
 
 void
@@ -186,6 +222,7 @@ GzipFileWork::GzipFileWork(Application& app, WorkParent& parent,
     , mKeepExisting(keepExisting)
 {
     checkNoGzipSuffix(mFilenameNoGz);
+    mResource = RESOURCE_CPU;
 }
 
 void
@@ -214,6 +251,7 @@ GunzipFileWork::GunzipFileWork(Application& app, WorkParent& parent,
     , mKeepExisting(keepExisting)
 {
     checkGzipSuffix(mFilenameGz);
+    mResource = RESOURCE_CPU;
 }
 
 void
@@ -225,6 +263,12 @@ GunzipFileWork::getCommand(std::string& cmdLine, std::string& outFile)
         cmdLine += "-c ";
         outFile = mFilenameGz.substr(0, mFilenameGz.size() - 3);
     }
+    else
+    {
+        // the file may be a hard link to the download cache, which gzip
+        // refuses to replace otherwise
+        cmdLine += "-f ";
+    }
     cmdLine += mFilenameGz;
 }
 
@@ -249,6 +293,7 @@ VerifyBucketWork::VerifyBucketWork(
     , mHash(hash)
 {
     checkNoGzipSuffix(mBucketFile);
+    mResource = RESOURCE_DISK;
 }
 
 void
@@ -291,10 +336,10 @@ VerifyBucketWork::onStart()
                     ec = std::make_error_code(std::errc::io_error);
                 }
             }
-            app.getClock().getIOService().post([ec, handler]()
-                                               {
-                                                   handler(ec);
-                                               });
+            app.getClock().postAction(Scheduler::BACKGROUND, [ec, handler]()
+                                      {
+                                          handler(ec);
+                                      });
         });
 }
 
@@ -309,6 +354,8 @@ VerifyBucketWork::onSuccess()
 {
     auto b = mApp.getBucketManager().adoptFileAsBucket(mBucketFile, mHash);
     mBuckets[binToHex(mHash)] = b;
+    mApp.getHistoryManager().getDownloadCache().markVerified(fs::remoteName(
+        HISTORY_FILE_TYPE_BUCKET, binToHex(mHash), "xdr.gz"));
     return WORK_SUCCESS;
 }
 
@@ -326,6 +373,7 @@ VerifyLedgerChainWork::VerifyLedgerChainWork(
     , mFirstVerified(firstVerified)
     , mLastVerified(lastVerified)
 {
+    mResource = RESOURCE_DISK;
 }
 
 std::string
@@ -339,6 +387,16 @@ VerifyLedgerChainWork::getStatus() const
     return Work::getStatus();
 }
 
+void
+VerifyLedgerChainWork::getProgress(uint64_t& done, uint64_t& total) const
+{
+    checkpointProgress(mApp, mFirstSeq, mLastSeq, mCurrSeq, done, total);
+    if (mState != WORK_SUCCESS)
+    {
+        --done;
+    }
+}
+
 void
 VerifyLedgerChainWork::onReset()
 {
@@ -468,6 +526,18 @@ VerifyLedgerChainWork::verifyHistoryOfSingleCheckpoint()
     return status;
 }
 
+void
+VerifyLedgerChainWork::markVerified()
+{
+    auto& cache = mApp.getHistoryManager().getDownloadCache();
+    auto step = mApp.getHistoryManager().getCheckpointFrequency();
+    for (auto seq = mFirstSeq; seq <= mLastSeq; seq += step)
+    {
+        FileTransferInfo ft(mDownloadDir, HISTORY_FILE_TYPE_LEDGER, seq);
+        cache.markVerified(ft.remoteName());
+    }
+}
+
 Work::State
 VerifyLedgerChainWork::onSuccess()
 {
@@ -486,6 +556,7 @@ VerifyLedgerChainWork::onSuccess()
         {
             CLOG(INFO, "History") << "History chain [" << mFirstSeq << ","
                                   << mLastSeq << "] verified";
+            markVerified();
             return WORK_SUCCESS;
         }
 
@@ -514,7 +585,10 @@ GetHistoryArchiveStateWork::GetHistoryArchiveStateWork(
     uint32_t seq, VirtualClock::duration const& initialDelay,
     std::shared_ptr<HistoryArchive const> archive,
     size_t maxRetries)
-    : Work(app, parent, "get-history-archive-state", maxRetries)
+    : Work(app, parent,
+           archive ? "get-history-archive-state-" + archive->getName()
+                   : std::string("get-history-archive-state"),
+           maxRetries)
     , mState(state)
     , mSeq(seq)
     , mInitialDelay(initialDelay)
@@ -676,6 +750,25 @@ BatchDownloadWork::getStatus() const
     return Work::getStatus();
 }
 
+void
+BatchDownloadWork::getProgress(uint64_t& done, uint64_t& total) const
+{
+    uint64_t next;
+    checkpointProgress(mApp, mFirst, mLast, mNext, next, total);
+    done = mFinished.size();
+    if (mState == WORK_SUCCESS)
+    {
+        done = total;
+    }
+}
+
+bool
+BatchDownloadWork::isDownloaded(uint32_t checkpoint) const
+{
+    return mState == WORK_SUCCESS ||
+           mFinished.find(checkpoint) != mFinished.end();
+}
+
 void
 BatchDownloadWork::addNextDownloadWorker()
 {
@@ -689,6 +782,7 @@ BatchDownloadWork::addNextDownloadWorker()
     {
         CLOG(DEBUG, "History") << "already have " << mFileType
             << " for checkpoint " << mNext;
+        mFinished.insert(mNext);
     }
     else if (fs::exists(ft.localPath_gz()))
     {
@@ -744,12 +838,17 @@ BatchDownloadWork::notify(std::string const& childChanged)
         CLOG(DEBUG, "History") << "Finished download of " << mFileType
                                << " for checkpoint " << i->second;
 
-        mFinished.push_back(i->second);
+        mFinished.insert(i->second);
         mRunning.erase(i);
         addNextDownloadWorker();
     }
     mApp.getHistoryManager().logAndUpdateStatus(true);
     advance();
+    if (!done.empty() && mState == WORK_PENDING)
+    {
+        // let siblings consume what is downloaded so far
+        notifyParent();
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////
@@ -777,6 +876,7 @@ ApplyBucketsWork::ApplyBucketsWork(
         throw std::runtime_error(
             "ApplyBucketsWork applying ledger earlier than local LCL");
     }
+    mResource = RESOURCE_DB;
 }
 
 BucketList&
@@ -910,14 +1010,17 @@ ApplyBucketsWork::onSuccess()
 
 ApplyLedgerChainWork::ApplyLedgerChainWork(
     Application& app, WorkParent& parent, TmpDir const& downloadDir,
-    uint32_t first, uint32_t last, LedgerHeaderHistoryEntry& lastApplied)
+    uint32_t first, uint32_t last, LedgerHeaderHistoryEntry& lastApplied,
+    std::shared_ptr<BatchDownloadWork const> txDownload)
     : Work(app, parent, std::string("apply-ledger-chain"))
     , mDownloadDir(downloadDir)
     , mFirstSeq(first)
     , mCurrSeq(first)
     , mLastSeq(last)
     , mLastApplied(lastApplied)
+    , mTxDownload(txDownload)
 {
+    mResource = RESOURCE_DB;
 }
 
 std::string
@@ -931,6 +1034,23 @@ ApplyLedgerChainWork::getStatus() const
     return Work::getStatus();
 }
 
+bool
+ApplyLedgerChainWork::isReady() const
+{
+    return mInputFilesOpen || mCurrSeq > mLastSeq || !mTxDownload ||
+           mTxDownload->isDownloaded(mCurrSeq);
+}
+
+void
+ApplyLedgerChainWork::getProgress(uint64_t& done, uint64_t& total) const
+{
+    checkpointProgress(mApp, mFirstSeq, mLastSeq, mCurrSeq, done, total);
+    if (mState != WORK_SUCCESS)
+    {
+        --done;
+    }
+}
+
 void
 ApplyLedgerChainWork::onReset()
 {
@@ -943,15 +1063,21 @@ ApplyLedgerChainWork::onReset()
                           << LedgerManager::ledgerAbbrev(
                                  lm.getLastClosedLedgerHeader());
     mCurrSeq = mFirstSeq;
+    closeInputFiles();
+}
+
+void
+ApplyLedgerChainWork::closeInputFiles()
+{
     mHdrIn.close();
     mTxIn.close();
+    mInputFilesOpen = false;
 }
 
 void
 ApplyLedgerChainWork::openCurrentInputFiles()
 {
-    mHdrIn.close();
-    mTxIn.close();
+    closeInputFiles();
     if (mCurrSeq > mLastSeq)
     {
         return;
@@ -965,6 +1091,8 @@ ApplyLedgerChainWork::openCurrentInputFiles()
     mHdrIn.open(hi.localPath_nogz());
     mTxIn.open(ti.localPath_nogz());
     mTxHistoryEntry = TransactionHistoryEntry();
+    mInputFilesOpen = true;
+    mWholeCheckpointApplied = true;
 }
 
 TxSetFramePtr
@@ -1012,6 +1140,12 @@ ApplyLedgerChainWork::applyHistoryOfSingleLedger()
 
     LedgerHeader const& previousHeader = lm.getLastClosedLedgerHeader().header;
 
+    if (header.ledgerSeq <= previousHeader.ledgerSeq)
+    {
+        // the transactions of this ledger are not checked
+        mWholeCheckpointApplied = false;
+    }
+
     // If we are >1 before LCL, skip
     if (header.ledgerSeq + 1 < previousHeader.ledgerSeq)
     {
@@ -1087,21 +1221,27 @@ ApplyLedgerChainWork::applyHistoryOfSingleLedger()
     return true;
 }
 
-void
-ApplyLedgerChainWork::onStart()
-{
-    openCurrentInputFiles();
-}
-
 void
 ApplyLedgerChainWork::onRun()
 {
     try
     {
+        if (!mInputFilesOpen)
+        {
+            openCurrentInputFiles();
+        }
         if (!applyHistoryOfSingleLedger())
         {
+            if (mWholeCheckpointApplied)
+            {
+                // every transaction set matched its verified header
+                FileTransferInfo ti(mDownloadDir,
+                                    HISTORY_FILE_TYPE_TRANSACTIONS, mCurrSeq);
+                mApp.getHistoryManager().getDownloadCache().markVerified(
+                    ti.remoteName());
+            }
             mCurrSeq += mApp.getHistoryManager().getCheckpointFrequency();
-            openCurrentInputFiles();
+            closeInputFiles();
         }
         scheduleSuccess();
     }
@@ -1119,6 +1259,14 @@ ApplyLedgerChainWork::onSuccess()
     {
         return WORK_SUCCESS;
     }
+    if (!isReady())
+    {
+        // wait for the transactions of the next checkpoint to be
+        // downloaded; we are advanced again when they are
+        CLOG(DEBUG, "History") << "Waiting for transactions of checkpoint "
+                               << mCurrSeq;
+        return WORK_PENDING;
+    }
     return WORK_RUNNING;
 }
 
@@ -1323,6 +1471,7 @@ CatchupMinimalWork::onSuccess()
                           << LedgerManager::ledgerAbbrev(mFirstVerified)
                           << " for nextLedger="
                           << nextLedger();
+    mApp.getHistoryManager().getDownloadCache().releaseUsed();
     mApp.getHistoryManager().historyCaughtup();
     asio::error_code ec;
     mEndHandler(ec, HistoryManager::CATCHUP_MINIMAL, mFirstVerified);
@@ -1333,6 +1482,7 @@ CatchupMinimalWork::onSuccess()
 void
 CatchupMinimalWork::onFailureRaise()
 {
+    mApp.getHistoryManager().getDownloadCache().dropUsed();
     mApp.getHistoryManager().historyCaughtup();
     asio::error_code ec = std::make_error_code(std::errc::timed_out);
     mEndHandler(ec, HistoryManager::CATCHUP_MINIMAL, mLastVerified);
@@ -1355,19 +1505,16 @@ CatchupCompleteWork::getStatus() const
 {
     if (mState == WORK_PENDING)
     {
-        if (mApplyWork)
+        // stages overlap: report the furthest one making progress
+        for (auto const& w : {mApplyWork, mVerifyWork,
+                              mDownloadTransactionsWork, mDownloadLedgersWork})
         {
-            return mApplyWork->getStatus();
-        }
-        else if (mVerifyWork)
-        {
-            return mVerifyWork->getStatus();
-        }
-        else if (mDownloadTransactionsWork)
-        {
-            return mDownloadTransactionsWork->getStatus();
+            if (w && w->getState() == WORK_RUNNING)
+            {
+                return w->getStatus();
+            }
         }
-        else if (mDownloadLedgersWork)
+        if (mDownloadLedgersWork)
         {
             return mDownloadLedgersWork->getStatus();
         }
@@ -1408,48 +1555,39 @@ CatchupCompleteWork::onSuccess()
     uint32_t firstSeq = firstCheckpointSeq();
     uint32_t lastSeq = lastCheckpointSeq();
 
-    // Phase 2: download and decompress the ledgers.
-    if (!mDownloadLedgersWork)
+    // Phase 2: download the ledgers and the transactions in parallel,
+    // verify the ledger chain as soon as the ledgers are there and apply
+    // each checkpoint as soon as its transactions are there, once the whole
+    // chain is verified: trust flows backwards from the last ledger, which
+    // is the one checked against the network.
+    if (!mApplyWork)
     {
-        CLOG(INFO, "History") << "Catchup COMPLETE downloading ledgers ["
-                              << firstSeq << ", " << lastSeq << "]";
+        CLOG(INFO, "History") << "Catchup COMPLETE downloading, verifying "
+                              << "and applying history [" << firstSeq << ", "
+                              << lastSeq << "]";
         mDownloadLedgersWork = addWork<BatchDownloadWork>(
             firstSeq, lastSeq, HISTORY_FILE_TYPE_LEDGER, *mDownloadDir);
-        return WORK_PENDING;
-    }
-
-    // Phase 3: download and decompress the transactions.
-    if (!mDownloadTransactionsWork)
-    {
-        CLOG(INFO, "History") << "Catchup COMPLETE downloading transactions";
-        mDownloadTransactionsWork = addWork<BatchDownloadWork>(
+        auto downloadTransactions = addWork<BatchDownloadWork>(
             firstSeq, lastSeq, HISTORY_FILE_TYPE_TRANSACTIONS, *mDownloadDir);
-        return WORK_PENDING;
-    }
+        mDownloadTransactionsWork = downloadTransactions;
 
-    // Phase 4: verify the ledger chain.
-    if (!mVerifyWork)
-    {
-        CLOG(INFO, "History") << "Catchup COMPLETE verifying history";
         mLastVerified = mApp.getLedgerManager().getLastClosedLedgerHeader();
         mVerifyWork = addWork<VerifyLedgerChainWork>(
             *mDownloadDir, firstSeq, lastSeq, mManualCatchup, mFirstVerified,
             mLastVerified);
-        return WORK_PENDING;
-    }
+        mVerifyWork->addDependency(mDownloadLedgersWork);
 
-    // Phase 5: apply the transactions.
-    if (!mApplyWork)
-    {
-        CLOG(INFO, "History") << "Catchup COMPLETE applying history";
-        mApplyWork = addWork<ApplyLedgerChainWork>(*mDownloadDir, firstSeq,
-                                                   lastSeq, mLastApplied);
+        mApplyWork = addWork<ApplyLedgerChainWork>(
+            *mDownloadDir, firstSeq, lastSeq, mLastApplied,
+            downloadTransactions);
+        mApplyWork->addDependency(mVerifyWork);
         return WORK_PENDING;
     }
 
     CLOG(INFO, "History") << "Completed catchup COMPLETE to state "
                           << LedgerManager::ledgerAbbrev(mLastApplied)
                           << " for nextLedger=" << nextLedger();
+    mApp.getHistoryManager().getDownloadCache().releaseUsed();
     mApp.getHistoryManager().historyCaughtup();
     asio::error_code ec;
     mEndHandler(ec, HistoryManager::CATCHUP_COMPLETE, mLastApplied);
@@ -1460,6 +1598,7 @@ CatchupCompleteWork::onSuccess()
 void
 CatchupCompleteWork::onFailureRaise()
 {
+    mApp.getHistoryManager().getDownloadCache().dropUsed();
     mApp.getHistoryManager().historyCaughtup();
     asio::error_code ec = std::make_error_code(std::errc::timed_out);
     mEndHandler(ec, HistoryManager::CATCHUP_COMPLETE, mLastVerified);
@@ -1498,6 +1637,7 @@ WriteSnapshotWork::WriteSnapshotWork(Application& app, WorkParent& parent,
     : Work(app, parent, "write-snapshot", Work::RETRY_A_LOT)
     , mSnapshot(snapshot)
 {
+    mResource = RESOURCE_DB;
 }
 
 void
@@ -1512,10 +1652,11 @@ WriteSnapshotWork::onStart()
         {
             ec = std::make_error_code(std::errc::io_error);
         }
-        snap->mApp.getClock().getIOService().post([handler, ec]()
-                                                  {
-                                                      handler(ec);
-                                                  });
+        snap->mApp.getClock().postAction(Scheduler::BACKGROUND,
+                                         [handler, ec]()
+                                         {
+                                             handler(ec);
+                                         });
     };
 
     // Throw the work over to a worker thread if we can use DB pools,
@@ -1543,68 +1684,100 @@ WriteSnapshotWork::onRun()
 PutSnapshotFilesWork::PutSnapshotFilesWork(
     Application& app, WorkParent& parent,
     std::shared_ptr<HistoryArchive const> archive,
-    std::shared_ptr<StateSnapshot> snapshot)
-    : Work(app, parent, "put-snapshot-files")
+    std::shared_ptr<StateSnapshot> snapshot,
+    std::vector<std::shared_ptr<FileTransferInfo>> const& files)
+    : Work(app, parent, "put-snapshot-files-" + archive->getName())
     , mArchive(archive)
     , mSnapshot(snapshot)
+    , mFiles(files)
+    , mUploadTimer(app.getMetrics().NewTimer(
+          {"history", "upload", archive->getName()}))
 {
 }
 
+std::string
+PutSnapshotFilesWork::getStatus() const
+{
+    if (mState == WORK_PENDING && !mPutHistoryArchiveStateWork)
+    {
+        return fmt::format("Uploading files to {:s}: {:d}/{:d} ({:d} running)",
+                           mArchive->getName(), mNext - mRunning.size(),
+                           mFiles.size(), mRunning.size());
+    }
+    return Work::getStatus();
+}
+
+void
+PutSnapshotFilesWork::addNextUpload()
+{
+    if (mNext >= mFiles.size())
+    {
+        return;
+    }
+    auto f = mFiles[mNext++];
+    auto put = addWork<PutRemoteFileWork>(f->localPath_gz(), f->remoteName(),
+                                          mArchive);
+    put->addWork<MakeRemoteDirWork>(f->remoteDir(), mArchive);
+    assert(mRunning.find(put->getUniqueName()) == mRunning.end());
+    mRunning.insert(
+        std::make_pair(put->getUniqueName(), mApp.getClock().now()));
+}
+
 void
 PutSnapshotFilesWork::onReset()
 {
     clearChildren();
-
-    mGetHistoryArchiveStateWork.reset();
-    mPutFilesWork.reset();
+    mRunning.clear();
+    mNext = 0;
     mPutHistoryArchiveStateWork.reset();
-}
 
-Work::State
-PutSnapshotFilesWork::onSuccess()
-{
-    // Phase 1: fetch remote history archive state
-    if (!mGetHistoryArchiveStateWork)
+    while (mRunning.size() < mArchive->getMaxConcurrentUploads() &&
+           mNext < mFiles.size())
     {
-        mGetHistoryArchiveStateWork = addWork<GetHistoryArchiveStateWork>(
-            mRemoteState, 0, std::chrono::seconds(0), mArchive);
-        return WORK_PENDING;
+        addNextUpload();
     }
+}
 
-    // Phase 2: put all requisite data files
-    if (!mPutFilesWork)
+void
+PutSnapshotFilesWork::notify(std::string const& childChanged)
+{
+    std::vector<std::string> done;
+    for (auto const& r : mRunning)
     {
-        mPutFilesWork = addWork<Work>("put-files");
-
-        std::vector<std::shared_ptr<FileTransferInfo>> files = {
-            mSnapshot->mLedgerSnapFile, mSnapshot->mTransactionSnapFile,
-            mSnapshot->mTransactionResultSnapFile,
-            mSnapshot->mSCPHistorySnapFile};
-
-        std::vector<std::string> bucketsToSend =
-            mSnapshot->mLocalState.differingBuckets(mRemoteState);
-
-        for (auto const& hash : bucketsToSend)
+        auto c = mChildren.find(r.first);
+        assert(c != mChildren.end());
+        if (c->second->getState() == WORK_SUCCESS)
         {
-            auto b = mApp.getBucketManager().getBucketByHash(hexToBin256(hash));
-            assert(b);
-            files.push_back(std::make_shared<FileTransferInfo>(*b));
+            done.push_back(r.first);
         }
-        for (auto f : files)
+    }
+    for (auto const& d : done)
+    {
+        auto i = mRunning.find(d);
+        mUploadTimer.Update(mApp.getClock().now() - i->second);
+        mRunning.erase(i);
+        mChildren.erase(d);
+        addNextUpload();
+    }
+    advance();
+}
+
+Work::State
+PutSnapshotFilesWork::onSuccess()
+{
+    // Phase 1: put all requisite data files, topped up by notify as uploads
+    // complete
+    if (mNext < mFiles.size())
+    {
+        while (mRunning.size() < mArchive->getMaxConcurrentUploads() &&
+               mNext < mFiles.size())
         {
-            if (f && fs::exists(f->localPath_nogz()))
-            {
-                auto put = mPutFilesWork->addWork<PutRemoteFileWork>(
-                    f->localPath_gz(), f->remoteName(), mArchive);
-                auto mkdir =
-                    put->addWork<MakeRemoteDirWork>(f->remoteDir(), mArchive);
-                mkdir->addWork<GzipFileWork>(f->localPath_nogz(), true);
-            }
+            addNextUpload();
         }
         return WORK_PENDING;
     }
 
-    // Phase 3: update remote history archive state
+    // Phase 2: update remote history archive state
     if (!mPutHistoryArchiveStateWork)
     {
         mPutHistoryArchiveStateWork = addWork<PutHistoryArchiveStateWork>(
@@ -1628,17 +1801,25 @@ PublishWork::getStatus() const
 {
     if (mState == WORK_PENDING)
     {
-        if (mResolveSnapshotWork)
+        if (mUpdateArchivesWork)
         {
-            return mResolveSnapshotWork->getStatus();
+            return mUpdateArchivesWork->getStatus();
+        }
+        else if (mCompressFilesWork)
+        {
+            return mCompressFilesWork->getStatus();
+        }
+        else if (mGetArchiveStatesWork)
+        {
+            return mGetArchiveStatesWork->getStatus();
         }
         else if (mWriteSnapshotWork)
         {
             return mWriteSnapshotWork->getStatus();
         }
-        else if (mUpdateArchivesWork)
+        else if (mResolveSnapshotWork)
         {
-            return mUpdateArchivesWork->getStatus();
+            return mResolveSnapshotWork->getStatus();
         }
     }
     return Work::getStatus();
@@ -1651,7 +1832,26 @@ PublishWork::onReset()
 
     mResolveSnapshotWork.reset();
     mWriteSnapshotWork.reset();
+    mGetArchiveStatesWork.reset();
+    mCompressFilesWork.reset();
     mUpdateArchivesWork.reset();
+
+    mRemoteStates.clear();
+    mFilesToSend.clear();
+}
+
+std::vector<std::shared_ptr<HistoryArchive const>>
+PublishWork::writableArchives() const
+{
+    std::vector<std::shared_ptr<HistoryArchive const>> archives;
+    for (auto& aPair : mApp.getConfig().HISTORY)
+    {
+        if (aPair.second->hasPutCmd())
+        {
+            archives.push_back(aPair.second);
+        }
+    }
+    return archives;
 }
 
 Work::State
@@ -1671,18 +1871,83 @@ PublishWork::onSuccess()
         return WORK_PENDING;
     }
 
-    // Phase 3: update archives
-    if (!mUpdateArchivesWork)
+    // Phase 3: fetch the state of every archive, to know which buckets each
+    // one is missing
+    if (!mGetArchiveStatesWork)
     {
-        mUpdateArchivesWork = addWork<Work>("update-archives");
-        for (auto& aPair : mApp.getConfig().HISTORY)
+        mGetArchiveStatesWork = addWork<Work>("get-archive-states");
+        for (auto const& arch : writableArchives())
+        {
+            mGetArchiveStatesWork->addWork<GetHistoryArchiveStateWork>(
+                mRemoteStates[arch->getName()], 0, std::chrono::seconds(0),
+                arch);
+        }
+        return WORK_PENDING;
+    }
+
+    // Phase 4: compress every file to send, once for all archives
+    if (!mCompressFilesWork)
+    {
+        mCompressFilesWork = addWork<Work>("compress-files");
+
+        std::vector<std::shared_ptr<FileTransferInfo>> snapFiles = {
+            mSnapshot->mLedgerSnapFile, mSnapshot->mTransactionSnapFile,
+            mSnapshot->mTransactionResultSnapFile,
+            mSnapshot->mSCPHistorySnapFile};
+
+        std::map<std::string, std::shared_ptr<FileTransferInfo>> buckets;
+        std::set<std::string> compressed;
+        auto compress = [&](std::shared_ptr<FileTransferInfo> const& f)
         {
-            auto arch = aPair.second;
-            if (!arch->hasPutCmd())
+            if (compressed.insert(f->localPath_nogz()).second)
             {
-                continue;
+                mCompressFilesWork->addWork<GzipFileWork>(f->localPath_nogz(),
+                                                          true);
             }
-            mUpdateArchivesWork->addWork<PutSnapshotFilesWork>(arch, mSnapshot);
+        };
+
+        for (auto const& arch : writableArchives())
+        {
+            auto& files = mFilesToSend[arch->getName()];
+            for (auto const& f : snapFiles)
+            {
+                if (f && fs::exists(f->localPath_nogz()))
+                {
+                    files.push_back(f);
+                    compress(f);
+                }
+            }
+
+            auto const& remoteState = mRemoteStates[arch->getName()];
+            for (auto const& hash :
+                 mSnapshot->mLocalState.differingBuckets(remoteState))
+            {
+                auto& f = buckets[hash];
+                if (!f)
+                {
+                    auto b = mApp.getBucketManager().getBucketByHash(
+                        hexToBin256(hash));
+                    assert(b);
+                    f = std::make_shared<FileTransferInfo>(*b);
+                }
+                if (fs::exists(f->localPath_nogz()))
+                {
+                    files.push_back(f);
+                    compress(f);
+                }
+            }
+        }
+        return WORK_PENDING;
+    }
+
+    // Phase 5: upload to all archives in parallel
+    if (!mUpdateArchivesWork)
+    {
+        mUpdateArchivesWork = addWork<Work>("update-archives");
+        for (auto const& arch : writableArchives())
+        {
+            mUpdateArchivesWork->addWork<PutSnapshotFilesWork>(
+                arch, mSnapshot, mFilesToSend[arch->getName()]);
         }
         return WORK_PENDING;
     }
@@ -1738,6 +2003,7 @@ RepairMissingBucketsWork::onReset()
 Work::State
 RepairMissingBucketsWork::onSuccess()
 {
+    mApp.getHistoryManager().getDownloadCache().releaseUsed();
     asio::error_code ec;
     mEndHandler(ec);
     return WORK_SUCCESS;
@@ -1746,6 +2012,7 @@ RepairMissingBucketsWork::onSuccess()
 void
 RepairMissingBucketsWork::onFailureRaise()
 {
+    mApp.getHistoryManager().getDownloadCache().dropUsed();
     asio::error_code ec = std::make_error_code(std::errc::io_error);
     mEndHandler(ec);
 }
@@ -14,15 +14,24 @@
 
 #include <memory>
 #include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 /*
  * This file contains a variety of Work subclasses for the History subsystem.
  */
 
+namespace medida
+{
+class Timer;
+}
+
 namespace stellar
 {
 
+class FileTransferInfo;
+
 // This subclass exists for two reasons: first, to factor out a little code
 // around running commands, and second to ensure that command-running
 // happens from onStart rather than onRun, and that onRun is an empty
@@ -46,17 +55,21 @@ class GetRemoteFileWork : public RunCommandWork
     std::string mRemote;
     std::string mLocal;
     std::shared_ptr<HistoryArchive const> mArchive;
+    // archive the current attempt reads from
+    std::string mArchiveName;
+    bool mFromCache{false};
     void getCommand(std::string& cmdLine, std::string& outFile) override;
 
   public:
     // Passing `nullptr` for the archive argument will cause the work to
     // select a new readable history archive at random each time it runs /
-    // retries.
+    // retries. Files are taken from, and added to, the download cache.
     GetRemoteFileWork(Application& app, WorkParent& parent,
                       std::string const& remote, std::string const& local,
                       std::shared_ptr<HistoryArchive const> archive = nullptr,
                       size_t maxRetries = Work::RETRY_A_FEW);
     void onReset() override;
+    Work::State onSuccess() override;
 };
 
 class PutRemoteFileWork : public RunCommandWork
@@ -260,7 +273,7 @@ class BatchDownloadWork : public Work
     // so you don't have to worry about making a few extra BatchDownloadWork
     // classes -- they won't override the global limit, just schedule a small
     // backlog in the ProcessManager).
-    std::deque<uint32_t> mFinished;
+    std::set<uint32_t> mFinished;
     std::map<std::string, uint32_t> mRunning;
     uint32_t mFirst;
     uint32_t mLast;
@@ -275,8 +288,14 @@ class BatchDownloadWork : public Work
                       uint32_t last, std::string const& type,
                       TmpDir const& downloadDir);
     std::string getStatus() const override;
+    void getProgress(uint64_t& done, uint64_t& total) const override;
     void onReset() override;
     void notify(std::string const& childChanged) override;
+
+    // Whether the file of `checkpoint` is downloaded and decompressed. The
+    // parent is notified as each file is, so that a sibling consuming them
+    // can start before the whole batch is done.
+    bool isDownloaded(uint32_t checkpoint) const;
 };
 
 class CatchupCompleteWork : public CatchupWork
@@ -345,6 +364,7 @@ class VerifyLedgerChainWork : public Work
     LedgerHeaderHistoryEntry& mLastVerified;
 
     HistoryManager::VerifyHashStatus verifyHistoryOfSingleCheckpoint();
+    void markVerified();
 
   public:
     VerifyLedgerChainWork(Application& app, WorkParent& parent,
@@ -353,6 +373,7 @@ class VerifyLedgerChainWork : public Work
                           LedgerHeaderHistoryEntry& firstVerified,
                           LedgerHeaderHistoryEntry& lastVerified);
     std::string getStatus() const override;
+    void getProgress(uint64_t& done, uint64_t& total) const override;
     void onReset() override;
     Work::State onSuccess() override;
 };
@@ -365,20 +386,28 @@ class ApplyLedgerChainWork : public Work
     uint32_t mLastSeq;
     XDRInputFileStream mHdrIn;
     XDRInputFileStream mTxIn;
+    bool mInputFilesOpen{false};
+    bool mWholeCheckpointApplied{false};
     TransactionHistoryEntry mTxHistoryEntry;
     LedgerHeaderHistoryEntry& mLastApplied;
+    std::shared_ptr<BatchDownloadWork const> mTxDownload;
 
     TxSetFramePtr getCurrentTxSet();
     void openCurrentInputFiles();
+    void closeInputFiles();
     bool applyHistoryOfSingleLedger();
 
   public:
-    ApplyLedgerChainWork(Application& app, WorkParent& parent,
-                         TmpDir const& downloadDir, uint32_t first,
-                         uint32_t last, LedgerHeaderHistoryEntry& lastApplied);
+    // If `txDownload` is given, each checkpoint is applied as soon as it
+    // finished downloading its transactions.
+    ApplyLedgerChainWork(
+        Application& app, WorkParent& parent, TmpDir const& downloadDir,
+        uint32_t first, uint32_t last, LedgerHeaderHistoryEntry& lastApplied,
+        std::shared_ptr<BatchDownloadWork const> txDownload = nullptr);
     std::string getStatus() const override;
+    bool isReady() const override;
+    void getProgress(uint64_t& done, uint64_t& total) const override;
     void onReset() override;
-    void onStart() override;
     void onRun() override;
     Work::State onSuccess() override;
 };
@@ -406,30 +435,47 @@ class WriteSnapshotWork : public Work
 
 class PutSnapshotFilesWork : public Work
 {
+    // Uploads already-compressed files to one archive, keeping at most
+    // HistoryArchive::getMaxConcurrentUploads() of them in flight (each one
+    // retrying on its own), then updates the archive's state file.
     std::shared_ptr<HistoryArchive const> mArchive;
     std::shared_ptr<StateSnapshot> mSnapshot;
-    HistoryArchiveState mRemoteState;
+    std::vector<std::shared_ptr<FileTransferInfo>> mFiles;
+    size_t mNext{0};
+    std::map<std::string, VirtualClock::time_point> mRunning;
+    medida::Timer& mUploadTimer;
 
-    std::shared_ptr<Work> mGetHistoryArchiveStateWork;
-    std::shared_ptr<Work> mPutFilesWork;
     std::shared_ptr<Work> mPutHistoryArchiveStateWork;
 
+    void addNextUpload();
+
   public:
-    PutSnapshotFilesWork(Application& app, WorkParent& parent,
-                         std::shared_ptr<HistoryArchive const> archive,
-                         std::shared_ptr<StateSnapshot> snapshot);
+    PutSnapshotFilesWork(
+        Application& app, WorkParent& parent,
+        std::shared_ptr<HistoryArchive const> archive,
+        std::shared_ptr<StateSnapshot> snapshot,
+        std::vector<std::shared_ptr<FileTransferInfo>> const& files);
+    std::string getStatus() const override;
     void onReset() override;
+    void notify(std::string const& childChanged) override;
     Work::State onSuccess() override;
 };
 
 class PublishWork : public Work
 {
     std::shared_ptr<StateSnapshot> mSnapshot;
+    std::map<std::string, HistoryArchiveState> mRemoteStates;
+    std::map<std::string, std::vector<std::shared_ptr<FileTransferInfo>>>
+        mFilesToSend;
 
     std::shared_ptr<Work> mResolveSnapshotWork;
     std::shared_ptr<Work> mWriteSnapshotWork;
+    std::shared_ptr<Work> mGetArchiveStatesWork;
+    std::shared_ptr<Work> mCompressFilesWork;
     std::shared_ptr<Work> mUpdateArchivesWork;
 
+    std::vector<std::shared_ptr<HistoryArchive const>> writableArchives() const;
+
   public:
     PublishWork(Application& app, WorkParent& parent,
                 std::shared_ptr<StateSnapshot> snapshot);
@@ -99,9 +99,11 @@ StateSnapshot::writeHistoryBlocks() const
 
         nHeaders = LedgerHeaderFrame::copyLedgerHeadersToStream(
             mApp.getDatabase(), sess, begin, count, ledgerOut);
+        auto const& cfg = mApp.getConfig();
         size_t nTxs = TransactionFrame::copyTransactionsToStream(
             mApp.getNetworkID(), mApp.getDatabase(), sess, begin, count, txOut,
-            txResultOut);
+            txResultOut,
+            cfg.PARANOID_MODE ? 1 : cfg.HISTORY_VERIFY_TX_SAMPLE_RATE);
         CLOG(DEBUG, "History") << "Wrote " << nHeaders << " ledger headers to "
                                << mLedgerSnapFile->localPath_nogz();
         CLOG(DEBUG, "History") << "Wrote " << nTxs << " transactions to "
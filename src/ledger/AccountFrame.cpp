@@ -207,12 +207,32 @@ AccountFrame::loadAccount(LedgerDelta& delta, AccountID const& accountID,
     return a;
 }
 
+static char const* const selectAccountQuery =
+    "SELECT balance, seqnum, numsubentries, inflationdest, homedomain, "
+    "thresholds, flags, lastmodified FROM accounts WHERE accountid=:v1";
+
+static char const* const selectSignersQuery =
+    "SELECT publickey, weight FROM signers WHERE accountid =:id";
+
+static char const* const prefetchAccountsQuery =
+    "SELECT accountid, balance, seqnum, numsubentries, inflationdest, "
+    "homedomain, thresholds, flags, lastmodified FROM accounts "
+    "WHERE accountid IN (";
+
+static char const* const prefetchSignersQuery =
+    "SELECT accountid, publickey, weight FROM signers WHERE accountid IN (";
+
 AccountFrame::pointer
 AccountFrame::loadAccount(AccountID const& accountID, Database& db)
 {
     LedgerKey key;
     key.type(ACCOUNT);
     key.account().accountID = accountID;
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        auto p = state->get(key);
+        return p ? std::make_shared<AccountFrame>(*p) : nullptr;
+    }
     if (cachedEntryExists(key, db))
     {
         auto p = getCachedEntry(key, db);
@@ -221,19 +241,189 @@ AccountFrame::loadAccount(AccountID const& accountID, Database& db)
 
     std::string actIDStrKey = PubKeyUtils::toStrKey(accountID);
 
-    std::string publicKey, inflationDest, creditAuthKey;
-    std::string homeDomain, thresholds;
-    soci::indicator inflationDestInd;
+    AccountFrame::pointer res = make_shared<AccountFrame>(accountID);
+    bool found;
+    {
+        auto prep = db.getPreparedStatement(selectAccountQuery);
+        found = loadAccountRow(prep.statement(), actIDStrKey, *res, &db);
+    }
+
+    if (!found)
+    {
+        putCachedEntry(key, nullptr, db);
+        return nullptr;
+    }
+
+    if (res->mAccountEntry.numSubEntries != 0)
+    {
+        auto prep2 = db.getPreparedStatement(selectSignersQuery);
+        auto signers = loadSignerRows(prep2.statement(), actIDStrKey, &db);
+        res->mAccountEntry.signers.insert(res->mAccountEntry.signers.begin(),
+                                          signers.begin(), signers.end());
+    }
+
+    res->normalize();
+    res->mUpdateSigners = false;
+    assert(res->isValid());
+    res->mKeyCalculated = false;
+    res->putCachedEntry(db);
+    return res;
+}
+
+AccountFrame::pointer
+AccountFrame::loadAccount(AccountID const& accountID, soci::session& sess)
+{
+    std::string actIDStrKey = PubKeyUtils::toStrKey(accountID);
 
     AccountFrame::pointer res = make_shared<AccountFrame>(accountID);
-    AccountEntry& account = res->getAccount();
-
-    auto prep =
-        db.getPreparedStatement("SELECT balance, seqnum, numsubentries, "
-                                "inflationdest, homedomain, thresholds, "
-                                "flags, lastmodified "
-                                "FROM accounts WHERE accountid=:v1");
-    auto& st = prep.statement();
+    statement st = (sess.prepare << selectAccountQuery);
+    if (!loadAccountRow(st, actIDStrKey, *res, nullptr))
+    {
+        return nullptr;
+    }
+
+    if (res->mAccountEntry.numSubEntries != 0)
+    {
+        statement st2 = (sess.prepare << selectSignersQuery);
+        auto signers = loadSignerRows(st2, actIDStrKey, nullptr);
+        res->mAccountEntry.signers.insert(res->mAccountEntry.signers.begin(),
+                                          signers.begin(), signers.end());
+    }
+
+    res->normalize();
+    res->mUpdateSigners = false;
+    assert(res->isValid());
+    res->mKeyCalculated = false;
+    return res;
+}
+
+void
+AccountFrame::prefetchAccounts(std::vector<AccountID> const& accountIDs,
+                               Database& db)
+{
+    std::vector<std::string> ids;
+    for (auto const& id : accountIDs)
+    {
+        ids.emplace_back(PubKeyUtils::toStrKey(id));
+    }
+
+    std::unordered_map<std::string, AccountFrame::pointer> found;
+    std::vector<std::string> withSigners;
+    std::string actIDStrKey, inflationDest, homeDomain, thresholds;
+    soci::indicator inflationDestInd;
+    LedgerEntry le;
+    le.data.type(ACCOUNT);
+    AccountEntry& account = le.data.account();
+
+    auto accountsQuery =
+        std::string(prefetchAccountsQuery) + prefetchParameters() + ")";
+    for (size_t i = 0; i < ids.size(); i += PREFETCH_BATCH_SIZE)
+    {
+        auto batch = prefetchBatch(ids, i);
+        auto prep = db.getPreparedStatement(accountsQuery);
+        auto& st = prep.statement();
+        st.exchange(into(actIDStrKey));
+        st.exchange(into(account.balance));
+        st.exchange(into(account.seqNum));
+        st.exchange(into(account.numSubEntries));
+        st.exchange(into(inflationDest, inflationDestInd));
+        st.exchange(into(homeDomain));
+        st.exchange(into(thresholds));
+        st.exchange(into(account.flags));
+        st.exchange(into(le.lastModifiedLedgerSeq));
+        for (auto const& id : batch)
+        {
+            st.exchange(use(id));
+        }
+        st.define_and_bind();
+        {
+            auto timer = db.getSelectTimer("account-prefetch");
+            st.execute(true);
+        }
+        while (st.got_data())
+        {
+            account.accountID = PubKeyUtils::fromStrKey(actIDStrKey);
+            account.homeDomain = homeDomain;
+            bn::decode_b64(thresholds.begin(), thresholds.end(),
+                           account.thresholds.begin());
+            if (inflationDestInd == soci::i_ok)
+            {
+                account.inflationDest.activate() =
+                    PubKeyUtils::fromStrKey(inflationDest);
+            }
+            else
+            {
+                account.inflationDest.reset();
+            }
+            found[actIDStrKey] = make_shared<AccountFrame>(le);
+            if (account.numSubEntries != 0)
+            {
+                withSigners.emplace_back(actIDStrKey);
+            }
+            st.fetch();
+        }
+    }
+
+    // signers of all the accounts that may have some, in one pass
+    std::string pubKey;
+    Signer signer;
+    auto signersQuery =
+        std::string(prefetchSignersQuery) + prefetchParameters() + ")";
+    for (size_t i = 0; i < withSigners.size(); i += PREFETCH_BATCH_SIZE)
+    {
+        auto batch = prefetchBatch(withSigners, i);
+        auto prep = db.getPreparedStatement(signersQuery);
+        auto& st = prep.statement();
+        st.exchange(into(actIDStrKey));
+        st.exchange(into(pubKey));
+        st.exchange(into(signer.weight));
+        for (auto const& id : batch)
+        {
+            st.exchange(use(id));
+        }
+        st.define_and_bind();
+        {
+            auto timer = db.getSelectTimer("signer-prefetch");
+            st.execute(true);
+        }
+        while (st.got_data())
+        {
+            signer.pubKey = PubKeyUtils::fromStrKey(pubKey);
+            found[actIDStrKey]->mAccountEntry.signers.push_back(signer);
+            st.fetch();
+        }
+    }
+
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        auto it = found.find(ids[i]);
+        if (it == found.end())
+        {
+            LedgerKey key;
+            key.type(ACCOUNT);
+            key.account().accountID = accountIDs[i];
+            putCachedEntry(key, nullptr, db);
+            continue;
+        }
+        auto& res = *it->second;
+        res.normalize();
+        res.mUpdateSigners = false;
+        assert(res.isValid());
+        res.mKeyCalculated = false;
+        res.putCachedEntry(db);
+    }
+}
+
+bool
+AccountFrame::loadAccountRow(soci::statement& st,
+                             std::string const& actIDStrKey, AccountFrame& res,
+                             Database* db)
+{
+    std::string inflationDest, homeDomain, thresholds;
+    soci::indicator inflationDestInd;
+
+    AccountEntry& account = res.getAccount();
+
     st.exchange(into(account.balance));
     st.exchange(into(account.seqNum));
     st.exchange(into(account.numSubEntries));
@@ -241,24 +431,28 @@ AccountFrame::loadAccount(AccountID const& accountID, Database& db)
     st.exchange(into(homeDomain));
     st.exchange(into(thresholds));
     st.exchange(into(account.flags));
-    st.exchange(into(res->getLastModified()));
+    st.exchange(into(res.getLastModified()));
     st.exchange(use(actIDStrKey));
     st.define_and_bind();
+    if (db)
+    {
+        auto timer = db->getSelectTimer("account");
+        st.execute(true);
+    }
+    else
     {
-        auto timer = db.getSelectTimer("account");
         st.execute(true);
     }
 
     if (!st.got_data())
     {
-        putCachedEntry(key, nullptr, db);
-        return nullptr;
+        return false;
     }
 
     account.homeDomain = homeDomain;
 
     bn::decode_b64(thresholds.begin(), thresholds.end(),
-                   res->mAccountEntry.thresholds.begin());
+                   account.thresholds.begin());
 
     if (inflationDestInd == soci::i_ok)
     {
@@ -267,38 +461,35 @@ AccountFrame::loadAccount(AccountID const& accountID, Database& db)
     }
 
     account.signers.clear();
-
-    if (account.numSubEntries != 0)
-    {
-        auto signers = loadSigners(db, actIDStrKey);
-        account.signers.insert(account.signers.begin(), signers.begin(),
-                               signers.end());
-    }
-
-    res->normalize();
-    res->mUpdateSigners = false;
-    assert(res->isValid());
-    res->mKeyCalculated = false;
-    res->putCachedEntry(db);
-    return res;
+    return true;
 }
 
 std::vector<Signer>
 AccountFrame::loadSigners(Database& db, std::string const& actIDStrKey)
+{
+    auto prep2 = db.getPreparedStatement(selectSignersQuery);
+    return loadSignerRows(prep2.statement(), actIDStrKey, &db);
+}
+
+std::vector<Signer>
+AccountFrame::loadSignerRows(soci::statement& st2,
+                             std::string const& actIDStrKey, Database* db)
 {
     std::vector<Signer> res;
     string pubKey;
     Signer signer;
 
-    auto prep2 = db.getPreparedStatement("SELECT publickey, weight FROM "
-                                         "signers WHERE accountid =:id");
-    auto& st2 = prep2.statement();
     st2.exchange(use(actIDStrKey));
     st2.exchange(into(pubKey));
     st2.exchange(into(signer.weight));
     st2.define_and_bind();
+    if (db)
+    {
+        auto timer = db->getSelectTimer("signer");
+        st2.execute(true);
+    }
+    else
     {
-        auto timer = db.getSelectTimer("signer");
         st2.execute(true);
     }
     while (st2.got_data())
@@ -316,6 +507,10 @@ AccountFrame::loadSigners(Database& db, std::string const& actIDStrKey)
 bool
 AccountFrame::exists(Database& db, LedgerKey const& key)
 {
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        return state->exists(key);
+    }
     if (cachedEntryExists(key, db) && getCachedEntry(key, db) != nullptr)
     {
         return true;
@@ -357,6 +552,13 @@ AccountFrame::storeDelete(LedgerDelta& delta, Database& db,
 {
     flushCachedEntry(key, db);
 
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        state->erase(key);
+        delta.deleteEntry(key);
+        return;
+    }
+
     std::string actIDStrKey = PubKeyUtils::toStrKey(key.account().accountID);
     {
         auto timer = db.getDeleteTimer("account");
@@ -388,6 +590,25 @@ AccountFrame::storeUpdate(LedgerDelta& delta, Database& db, bool insert)
 
     flushCachedEntry(db);
 
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        // signers are stored along with the account: nothing to diff
+        if (state->exists(getKey()) == insert)
+        {
+            throw std::runtime_error("Could not update ledger state");
+        }
+        state->put(mEntry);
+        if (insert)
+        {
+            delta.addEntry(*this);
+        }
+        else
+        {
+            delta.modEntry(*this);
+        }
+        return;
+    }
+
     std::string actIDStrKey = PubKeyUtils::toStrKey(mAccountEntry.accountID);
     std::string sql;
 
@@ -598,6 +819,39 @@ AccountFrame::processForInflation(
     std::function<bool(AccountFrame::InflationVotes const&)> inflationProcessor,
     int maxWinners, Database& db)
 {
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        // same order as the query below: most votes first, ties broken by
+        // the destination's strkey, descending
+        std::vector<std::pair<std::string, InflationVotes>> votes;
+        for (auto const& v : state->getInflationVotes())
+        {
+            InflationVotes iv;
+            iv.mVotes = v.second;
+            iv.mInflationDest = v.first;
+            votes.emplace_back(PubKeyUtils::toStrKey(v.first), iv);
+        }
+        std::sort(votes.begin(), votes.end(),
+                  [](std::pair<std::string, InflationVotes> const& l,
+                     std::pair<std::string, InflationVotes> const& r)
+                  {
+                      if (l.second.mVotes != r.second.mVotes)
+                      {
+                          return l.second.mVotes > r.second.mVotes;
+                      }
+                      return l.first > r.first;
+                  });
+        for (int i = 0; i < maxWinners && i < static_cast<int>(votes.size());
+             i++)
+        {
+            if (!inflationProcessor(votes[i].second))
+            {
+                break;
+            }
+        }
+        return;
+    }
+
     soci::session& session = db.getSession();
 
     InflationVotes v;
@@ -629,6 +883,18 @@ std::unordered_map<AccountID, AccountFrame::pointer>
 AccountFrame::checkDB(Database& db)
 {
     std::unordered_map<AccountID, AccountFrame::pointer> state;
+    if (auto ledgerState = db.getInMemoryLedgerState())
+    {
+        // signers are stored along with their account: nothing to cross
+        // check
+        ledgerState->forEachEntry(
+            ACCOUNT, [&state](LedgerEntry const& e)
+            {
+                state.insert(std::make_pair(e.data.account().accountID,
+                                            make_shared<AccountFrame>(e)));
+            });
+        return state;
+    }
     {
         std::string id;
         soci::statement st =
@@ -12,6 +12,7 @@
 namespace soci
 {
 class session;
+class statement;
 namespace details
 {
 class prepare_temp_type;
@@ -37,6 +38,12 @@ class AccountFrame : public EntryFrame
 
     static std::vector<Signer> loadSigners(Database& db,
                                            std::string const& actIDStrKey);
+    static bool loadAccountRow(soci::statement& st,
+                               std::string const& actIDStrKey,
+                               AccountFrame& res, Database* db);
+    static std::vector<Signer> loadSignerRows(soci::statement& st,
+                                              std::string const& actIDStrKey,
+                                              Database* db);
     void applySigners(Database& db, bool insert);
 
   public:
@@ -125,6 +132,15 @@ class AccountFrame : public EntryFrame
     loadAccount(LedgerDelta& delta, AccountID const& accountID, Database& db);
     static AccountFrame::pointer loadAccount(AccountID const& accountID,
                                              Database& db);
+    // loads directly through `sess`, bypassing the entry cache and the
+    // prepared statements of the Database: for worker threads that read
+    // through a session of their own
+    static AccountFrame::pointer loadAccount(AccountID const& accountID,
+                                             soci::session& sess);
+    // loads the accounts, and their signers, into the entry cache by batches:
+    // see EntryFrame::prefetch
+    static void prefetchAccounts(std::vector<AccountID> const& accountIDs,
+                                 Database& db);
 
     // compare signers, ignores weight
     static bool signerCompare(Signer const& s1, Signer const& s2);
@@ -79,6 +79,20 @@ DataFrame::loadData(AccountID const& accountID, std::string dataName,
 {
     DataFrame::pointer retData;
 
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        LedgerKey key;
+        key.type(DATA);
+        key.data().accountID = accountID;
+        key.data().dataName = dataName;
+        auto p = state->get(key);
+        if (p)
+        {
+            retData = make_shared<DataFrame>(*p);
+        }
+        return retData;
+    }
+
     std::string actIDStrKey = PubKeyUtils::toStrKey(accountID);
 
     std::string sql = dataColumnSelector;
@@ -141,6 +155,17 @@ DataFrame::loadAccountsData(AccountID const& accountID,
                        std::vector<DataFrame::pointer>& retData,
                        Database& db)
 {
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        std::vector<InMemoryLedgerState::EntryPtr> data;
+        state->loadSubEntries(accountID, DATA, data);
+        for (auto const& d : data)
+        {
+            retData.emplace_back(make_shared<DataFrame>(*d));
+        }
+        return;
+    }
+
     std::string actIDStrKey;
     actIDStrKey = PubKeyUtils::toStrKey(accountID);
 
@@ -161,6 +186,17 @@ std::unordered_map<AccountID, std::vector<DataFrame::pointer>>
 DataFrame::loadAllData(Database& db)
 {
     std::unordered_map<AccountID, std::vector<DataFrame::pointer>> retData;
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        state->forEachEntry(DATA, [&retData](LedgerEntry const& of)
+                            {
+                                auto& thisUserData =
+                                    retData[of.data.data().accountID];
+                                thisUserData.emplace_back(
+                                    make_shared<DataFrame>(of));
+                            });
+        return retData;
+    }
     std::string sql = dataColumnSelector;
     sql += " ORDER BY accountid";
     auto prep = db.getPreparedStatement(sql);
@@ -177,6 +213,10 @@ DataFrame::loadAllData(Database& db)
 bool
 DataFrame::exists(Database& db, LedgerKey const& key)
 {
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        return state->exists(key);
+    }
     std::string actIDStrKey = PubKeyUtils::toStrKey(key.data().accountID);
     std::string dataName = key.data().dataName;
     int exists = 0;
@@ -210,6 +250,13 @@ DataFrame::storeDelete(LedgerDelta& delta, Database& db) const
 void
 DataFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
 {
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        state->erase(key);
+        delta.deleteEntry(key);
+        return;
+    }
+
     std::string actIDStrKey = PubKeyUtils::toStrKey(key.data().accountID);
     std::string dataName = key.data().dataName;
     auto timer = db.getDeleteTimer("data");
@@ -240,6 +287,24 @@ DataFrame::storeUpdateHelper(LedgerDelta& delta, Database& db, bool insert)
 {
     touch(delta);
 
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        if (state->exists(getKey()) == insert)
+        {
+            throw std::runtime_error("could not update ledger state");
+        }
+        state->put(mEntry);
+        if (insert)
+        {
+            delta.addEntry(*this);
+        }
+        else
+        {
+            delta.modEntry(*this);
+        }
+        return;
+    }
+
     std::string actIDStrKey = PubKeyUtils::toStrKey(mData.accountID);
     std::string dataName = mData.dataName;
     std::string dataValue = bn::encode_b64(mData.dataValue);
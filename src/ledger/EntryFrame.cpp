@@ -14,6 +14,8 @@
 #include "crypto/Hex.h"
 #include "database/Database.h"
 
+#include <set>
+
 namespace stellar
 {
 using xdr::operator==;
@@ -109,6 +111,12 @@ EntryFrame::touch(LedgerDelta const& delta)
 void
 EntryFrame::flushCachedEntry(LedgerKey const& key, Database& db)
 {
+    if (db.getInMemoryLedgerState())
+    {
+        // entries held in memory are never cached; this also keeps the
+        // cache out of reach of transactions applied on worker threads
+        return;
+    }
     auto s = binToHex(xdr::xdr_to_opaque(key));
     db.getEntryCache().erase_if_exists(s);
 }
@@ -135,6 +143,73 @@ EntryFrame::putCachedEntry(LedgerKey const& key,
     db.getEntryCache().put(s, p);
 }
 
+size_t const EntryFrame::PREFETCH_BATCH_SIZE = 64;
+
+std::string
+EntryFrame::prefetchParameters()
+{
+    std::string res;
+    for (size_t i = 0; i < PREFETCH_BATCH_SIZE; i++)
+    {
+        res += (i == 0 ? ":v" : ", :v") + std::to_string(i);
+    }
+    return res;
+}
+
+std::vector<std::string>
+EntryFrame::prefetchBatch(std::vector<std::string> const& ids, size_t begin)
+{
+    std::vector<std::string> batch;
+    for (size_t i = begin; i < ids.size() && batch.size() < PREFETCH_BATCH_SIZE;
+         i++)
+    {
+        batch.emplace_back(ids[i]);
+    }
+    // matching an id twice is harmless
+    batch.resize(PREFETCH_BATCH_SIZE, batch.back());
+    return batch;
+}
+
+void
+EntryFrame::prefetch(std::vector<LedgerKey> const& keys, Database& db)
+{
+    if (db.getInMemoryLedgerState())
+    {
+        return;
+    }
+
+    std::set<LedgerKey, LedgerEntryIdCmp> seen;
+    std::vector<AccountID> accounts;
+    std::vector<LedgerKey> trustLines;
+    for (auto const& key : keys)
+    {
+        // past half the cache, prefetched entries would start evicting
+        // each other before they get used
+        if (seen.size() >= Database::ENTRY_CACHE_SIZE / 2)
+        {
+            break;
+        }
+        if (!seen.insert(key).second || cachedEntryExists(key, db))
+        {
+            continue;
+        }
+        switch (key.type())
+        {
+        case ACCOUNT:
+            accounts.emplace_back(key.account().accountID);
+            break;
+        case TRUSTLINE:
+            trustLines.emplace_back(key);
+            break;
+        default:
+            break;
+        }
+    }
+
+    AccountFrame::prefetchAccounts(accounts, db);
+    TrustFrame::prefetchTrustLines(trustLines, db);
+}
+
 void
 EntryFrame::flushCachedEntry(Database& db) const
 {
@@ -31,6 +31,15 @@ class EntryFrame : public NonMovableOrCopyable
         mKeyCalculated = false;
     }
 
+    // Prefetch queries look up this many ids at a time, padding the last
+    // batch, so that each is prepared only once.
+    static size_t const PREFETCH_BATCH_SIZE;
+    // ":v0, :v1, ..." with PREFETCH_BATCH_SIZE parameters, for an IN list
+    static std::string prefetchParameters();
+    // `ids[begin, begin + PREFETCH_BATCH_SIZE)`, padded with the last id
+    static std::vector<std::string>
+    prefetchBatch(std::vector<std::string> const& ids, size_t begin);
+
   public:
     typedef std::shared_ptr<EntryFrame> pointer;
 
@@ -51,6 +60,12 @@ class EntryFrame : public NonMovableOrCopyable
                                std::shared_ptr<LedgerEntry const> p,
                                Database& db);
 
+    // Loads the accounts and trust lines of `keys` that aren't cached yet
+    // into the cache, with a few batched queries instead of one per entry
+    // as they get loaded. Other keys are ignored, as are all keys when the
+    // ledger is kept in memory.
+    static void prefetch(std::vector<LedgerKey> const& keys, Database& db);
+
     // helpers to get/set the last modified field
     uint32 getLastModified() const;
     uint32& getLastModified();
@@ -0,0 +1,121 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/HistoryPruner.h"
+#include "database/Database.h"
+#include "ledger/LedgerHeaderFrame.h"
+#include "ledger/LedgerManager.h"
+#include "main/Application.h"
+#include "main/ExternalQueue.h"
+#include "util/Logging.h"
+
+#include "medida/counter.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+
+#include <algorithm>
+
+namespace stellar
+{
+
+uint32_t const HistoryPruner::BATCH_LEDGERS = 16;
+std::chrono::milliseconds const HistoryPruner::STEP_BUDGET(50);
+
+HistoryPruner::HistoryPruner(Application& app)
+    : mApp(app)
+    , mRowsPruned(
+          app.getMetrics().NewMeter({"history", "prune", "rows"}, "row"))
+    , mBacklog(app.getMetrics().NewCounter({"history", "prune", "backlog"}))
+    , mTarget(0)
+    , mPrunedTo(0)
+    , mBusy(false)
+{
+}
+
+void
+HistoryPruner::pruneTo(uint32_t ledgerSeq)
+{
+    mTarget = std::max(mTarget, ledgerSeq);
+    step();
+}
+
+void
+HistoryPruner::step()
+{
+    if (mBusy || mPrunedTo >= mTarget)
+    {
+        return;
+    }
+
+    uint32_t ledgerSeq =
+        std::min(mTarget, ExternalQueue(mApp).getDeletableLedger());
+    if (mPrunedTo >= ledgerSeq)
+    {
+        return;
+    }
+
+    auto& db = mApp.getDatabase();
+    if (db.isSqlite())
+    {
+        run(db.getSession(), ledgerSeq);
+        return;
+    }
+
+    mBusy = true;
+    auto& pool = db.getPool();
+    mApp.getWorkerIOService().post([this, &pool, ledgerSeq]()
+                                   {
+                                       try
+                                       {
+                                           soci::session sess(pool);
+                                           run(sess, ledgerSeq);
+                                       }
+                                       catch (std::exception& e)
+                                       {
+                                           // tried again after next ledger
+                                           CLOG(ERROR, "History")
+                                               << "Failed to delete old "
+                                                  "history: "
+                                               << e.what();
+                                       }
+                                       mBusy = false;
+                                   });
+}
+
+void
+HistoryPruner::run(soci::session& sess, uint32_t ledgerSeq)
+{
+    // wall clock: this may run on a worker thread
+    auto deadline = std::chrono::steady_clock::now() + STEP_BUDGET;
+    auto& lm = mApp.getLedgerManager();
+    bool done = false;
+    do
+    {
+        size_t rows;
+        {
+            soci::transaction tx(sess);
+            if (!mApp.getDatabase().isSqlite())
+            {
+                // deletes conflict with nothing ledger close does: don't let
+                // them make it fail to serialize
+                sess << "SET TRANSACTION ISOLATION LEVEL READ COMMITTED";
+            }
+            rows = lm.deleteOldEntries(sess, ledgerSeq, BATCH_LEDGERS);
+            tx.commit();
+        }
+        mRowsPruned.Mark(rows);
+        done = rows == 0;
+    } while (!done && std::chrono::steady_clock::now() < deadline);
+
+    uint32_t oldest = LedgerHeaderFrame::loadOldestSequence(sess);
+    mBacklog.set_count(oldest == 0 || oldest > ledgerSeq
+                           ? 0
+                           : ledgerSeq - oldest + 1);
+    if (done)
+    {
+        mPrunedTo = ledgerSeq;
+        CLOG(INFO, "History") << "Deleted history <= ledger " << ledgerSeq;
+    }
+}
+}
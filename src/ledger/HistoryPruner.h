@@ -0,0 +1,77 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace medida
+{
+class Counter;
+class Meter;
+}
+
+namespace soci
+{
+class session;
+}
+
+namespace stellar
+{
+class Application;
+
+/**
+ * Deletes the history of old ledgers (headers, transactions, fees and SCP
+ * messages) a little at a time, rather than in a few large statements that
+ * would hold the database for as long as they take.
+ *
+ * Maintenance (ExternalQueue::process) tells it which ledgers may go; then,
+ * after each ledger closed, it deletes BATCH_LEDGERS ledgers at a time, each
+ * batch in a transaction of its own, for STEP_BUDGET at most. The deletable
+ * ledgers are checked again before each step, as subscribers may have moved
+ * their cursors back since.
+ *
+ * On postgresql, steps run on a worker thread through a pooled connection,
+ * so that ledger close doesn't wait for them. SQLite takes one writer at a
+ * time: there, steps run on the main thread, in between ledger closes.
+ */
+class HistoryPruner : NonMovableOrCopyable
+{
+  public:
+    // ledgers of history deleted per statement
+    static uint32_t const BATCH_LEDGERS;
+    // time a step may take
+    static std::chrono::milliseconds const STEP_BUDGET;
+
+    explicit HistoryPruner(Application& app);
+
+    // Lets the history of the ledgers up to `ledgerSeq` be deleted, and
+    // starts deleting it.
+    void pruneTo(uint32_t ledgerSeq);
+
+    // Deletes some more of the history, if there is some left to delete and
+    // no step is running already.
+    void step();
+
+  private:
+    Application& mApp;
+    medida::Meter& mRowsPruned;
+    // ledgers of history left to delete, as of the last step
+    medida::Counter& mBacklog;
+
+    // main thread only
+    uint32_t mTarget;
+    // the history of ledgers up to there is gone; set by steps, which may
+    // run on a worker thread
+    std::atomic<uint32_t> mPrunedTo;
+    std::atomic<bool> mBusy;
+
+    // Deletes batches up to `ledgerSeq`, for STEP_BUDGET at most.
+    void run(soci::session& sess, uint32_t ledgerSeq);
+};
+}
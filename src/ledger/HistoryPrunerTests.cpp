@@ -0,0 +1,56 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "database/Database.h"
+#include "ledger/HistoryPruner.h"
+#include "ledger/LedgerHeaderFrame.h"
+#include "ledger/LedgerManager.h"
+#include "lib/catch.hpp"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "main/ExternalQueue.h"
+#include "main/test.h"
+#include "test/TxTests.h"
+#include "util/Timer.h"
+
+#include "medida/counter.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+
+using namespace stellar;
+using namespace stellar::txtest;
+
+TEST_CASE("history pruning", "[history][maintenance]")
+{
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, getTestConfig());
+    app->start();
+
+    // more ledgers than a batch holds, and than publishing needs kept
+    uint32_t const keepFrom = 2 * HistoryPruner::BATCH_LEDGERS + 2;
+    uint32_t lastLedger =
+        keepFrom + app->getHistoryManager().getCheckpointFrequency() + 2;
+    for (uint32_t seq = 2; seq <= lastLedger; ++seq)
+    {
+        closeLedgerOn(*app, seq, 1, 1, 2016);
+    }
+
+    auto& db = app->getDatabase();
+    auto& sess = db.getSession();
+    auto& rows =
+        app->getMetrics().NewMeter({"history", "prune", "rows"}, "row");
+    auto& backlog =
+        app->getMetrics().NewCounter({"history", "prune", "backlog"});
+
+    ExternalQueue ps(*app);
+    ps.setCursorForResource("A1", keepFrom - 1);
+    REQUIRE(ps.getDeletableLedger() == keepFrom - 1);
+    ps.process();
+
+    REQUIRE(rows.count() > 0);
+    REQUIRE(backlog.count() == 0);
+    REQUIRE(LedgerHeaderFrame::loadOldestSequence(sess) == keepFrom);
+    REQUIRE(!LedgerHeaderFrame::loadBySequence(keepFrom - 1, db, sess));
+    REQUIRE(!!LedgerHeaderFrame::loadBySequence(keepFrom, db, sess));
+}
@@ -0,0 +1,339 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/InMemoryLedgerState.h"
+#include "ledger/EntryFrame.h"
+#include "xdrpp/marshal.h"
+
+#include <cassert>
+
+namespace stellar
+{
+
+const int64 InMemoryLedgerState::INFLATION_VOTE_MIN_BALANCE = 1000000000;
+
+static std::string
+toKeyString(LedgerKey const& key)
+{
+    auto bytes = xdr::xdr_to_opaque(key);
+    return std::string(bytes.begin(), bytes.end());
+}
+
+static std::string
+toAssetString(Asset const& asset)
+{
+    auto bytes = xdr::xdr_to_opaque(asset);
+    return std::string(bytes.begin(), bytes.end());
+}
+
+static AccountID const&
+getOwner(LedgerEntry const& entry)
+{
+    switch (entry.data.type())
+    {
+    case TRUSTLINE:
+        return entry.data.trustLine().accountID;
+    case OFFER:
+        return entry.data.offer().sellerID;
+    case DATA:
+        return entry.data.data().accountID;
+    default:
+        return entry.data.account().accountID;
+    }
+}
+
+static bool
+votesForInflation(AccountEntry const& account)
+{
+    return account.inflationDest &&
+           account.balance >= InMemoryLedgerState::INFLATION_VOTE_MIN_BALANCE;
+}
+
+InMemoryLedgerState::InMemoryLedgerState(InMemoryLedgerState const* parent)
+    : mParent(parent)
+{
+}
+
+void
+InMemoryLedgerState::index(LedgerEntry const& entry, std::string const& key,
+                           EntryPtr const& p)
+{
+    ++mCounts[entry.data.type()];
+    switch (entry.data.type())
+    {
+    case ACCOUNT:
+    {
+        auto const& account = entry.data.account();
+        if (votesForInflation(account))
+        {
+            mInflationVotes[*account.inflationDest] += account.balance;
+        }
+    }
+    break;
+    case OFFER:
+    {
+        auto const& offer = entry.data.offer();
+        auto& book = mOrderBooks[std::make_pair(toAssetString(offer.selling),
+                                                toAssetString(offer.buying))];
+        // same price as OfferFrame::computePrice stores in the offers table
+        double price = double(offer.price.n) / double(offer.price.d);
+        book[std::make_pair(price, offer.offerID)] = p;
+        mSubEntries[offer.sellerID].insert(key);
+    }
+    break;
+    default:
+        mSubEntries[getOwner(entry)].insert(key);
+        break;
+    }
+}
+
+void
+InMemoryLedgerState::unindex(LedgerEntry const& entry, std::string const& key)
+{
+    --mCounts[entry.data.type()];
+    switch (entry.data.type())
+    {
+    case ACCOUNT:
+    {
+        auto const& account = entry.data.account();
+        if (votesForInflation(account))
+        {
+            auto it = mInflationVotes.find(*account.inflationDest);
+            it->second -= account.balance;
+            if (it->second == 0)
+            {
+                mInflationVotes.erase(it);
+            }
+        }
+    }
+    break;
+    case OFFER:
+    {
+        auto const& offer = entry.data.offer();
+        auto it = mOrderBooks.find(std::make_pair(
+            toAssetString(offer.selling), toAssetString(offer.buying)));
+        double price = double(offer.price.n) / double(offer.price.d);
+        it->second.erase(std::make_pair(price, offer.offerID));
+        if (it->second.empty())
+        {
+            mOrderBooks.erase(it);
+        }
+    }
+    // fall through
+    default:
+    {
+        auto it = mSubEntries.find(getOwner(entry));
+        it->second.erase(key);
+        if (it->second.empty())
+        {
+            mSubEntries.erase(it);
+        }
+    }
+    break;
+    }
+}
+
+void
+InMemoryLedgerState::set(LedgerKey const& key, EntryPtr p, bool logUndo)
+{
+    auto k = toKeyString(key);
+    if (mParent)
+    {
+        if (logUndo)
+        {
+            mUndo.emplace_back(key, get(key));
+        }
+        mEntries[k] = p;
+        return;
+    }
+
+    auto it = mEntries.find(k);
+    EntryPtr previous;
+    if (it != mEntries.end())
+    {
+        previous = it->second;
+        unindex(*previous, k);
+    }
+    if (logUndo)
+    {
+        mUndo.emplace_back(key, previous);
+    }
+
+    if (p)
+    {
+        index(*p, k, p);
+        if (it != mEntries.end())
+        {
+            it->second = p;
+        }
+        else
+        {
+            mEntries.emplace(k, p);
+        }
+    }
+    else if (it != mEntries.end())
+    {
+        mEntries.erase(it);
+    }
+}
+
+InMemoryLedgerState::EntryPtr
+InMemoryLedgerState::get(LedgerKey const& key) const
+{
+    auto it = mEntries.find(toKeyString(key));
+    if (it != mEntries.end())
+    {
+        return it->second;
+    }
+    return mParent ? mParent->get(key) : nullptr;
+}
+
+bool
+InMemoryLedgerState::exists(LedgerKey const& key) const
+{
+    auto it = mEntries.find(toKeyString(key));
+    if (it != mEntries.end())
+    {
+        return !!it->second;
+    }
+    return mParent && mParent->exists(key);
+}
+
+void
+InMemoryLedgerState::put(LedgerEntry const& entry)
+{
+    set(LedgerEntryKey(entry), std::make_shared<LedgerEntry const>(entry),
+        true);
+}
+
+void
+InMemoryLedgerState::erase(LedgerKey const& key)
+{
+    set(key, nullptr, true);
+}
+
+void
+InMemoryLedgerState::clear()
+{
+    mEntries.clear();
+    mSubEntries.clear();
+    mOrderBooks.clear();
+    mInflationVotes.clear();
+    mCounts.clear();
+    mUndo.clear();
+}
+
+uint64_t
+InMemoryLedgerState::countEntries(LedgerEntryType type) const
+{
+    assert(!mParent);
+    auto it = mCounts.find(type);
+    return it == mCounts.end() ? 0 : it->second;
+}
+
+void
+InMemoryLedgerState::loadBestOffers(size_t numOffers, size_t offset,
+                                    Asset const& selling, Asset const& buying,
+                                    std::vector<EntryPtr>& retOffers) const
+{
+    assert(!mParent);
+    auto it = mOrderBooks.find(
+        std::make_pair(toAssetString(selling), toAssetString(buying)));
+    if (it == mOrderBooks.end())
+    {
+        return;
+    }
+    auto const& book = it->second;
+    auto o = book.begin();
+    for (size_t i = 0; i < offset && o != book.end(); ++i)
+    {
+        ++o;
+    }
+    for (size_t i = 0; i < numOffers && o != book.end(); ++i, ++o)
+    {
+        retOffers.emplace_back(o->second);
+    }
+}
+
+void
+InMemoryLedgerState::loadSubEntries(AccountID const& accountID,
+                                    LedgerEntryType type,
+                                    std::vector<EntryPtr>& retEntries) const
+{
+    assert(!mParent);
+    auto it = mSubEntries.find(accountID);
+    if (it == mSubEntries.end())
+    {
+        return;
+    }
+    for (auto const& k : it->second)
+    {
+        auto const& p = mEntries.find(k)->second;
+        if (p->data.type() == type)
+        {
+            retEntries.emplace_back(p);
+        }
+    }
+}
+
+void
+InMemoryLedgerState::forEachEntry(
+    LedgerEntryType type, std::function<void(LedgerEntry const&)> f) const
+{
+    assert(!mParent);
+    for (auto const& e : mEntries)
+    {
+        if (e.second->data.type() == type)
+        {
+            f(*e.second);
+        }
+    }
+}
+
+std::vector<std::pair<AccountID, int64>>
+InMemoryLedgerState::getInflationVotes() const
+{
+    assert(!mParent);
+    return std::vector<std::pair<AccountID, int64>>(mInflationVotes.begin(),
+                                                    mInflationVotes.end());
+}
+
+size_t
+InMemoryLedgerState::getUndoMark() const
+{
+    return mUndo.size();
+}
+
+void
+InMemoryLedgerState::rollbackTo(size_t mark)
+{
+    while (mUndo.size() > mark)
+    {
+        auto& u = mUndo.back();
+        set(u.first, u.second, false);
+        mUndo.pop_back();
+    }
+}
+
+void
+InMemoryLedgerState::commitTo(size_t mark)
+{
+    assert(!mParent);
+    if (mUndo.size() > mark)
+    {
+        mUndo.erase(mUndo.begin() + mark, mUndo.end());
+    }
+}
+
+void
+InMemoryLedgerState::mergeLayer(InMemoryLedgerState const& layer)
+{
+    assert(layer.mParent == this);
+    // every change left in the layer is in its undo log, in order
+    for (auto const& u : layer.mUndo)
+    {
+        set(u.first, layer.mEntries.find(toKeyString(u.first))->second, true);
+    }
+}
+}
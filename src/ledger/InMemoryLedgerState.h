@@ -0,0 +1,123 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/SecretKey.h"
+#include "overlay/StellarXDR.h"
+#include "util/NonCopyable.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace stellar
+{
+
+/**
+ * Ledger entries of the current ledger, kept in memory in place of the
+ * accounts, signers, trustlines, offers and accountdata tables when
+ * Config::IN_MEMORY_LEDGER_STATE is set. The Database owns it and the frames
+ * read and write through it instead of issuing SQL.
+ *
+ * Besides the entries, keyed by LedgerKey, it maintains the indexes the SQL
+ * tables have for the queries transactions make: offers by (selling,
+ * buying) ordered by price, sub-entries by account, and inflation votes by
+ * destination.
+ *
+ * Changes are undone the way an SQL transaction would be rolled back: every
+ * change is logged along with the entry it replaced, and LedgerDelta rolls
+ * the log back to where it stood when the delta was created, unless the
+ * delta is committed.
+ *
+ * Contents are not persisted: they are rebuilt from the bucket list on
+ * startup, by LedgerManager.
+ *
+ * A state created over a parent state is a layer: it reads the entries it
+ * doesn't hold from its parent, which it never changes, and keeps its own
+ * changes until mergeLayer applies them to the parent. Layers only hold
+ * entries, not the indexes: they serve transactions applied in parallel,
+ * which don't query them (see LedgerManagerImpl::applyTransactions).
+ */
+class InMemoryLedgerState : NonMovableOrCopyable
+{
+  public:
+    typedef std::shared_ptr<LedgerEntry const> EntryPtr;
+
+  private:
+    // price as computed for the offers table, then offerid
+    typedef std::pair<double, uint64> OfferOrder;
+    typedef std::map<OfferOrder, EntryPtr> OrderBook;
+
+    InMemoryLedgerState const* mParent;
+
+    // in layers, nullptr for the entries erased from the parent
+    std::unordered_map<std::string, EntryPtr> mEntries;
+    // trustlines, offers and data entries of each account, by key
+    std::unordered_map<AccountID, std::set<std::string>> mSubEntries;
+    // keyed by the (selling, buying) assets, as XDR
+    std::map<std::pair<std::string, std::string>, OrderBook> mOrderBooks;
+    // sum of the balances voting for each destination
+    std::unordered_map<AccountID, int64> mInflationVotes;
+    std::map<LedgerEntryType, uint64_t> mCounts;
+
+    std::vector<std::pair<LedgerKey, EntryPtr>> mUndo;
+
+    void index(LedgerEntry const& entry, std::string const& key,
+               EntryPtr const& p);
+    void unindex(LedgerEntry const& entry, std::string const& key);
+    void set(LedgerKey const& key, EntryPtr p, bool logUndo);
+
+  public:
+    explicit InMemoryLedgerState(InMemoryLedgerState const* parent = nullptr);
+
+    // minimum balance for an account's vote to count towards inflation
+    static const int64 INFLATION_VOTE_MIN_BALANCE;
+
+    // the entry stored under `key`, nullptr if there is none
+    EntryPtr get(LedgerKey const& key) const;
+    bool exists(LedgerKey const& key) const;
+
+    // inserts or replaces the entry
+    void put(LedgerEntry const& entry);
+    // removes the entry stored under `key`, if any
+    void erase(LedgerKey const& key);
+    // removes all entries, without logging them for undo
+    void clear();
+
+    uint64_t countEntries(LedgerEntryType type) const;
+
+    // the offers selling `selling` for `buying`, in the order of the offers
+    // table's "ORDER BY price, offerid", skipping `offset` of them
+    void loadBestOffers(size_t numOffers, size_t offset, Asset const& selling,
+                        Asset const& buying,
+                        std::vector<EntryPtr>& retOffers) const;
+
+    // the trustlines, offers or data entries of `accountID`
+    void loadSubEntries(AccountID const& accountID, LedgerEntryType type,
+                        std::vector<EntryPtr>& retEntries) const;
+
+    void forEachEntry(LedgerEntryType type,
+                      std::function<void(LedgerEntry const&)> f) const;
+
+    // total votes of every inflation destination, in no particular order
+    std::vector<std::pair<AccountID, int64>> getInflationVotes() const;
+
+    // position of the undo log, to give back to rollbackTo or commitTo
+    size_t getUndoMark() const;
+    // undoes the changes made since `mark`
+    void rollbackTo(size_t mark);
+    // forgets how to undo the changes made since `mark`; not for layers,
+    // whose undo log is what mergeLayer applies
+    void commitTo(size_t mark);
+
+    // applies the changes of `layer`, created over this state, as if they
+    // had been made here
+    void mergeLayer(InMemoryLedgerState const& layer);
+};
+}
@@ -0,0 +1,460 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/Bucket.h"
+#include "bucket/BucketManager.h"
+#include "database/Database.h"
+#include "herder/TxSetFrame.h"
+#include "ledger/AccountFrame.h"
+#include "ledger/LedgerDelta.h"
+#include "ledger/LedgerManager.h"
+#include "ledger/OfferFrame.h"
+#include "lib/catch.hpp"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "main/test.h"
+#include "test/TxTests.h"
+#include "util/Timer.h"
+#include "util/types.h"
+
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+
+using namespace stellar;
+using namespace stellar::txtest;
+
+static OfferFrame::pointer
+makeOffer(AccountID const& seller, uint64 offerID, Asset const& selling,
+          Asset const& buying, Price const& price)
+{
+    auto offer = std::make_shared<OfferFrame>();
+    auto& oe = offer->getOffer();
+    oe.sellerID = seller;
+    oe.offerID = offerID;
+    oe.selling = selling;
+    oe.buying = buying;
+    oe.price = price;
+    oe.amount = 100;
+    return offer;
+}
+
+TEST_CASE("in-memory ledger state", "[ledger][inmemory]")
+{
+    Config cfg(getTestConfig());
+    cfg.IN_MEMORY_LEDGER_STATE = true;
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    auto& db = app->getDatabase();
+    auto state = db.getInMemoryLedgerState();
+    REQUIRE(state != nullptr);
+
+    // the genesis ledger's root account is only kept in memory
+    SecretKey root = getRoot(app->getNetworkID());
+    REQUIRE(loadAccount(root, *app));
+    REQUIRE(state->countEntries(ACCOUNT) == 1);
+    REQUIRE(AccountFrame::countObjects(db.getSession()) == 0);
+
+    auto seller = getAccount("seller").getPublicKey();
+    Asset native(ASSET_TYPE_NATIVE);
+    Asset usd = makeAsset(getAccount("issuer"), "USD");
+
+    SECTION("order book")
+    {
+        {
+            LedgerDelta delta(app->getLedgerManager().getCurrentLedgerHeader(),
+                              db);
+            makeOffer(seller, 1, usd, native, Price(3, 1))->storeAdd(delta, db);
+            makeOffer(seller, 2, usd, native, Price(1, 2))->storeAdd(delta, db);
+            makeOffer(seller, 3, usd, native, Price(2, 4))->storeAdd(delta, db);
+            makeOffer(seller, 4, usd, native, Price(2, 1))->storeAdd(delta, db);
+            makeOffer(seller, 5, native, usd, Price(1, 1))->storeAdd(delta, db);
+            delta.commit();
+        }
+
+        auto bestIDs = [&](size_t n, size_t offset)
+        {
+            std::vector<OfferFrame::pointer> offers;
+            OfferFrame::loadBestOffers(n, offset, usd, native, offers, db);
+            std::vector<uint64> ids;
+            for (auto const& o : offers)
+            {
+                ids.push_back(o->getOfferID());
+            }
+            return ids;
+        };
+
+        // by price, then by offer ID for the same price
+        REQUIRE(bestIDs(10, 0) == std::vector<uint64>({2, 3, 4, 1}));
+        REQUIRE(bestIDs(2, 1) == std::vector<uint64>({3, 4}));
+
+        std::vector<OfferFrame::pointer> sellerOffers;
+        OfferFrame::loadOffers(seller, sellerOffers, db);
+        REQUIRE(sellerOffers.size() == 5);
+
+        {
+            LedgerDelta delta(app->getLedgerManager().getCurrentLedgerHeader(),
+                              db);
+            auto offer = OfferFrame::loadOffer(seller, 2, db);
+            offer->getOffer().price = Price(4, 1);
+            offer->storeChange(delta, db);
+            OfferFrame::storeDelete(delta, db, makeOffer(seller, 4, usd,
+                                                         native, Price(2, 1))
+                                                   ->getKey());
+            delta.commit();
+        }
+        REQUIRE(bestIDs(10, 0) == std::vector<uint64>({3, 1, 2}));
+        REQUIRE(state->countEntries(OFFER) == 4);
+    }
+
+    SECTION("rolled back with the delta")
+    {
+        auto rootBalance = getAccountBalance(root, *app);
+        {
+            LedgerDelta outer(app->getLedgerManager().getCurrentLedgerHeader(),
+                              db);
+            {
+                LedgerDelta inner(outer);
+                auto acc = loadAccount(root, *app);
+                acc->getAccount().balance -= 10;
+                acc->storeChange(inner, db);
+                makeOffer(seller, 1, usd, native, Price(1, 1))
+                    ->storeAdd(inner, db);
+                REQUIRE(getAccountBalance(root, *app) == rootBalance - 10);
+                // not committed
+            }
+            REQUIRE(getAccountBalance(root, *app) == rootBalance);
+            REQUIRE(!OfferFrame::loadOffer(seller, 1, db));
+
+            {
+                LedgerDelta inner(outer);
+                auto acc = loadAccount(root, *app);
+                acc->getAccount().balance -= 20;
+                acc->storeChange(inner, db);
+                inner.commit();
+            }
+            REQUIRE(getAccountBalance(root, *app) == rootBalance - 20);
+            // not committed either
+        }
+        REQUIRE(getAccountBalance(root, *app) == rootBalance);
+        REQUIRE(state->countEntries(OFFER) == 0);
+    }
+
+    SECTION("layers")
+    {
+        auto rootKey = loadAccount(root, *app)->getKey();
+        auto rootEntry = state->get(rootKey);
+        auto offer = makeOffer(seller, 1, usd, native, Price(1, 1));
+
+        InMemoryLedgerState layer(state);
+        REQUIRE(layer.get(rootKey) == rootEntry);
+
+        auto mark = layer.getUndoMark();
+        layer.put(offer->mEntry);
+        layer.erase(rootKey);
+        REQUIRE(layer.exists(offer->getKey()));
+        REQUIRE(!layer.exists(rootKey));
+        // the parent is left as it was
+        REQUIRE(!state->exists(offer->getKey()));
+        REQUIRE(state->get(rootKey) == rootEntry);
+
+        layer.rollbackTo(mark);
+        REQUIRE(!layer.exists(offer->getKey()));
+        REQUIRE(layer.get(rootKey) == rootEntry);
+
+        layer.put(offer->mEntry);
+        state->mergeLayer(layer);
+        REQUIRE(state->exists(offer->getKey()));
+        REQUIRE(state->countEntries(OFFER) == 1);
+        REQUIRE(state->get(rootKey) == rootEntry);
+    }
+
+    SECTION("inflation votes")
+    {
+        auto dest1 = getAccount("dest1").getPublicKey();
+        auto dest2 = getAccount("dest2").getPublicKey();
+        {
+            LedgerDelta delta(app->getLedgerManager().getCurrentLedgerHeader(),
+                              db);
+            auto vote = [&](char const* name, int64 balance,
+                            AccountID const& dest)
+            {
+                AccountFrame acc(getAccount(name).getPublicKey());
+                acc.getAccount().balance = balance;
+                acc.getAccount().inflationDest.activate() = dest;
+                acc.storeAdd(delta, db);
+            };
+            vote("v1", 3000000000, dest1);
+            vote("v2", 2000000000, dest2);
+            vote("v3", 2000000000, dest2);
+            // below the minimum balance to vote
+            vote("v4", 999999999, dest1);
+            delta.commit();
+        }
+
+        std::vector<AccountFrame::InflationVotes> winners;
+        AccountFrame::processForInflation(
+            [&](AccountFrame::InflationVotes const& v)
+            {
+                winners.push_back(v);
+                return true;
+            },
+            10, db);
+        REQUIRE(winners.size() == 2);
+        REQUIRE(winners[0].mInflationDest == dest2);
+        REQUIRE(winners[0].mVotes == 4000000000);
+        REQUIRE(winners[1].mInflationDest == dest1);
+        REQUIRE(winners[1].mVotes == 3000000000);
+    }
+}
+
+TEST_CASE("in-memory ledger state closes the same ledgers as SQL",
+          "[ledger][inmemory]")
+{
+    Config cfg(getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE));
+    cfg.IN_MEMORY_LEDGER_STATE = true;
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    VirtualClock sqlClock;
+    Application::pointer sqlApp =
+        Application::create(sqlClock, getTestConfig(1));
+    sqlApp->start();
+
+    Hash const& networkID = app->getNetworkID();
+    SecretKey root = getRoot(networkID);
+    SecretKey gw = getAccount("gw");
+    SecretKey a1 = getAccount("a1");
+    SecretKey a2 = getAccount("a2");
+    Asset usd = makeAsset(gw, "USD");
+    Asset native(ASSET_TYPE_NATIVE);
+    int64_t amount = app->getLedgerManager().getMinBalance(5) * 10;
+
+    // applies the same transactions to both, each built against its own
+    // sequence numbers
+    typedef std::function<std::vector<TransactionFramePtr>(Application&)>
+        TxsBuilder;
+    int day = 1;
+    auto close = [&](TxsBuilder build)
+    {
+        for (auto a : {app, sqlApp})
+        {
+            auto txSet = std::make_shared<TxSetFrame>(
+                a->getLedgerManager().getLastClosedLedgerHeader().hash);
+            for (auto const& tx : build(*a))
+            {
+                txSet->add(tx);
+            }
+            txSet->sortForHash();
+            closeLedgerOn(*a, a->getLedgerManager().getLedgerNum(), day, 7,
+                          2014, txSet);
+        }
+        ++day;
+        REQUIRE(app->getLedgerManager().getLastClosedLedgerHeader().hash ==
+                sqlApp->getLedgerManager().getLastClosedLedgerHeader().hash);
+    };
+
+    close([&](Application& a)
+          {
+              auto seq = getAccountSeqNum(root, a) + 1;
+              return std::vector<TransactionFramePtr>{
+                  createCreateAccountTx(networkID, root, gw, seq, amount),
+                  createCreateAccountTx(networkID, root, a1, seq + 1, amount),
+                  createCreateAccountTx(networkID, root, a2, seq + 2, amount)};
+          });
+    close([&](Application& a)
+          {
+              return std::vector<TransactionFramePtr>{
+                  createChangeTrust(networkID, a1, gw,
+                                    getAccountSeqNum(a1, a) + 1, "USD", 10000),
+                  createChangeTrust(networkID, a2, gw,
+                                    getAccountSeqNum(a2, a) + 1, "USD",
+                                    10000)};
+          });
+    close([&](Application& a)
+          {
+              auto seq = getAccountSeqNum(gw, a) + 1;
+              return std::vector<TransactionFramePtr>{
+                  createCreditPaymentTx(networkID, gw, a1, usd, seq, 1000),
+                  createCreditPaymentTx(networkID, gw, a2, usd, seq + 1,
+                                        1000)};
+          });
+    close([&](Application& a)
+          {
+              auto seq = getAccountSeqNum(a1, a) + 1;
+              return std::vector<TransactionFramePtr>{
+                  manageOfferOp(networkID, 0, a1, usd, native, Price(2, 1),
+                                100, seq),
+                  manageOfferOp(networkID, 0, a1, usd, native, Price(3, 1),
+                                100, seq + 1),
+                  manageOfferOp(networkID, 0, a2, usd, native, Price(1, 1),
+                                100, getAccountSeqNum(a2, a) + 1)};
+          });
+    // crosses the offers, best first
+    close([&](Application& a)
+          {
+              return std::vector<TransactionFramePtr>{createPathPaymentTx(
+                  networkID, root, a1, native, 1000, usd, 150,
+                  getAccountSeqNum(root, a) + 1, {})};
+          });
+
+    REQUIRE(AccountFrame::countObjects(app->getDatabase().getSession()) == 0);
+    REQUIRE(app->getDatabase().getInMemoryLedgerState()->countEntries(
+                OFFER) == 2);
+
+    SECTION("rebuilt from the buckets on restart")
+    {
+        auto lcl = app->getLedgerManager().getLastClosedLedgerHeader().hash;
+        auto a1Entry = loadAccount(a1, *app)->mEntry;
+        app.reset();
+
+        VirtualClock clock2;
+        Application::pointer app2 = Application::create(clock2, cfg, false);
+        app2->start();
+        REQUIRE(app2->getLedgerManager().getLastClosedLedgerHeader().hash ==
+                lcl);
+        REQUIRE(loadAccount(a1, *app2)->mEntry == a1Entry);
+        checkDBAgainstBuckets(app2->getMetrics(), app2->getBucketManager(),
+                              app2->getDatabase(),
+                              app2->getBucketManager().getBucketList());
+        app2->getLedgerManager().checkDbState();
+    }
+}
+
+TEST_CASE("parallel transaction apply closes the same ledgers as serial",
+          "[ledger][inmemory][parallel]")
+{
+    Config cfg(getTestConfig(0));
+    cfg.IN_MEMORY_LEDGER_STATE = true;
+    cfg.PARALLEL_TX_APPLY = true;
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    Config serialCfg(getTestConfig(1));
+    serialCfg.IN_MEMORY_LEDGER_STATE = true;
+    VirtualClock serialClock;
+    Application::pointer serialApp =
+        Application::create(serialClock, serialCfg);
+    serialApp->start();
+
+    Hash const& networkID = app->getNetworkID();
+    SecretKey root = getRoot(networkID);
+    SecretKey gw = getAccount("gw");
+    SecretKey merged = getAccount("merged");
+    std::vector<SecretKey> accounts;
+    for (int i = 0; i < 16; i++)
+    {
+        accounts.emplace_back(getAccount(("p" + std::to_string(i)).c_str()));
+    }
+    Asset usd = makeAsset(gw, "USD");
+    Asset native(ASSET_TYPE_NATIVE);
+    int64_t amount = app->getLedgerManager().getMinBalance(5) * 10;
+
+    typedef std::function<std::vector<TransactionFramePtr>(Application&)>
+        TxsBuilder;
+    int day = 1;
+    auto close = [&](TxsBuilder build)
+    {
+        for (auto a : {app, serialApp})
+        {
+            auto txSet = std::make_shared<TxSetFrame>(
+                a->getLedgerManager().getLastClosedLedgerHeader().hash);
+            for (auto const& tx : build(*a))
+            {
+                txSet->add(tx);
+            }
+            txSet->sortForHash();
+            closeLedgerOn(*a, a->getLedgerManager().getLedgerNum(), day, 7,
+                          2014, txSet);
+        }
+        ++day;
+        REQUIRE(app->getLedgerManager().getLastClosedLedgerHeader().hash ==
+                serialApp->getLedgerManager()
+                    .getLastClosedLedgerHeader()
+                    .hash);
+    };
+
+    // a single cluster: root pays for every account
+    close([&](Application& a)
+          {
+              auto seq = getAccountSeqNum(root, a) + 1;
+              std::vector<TransactionFramePtr> txs{
+                  createCreateAccountTx(networkID, root, gw, seq++, amount),
+                  createCreateAccountTx(networkID, root, merged, seq++,
+                                        amount)};
+              for (auto const& acc : accounts)
+              {
+                  txs.emplace_back(createCreateAccountTx(networkID, root, acc,
+                                                         seq++, amount));
+              }
+              return txs;
+          });
+    // one cluster per account, the issuer only being read
+    close([&](Application& a)
+          {
+              std::vector<TransactionFramePtr> txs;
+              for (auto const& acc : accounts)
+              {
+                  txs.emplace_back(createChangeTrust(
+                      networkID, acc, gw, getAccountSeqNum(acc, a) + 1, "USD",
+                      INT64_MAX));
+              }
+              std::string name("name");
+              DataValue value;
+              value.resize(4);
+              txs.emplace_back(createManageData(
+                  networkID, accounts[0], name, &value,
+                  getAccountSeqNum(accounts[0], a) + 2));
+              return txs;
+          });
+    close([&](Application& a)
+          {
+              auto seq = getAccountSeqNum(gw, a) + 1;
+              std::vector<TransactionFramePtr> txs;
+              for (auto const& acc : accounts)
+              {
+                  txs.emplace_back(createCreditPaymentTx(
+                      networkID, gw, acc.getPublicKey(), usd, seq++, 1000));
+              }
+              return txs;
+          });
+    // clusters of several transactions, failed ones and ones crossing
+    // offers, applied in order
+    close([&](Application& a)
+          {
+              std::vector<TransactionFramePtr> txs;
+              for (int i = 0; i < 8; i++)
+              {
+                  txs.emplace_back(createPaymentTx(
+                      networkID, accounts[i], accounts[i + 8],
+                      getAccountSeqNum(accounts[i], a) + 1, 1000));
+              }
+              txs.emplace_back(createCreditPaymentTx(
+                  networkID, accounts[8], accounts[9].getPublicKey(), usd,
+                  getAccountSeqNum(accounts[8], a) + 1, 100));
+              // underfunded
+              txs.emplace_back(createCreditPaymentTx(
+                  networkID, accounts[10], accounts[11].getPublicKey(), usd,
+                  getAccountSeqNum(accounts[10], a) + 1, 100000));
+              txs.emplace_back(manageOfferOp(
+                  networkID, 0, accounts[12], usd, native, Price(1, 1), 100,
+                  getAccountSeqNum(accounts[12], a) + 1));
+              txs.emplace_back(createPathPaymentTx(
+                  networkID, accounts[13], accounts[14], native, 200, usd, 50,
+                  getAccountSeqNum(accounts[13], a) + 1, {}));
+              txs.emplace_back(createAccountMerge(
+                  networkID, merged, accounts[15].getPublicKey(),
+                  getAccountSeqNum(merged, a) + 1));
+              return txs;
+          });
+
+    auto& applied = app->getMetrics().NewMeter(
+        {"ledger", "transaction", "apply-parallel"}, "transaction");
+    REQUIRE(applied.count() >= 32);
+    requireNoAccount(merged, *app);
+    app->getLedgerManager().checkDbState();
+}
@@ -0,0 +1,188 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerCloseMetaStream.h"
+#include "main/Application.h"
+#include "util/Logging.h"
+
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+
+#include <cerrno>
+#include <chrono>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace stellar
+{
+
+size_t const LedgerCloseMetaStream::MAX_PENDING = 16;
+
+LedgerCloseMetaStream::LedgerCloseMetaStream(Application& app,
+                                             std::string const& path)
+    : mPath(path)
+    , mWrites(app.getMetrics().NewMeter({"ledger", "metadata", "write"},
+                                        "ledger"))
+    , mBlocked(app.getMetrics().NewTimer({"ledger", "metadata", "blocked"}))
+    , mStopping(false)
+    , mThread([this]()
+              {
+                  run();
+              })
+{
+}
+
+LedgerCloseMetaStream::~LedgerCloseMetaStream()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCond.notify_all();
+    mThread.join();
+}
+
+void
+LedgerCloseMetaStream::emit(LedgerCloseMeta&& meta)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (!mError && mPending.size() >= MAX_PENDING)
+    {
+        CLOG(WARNING, "Ledger") << "Waiting for the reader of " << mPath
+                                << " to catch up";
+        auto blocked = mBlocked.TimeScope();
+        mCond.wait(lock, [this]()
+                   {
+                       return mError || mPending.size() < MAX_PENDING;
+                   });
+    }
+    if (mError)
+    {
+        std::rethrow_exception(mError);
+    }
+    mPending.emplace_back(std::move(meta));
+    mCond.notify_all();
+}
+
+bool
+LedgerCloseMetaStream::openStream()
+{
+#ifndef _WIN32
+    struct stat st;
+    if (stat(mPath.c_str(), &st) != 0 || !S_ISFIFO(st.st_mode))
+    {
+        mOut.open(mPath, true);
+        return true;
+    }
+
+    // opening a named pipe for writing blocks until there is a reader, and
+    // nothing could stop the stream then: probe without blocking instead
+    std::unique_lock<std::mutex> lock(mMutex);
+    bool warned = false;
+    while (!mStopping)
+    {
+        int fd = ::open(mPath.c_str(), O_WRONLY | O_NONBLOCK);
+        if (fd >= 0)
+        {
+            // the probe stays open until the stream is, so that the reader
+            // does not see the end of the stream in between
+            lock.unlock();
+            try
+            {
+                mOut.open(mPath, true);
+            }
+            catch (...)
+            {
+                ::close(fd);
+                throw;
+            }
+            ::close(fd);
+            return true;
+        }
+        if (errno != ENXIO)
+        {
+            throw std::runtime_error("failed to open " + mPath);
+        }
+        if (!warned)
+        {
+            CLOG(WARNING, "Ledger") << "Waiting for a reader on " << mPath;
+            warned = true;
+        }
+        mCond.wait_for(lock, std::chrono::milliseconds(100));
+    }
+    return false;
+#else
+    mOut.open(mPath, true);
+    return true;
+#endif
+}
+
+void
+LedgerCloseMetaStream::run()
+{
+    try
+    {
+        if (!openStream())
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            CLOG(WARNING, "Ledger") << "No reader opened " << mPath
+                                    << ", dropping " << mPending.size()
+                                    << " ledgers";
+            mPending.clear();
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (true)
+        {
+            mCond.wait(lock, [this]()
+                       {
+                           return mStopping || !mPending.empty();
+                       });
+            if (mPending.empty())
+            {
+                break;
+            }
+            LedgerCloseMeta meta = std::move(mPending.front());
+            mPending.pop_front();
+            mCond.notify_all();
+
+            lock.unlock();
+            if (!mOut.writeOne(meta))
+            {
+                throw std::runtime_error("failed to write to " + mPath);
+            }
+            mWrites.Mark();
+            lock.lock();
+
+            // a reader sees whole records, at the latest once it is caught up
+            if (mPending.empty())
+            {
+                lock.unlock();
+                if (!mOut.flush())
+                {
+                    throw std::runtime_error("failed to flush " + mPath);
+                }
+                lock.lock();
+            }
+        }
+        lock.unlock();
+        mOut.close();
+    }
+    catch (std::exception& e)
+    {
+        CLOG(FATAL, "Ledger") << "Ledger metadata stream stopped: "
+                              << e.what();
+        std::lock_guard<std::mutex> lock(mMutex);
+        mError = std::current_exception();
+        mPending.clear();
+        mCond.notify_all();
+    }
+}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include "util/XDRStream.h"
+#include "xdr/Stellar-ledger.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace medida
+{
+class Meter;
+class Timer;
+}
+
+namespace stellar
+{
+class Application;
+
+/**
+ * Writes the metadata of the ledgers closed to Config::METADATA_OUTPUT_STREAM,
+ * a file or a named pipe, one LedgerCloseMeta record per ledger, framed the
+ * way history files are (see XDROutputFileStream).
+ *
+ * Records are written on a thread of their own, so that a slow reader does
+ * not hold up ledger close until MAX_PENDING records are waiting: emit then
+ * blocks until the reader catches up. The stream is opened on that thread
+ * too, in append mode so that a restart keeps what the reader has not read
+ * yet; a named pipe is only opened once it has a reader, and stopping the
+ * stream before then drops the records pending.
+ *
+ * Failing to open or to write is fatal: the next emit throws, rather than
+ * leave a gap in the stream.
+ */
+class LedgerCloseMetaStream : NonMovableOrCopyable
+{
+  public:
+    // records emitted but not written yet, past which emit blocks
+    static size_t const MAX_PENDING;
+
+    LedgerCloseMetaStream(Application& app, std::string const& path);
+    // writes the records still pending
+    ~LedgerCloseMetaStream();
+
+    void emit(LedgerCloseMeta&& meta);
+
+  private:
+    std::string const mPath;
+    XDROutputFileStream mOut;
+    medida::Meter& mWrites;
+    medida::Timer& mBlocked;
+
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    std::deque<LedgerCloseMeta> mPending;
+    bool mStopping;
+    std::exception_ptr mError;
+
+    // last, started once the rest is
+    std::thread mThread;
+
+    void run();
+    // opens mOut, once there is a reader for a named pipe; false if stopped
+    // first
+    bool openStream();
+};
+}
@@ -0,0 +1,128 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerManager.h"
+#include "lib/catch.hpp"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "main/test.h"
+#include "test/TxTests.h"
+#include "util/Timer.h"
+#include "util/TmpDir.h"
+#include "util/XDRStream.h"
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+using namespace stellar;
+using namespace stellar::txtest;
+
+TEST_CASE("ledger close metadata stream", "[ledger][metadata]")
+{
+    TmpDir dir("meta-stream");
+    Config cfg(getTestConfig());
+    cfg.METADATA_OUTPUT_STREAM = dir.getName() + "/meta.xdr";
+
+    Hash txHash;
+    LedgerHeaderHistoryEntry lastClosed;
+    {
+        VirtualClock clock;
+        Application::pointer app = Application::create(clock, cfg);
+        app->start();
+
+        auto root = getRoot(app->getNetworkID());
+        auto a1 = getAccount("A");
+        auto tx = createCreateAccountTx(
+            app->getNetworkID(), root, a1, getAccountSeqNum(root, *app) + 1,
+            app->getLedgerManager().getMinBalance(0));
+        txHash = tx->getContentsHash();
+
+        closeLedgerOn(*app, 2, 1, 1, 2016, tx);
+        closeLedgerOn(*app, 3, 2, 1, 2016);
+        lastClosed = app->getLedgerManager().getLastClosedLedgerHeader();
+        // stopping writes what is left of the stream
+    }
+
+    XDRInputFileStream in;
+    in.open(cfg.METADATA_OUTPUT_STREAM);
+    LedgerCloseMeta meta;
+
+    REQUIRE(in.readOne(meta));
+    REQUIRE(meta.v0().ledgerHeader.header.ledgerSeq == 2);
+    REQUIRE(meta.v0().txSet.txs.size() == 1);
+    REQUIRE(meta.v0().txProcessing.size() == 1);
+    auto const& trm = meta.v0().txProcessing[0];
+    REQUIRE(trm.result.transactionHash == txHash);
+    REQUIRE(trm.result.result.result.code() == txSUCCESS);
+    // the fee is charged to the source account
+    REQUIRE(!trm.feeProcessing.empty());
+    REQUIRE(trm.txApplyProcessing.operations().size() == 1);
+
+    REQUIRE(in.readOne(meta));
+    REQUIRE(meta.v0().ledgerHeader.hash == lastClosed.hash);
+    REQUIRE(meta.v0().ledgerHeader.header.ledgerSeq == 3);
+    REQUIRE(meta.v0().txProcessing.empty());
+
+    REQUIRE(!in.readOne(meta));
+}
+
+TEST_CASE("ledger close metadata stream across restarts", "[ledger][metadata]")
+{
+    TmpDir dir("meta-stream");
+    Config cfg(getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE));
+    cfg.METADATA_OUTPUT_STREAM = dir.getName() + "/meta.xdr";
+
+    {
+        VirtualClock clock;
+        Application::pointer app = Application::create(clock, cfg);
+        app->start();
+        closeLedgerOn(*app, 2, 1, 1, 2016);
+        closeLedgerOn(*app, 3, 2, 1, 2016);
+    }
+
+    // a restart closing no ledger leaves the stream alone, the next ledger
+    // closed is appended to it
+    Config cfg2(cfg);
+    cfg2.FORCE_SCP = false;
+    {
+        VirtualClock clock;
+        Application::pointer app = Application::create(clock, cfg2, false);
+        app->start();
+    }
+    {
+        VirtualClock clock;
+        Application::pointer app = Application::create(clock, cfg2, false);
+        app->start();
+        closeLedgerOn(*app, 4, 3, 1, 2016);
+    }
+
+    XDRInputFileStream in;
+    in.open(cfg.METADATA_OUTPUT_STREAM);
+    LedgerCloseMeta meta;
+    for (uint32_t seq = 2; seq <= 4; seq++)
+    {
+        REQUIRE(in.readOne(meta));
+        REQUIRE(meta.v0().ledgerHeader.header.ledgerSeq == seq);
+    }
+    REQUIRE(!in.readOne(meta));
+}
+
+#ifndef _WIN32
+TEST_CASE("ledger close metadata stream to a pipe without reader",
+          "[ledger][metadata]")
+{
+    TmpDir dir("meta-stream");
+    Config cfg(getTestConfig());
+    cfg.METADATA_OUTPUT_STREAM = dir.getName() + "/meta.fifo";
+    REQUIRE(mkfifo(cfg.METADATA_OUTPUT_STREAM.c_str(), 0600) == 0);
+
+    // stopping does not wait for a reader forever
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+    closeLedgerOn(*app, 2, 1, 1, 2016);
+    app.reset();
+}
+#endif
@@ -3,6 +3,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "ledger/LedgerDelta.h"
+#include "database/Database.h"
 #include "xdr/Stellar-ledger.h"
 #include "main/Application.h"
 #include "main/Config.h"
@@ -17,22 +18,42 @@ using xdr::operator==;
 LedgerDelta::LedgerDelta(LedgerDelta& outerDelta)
     : mOuterDelta(&outerDelta)
     , mHeader(&outerDelta.getHeader())
+    , mArena(outerDelta.mArena)
     , mCurrentHeader(outerDelta.getHeader())
     , mPreviousHeaderValue(outerDelta.getHeader())
+    , mNew(LedgerEntryIdCmp(), KeyEntryMap::allocator_type(mArena.get()))
+    , mMod(LedgerEntryIdCmp(), KeyEntryMap::allocator_type(mArena.get()))
+    , mDelete(LedgerEntryIdCmp(), KeySet::allocator_type(mArena.get()))
+    , mPrevious(LedgerEntryIdCmp(), KeyEntryMap::allocator_type(mArena.get()))
     , mDb(outerDelta.mDb)
+    , mStateMark(0)
     , mUpdateLastModified(outerDelta.mUpdateLastModified)
 {
+    if (auto state = mDb.getInMemoryLedgerState())
+    {
+        mStateMark = state->getUndoMark();
+    }
 }
 
 LedgerDelta::LedgerDelta(LedgerHeader& header, Database& db,
                          bool updateLastModified)
     : mOuterDelta(nullptr)
     , mHeader(&header)
+    , mArena(std::make_shared<LedgerDeltaArena>())
     , mCurrentHeader(header)
     , mPreviousHeaderValue(header)
+    , mNew(LedgerEntryIdCmp(), KeyEntryMap::allocator_type(mArena.get()))
+    , mMod(LedgerEntryIdCmp(), KeyEntryMap::allocator_type(mArena.get()))
+    , mDelete(LedgerEntryIdCmp(), KeySet::allocator_type(mArena.get()))
+    , mPrevious(LedgerEntryIdCmp(), KeyEntryMap::allocator_type(mArena.get()))
     , mDb(db)
+    , mStateMark(0)
     , mUpdateLastModified(updateLastModified)
 {
+    if (auto state = mDb.getInMemoryLedgerState())
+    {
+        mStateMark = state->getUndoMark();
+    }
 }
 
 LedgerDelta::~LedgerDelta()
@@ -183,16 +204,40 @@ LedgerDelta::mergeEntries(LedgerDelta& other)
 {
     checkState();
 
+    // "other" is done with its entries: they're shared rather than copied
+
     // propagates mPrevious for deleted & modified entries
     for (auto& d : other.mDelete)
     {
-        deleteEntry(d);
         auto it = other.mPrevious.find(d);
         if (it != other.mPrevious.end())
         {
-            recordEntry(*it->second);
+            recordEntry(it->second);
         }
     }
+    for (auto& m : other.mMod)
+    {
+        auto it = other.mPrevious.find(m.first);
+        if (it != other.mPrevious.end())
+        {
+            recordEntry(it->second);
+        }
+    }
+
+    if (mNew.empty() && mMod.empty() && mDelete.empty())
+    {
+        // nothing to reconcile the changes with, as for the first operation
+        // of a transaction: take the containers whole
+        mNew.swap(other.mNew);
+        mMod.swap(other.mMod);
+        mDelete.swap(other.mDelete);
+        return;
+    }
+
+    for (auto& d : other.mDelete)
+    {
+        deleteEntry(d);
+    }
     for (auto& n : other.mNew)
     {
         addEntry(n.second);
@@ -200,11 +245,6 @@ LedgerDelta::mergeEntries(LedgerDelta& other)
     for (auto& m : other.mMod)
     {
         modEntry(m.second);
-        auto it = other.mPrevious.find(m.first);
-        if (it != other.mPrevious.end())
-        {
-            recordEntry(*it->second);
-        }
     }
 }
 
@@ -224,6 +264,11 @@ LedgerDelta::commit()
         mOuterDelta->mergeEntries(*this);
         mOuterDelta = nullptr;
     }
+    else if (auto state = mDb.getInMemoryLedgerState())
+    {
+        // nothing left to roll these changes back
+        state->commitTo(mStateMark);
+    }
     *mHeader = mCurrentHeader.mHeader;
     mHeader = nullptr;
 }
@@ -246,6 +291,11 @@ LedgerDelta::rollback()
     {
         EntryFrame::flushCachedEntry(m.first, mDb);
     }
+
+    if (auto state = mDb.getInMemoryLedgerState())
+    {
+        state->rollbackTo(mStateMark);
+    }
 }
 
 void
@@ -331,6 +381,12 @@ LedgerDelta::updateLastModified() const
     return mUpdateLastModified;
 }
 
+size_t
+LedgerDelta::getAllocationCount() const
+{
+    return mArena->getAllocationCount();
+}
+
 void
 LedgerDelta::markMeters(Application& app) const
 {
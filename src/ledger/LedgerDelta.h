@@ -5,8 +5,10 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include <map>
+#include <memory>
 #include <set>
 #include "ledger/EntryFrame.h"
+#include "ledger/LedgerDeltaArena.h"
 #include "ledger/LedgerHeaderFrame.h"
 #include "bucket/LedgerCmp.h"
 #include "xdrpp/marshal.h"
@@ -18,13 +20,21 @@ class Database;
 
 class LedgerDelta
 {
-    typedef std::map<LedgerKey, EntryFrame::pointer, LedgerEntryIdCmp>
+    typedef std::map<
+        LedgerKey, EntryFrame::pointer, LedgerEntryIdCmp,
+        LedgerDeltaAllocator<std::pair<LedgerKey const, EntryFrame::pointer>>>
         KeyEntryMap;
+    typedef std::set<LedgerKey, LedgerEntryIdCmp,
+                     LedgerDeltaAllocator<LedgerKey>> KeySet;
 
     LedgerDelta*
         mOuterDelta;       // set when this delta is nested inside another delta
     LedgerHeader* mHeader; // LedgerHeader to commit changes to
 
+    // shared by the deltas nested in the outermost one; declared before the
+    // containers drawing from it, to outlive them
+    std::shared_ptr<LedgerDeltaArena> mArena;
+
     // objects to keep track of changes
     // ledger header itself
     LedgerHeaderFrame mCurrentHeader;
@@ -32,10 +42,13 @@ class LedgerDelta
     // ledger entries
     KeyEntryMap mNew;
     KeyEntryMap mMod;
-    std::set<LedgerKey, LedgerEntryIdCmp> mDelete;
+    KeySet mDelete;
     KeyEntryMap mPrevious;
 
-    Database& mDb; // Used strictly for rollback of db entry cache.
+    Database& mDb; // Used strictly for rollback of db entry cache
+                   // and of the in-memory ledger state.
+    // undo log position of the in-memory ledger state, if any, on creation
+    size_t mStateMark;
 
     bool mUpdateLastModified;
 
@@ -60,7 +73,8 @@ class LedgerDelta
 
     // keeps an internal reference to ledgerHeader,
     // will apply changes to ledgerHeader on commit,
-    // will clear db entry cache on rollback.
+    // will clear db entry cache on rollback (and undo the changes made to
+    // the in-memory ledger state since its creation).
     // updateLastModified: if true, revs the lastModified field
     LedgerDelta(LedgerHeader& ledgerHeader, Database& db,
                 bool updateLastModified = true);
@@ -85,6 +99,10 @@ class LedgerDelta
 
     bool updateLastModified() const;
 
+    // blocks taken from the heap for the entries of the outermost delta and
+    // of those nested in it, so far
+    size_t getAllocationCount() const;
+
     void markMeters(Application& app) const;
 
     std::vector<LedgerEntry> getLiveEntries() const;
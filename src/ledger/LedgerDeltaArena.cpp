@@ -0,0 +1,72 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerDeltaArena.h"
+
+#include <new>
+
+namespace stellar
+{
+
+LedgerDeltaArena::LedgerDeltaArena() : mAllocations(0)
+{
+}
+
+LedgerDeltaArena::~LedgerDeltaArena()
+{
+    // containers are gone by now: every block is free
+    for (auto& f : mFree)
+    {
+        for (auto p : f.second)
+        {
+            ::operator delete(p);
+        }
+    }
+}
+
+void*
+LedgerDeltaArena::allocate(size_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto& f : mFree)
+        {
+            if (f.first == bytes)
+            {
+                if (!f.second.empty())
+                {
+                    void* p = f.second.back();
+                    f.second.pop_back();
+                    return p;
+                }
+                break;
+            }
+        }
+        ++mAllocations;
+    }
+    return ::operator new(bytes);
+}
+
+void
+LedgerDeltaArena::deallocate(void* p, size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto& f : mFree)
+    {
+        if (f.first == bytes)
+        {
+            f.second.emplace_back(p);
+            return;
+        }
+    }
+    mFree.emplace_back(bytes, std::vector<void*>{p});
+}
+
+size_t
+LedgerDeltaArena::getAllocationCount()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mAllocations;
+}
+}
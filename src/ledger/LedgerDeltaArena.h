@@ -0,0 +1,95 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace stellar
+{
+
+/**
+ * Memory for the maps and sets of a LedgerDelta and of all the deltas nested
+ * in it, for as long as the outermost one lives: a ledger close.
+ *
+ * Nested deltas come and go with every transaction and operation. The nodes
+ * they free are kept on free lists, by size, and handed out again to the
+ * next ones rather than given back to the heap: closing a ledger allocates
+ * about as many nodes as its deltas hold at once, not as many as they ever
+ * hold.
+ *
+ * Deltas of transactions applied on worker threads share the arena of the
+ * ledger's delta (see LedgerManagerImpl::applyTransactionsInParallel), hence
+ * the lock.
+ */
+class LedgerDeltaArena : NonMovableOrCopyable
+{
+    std::mutex mMutex;
+    // free blocks by size; containers only ever ask for a few sizes
+    std::vector<std::pair<size_t, std::vector<void*>>> mFree;
+    size_t mAllocations;
+
+  public:
+    LedgerDeltaArena();
+    ~LedgerDeltaArena();
+
+    void* allocate(size_t bytes);
+    void deallocate(void* p, size_t bytes);
+
+    // number of blocks taken from the heap so far
+    size_t getAllocationCount();
+};
+
+// Allocator for the containers of LedgerDelta, drawing from an arena.
+template <typename T> class LedgerDeltaAllocator
+{
+  public:
+    typedef T value_type;
+    template <typename U> struct rebind
+    {
+        typedef LedgerDeltaAllocator<U> other;
+    };
+
+    LedgerDeltaArena* mArena;
+
+    explicit LedgerDeltaAllocator(LedgerDeltaArena* arena) : mArena(arena)
+    {
+    }
+    template <typename U>
+    LedgerDeltaAllocator(LedgerDeltaAllocator<U> const& other)
+        : mArena(other.mArena)
+    {
+    }
+
+    T*
+    allocate(size_t n)
+    {
+        return static_cast<T*>(mArena->allocate(n * sizeof(T)));
+    }
+    void
+    deallocate(T* p, size_t n)
+    {
+        mArena->deallocate(p, n * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool
+operator==(LedgerDeltaAllocator<T> const& a, LedgerDeltaAllocator<U> const& b)
+{
+    return a.mArena == b.mArena;
+}
+
+template <typename T, typename U>
+bool
+operator!=(LedgerDeltaAllocator<T> const& a, LedgerDeltaAllocator<U> const& b)
+{
+    return a.mArena != b.mArena;
+}
+}
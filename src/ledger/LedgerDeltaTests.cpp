@@ -334,3 +334,49 @@ TEST_CASE("Ledger delta", "[ledger][ledgerdelta]")
         }
     }
 }
+
+TEST_CASE("Ledger delta arena", "[ledger][ledgerdelta]")
+{
+    Config cfg(getTestConfig());
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+    LedgerHeader& curHeader = app->getLedgerManager().getCurrentLedgerHeader();
+
+    LedgerDelta delta(curHeader, app->getDatabase());
+
+    LedgerEntry le;
+    le.data.type(ACCOUNT);
+    le.data.account() = LedgerTestUtils::generateValidAccountEntry(5);
+    AccountFrame account(le);
+
+    // a transaction with an operation changing the same account, as many
+    // times as asked
+    auto applyTxs = [&](size_t nbTxs)
+    {
+        for (size_t i = 0; i < nbTxs; i++)
+        {
+            LedgerDelta txDelta(delta);
+            {
+                LedgerDelta opDelta(txDelta);
+                opDelta.recordEntry(account);
+                account.getAccount().seqNum++;
+                opDelta.modEntry(account);
+                opDelta.commit();
+            }
+            txDelta.commit();
+        }
+    };
+
+    // nested deltas reuse the nodes of those before them
+    applyTxs(10);
+    auto allocations = delta.getAllocationCount();
+    REQUIRE(allocations != 0);
+    applyTxs(100);
+    REQUIRE(delta.getAllocationCount() == allocations);
+
+    auto changes = delta.getChanges();
+    REQUIRE(changes.size() == 2);
+    REQUIRE(changes[1].updated().data.account().seqNum ==
+            account.getAccount().seqNum);
+}
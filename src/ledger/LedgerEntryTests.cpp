@@ -17,6 +17,8 @@
 #include "crypto/SecretKey.h"
 #include "ledger/LedgerTestUtils.h"
 #include "database/Database.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
 #include <utility>
 #include <memory>
 #include <unordered_map>
@@ -287,5 +289,71 @@ TEST_CASE("Ledger Entry tests", "[ledgerentry]")
 
         app->getLedgerManager().checkDbState();
     }
+
+    SECTION("prefetch")
+    {
+        LedgerHeader lh;
+        LedgerDelta delta(lh, db, false);
+
+        size_t const nbAccounts = 100;
+        std::vector<LedgerKey> keys;
+        for (size_t i = 0; i < nbAccounts; i++)
+        {
+            LedgerEntry le;
+            le.data.type(ACCOUNT);
+            le.data.account() = LedgerTestUtils::generateValidAccountEntry(5);
+            AccountFrame af(le);
+            af.storeAdd(delta, db);
+            keys.emplace_back(af.getKey());
+
+            LedgerEntry tle;
+            tle.data.type(TRUSTLINE);
+            tle.data.trustLine() =
+                LedgerTestUtils::generateValidTrustLineEntry(5);
+            tle.data.trustLine().accountID = le.data.account().accountID;
+            TrustFrame tf(tle);
+            tf.storeAdd(delta, db);
+            keys.emplace_back(tf.getKey());
+        }
+        LedgerKey missingAccount;
+        missingAccount.type(ACCOUNT);
+        missingAccount.account().accountID =
+            SecretKey::random().getPublicKey();
+        keys.emplace_back(missingAccount);
+
+        db.getEntryCache().clear();
+        EntryFrame::prefetch(keys, db);
+
+        // accounts by batches, then a single pass over their signers
+        auto& accountTimer = app->getMetrics().NewTimer(
+            {"database", "select", "account-prefetch"});
+        REQUIRE(accountTimer.count() == 2);
+
+        for (auto const& key : keys)
+        {
+            REQUIRE(EntryFrame::cachedEntryExists(key, db));
+        }
+        REQUIRE(!EntryFrame::getCachedEntry(missingAccount, db));
+
+        std::vector<std::shared_ptr<LedgerEntry const>> cached;
+        for (auto const& key : keys)
+        {
+            cached.emplace_back(EntryFrame::getCachedEntry(key, db));
+        }
+        db.getEntryCache().clear();
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            auto fromDb = EntryFrame::storeLoad(keys[i], db);
+            if (fromDb)
+            {
+                REQUIRE(cached[i]);
+                REQUIRE(fromDb->mEntry == *cached[i]);
+            }
+            else
+            {
+                REQUIRE(!cached[i]);
+            }
+        }
+    }
 }
 }
@@ -218,11 +218,26 @@ LedgerHeaderFrame::copyLedgerHeadersToStream(Database& db, soci::session& sess,
     return n;
 }
 
-void
-LedgerHeaderFrame::deleteOldEntries(Database& db, uint32_t ledgerSeq)
+size_t
+LedgerHeaderFrame::deleteOldEntries(soci::session& sess, uint32_t ledgerSeq,
+                                    uint32_t count)
 {
-    db.getSession() << "DELETE FROM ledgerheaders WHERE ledgerseq <= "
-                    << ledgerSeq;
+    return Database::deleteOldEntriesHelper(sess, "ledgerheaders", "ledgerseq",
+                                            ledgerSeq, count);
+}
+
+uint32_t
+LedgerHeaderFrame::loadOldestSequence(soci::session& sess)
+{
+    int oldest;
+    soci::indicator oldestIndicator;
+    sess << "SELECT MIN(ledgerseq) FROM ledgerheaders",
+        soci::into(oldest, oldestIndicator);
+    if (oldestIndicator != soci::indicator::i_ok)
+    {
+        return 0;
+    }
+    return static_cast<uint32_t>(oldest);
 }
 
 void
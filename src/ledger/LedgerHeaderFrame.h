@@ -54,7 +54,11 @@ class LedgerHeaderFrame
                                             uint32_t ledgerCount,
                                             XDROutputFileStream& headersOut);
 
-    static void deleteOldEntries(Database& db, uint32_t ledgerSeq);
+    // see Database::deleteOldEntriesHelper
+    static size_t deleteOldEntries(soci::session& sess, uint32_t ledgerSeq,
+                                   uint32_t count);
+    // sequence number of the oldest ledger header stored, 0 if none
+    static uint32_t loadOldestSequence(soci::session& sess);
 
     static void dropAll(Database& db);
     static const char* kSQLCreateStatement;
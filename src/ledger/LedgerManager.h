@@ -7,12 +7,18 @@
 #include "history/HistoryManager.h"
 #include <memory>
 
+namespace soci
+{
+class session;
+}
+
 namespace stellar
 {
 
 class LedgerHeaderFrame;
 class LedgerCloseData;
 class Database;
+class PathFinder;
 
 /**
  * LedgerManager maintains, in memory, a logical pair of ledgers:
@@ -164,12 +170,31 @@ class LedgerManager
     // permit testing.
     virtual void closeLedger(LedgerCloseData const& ledgerData) = 0;
 
-    // deletes old entries stored in the database
-    virtual void deleteOldEntries(Database& db, uint32_t ledgerSeq) = 0;
+    // Apply `ledgerData` on top of the last closed ledger ahead of time,
+    // keeping the results but rolling back the database, so that a following
+    // closeLedger with the same value only has to store them. Called by the
+    // Herder while SCP is balloting; does nothing unless
+    // SPECULATIVE_LEDGER_CLOSE is set and we are in sync.
+    virtual void
+    speculativelyCloseLedger(LedgerCloseData const& ledgerData) = 0;
+
+    // Deletes the history stored of the oldest `count` ledgers at most, among
+    // those up to `ledgerSeq`, through `sess`; returns the number of rows
+    // deleted, 0 once none are left. Safe to call from any thread.
+    virtual size_t deleteOldEntries(soci::session& sess, uint32_t ledgerSeq,
+                                    uint32_t count) = 0;
+
+    // Lets the history of the ledgers up to `ledgerSeq` be deleted, a little
+    // after each ledger closed (see HistoryPruner).
+    virtual void pruneHistory(uint32_t ledgerSeq) = 0;
 
     // checks the database for inconsistencies between objects
     virtual void checkDbState() = 0;
 
+    // the order books kept for the /paths command, when
+    // Config::PATH_FINDING is set; nullptr otherwise
+    virtual PathFinder* getPathFinder() = 0;
+
     virtual ~LedgerManager()
     {
     }
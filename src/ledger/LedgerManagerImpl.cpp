@@ -2,6 +2,8 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "bucket/Bucket.h"
+#include "bucket/BucketList.h"
 #include "bucket/BucketManager.h"
 #include "crypto/Hex.h"
 #include "crypto/SHA.h"
@@ -11,6 +13,8 @@
 #include "herder/TxSetFrame.h"
 #include "herder/LedgerCloseData.h"
 #include "history/HistoryManager.h"
+#include "ledger/EntryFrame.h"
+#include "ledger/InMemoryLedgerState.h"
 #include "ledger/LedgerDelta.h"
 #include "ledger/LedgerHeaderFrame.h"
 #include "ledger/LedgerManagerImpl.h"
@@ -22,17 +26,22 @@
 #include "overlay/OverlayManager.h"
 #include "util/Logging.h"
 #include "util/make_unique.h"
+#include "util/ParallelLoop.h"
 #include "util/format.h"
 
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
 #include "medida/timer.h"
 #include "medida/counter.h"
+#include "medida/histogram.h"
 #include "xdrpp/printer.h"
 #include "xdrpp/types.h"
 
 #include <chrono>
+#include <numeric>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
 
 /*
 The ledger module:
@@ -101,7 +110,11 @@ LedgerManagerImpl::LedgerManagerImpl(Application& app)
     : mApp(app)
     , mTransactionApply(
           app.getMetrics().NewTimer({"ledger", "transaction", "apply"}))
+    , mTransactionApplyParallel(app.getMetrics().NewMeter(
+          {"ledger", "transaction", "apply-parallel"}, "transaction"))
     , mLedgerClose(app.getMetrics().NewTimer({"ledger", "ledger", "close"}))
+    , mLedgerDeltaAllocations(
+          app.getMetrics().NewHistogram({"ledger", "delta", "allocations"}))
     , mLedgerAgeClosed(app.getMetrics().NewTimer({"ledger", "age", "closed"}))
     , mLedgerAge(
           app.getMetrics().NewCounter({"ledger", "age", "current-seconds"}))
@@ -113,9 +126,20 @@ LedgerManagerImpl::LedgerManagerImpl(Application& app)
     , mLastStateChange(mApp.getClock().now())
     , mSyncingLedgersSize(
           app.getMetrics().NewCounter({"ledger", "memory", "syncing-ledgers"}))
+    , mSpeculativeApply(
+          app.getMetrics().NewTimer({"ledger", "speculative", "apply"}))
+    , mSpeculativeHit(app.getMetrics().NewMeter(
+          {"ledger", "speculative", "hit"}, "ledger"))
+    , mSpeculativeMiss(app.getMetrics().NewMeter(
+          {"ledger", "speculative", "miss"}, "ledger"))
+    , mHistoryPruner(app)
     , mState(LM_BOOTING_STATE)
 
 {
+    if (app.getConfig().PATH_FINDING)
+    {
+        mPathFinder = make_unique<PathFinder>(app);
+    }
 }
 
 void
@@ -224,6 +248,14 @@ LedgerManagerImpl::loadLastKnownLedger(
                 else
                 {
                     mApp.getBucketManager().assumeState(has);
+                    if (getDatabase().getInMemoryLedgerState())
+                    {
+                        loadLedgerStateFromBuckets();
+                    }
+                    if (mPathFinder)
+                    {
+                        mPathFinder->load(mCurrentLedger->mHeader.ledgerSeq);
+                    }
 
                     CLOG(INFO, "Ledger") << "Loaded last known ledger: "
                                          << ledgerAbbrev(mCurrentLedger);
@@ -260,6 +292,31 @@ LedgerManagerImpl::loadLastKnownLedger(
     }
 }
 
+// Rebuilds the in-memory ledger state the way catchup applies buckets: from
+// the oldest bucket to the newest, so that newer entries replace older ones
+// and dead entries remove them.
+void
+LedgerManagerImpl::loadLedgerStateFromBuckets()
+{
+    auto& db = getDatabase();
+    auto state = db.getInMemoryLedgerState();
+    state->clear();
+
+    auto& bl = mApp.getBucketManager().getBucketList();
+    for (size_t i = BucketList::kNumLevels; i-- > 0;)
+    {
+        BucketLevel& level = bl.getLevel(i);
+        level.getSnap()->apply(db);
+        level.getCurr()->apply(db);
+    }
+
+    CLOG(INFO, "Ledger") << "Loaded ledger state from buckets: "
+                         << state->countEntries(ACCOUNT) << " accounts, "
+                         << state->countEntries(TRUSTLINE) << " trustlines, "
+                         << state->countEntries(OFFER) << " offers, "
+                         << state->countEntries(DATA) << " data entries";
+}
+
 Database&
 LedgerManagerImpl::getDatabase()
 {
@@ -674,6 +731,14 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
         throw std::runtime_error("txset mismatch");
     }
 
+    // the metadata stream is only opened by the first ledger closed, so that
+    // runs closing none leave it alone
+    if (!mMetaStream && !mApp.getConfig().METADATA_OUTPUT_STREAM.empty())
+    {
+        mMetaStream = make_unique<LedgerCloseMetaStream>(
+            mApp, mApp.getConfig().METADATA_OUTPUT_STREAM);
+    }
+
     if (ledgerData.mTxSet->getContentsHash() != ledgerData.mValue.txSetHash)
     {
         throw std::runtime_error("corrupt transaction set");
@@ -688,18 +753,112 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
 
     LedgerDelta ledgerDelta(mCurrentLedger->mHeader, getDatabase());
 
+    std::unique_ptr<SpeculativeClose> spec;
+    spec.swap(mSpeculativeClose);
+    if (spec && speculationMatches(*spec, ledgerData))
+    {
+        mSpeculativeHit.Mark();
+        replaySpeculativeClose(*spec, ledgerDelta);
+    }
+    else
+    {
+        if (spec)
+        {
+            mSpeculativeMiss.Mark();
+        }
+        // what gets recorded to replay a ledger is what gets streamed
+        spec.reset();
+        if (mMetaStream)
+        {
+            spec = make_unique<SpeculativeClose>();
+        }
+        applyLedger(ledgerData, ledgerDelta, spec.get());
+    }
+
+    ledgerDelta.checkAgainstDatabase(mApp);
+
+    ledgerDelta.commit();
+    mLedgerDeltaAllocations.Update(ledgerDelta.getAllocationCount());
+    closeLedgerHelper(ledgerDelta);
+
+    // The next 4 steps happen in a relatively non-obvious, subtle order.
+    // This is unfortunate and it would be nice if we could make it not
+    // be so subtle, but for the time being this is where we are.
+    //
+    // 1. Queue any history-checkpoint to the database, _within_ the current
+    //    transaction. This way if there's a crash after commit and before
+    //    we've published successfully, we'll re-publish on restart.
+    //
+    // 2. Commit the current transaction.
+    //
+    // 3. Start any queued checkpoint publishing, _after_ the commit so that
+    //    it takes its snapshot of history-rows from the committed state, but
+    //    _before_ we GC any buckets (because this is the step where the
+    //    bucket refcounts are incremented for the duration of the publish).
+    //
+    // 4. GC unreferenced buckets. Only do this once publishes are in progress.
+
+    // step 1
+    auto& hm = mApp.getHistoryManager();
+    hm.maybeQueueHistoryCheckpoint();
+
+    // step 2
+    mApp.getDatabase().resetPreparedStatements();
+    txscope.commit();
+
+    // only ever stream what is committed
+    if (mMetaStream)
+    {
+        emitLedgerCloseMeta(ledgerData, *spec);
+    }
+
+    // step 3
+    hm.publishQueuedHistory();
+    hm.logAndUpdateStatus(true);
+
+    // step 4
+    if (getState() != LM_CATCHING_UP_STATE) {
+        mApp.getBucketManager().forgetUnreferencedBuckets();
+    }
+
+    // in between ledgers, some of the history maintenance let go
+    mHistoryPruner.step();
+}
+
+// Applies the transactions and upgrades of `ledgerData` to `ledgerDelta`,
+// recording what is needed to replay them in `record` if set.
+void
+LedgerManagerImpl::applyLedger(LedgerCloseData const& ledgerData,
+                               LedgerDelta& ledgerDelta,
+                               SpeculativeClose* record)
+{
+    auto const& sv = ledgerData.mValue;
+
     // the transaction set that was agreed upon by consensus
     // was sorted by hash; we reorder it so that transactions are
     // sorted such that sequence numbers are respected
     vector<TransactionFramePtr> txs = ledgerData.mTxSet->sortForApply();
 
     // first, charge fees
-    processFeesSeqNums(txs, ledgerDelta);
+    prefetchLedgerEntries(txs);
+    processFeesSeqNums(txs, ledgerDelta,
+                       record ? &record->mFeeChanges : nullptr);
 
     TransactionResultSet txResultSet;
     txResultSet.results.reserve(txs.size());
 
-    applyTransactions(txs, ledgerDelta, txResultSet);
+    // charging fees stored the source accounts, dropping them from the cache
+    prefetchLedgerEntries(txs);
+    applyTransactions(txs, ledgerDelta, txResultSet,
+                      record ? &record->mMetas : nullptr);
+    if (record)
+    {
+        record->mTxs = txs;
+        for (auto const& tx : txs)
+        {
+            record->mResults.emplace_back(tx->getResult());
+        }
+    }
 
     ledgerDelta.getHeader().txSetResultHash =
         sha256(xdr::xdr_to_opaque(txResultSet));
@@ -739,53 +898,173 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
         }
         }
     }
+}
 
-    ledgerDelta.checkAgainstDatabase(mApp);
+void
+LedgerManagerImpl::speculativelyCloseLedger(LedgerCloseData const& ledgerData)
+{
+    if (!mApp.getConfig().SPECULATIVE_LEDGER_CLOSE ||
+        getState() != LM_SYNCED_STATE ||
+        ledgerData.mLedgerSeq != mCurrentLedger->mHeader.ledgerSeq ||
+        ledgerData.mTxSet->previousLedgerHash() !=
+            getLastClosedLedgerHeader().hash ||
+        ledgerData.mTxSet->getContentsHash() != ledgerData.mValue.txSetHash)
+    {
+        return;
+    }
+    if (mSpeculativeClose &&
+        speculationMatches(*mSpeculativeClose, ledgerData))
+    {
+        return;
+    }
+    mSpeculativeClose.reset();
 
-    ledgerDelta.commit();
-    closeLedgerHelper(ledgerDelta);
+    CLOG(DEBUG, "Ledger") << "speculatively closing ledgerSeq="
+                          << ledgerData.mLedgerSeq << " with "
+                          << stellarValueToString(ledgerData.mValue);
 
-    // The next 4 steps happen in a relatively non-obvious, subtle order.
-    // This is unfortunate and it would be nice if we could make it not
-    // be so subtle, but for the time being this is where we are.
-    //
-    // 1. Queue any history-checkpoint to the database, _within_ the current
-    //    transaction. This way if there's a crash after commit and before
-    //    we've published successfully, we'll re-publish on restart.
-    //
-    // 2. Commit the current transaction.
-    //
-    // 3. Start any queued checkpoint publishing, _after_ the commit so that
-    //    it takes its snapshot of history-rows from the committed state, but
-    //    _before_ we GC any buckets (because this is the step where the
-    //    bucket refcounts are incremented for the duration of the publish).
-    //
-    // 4. GC unreferenced buckets. Only do this once publishes are in progress.
+    DBTimeExcluder qtExclude(mApp);
+    auto timer = mSpeculativeApply.TimeScope();
+
+    auto spec = make_unique<SpeculativeClose>();
+    spec->mLedgerSeq = ledgerData.mLedgerSeq;
+    spec->mPreviousLedgerHash = getLastClosedLedgerHeader().hash;
+
+    // Transactions read the close time from the current ledger header: set
+    // the value on it the way closeLedger does, but apply to a copy of the
+    // header, and put the value back afterwards.
+    StellarValue const previousValue = mCurrentLedger->mHeader.scpValue;
+    mCurrentLedger->mHeader.scpValue = ledgerData.mValue;
+    spec->mStartHeader = mCurrentLedger->mHeader;
+    try
+    {
+        soci::transaction txscope(getDatabase().getSession());
+        LedgerHeader header = mCurrentLedger->mHeader;
+        {
+            // never committed: rolling back flushes the entries it changed
+            // from the entry cache
+            LedgerDelta ledgerDelta(header, getDatabase());
+            applyLedger(ledgerData, ledgerDelta, spec.get());
+            spec->mHeader = ledgerDelta.getHeader();
+            spec->mLive = ledgerDelta.getLiveEntries();
+            spec->mDead = ledgerDelta.getDeadEntries();
+        }
+        getDatabase().resetPreparedStatements();
+        txscope.rollback();
+    }
+    catch (std::exception& e)
+    {
+        CLOG(WARNING, "Ledger") << "speculative close of ledgerSeq="
+                                << ledgerData.mLedgerSeq
+                                << " failed: " << e.what();
+        mCurrentLedger->mHeader.scpValue = previousValue;
+        return;
+    }
+    mCurrentLedger->mHeader.scpValue = previousValue;
+    mSpeculativeClose = std::move(spec);
+}
 
-    // step 1
-    auto& hm = mApp.getHistoryManager();
-    hm.maybeQueueHistoryCheckpoint();
+bool
+LedgerManagerImpl::speculationMatches(SpeculativeClose const& spec,
+                                      LedgerCloseData const& ledgerData) const
+{
+    if (spec.mLedgerSeq != ledgerData.mLedgerSeq ||
+        spec.mPreviousLedgerHash != getLastClosedLedgerHeader().hash ||
+        !(spec.mStartHeader.scpValue == ledgerData.mValue) ||
+        ledgerData.mTxSet->mTransactions.size() != spec.mTxs.size())
+    {
+        return false;
+    }
+    // the header the value gets applied to, as closeLedger is about to set it
+    LedgerHeader start = mCurrentLedger->mHeader;
+    start.scpValue = ledgerData.mValue;
+    return start == spec.mStartHeader;
+}
 
-    // step 2
-    mApp.getDatabase().clearPreparedStatementCache();
-    txscope.commit();
+// Stores the effects recorded by speculativelyCloseLedger rather than
+// applying the transactions again: same fee and transaction history rows,
+// same ledger entries, same header.
+void
+LedgerManagerImpl::replaySpeculativeClose(SpeculativeClose const& spec,
+                                          LedgerDelta& ledgerDelta)
+{
+    CLOG(DEBUG, "Ledger") << "reusing speculative close of ledgerSeq="
+                          << spec.mLedgerSeq;
+    auto& db = getDatabase();
+    {
+        soci::transaction sqlTx(db.getSession());
+        for (size_t i = 0; i < spec.mTxs.size(); i++)
+        {
+            spec.mTxs[i]->storeTransactionFee(*this, spec.mFeeChanges[i],
+                                              static_cast<int>(i + 1));
+        }
+        sqlTx.commit();
+    }
 
-    // step 3
-    hm.publishQueuedHistory();
-    hm.logAndUpdateStatus(true);
+    for (auto const& key : spec.mDead)
+    {
+        EntryFrame::storeDelete(ledgerDelta, db, key);
+    }
+    for (auto const& entry : spec.mLive)
+    {
+        EntryFrame::FromXDR(entry)->storeAddOrChange(ledgerDelta, db);
+    }
 
-    // step 4
-    if (getState() != LM_CATCHING_UP_STATE) {
-        mApp.getBucketManager().forgetUnreferencedBuckets();
+    TransactionResultSet txResultSet;
+    txResultSet.results.reserve(spec.mTxs.size());
+    for (size_t i = 0; i < spec.mTxs.size(); i++)
+    {
+        auto& tx = spec.mTxs[i];
+        // the frames may have been validated again since
+        tx->getResult() = spec.mResults[i];
+        TransactionMeta tm = spec.mMetas[i];
+        tx->storeTransaction(*this, tm, static_cast<int>(i + 1), txResultSet);
     }
+    if (sha256(xdr::xdr_to_opaque(txResultSet)) !=
+        spec.mHeader.txSetResultHash)
+    {
+        throw std::runtime_error("speculative close results mismatch");
+    }
+
+    ledgerDelta.getHeader() = spec.mHeader;
 }
 
+// Hands the metadata of the ledger just closed, as recorded by applyLedger or
+// speculativelyCloseLedger, over to the metadata stream.
 void
-LedgerManagerImpl::deleteOldEntries(Database& db, uint32_t ledgerSeq)
+LedgerManagerImpl::emitLedgerCloseMeta(LedgerCloseData const& ledgerData,
+                                       SpeculativeClose& record)
+{
+    LedgerCloseMeta meta;
+    meta.v(0);
+    auto& v0 = meta.v0();
+    v0.ledgerHeader = mLastClosedLedger;
+    ledgerData.mTxSet->toXDR(v0.txSet);
+    v0.txProcessing.resize(record.mTxs.size());
+    for (size_t i = 0; i < record.mTxs.size(); i++)
+    {
+        auto& trm = v0.txProcessing[i];
+        trm.result.transactionHash = record.mTxs[i]->getContentsHash();
+        trm.result.result = std::move(record.mResults[i]);
+        trm.feeProcessing = std::move(record.mFeeChanges[i]);
+        trm.txApplyProcessing = std::move(record.mMetas[i]);
+    }
+    mMetaStream->emit(std::move(meta));
+}
+
+size_t
+LedgerManagerImpl::deleteOldEntries(soci::session& sess, uint32_t ledgerSeq,
+                                    uint32_t count)
 {
-    LedgerHeaderFrame::deleteOldEntries(db, ledgerSeq);
-    TransactionFrame::deleteOldEntries(db, ledgerSeq);
-    Herder::deleteOldEntries(db, ledgerSeq);
+    return LedgerHeaderFrame::deleteOldEntries(sess, ledgerSeq, count) +
+           TransactionFrame::deleteOldEntries(sess, ledgerSeq, count) +
+           Herder::deleteOldEntries(sess, ledgerSeq, count);
+}
+
+void
+LedgerManagerImpl::pruneHistory(uint32_t ledgerSeq)
+{
+    mHistoryPruner.pruneTo(ledgerSeq);
 }
 
 void
@@ -853,6 +1132,12 @@ LedgerManagerImpl::checkDbState()
     }
 }
 
+PathFinder*
+LedgerManagerImpl::getPathFinder()
+{
+    return mPathFinder.get();
+}
+
 void
 LedgerManagerImpl::advanceLedgerPointers()
 {
@@ -867,9 +1152,26 @@ LedgerManagerImpl::advanceLedgerPointers()
                           << mCurrentLedger->mHeader.ledgerSeq;
 }
 
+// Loads the accounts and trust lines `txs` are known to touch into the entry
+// cache, so that applying them takes a few batched queries per table rather
+// than one query per entry.
 void
-LedgerManagerImpl::processFeesSeqNums(std::vector<TransactionFramePtr>& txs,
-                                      LedgerDelta& delta)
+LedgerManagerImpl::prefetchLedgerEntries(
+    std::vector<TransactionFramePtr> const& txs)
+{
+    std::vector<LedgerKey> keys;
+    for (auto const& tx : txs)
+    {
+        // keys of incomplete footprints are still worth loading
+        tx->getFootprint(keys, keys);
+    }
+    EntryFrame::prefetch(keys, mApp.getDatabase());
+}
+
+void
+LedgerManagerImpl::processFeesSeqNums(
+    std::vector<TransactionFramePtr>& txs, LedgerDelta& delta,
+    std::vector<LedgerEntryChanges>* feeChanges)
 {
     CLOG(DEBUG, "Ledger") << "processing fees and sequence numbers";
     int index = 0;
@@ -880,7 +1182,12 @@ LedgerManagerImpl::processFeesSeqNums(std::vector<TransactionFramePtr>& txs,
         {
             LedgerDelta thisTxDelta(delta);
             tx->processFeeSeqNum(thisTxDelta, *this);
-            tx->storeTransactionFee(*this, thisTxDelta.getChanges(), ++index);
+            auto changes = thisTxDelta.getChanges();
+            tx->storeTransactionFee(*this, changes, ++index);
+            if (feeChanges)
+            {
+                feeChanges->emplace_back(std::move(changes));
+            }
             thisTxDelta.commit();
         }
         sqlTx.commit();
@@ -893,48 +1200,256 @@ LedgerManagerImpl::processFeesSeqNums(std::vector<TransactionFramePtr>& txs,
     }
 }
 
+// Below this many transactions in a row with known footprints, handing
+// them over to worker threads costs more than it saves.
+static size_t const MIN_TXS_FOR_PARALLEL_APPLY = 8;
+
+namespace
+{
+struct TxFootprint
+{
+    std::vector<LedgerKey> mReads;
+    std::vector<LedgerKey> mWrites;
+};
+}
+
+// Groups transactions by the ledger entries they have in common: two
+// transactions end up in the same cluster when one of them changes an entry
+// the other one reads or changes. Clusters list transactions by index, in
+// order, and come in the order of their first transaction.
+static vector<vector<size_t>>
+clusterByFootprint(vector<TxFootprint> const& footprints)
+{
+    vector<size_t> parent(footprints.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&parent](size_t i)
+    {
+        while (parent[i] != i)
+        {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
+
+    struct KeyUse
+    {
+        vector<size_t> mTxs;
+        bool mWritten{false};
+    };
+    unordered_map<string, KeyUse> uses;
+    auto use = [&uses](LedgerKey const& key, size_t tx, bool write)
+    {
+        auto bytes = xdr::xdr_to_opaque(key);
+        auto& u = uses[string(bytes.begin(), bytes.end())];
+        u.mTxs.push_back(tx);
+        u.mWritten = u.mWritten || write;
+    };
+    for (size_t i = 0; i < footprints.size(); ++i)
+    {
+        for (auto const& k : footprints[i].mReads)
+        {
+            use(k, i, false);
+        }
+        for (auto const& k : footprints[i].mWrites)
+        {
+            use(k, i, true);
+        }
+    }
+    // entries only read can be read by all clusters at once
+    for (auto const& u : uses)
+    {
+        if (u.second.mWritten)
+        {
+            auto root = find(u.second.mTxs.front());
+            for (auto tx : u.second.mTxs)
+            {
+                parent[find(tx)] = root;
+            }
+        }
+    }
+
+    vector<vector<size_t>> clusters;
+    unordered_map<size_t, size_t> clusterOf;
+    for (size_t i = 0; i < footprints.size(); ++i)
+    {
+        auto it = clusterOf.find(find(i));
+        if (it == clusterOf.end())
+        {
+            it = clusterOf.emplace(find(i), clusters.size()).first;
+            clusters.emplace_back();
+        }
+        clusters[it->second].push_back(i);
+    }
+    return clusters;
+}
+
 void
 LedgerManagerImpl::applyTransactions(std::vector<TransactionFramePtr>& txs,
                                      LedgerDelta& ledgerDelta,
-                                     TransactionResultSet& txResultSet)
+                                     TransactionResultSet& txResultSet,
+                                     std::vector<TransactionMeta>* metas)
 {
     CLOG(DEBUG, "Tx") << "applyTransactions: ledger = "
                       << mCurrentLedger->mHeader.ledgerSeq;
+    // layers of the ledger state held in memory let transactions be applied
+    // on worker threads
+    bool parallel = mApp.getConfig().PARALLEL_TX_APPLY &&
+                    mApp.getDatabase().getInMemoryLedgerState();
     int index = 0;
-    for (auto tx : txs)
+    size_t i = 0;
+    while (i < txs.size())
     {
-        auto txTime = mTransactionApply.TimeScope();
-        LedgerDelta delta(ledgerDelta);
-        TransactionMeta tm;
-        try
+        // the transactions from i on with known footprints, if any, are
+        // applied in clusters; the others (crossing offers, inflation) one
+        // at a time, in order
+        vector<TxFootprint> footprints;
+        if (parallel)
+        {
+            for (size_t j = i; j < txs.size(); ++j)
+            {
+                TxFootprint fp;
+                if (!txs[j]->getFootprint(fp.mReads, fp.mWrites))
+                {
+                    break;
+                }
+                footprints.emplace_back(std::move(fp));
+            }
+        }
+        vector<vector<size_t>> clusters;
+        if (footprints.size() >= MIN_TXS_FOR_PARALLEL_APPLY)
         {
-            CLOG(DEBUG, "Tx")
-                << " tx#" << index << " = " << hexAbbrev(tx->getFullHash())
-                << " txseq=" << tx->getSeqNum() << " (@ "
-                << mApp.getConfig().toShortString(tx->getSourceID()) << ")";
+            clusters = clusterByFootprint(footprints);
+        }
 
-            if (tx->apply(delta, tm, mApp))
+        vector<TransactionFramePtr> run(
+            txs.begin() + i,
+            txs.begin() + i + std::max<size_t>(footprints.size(), 1));
+        vector<TransactionMeta> tms(run.size());
+        if (clusters.size() > 1)
+        {
+            applyTransactionsInParallel(run, clusters, ledgerDelta, tms,
+                                        index);
+            mTransactionApplyParallel.Mark(run.size());
+        }
+        else
+        {
+            for (size_t j = 0; j < run.size(); ++j)
             {
-                delta.commit();
+                applyTransaction(run[j], ledgerDelta, tms[j],
+                                 index + int(j));
             }
-            else
+        }
+        for (size_t j = 0; j < run.size(); ++j)
+        {
+            run[j]->storeTransaction(*this, tms[j], ++index, txResultSet);
+            if (metas)
             {
-                // failure means there should be no side effects
-                assert(delta.getChanges().size() == 0);
-                assert(delta.getHeader() == ledgerDelta.getHeader());
+                metas->emplace_back(std::move(tms[j]));
             }
         }
-        catch (std::runtime_error& e)
+        i += run.size();
+    }
+}
+
+// Applies `tx` in a delta nested in `outerDelta`, committed if it succeeds.
+// Failures, exceptions included, leave no side effects. Runs on a worker
+// thread for applyTransactionsInParallel.
+void
+LedgerManagerImpl::applyTransaction(TransactionFramePtr const& tx,
+                                    LedgerDelta& outerDelta,
+                                    TransactionMeta& tm, int index)
+{
+    auto txTime = mTransactionApply.TimeScope();
+    LedgerDelta delta(outerDelta);
+    try
+    {
+        CLOG(DEBUG, "Tx") << " tx#" << index << " = "
+                          << hexAbbrev(tx->getFullHash())
+                          << " txseq=" << tx->getSeqNum() << " (@ "
+                          << mApp.getConfig().toShortString(tx->getSourceID())
+                          << ")";
+
+        if (tx->apply(delta, tm, mApp))
+        {
+            delta.commit();
+        }
+        else
         {
-            CLOG(ERROR, "Ledger") << "Exception during tx->apply: " << e.what();
-            tx->getResult().result.code(txINTERNAL_ERROR);
+            // failure means there should be no side effects
+            assert(delta.getChanges().size() == 0);
+            assert(delta.getHeader() == outerDelta.getHeader());
         }
-        catch (...)
+    }
+    catch (std::runtime_error& e)
+    {
+        CLOG(ERROR, "Ledger") << "Exception during tx->apply: " << e.what();
+        tx->getResult().result.code(txINTERNAL_ERROR);
+    }
+    catch (...)
+    {
+        CLOG(ERROR, "Ledger") << "Unknown exception during tx->apply";
+        tx->getResult().result.code(txINTERNAL_ERROR);
+    }
+}
+
+// Applies each cluster of `txs` (see clusterByFootprint), on the main thread
+// and on worker threads, into a delta and a layer over the in-memory ledger
+// state of its own, then merges them in cluster order. Clusters have no
+// ledger entry one of them changes in common, so this gives the same ledger
+// entries, results and metas as applying `txs` in order.
+void
+LedgerManagerImpl::applyTransactionsInParallel(
+    std::vector<TransactionFramePtr> const& txs,
+    std::vector<std::vector<size_t>> const& clusters, LedgerDelta& ledgerDelta,
+    std::vector<TransactionMeta>& tms, int index)
+{
+    auto& db = mApp.getDatabase();
+    auto ledgerState = db.getInMemoryLedgerState();
+    assert(ledgerState);
+
+    vector<unique_ptr<InMemoryLedgerState>> layers;
+    vector<unique_ptr<LedgerDelta>> deltas;
+    for (size_t c = 0; c < clusters.size(); ++c)
+    {
+        layers.emplace_back(make_unique<InMemoryLedgerState>(ledgerState));
+        deltas.emplace_back(make_unique<LedgerDelta>(ledgerDelta));
+    }
+
+    auto loop = make_shared<ParallelLoop>(clusters.size());
+    auto runClusters = [&]()
+    {
+        size_t c;
+        while (loop->next(c))
         {
-            CLOG(ERROR, "Ledger") << "Unknown exception during tx->apply";
-            tx->getResult().result.code(txINTERNAL_ERROR);
+            db.setThreadLedgerState(layers[c].get());
+            try
+            {
+                for (auto i : clusters[c])
+                {
+                    applyTransaction(txs[i], *deltas[c], tms[i],
+                                     index + int(i));
+                }
+            }
+            catch (...)
+            {
+                db.setThreadLedgerState(nullptr);
+                throw;
+            }
+            db.setThreadLedgerState(nullptr);
         }
-        tx->storeTransaction(*this, tm, ++index, txResultSet);
+    };
+
+    loop->help(mApp.getWorkerIOService(),
+               std::min<size_t>(std::thread::hardware_concurrency(),
+                                clusters.size() - 1),
+               runClusters);
+    loop->run(runClusters);
+
+    for (size_t c = 0; c < clusters.size(); ++c)
+    {
+        ledgerState->mergeLayer(*layers[c]);
+        deltas[c]->commit();
     }
 }
 
@@ -942,9 +1457,17 @@ void
 LedgerManagerImpl::closeLedgerHelper(LedgerDelta const& delta)
 {
     delta.markMeters(mApp);
+    auto live = delta.getLiveEntries();
+    auto dead = delta.getDeadEntries();
     mApp.getBucketManager().addBatch(mApp, mCurrentLedger->mHeader.ledgerSeq,
-                                     delta.getLiveEntries(),
-                                     delta.getDeadEntries());
+                                     live, dead);
+    mApp.getHerder().ledgerStateChanged(mCurrentLedger->mHeader.ledgerSeq,
+                                        live, dead);
+    if (mPathFinder)
+    {
+        mPathFinder->ledgerStateChanged(mCurrentLedger->mHeader.ledgerSeq,
+                                        live, dead);
+    }
 
     mApp.getBucketManager().snapshotLedger(mCurrentLedger->mHeader);
 
@@ -7,7 +7,10 @@
 
 #include <string>
 #include "ledger/LedgerManager.h"
+#include "ledger/LedgerCloseMetaStream.h"
+#include "ledger/HistoryPruner.h"
 #include "ledger/LedgerHeaderFrame.h"
+#include "ledger/PathFinder.h"
 #include "main/PersistentState.h"
 #include "history/HistoryManager.h"
 #include "xdr/Stellar-ledger.h"
@@ -20,8 +23,10 @@ Hands the old ledger off to the history
 
 namespace medida
 {
+class Meter;
 class Timer;
 class Counter;
+class Histogram;
 }
 
 namespace stellar
@@ -37,7 +42,11 @@ class LedgerManagerImpl : public LedgerManager
 
     Application& mApp;
     medida::Timer& mTransactionApply;
+    // transactions applied on worker threads, with PARALLEL_TX_APPLY
+    medida::Meter& mTransactionApplyParallel;
     medida::Timer& mLedgerClose;
+    // heap allocations of the LedgerDelta of each ledger closed
+    medida::Histogram& mLedgerDeltaAllocations;
     medida::Timer& mLedgerAgeClosed;
     medida::Counter& mLedgerAge;
     medida::Counter& mLedgerStateCurrent;
@@ -49,18 +58,64 @@ class LedgerManagerImpl : public LedgerManager
 
     std::vector<LedgerCloseData> mSyncingLedgers;
 
+    // Effects of applying a value on top of the last closed ledger, as
+    // computed by speculativelyCloseLedger.
+    struct SpeculativeClose
+    {
+        uint32_t mLedgerSeq;
+        Hash mPreviousLedgerHash;
+        // current ledger header the value was applied to (with the value
+        // set), and the resulting one
+        LedgerHeader mStartHeader;
+        LedgerHeader mHeader;
+        // in application order
+        std::vector<TransactionFramePtr> mTxs;
+        std::vector<TransactionResult> mResults;
+        std::vector<TransactionMeta> mMetas;
+        std::vector<LedgerEntryChanges> mFeeChanges;
+        std::vector<LedgerEntry> mLive;
+        std::vector<LedgerKey> mDead;
+    };
+    std::unique_ptr<SpeculativeClose> mSpeculativeClose;
+    std::unique_ptr<PathFinder> mPathFinder;
+    std::unique_ptr<LedgerCloseMetaStream> mMetaStream;
+    medida::Timer& mSpeculativeApply;
+    medida::Meter& mSpeculativeHit;
+    medida::Meter& mSpeculativeMiss;
+    HistoryPruner mHistoryPruner;
+
     void historyCaughtup(asio::error_code const& ec,
                          HistoryManager::CatchupMode mode,
                          LedgerHeaderHistoryEntry const& lastClosed);
 
+    void prefetchLedgerEntries(std::vector<TransactionFramePtr> const& txs);
     void processFeesSeqNums(std::vector<TransactionFramePtr>& txs,
-                            LedgerDelta& delta);
+                            LedgerDelta& delta,
+                            std::vector<LedgerEntryChanges>* feeChanges);
     void applyTransactions(std::vector<TransactionFramePtr>& txs,
                            LedgerDelta& ledgerDelta,
-                           TransactionResultSet& txResultSet);
+                           TransactionResultSet& txResultSet,
+                           std::vector<TransactionMeta>* metas);
+    void applyTransaction(TransactionFramePtr const& tx,
+                          LedgerDelta& outerDelta, TransactionMeta& tm,
+                          int index);
+    void
+    applyTransactionsInParallel(std::vector<TransactionFramePtr> const& txs,
+                                std::vector<std::vector<size_t>> const& clusters,
+                                LedgerDelta& ledgerDelta,
+                                std::vector<TransactionMeta>& tms, int index);
+    void applyLedger(LedgerCloseData const& ledgerData,
+                     LedgerDelta& ledgerDelta, SpeculativeClose* record);
+    bool speculationMatches(SpeculativeClose const& spec,
+                            LedgerCloseData const& ledgerData) const;
+    void replaySpeculativeClose(SpeculativeClose const& spec,
+                                LedgerDelta& ledgerDelta);
+    void emitLedgerCloseMeta(LedgerCloseData const& ledgerData,
+                             SpeculativeClose& record);
 
     void closeLedgerHelper(LedgerDelta const& delta);
     void advanceLedgerPointers();
+    void loadLedgerStateFromBuckets();
 
     State mState;
 
@@ -97,7 +152,12 @@ class LedgerManagerImpl : public LedgerManager
     HistoryManager::VerifyHashStatus
     verifyCatchupCandidate(LedgerHeaderHistoryEntry const&) const override;
     void closeLedger(LedgerCloseData const& ledgerData) override;
-    void deleteOldEntries(Database& db, uint32_t ledgerSeq) override;
+    void
+    speculativelyCloseLedger(LedgerCloseData const& ledgerData) override;
+    size_t deleteOldEntries(soci::session& sess, uint32_t ledgerSeq,
+                            uint32_t count) override;
+    void pruneHistory(uint32_t ledgerSeq) override;
     void checkDbState() override;
+    PathFinder* getPathFinder() override;
 };
 }
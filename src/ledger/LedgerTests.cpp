@@ -16,6 +16,10 @@
 #include "util/types.h"
 #include <xdrpp/autocheck.h>
 #include "LedgerTestUtils.h"
+#include "herder/LedgerCloseData.h"
+#include "test/TxTests.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
 
 using namespace stellar;
 
@@ -137,3 +141,83 @@ TEST_CASE("DB cache interaction with transactions", "[ledger][dbcache]")
 
     CHECK(balance0 == acc->getAccount().balance);
 }
+
+TEST_CASE("speculative ledger close", "[ledger]")
+{
+    using namespace stellar::txtest;
+
+    // app closes ledgers speculatively, app2 the usual way
+    Config cfg(getTestConfig(0));
+    cfg.SPECULATIVE_LEDGER_CLOSE = true;
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    VirtualClock clock2;
+    Application::pointer app2 = Application::create(clock2, getTestConfig(1));
+    app2->start();
+
+    auto& lm = app->getLedgerManager();
+    lm.setState(LedgerManager::LM_SYNCED_STATE);
+    REQUIRE(lm.getLastClosedLedgerHeader().hash ==
+            app2->getLedgerManager().getLastClosedLedgerHeader().hash);
+
+    Hash const& networkID = app->getNetworkID();
+    SecretKey root = getRoot(networkID);
+    int64_t amount = lm.getMinBalance(0) * 10;
+    auto makeTxSet = [&](Application& a)
+    {
+        auto txSet = std::make_shared<TxSetFrame>(
+            a.getLedgerManager().getLastClosedLedgerHeader().hash);
+        SequenceNumber seq = getAccountSeqNum(root, a) + 1;
+        txSet->add(createCreateAccountTx(networkID, root, getAccount("a1"),
+                                         seq++, amount));
+        txSet->add(createCreateAccountTx(networkID, root, getAccount("a2"),
+                                         seq++, amount));
+        txSet->add(
+            createPaymentTx(networkID, root, getAccount("a1"), seq++, 1000));
+        // fails: no destination
+        txSet->add(createPaymentTx(networkID, root, getAccount("nobody"),
+                                   seq++, 1000));
+        txSet->sortForHash();
+        return txSet;
+    };
+
+    auto& hits =
+        app->getMetrics().NewMeter({"ledger", "speculative", "hit"}, "ledger");
+    auto& misses =
+        app->getMetrics().NewMeter({"ledger", "speculative", "miss"}, "ledger");
+
+    uint32 ledgerSeq = lm.getLedgerNum();
+    auto txSet = makeTxSet(*app);
+    auto speculate = [&](int day)
+    {
+        StellarValue sv(txSet->getContentsHash(), getTestDate(day, 7, 2014),
+                        emptyUpgradeSteps, 0);
+        lm.speculativelyCloseLedger(LedgerCloseData(ledgerSeq, txSet, sv));
+        // nothing is committed
+        REQUIRE(lm.getLedgerNum() == ledgerSeq);
+        REQUIRE(!loadAccount(getAccount("a1"), *app, false));
+    };
+
+    SECTION("same value")
+    {
+        speculate(1);
+        closeLedgerOn(*app, ledgerSeq, 1, 7, 2014, txSet);
+        REQUIRE(hits.count() == 1);
+        REQUIRE(misses.count() == 0);
+    }
+    SECTION("other value")
+    {
+        speculate(2);
+        closeLedgerOn(*app, ledgerSeq, 1, 7, 2014, txSet);
+        REQUIRE(hits.count() == 0);
+        REQUIRE(misses.count() == 1);
+    }
+
+    closeLedgerOn(*app2, ledgerSeq, 1, 7, 2014, makeTxSet(*app2));
+    REQUIRE(lm.getLastClosedLedgerHeader().hash ==
+            app2->getLedgerManager().getLastClosedLedgerHeader().hash);
+    REQUIRE(loadAccount(getAccount("a1"), *app)->getBalance() ==
+            amount + 1000);
+}
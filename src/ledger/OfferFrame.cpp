@@ -133,6 +133,24 @@ OfferFrame::loadOffer(AccountID const& sellerID, uint64_t offerID, Database& db,
 {
     OfferFrame::pointer retOffer;
 
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        LedgerKey key;
+        key.type(OFFER);
+        key.offer().sellerID = sellerID;
+        key.offer().offerID = offerID;
+        auto p = state->get(key);
+        if (p)
+        {
+            retOffer = make_shared<OfferFrame>(*p);
+            if (delta)
+            {
+                delta->recordEntry(*retOffer);
+            }
+        }
+        return retOffer;
+    }
+
     std::string actIDStrKey = PubKeyUtils::toStrKey(sellerID);
 
     std::string sql = offerColumnSelector;
@@ -260,6 +278,17 @@ OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
                            Asset const& selling, Asset const& buying,
                            vector<OfferFrame::pointer>& retOffers, Database& db)
 {
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        std::vector<InMemoryLedgerState::EntryPtr> offers;
+        state->loadBestOffers(numOffers, offset, selling, buying, offers);
+        for (auto const& of : offers)
+        {
+            retOffers.emplace_back(make_shared<OfferFrame>(*of));
+        }
+        return;
+    }
+
     std::string sql = offerColumnSelector;
 
     std::string sellingAssetCode, sellingIssuerStrKey;
@@ -356,6 +385,17 @@ OfferFrame::loadOffers(AccountID const& accountID,
                        std::vector<OfferFrame::pointer>& retOffers,
                        Database& db)
 {
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        std::vector<InMemoryLedgerState::EntryPtr> offers;
+        state->loadSubEntries(accountID, OFFER, offers);
+        for (auto const& of : offers)
+        {
+            retOffers.emplace_back(make_shared<OfferFrame>(*of));
+        }
+        return;
+    }
+
     std::string actIDStrKey;
     actIDStrKey = PubKeyUtils::toStrKey(accountID);
 
@@ -376,6 +416,16 @@ std::unordered_map<AccountID, std::vector<OfferFrame::pointer>>
 OfferFrame::loadAllOffers(Database& db)
 {
     std::unordered_map<AccountID, std::vector<OfferFrame::pointer>> retOffers;
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        state->forEachEntry(
+            OFFER, [&retOffers](LedgerEntry const& of)
+            {
+                auto& thisUserOffers = retOffers[of.data.offer().sellerID];
+                thisUserOffers.emplace_back(make_shared<OfferFrame>(of));
+            });
+        return retOffers;
+    }
     std::string sql = offerColumnSelector;
     sql += " ORDER BY sellerid";
     auto prep = db.getPreparedStatement(sql);
@@ -392,6 +442,10 @@ OfferFrame::loadAllOffers(Database& db)
 bool
 OfferFrame::exists(Database& db, LedgerKey const& key)
 {
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        return state->exists(key);
+    }
     std::string actIDStrKey = PubKeyUtils::toStrKey(key.offer().sellerID);
     int exists = 0;
     auto timer = db.getSelectTimer("offer-exists");
@@ -424,6 +478,13 @@ OfferFrame::storeDelete(LedgerDelta& delta, Database& db) const
 void
 OfferFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
 {
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        state->erase(key);
+        delta.deleteEntry(key);
+        return;
+    }
+
     auto timer = db.getDeleteTimer("offer");
     auto prep = db.getPreparedStatement("DELETE FROM offers WHERE offerid=:s");
     auto& st = prep.statement();
@@ -461,6 +522,24 @@ OfferFrame::storeUpdateHelper(LedgerDelta& delta, Database& db, bool insert)
         throw std::runtime_error("Invalid asset");
     }
 
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        if (state->exists(getKey()) == insert)
+        {
+            throw std::runtime_error("could not update ledger state");
+        }
+        state->put(mEntry);
+        if (insert)
+        {
+            delta.addEntry(*this);
+        }
+        else
+        {
+            delta.modEntry(*this);
+        }
+        return;
+    }
+
     std::string actIDStrKey = PubKeyUtils::toStrKey(mOffer.sellerID);
 
     unsigned int sellingType = mOffer.selling.type();
@@ -0,0 +1,513 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/PathFinder.h"
+#include "crypto/SecretKey.h"
+#include "ledger/OfferFrame.h"
+#include "main/Application.h"
+#include "util/Logging.h"
+#include "util/ParallelLoop.h"
+#include "util/types.h"
+#include "xdrpp/marshal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+namespace stellar
+{
+
+size_t const PathFinder::MAX_PATH_LENGTH = 5;
+
+static std::string
+toAssetString(Asset const& asset)
+{
+    auto bytes = xdr::xdr_to_opaque(asset);
+    return std::string(bytes.begin(), bytes.end());
+}
+
+static Asset
+fromAssetString(std::string const& str)
+{
+    Asset asset;
+    xdr::xdr_from_opaque(std::vector<uint8_t>(str.begin(), str.end()), asset);
+    return asset;
+}
+
+// What `book` gives of the asset it sells for `amount` of the one it buys,
+// crossing its offers best first; 0 if it can't take all of `amount`.
+template <typename Book>
+static int64
+sendThrough(Book const& book, int64 amount)
+{
+    int64 received = 0;
+    for (auto const& o : book)
+    {
+        auto const& offer = o.second;
+        // offers give price.d of what they sell for price.n of what they buy
+        int64 affordable;
+        if (!bigDivide(affordable, amount, offer.price.d, offer.price.n))
+        {
+            affordable = INT64_MAX;
+        }
+        if (affordable <= offer.amount)
+        {
+            return affordable > INT64_MAX - received ? INT64_MAX
+                                                     : received + affordable;
+        }
+        int64 paid;
+        if (!bigDivide(paid, offer.amount, offer.price.n, offer.price.d) ||
+            offer.amount > INT64_MAX - received)
+        {
+            return 0;
+        }
+        received += offer.amount;
+        amount -= paid;
+    }
+    return 0;
+}
+
+// What `book` takes of the asset it buys to give `amount` of the one it
+// sells, crossing its offers best first; 0 if it can't give that much.
+template <typename Book>
+static int64
+receiveThrough(Book const& book, int64 amount)
+{
+    int64 needed = 0;
+    for (auto const& o : book)
+    {
+        auto const& offer = o.second;
+        int64 taken = std::min(offer.amount, amount);
+        int64 cost;
+        if (!bigDivide(cost, taken, offer.price.n, offer.price.d) ||
+            cost > INT64_MAX - needed)
+        {
+            return 0;
+        }
+        needed += cost;
+        amount -= taken;
+        if (amount == 0)
+        {
+            return needed;
+        }
+    }
+    return 0;
+}
+
+// A depth first search over the assets, from the source asset forwards or,
+// for strict receive searches, from the destination asset backwards. The
+// first hops are shared out between the threads taking part through a
+// ParallelLoop.
+class PathFinder::Search
+{
+    std::shared_ptr<Snapshot const> mSnapshot;
+    std::string mStart;
+    std::string mTarget;
+    int64 mAmount;
+    bool mStrictReceive;
+    size_t mMaxPaths;
+    std::chrono::steady_clock::time_point mDeadline;
+    std::vector<std::string> const* mFirstHops;
+
+    std::atomic<bool> mTimedOut{false};
+
+    bool
+    timedOut()
+    {
+        if (!mTimedOut && std::chrono::steady_clock::now() > mDeadline)
+        {
+            mTimedOut = true;
+        }
+        return mTimedOut;
+    }
+
+    std::vector<std::string> const*
+    nextAssets(std::string const& asset) const
+    {
+        auto const& edges =
+            mStrictReceive ? mSnapshot->mPayable : mSnapshot->mBuyable;
+        auto it = edges.find(asset);
+        return it == edges.end() ? nullptr : &it->second;
+    }
+
+    // `amount` of `from` turned into `to`, going forwards; the amount of
+    // `from` needed to get `amount` of `to`, going backwards
+    int64
+    exchange(std::string const& from, std::string const& to,
+             int64 amount) const
+    {
+        auto const& books = mSnapshot->mBooks;
+        if (mStrictReceive)
+        {
+            auto it = books.find(std::make_pair(from, to));
+            return receiveThrough(*it->second, amount);
+        }
+        auto it = books.find(std::make_pair(to, from));
+        return sendThrough(*it->second, amount);
+    }
+
+    void
+    record(std::vector<std::string> const& assets, int64 amount)
+    {
+        Path path;
+        for (size_t i = 1; i + 1 < assets.size(); ++i)
+        {
+            path.mPath.emplace_back(fromAssetString(assets[i]));
+        }
+        if (mStrictReceive)
+        {
+            std::reverse(path.mPath.begin(), path.mPath.end());
+            path.mSourceAmount = amount;
+            path.mDestAmount = mAmount;
+        }
+        else
+        {
+            path.mSourceAmount = mAmount;
+            path.mDestAmount = amount;
+        }
+
+        bool strictReceive = mStrictReceive;
+        auto better = [strictReceive](Path const& a, Path const& b)
+        {
+            if (a.mSourceAmount != b.mSourceAmount ||
+                a.mDestAmount != b.mDestAmount)
+            {
+                return strictReceive ? a.mSourceAmount < b.mSourceAmount
+                                     : a.mDestAmount > b.mDestAmount;
+            }
+            return a.mPath.size() < b.mPath.size();
+        };
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBest.insert(std::upper_bound(mBest.begin(), mBest.end(), path,
+                                      better),
+                     path);
+        if (mBest.size() > mMaxPaths)
+        {
+            mBest.pop_back();
+        }
+    }
+
+    void
+    visit(std::vector<std::string>& assets, int64 amount)
+    {
+        if (assets.back() == mTarget)
+        {
+            record(assets, amount);
+            return;
+        }
+        // as many hops as there are assets, past the first one
+        if (assets.size() > MAX_PATH_LENGTH + 1 || timedOut())
+        {
+            return;
+        }
+        auto next = nextAssets(assets.back());
+        if (!next)
+        {
+            return;
+        }
+        for (auto const& asset : *next)
+        {
+            if (std::find(assets.begin(), assets.end(), asset) !=
+                assets.end())
+            {
+                continue;
+            }
+            auto converted = exchange(assets.back(), asset, amount);
+            if (converted > 0)
+            {
+                assets.push_back(asset);
+                visit(assets, converted);
+                assets.pop_back();
+            }
+        }
+    }
+
+  public:
+    std::mutex mMutex;
+    std::vector<Path> mBest;
+
+    Search(std::shared_ptr<Snapshot const> snapshot, std::string const& start,
+           std::string const& target, int64 amount, bool strictReceive,
+           size_t maxPaths, std::chrono::milliseconds budget)
+        : mSnapshot(snapshot)
+        , mStart(start)
+        , mTarget(target)
+        , mAmount(amount)
+        , mStrictReceive(strictReceive)
+        , mMaxPaths(maxPaths)
+        , mDeadline(std::chrono::steady_clock::now() + budget)
+        , mFirstHops(nextAssets(start))
+    {
+    }
+
+    size_t
+    countFirstHops() const
+    {
+        return mFirstHops ? mFirstHops->size() : 0;
+    }
+
+    bool
+    isComplete() const
+    {
+        return !mTimedOut;
+    }
+
+    // searches from the first hops `loop` hands out
+    void
+    run(ParallelLoop& loop)
+    {
+        size_t i;
+        while (!timedOut() && loop.next(i))
+        {
+            auto const& asset = (*mFirstHops)[i];
+            auto converted = exchange(mStart, asset, mAmount);
+            if (converted > 0)
+            {
+                std::vector<std::string> assets{mStart, asset};
+                visit(assets, converted);
+            }
+        }
+    }
+};
+
+PathFinder::PathFinder(Application& app)
+    : mApp(app), mLastLedgerSeq(0), mSnapshot(std::make_shared<Snapshot>())
+{
+}
+
+static std::pair<std::string, std::string>
+bookOf(OfferEntry const& offer)
+{
+    return std::make_pair(toAssetString(offer.selling),
+                          toAssetString(offer.buying));
+}
+
+static std::pair<double, uint64>
+orderOf(OfferEntry const& offer)
+{
+    // same price as OfferFrame::computePrice stores in the offers table
+    return std::make_pair(double(offer.price.n) / double(offer.price.d),
+                          offer.offerID);
+}
+
+void
+PathFinder::load(uint32_t ledgerSeq)
+{
+    mLastLedgerSeq = ledgerSeq;
+    mOffers.clear();
+
+    std::map<std::pair<std::string, std::string>, std::shared_ptr<Book>> books;
+    for (auto const& seller : OfferFrame::loadAllOffers(mApp.getDatabase()))
+    {
+        for (auto const& frame : seller.second)
+        {
+            auto const& offer = frame->getOffer();
+            OfferPlace place{bookOf(offer), orderOf(offer)};
+            auto& book = books[place.mBook];
+            if (!book)
+            {
+                book = std::make_shared<Book>();
+            }
+            (*book)[place.mOrder] = offer;
+            mOffers[offer.offerID] = place;
+        }
+    }
+
+    CLOG(INFO, "Ledger") << "Loaded " << mOffers.size() << " offers in "
+                         << books.size() << " order books for path finding";
+    publish(Books(books.begin(), books.end()));
+}
+
+void
+PathFinder::ledgerStateChanged(uint32_t ledgerSeq,
+                               std::vector<LedgerEntry> const& live,
+                               std::vector<LedgerKey> const& dead)
+{
+    if (ledgerSeq != mLastLedgerSeq + 1)
+    {
+        // we missed some ledgers (catchup); can't tell what changed
+        load(ledgerSeq);
+        return;
+    }
+    mLastLedgerSeq = ledgerSeq;
+
+    // only this thread publishes snapshots, this one is current
+    auto books = getSnapshot()->mBooks;
+    std::map<std::pair<std::string, std::string>, std::shared_ptr<Book>>
+        touched;
+    auto getBook = [&](std::pair<std::string, std::string> const& key)
+                       -> Book &
+    {
+        auto& book = touched[key];
+        if (!book)
+        {
+            auto it = books.find(key);
+            book = it == books.end() ? std::make_shared<Book>()
+                                     : std::make_shared<Book>(*it->second);
+        }
+        return *book;
+    };
+    auto remove = [&](uint64 offerID)
+    {
+        auto it = mOffers.find(offerID);
+        if (it != mOffers.end())
+        {
+            getBook(it->second.mBook).erase(it->second.mOrder);
+            mOffers.erase(it);
+        }
+    };
+
+    for (auto const& e : live)
+    {
+        if (e.data.type() == OFFER)
+        {
+            auto const& offer = e.data.offer();
+            remove(offer.offerID);
+            OfferPlace place{bookOf(offer), orderOf(offer)};
+            getBook(place.mBook)[place.mOrder] = offer;
+            mOffers[offer.offerID] = place;
+        }
+    }
+    for (auto const& k : dead)
+    {
+        if (k.type() == OFFER)
+        {
+            remove(k.offer().offerID);
+        }
+    }
+
+    if (touched.empty())
+    {
+        return;
+    }
+    for (auto const& t : touched)
+    {
+        if (t.second->empty())
+        {
+            books.erase(t.first);
+        }
+        else
+        {
+            books[t.first] = t.second;
+        }
+    }
+    publish(std::move(books));
+}
+
+std::shared_ptr<PathFinder::Snapshot const>
+PathFinder::getSnapshot() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mSnapshot;
+}
+
+void
+PathFinder::publish(Books books)
+{
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->mBooks = std::move(books);
+    for (auto const& b : snapshot->mBooks)
+    {
+        snapshot->mBuyable[b.first.second].emplace_back(b.first.first);
+        snapshot->mPayable[b.first.first].emplace_back(b.first.second);
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSnapshot = snapshot;
+}
+
+std::vector<PathFinder::Path>
+PathFinder::findPaths(Asset const& source, Asset const& dest, int64 amount,
+                      bool strictReceive, size_t maxPaths,
+                      std::chrono::milliseconds budget, bool& complete) const
+{
+    complete = true;
+    auto sourceStr = toAssetString(source);
+    auto destStr = toAssetString(dest);
+    if (sourceStr == destStr || amount <= 0 || maxPaths == 0)
+    {
+        return std::vector<Path>();
+    }
+
+    Search search(getSnapshot(), strictReceive ? destStr : sourceStr,
+                  strictReceive ? sourceStr : destStr, amount, strictReceive,
+                  maxPaths, budget);
+    auto loop = std::make_shared<ParallelLoop>(search.countFirstHops());
+    auto run = [&search, &loop]()
+    {
+        search.run(*loop);
+    };
+
+    if (search.countFirstHops() > 1)
+    {
+        loop->help(mApp.getWorkerIOService(),
+                   std::min<size_t>(std::thread::hardware_concurrency(),
+                                    search.countFirstHops() - 1),
+                   run);
+    }
+    loop->run(run);
+
+    complete = search.isComplete();
+    return search.mBest;
+}
+
+std::string
+PathFinder::assetToString(Asset const& asset)
+{
+    std::string code;
+    switch (asset.type())
+    {
+    case ASSET_TYPE_CREDIT_ALPHANUM4:
+        assetCodeToStr(asset.alphaNum4().assetCode, code);
+        break;
+    case ASSET_TYPE_CREDIT_ALPHANUM12:
+        assetCodeToStr(asset.alphaNum12().assetCode, code);
+        break;
+    default:
+        return "native";
+    }
+    return code + ":" + PubKeyUtils::toStrKey(getIssuer(asset));
+}
+
+Asset
+PathFinder::assetFromString(std::string const& str)
+{
+    Asset asset;
+    if (str == "native")
+    {
+        asset.type(ASSET_TYPE_NATIVE);
+        return asset;
+    }
+
+    auto colon = str.find(':');
+    if (colon == std::string::npos)
+    {
+        throw std::invalid_argument("invalid asset " + str);
+    }
+    auto code = str.substr(0, colon);
+    if (code.empty() || code.size() > 12)
+    {
+        throw std::invalid_argument("invalid asset " + str);
+    }
+    auto issuer = PubKeyUtils::fromStrKey(str.substr(colon + 1));
+    if (code.size() <= 4)
+    {
+        asset.type(ASSET_TYPE_CREDIT_ALPHANUM4);
+        strToAssetCode(asset.alphaNum4().assetCode, code);
+        asset.alphaNum4().issuer = issuer;
+    }
+    else
+    {
+        asset.type(ASSET_TYPE_CREDIT_ALPHANUM12);
+        strToAssetCode(asset.alphaNum12().assetCode, code);
+        asset.alphaNum12().issuer = issuer;
+    }
+    if (!isAssetValid(asset))
+    {
+        throw std::invalid_argument("invalid asset " + str);
+    }
+    return asset;
+}
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "overlay/StellarXDR.h"
+#include "util/NonCopyable.h"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace stellar
+{
+class Application;
+
+/**
+ * Order books kept in memory, when Config::PATH_FINDING is set, to find the
+ * paths a payment can take from one asset to another without querying the
+ * database: see the /paths command.
+ *
+ * LedgerManager hands over the offers each ledger closed creates, changes
+ * or deletes, and has them all reloaded from the database when ledgers were
+ * missed (restart, catchup).
+ *
+ * Searches run on the HTTP threads, helped by the worker threads, against a
+ * snapshot of the books: books are never changed once published, the ones
+ * a ledger touches are replaced by updated copies.
+ */
+class PathFinder : NonMovableOrCopyable
+{
+  public:
+    struct Path
+    {
+        // assets in between, as in PathPaymentOp::path
+        std::vector<Asset> mPath;
+        int64 mSourceAmount;
+        int64 mDestAmount;
+    };
+
+    // most assets a path payment can go through in between
+    static size_t const MAX_PATH_LENGTH;
+
+    explicit PathFinder(Application& app);
+
+    // Reloads every offer from the database, as of ledger `ledgerSeq`.
+    void load(uint32_t ledgerSeq);
+
+    // Updates the books with the offers ledger `ledgerSeq` created, modified
+    // or deleted.
+    void ledgerStateChanged(uint32_t ledgerSeq,
+                            std::vector<LedgerEntry> const& live,
+                            std::vector<LedgerKey> const& dead);
+
+    // The `maxPaths` best paths from `source` to `dest`, best first: those
+    // delivering the most of `dest` in exchange for `amount` of `source` or,
+    // if `strictReceive`, those costing the least of `source` to deliver
+    // `amount` of `dest`. Amounts are estimated from the offers of the last
+    // ledger closed. Clears `complete` if the search had to stop after
+    // `budget`, returning the best paths found until then.
+    std::vector<Path> findPaths(Asset const& source, Asset const& dest,
+                                int64 amount, bool strictReceive,
+                                size_t maxPaths,
+                                std::chrono::milliseconds budget,
+                                bool& complete) const;
+
+    // Assets as "native" or "CODE:ISSUER", for the /paths command.
+    static std::string assetToString(Asset const& asset);
+    // Throws std::invalid_argument if `str` names no valid asset.
+    static Asset assetFromString(std::string const& str);
+
+  private:
+    // offers by price, as in the offers table, then offerid
+    typedef std::map<std::pair<double, uint64>, OfferEntry> Book;
+    // books by (selling, buying) assets, as XDR
+    typedef std::map<std::pair<std::string, std::string>,
+                     std::shared_ptr<Book const>> Books;
+
+    struct Snapshot
+    {
+        Books mBooks;
+        // for each asset, the assets offered for it
+        std::unordered_map<std::string, std::vector<std::string>> mBuyable;
+        // for each asset, the assets it is offered for
+        std::unordered_map<std::string, std::vector<std::string>> mPayable;
+    };
+
+    struct OfferPlace
+    {
+        std::pair<std::string, std::string> mBook;
+        std::pair<double, uint64> mOrder;
+    };
+
+    class Search;
+
+    Application& mApp;
+    // main thread only
+    uint32_t mLastLedgerSeq;
+    std::unordered_map<uint64, OfferPlace> mOffers;
+
+    mutable std::mutex mMutex;
+    std::shared_ptr<Snapshot const> mSnapshot;
+
+    std::shared_ptr<Snapshot const> getSnapshot() const;
+    void publish(Books books);
+};
+}
@@ -0,0 +1,137 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerManager.h"
+#include "ledger/PathFinder.h"
+#include "lib/catch.hpp"
+#include "main/Application.h"
+#include "main/CommandHandler.h"
+#include "main/Config.h"
+#include "main/test.h"
+#include "test/TestAccount.h"
+#include "test/TxTests.h"
+#include "util/Timer.h"
+
+using namespace stellar;
+using namespace stellar::txtest;
+
+TEST_CASE("path finding", "[ledger][paths]")
+{
+    Config cfg(getTestConfig());
+    cfg.PATH_FINDING = true;
+    VirtualClock clock;
+    Application::pointer appPtr = Application::create(clock, cfg);
+    Application& app = *appPtr;
+    app.start();
+
+    auto& lm = app.getLedgerManager();
+    auto pathFinder = lm.getPathFinder();
+    REQUIRE(pathFinder != nullptr);
+
+    auto root = TestAccount::createRoot(app);
+    int64_t const minBalance = lm.getMinBalance(3) * 10;
+    int64_t const trustLimit = 1000000;
+    auto gateway = root.create("gateway", minBalance);
+    auto m1 = root.create("m1", minBalance);
+    auto m2 = root.create("m2", minBalance);
+
+    Asset xlm;
+    xlm.type(AssetType::ASSET_TYPE_NATIVE);
+    Asset usd = makeAsset(gateway, "USD");
+    Asset eur = makeAsset(gateway, "EUR");
+
+    REQUIRE(PathFinder::assetToString(xlm) == "native");
+    REQUIRE(PathFinder::assetFromString(PathFinder::assetToString(usd)) ==
+            usd);
+    REQUIRE_THROWS_AS(PathFinder::assetFromString("USD"),
+                      std::invalid_argument);
+
+    // m1 sells USD for XLM, m2 sells EUR for USD: XLM -> USD -> EUR
+    m1.changeTrust(usd, trustLimit);
+    m2.changeTrust(usd, trustLimit);
+    m2.changeTrust(eur, trustLimit);
+    gateway.pay(m1, usd, 1000);
+    gateway.pay(m2, eur, 1000);
+    m1.manageOffer(0, usd, xlm, Price(1, 1), 1000);
+    auto eurOffer = m2.manageOffer(0, eur, usd, Price(1, 1), 1000);
+
+    // offers were applied outside of a ledger close
+    pathFinder->load(lm.getLastClosedLedgerNum());
+
+    auto const budget = std::chrono::seconds(10);
+    bool complete = false;
+
+    SECTION("strict send")
+    {
+        auto paths =
+            pathFinder->findPaths(xlm, eur, 100, false, 5, budget, complete);
+        REQUIRE(complete);
+        REQUIRE(paths.size() == 1);
+        REQUIRE(paths[0].mPath == std::vector<Asset>{usd});
+        REQUIRE(paths[0].mSourceAmount == 100);
+        REQUIRE(paths[0].mDestAmount == 100);
+    }
+
+    SECTION("strict receive")
+    {
+        auto paths =
+            pathFinder->findPaths(xlm, eur, 100, true, 5, budget, complete);
+        REQUIRE(complete);
+        REQUIRE(paths.size() == 1);
+        REQUIRE(paths[0].mPath == std::vector<Asset>{usd});
+        REQUIRE(paths[0].mSourceAmount == 100);
+        REQUIRE(paths[0].mDestAmount == 100);
+    }
+
+    SECTION("more than the books hold")
+    {
+        REQUIRE(pathFinder
+                    ->findPaths(xlm, eur, 2000, true, 5, budget, complete)
+                    .empty());
+    }
+
+    SECTION("offer deleted by a ledger close")
+    {
+        auto tx = manageOfferOp(app.getNetworkID(), eurOffer, m2, eur, usd,
+                                Price(1, 1), 0, m2.nextSequenceNumber());
+        closeLedgerOn(app, lm.getLedgerNum(), 1, 1, 2016, tx);
+        REQUIRE(pathFinder
+                    ->findPaths(xlm, eur, 100, false, 5, budget, complete)
+                    .empty());
+        REQUIRE(!pathFinder
+                     ->findPaths(xlm, usd, 100, false, 5, budget, complete)
+                     .empty());
+    }
+
+    SECTION("paths command")
+    {
+        auto issuer = PubKeyUtils::toStrKey(gateway.getPublicKey());
+        auto paths = [&](std::string const& dest)
+        {
+            std::string ret;
+            app.getCommandHandler().paths(
+                "source=native&dest=" + dest + "&amount=100", ret);
+            return ret;
+        };
+
+        REQUIRE(paths("EUR:" + issuer).find("\"paths\"") !=
+                std::string::npos);
+
+        SECTION("empty asset code")
+        {
+            REQUIRE_THROWS_AS(PathFinder::assetFromString(":" + issuer),
+                              std::invalid_argument);
+            REQUIRE(paths(":" + issuer).find("invalid asset") !=
+                    std::string::npos);
+        }
+
+        SECTION("13 character asset code")
+        {
+            auto dest = "ABCDEFGHIJKLM:" + issuer;
+            REQUIRE_THROWS_AS(PathFinder::assetFromString(dest),
+                              std::invalid_argument);
+            REQUIRE(paths(dest).find("invalid asset") != std::string::npos);
+        }
+    }
+}
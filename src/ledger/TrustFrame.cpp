@@ -9,6 +9,9 @@
 #include "LedgerDelta.h"
 #include "util/types.h"
 
+#include <set>
+#include <unordered_set>
+
 using namespace std;
 using namespace soci;
 
@@ -171,6 +174,10 @@ TrustFrame::isValid() const
 bool
 TrustFrame::exists(Database& db, LedgerKey const& key)
 {
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        return state->exists(key);
+    }
     if (cachedEntryExists(key, db) && getCachedEntry(key, db) != nullptr)
     {
         return true;
@@ -212,6 +219,13 @@ TrustFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
 {
     flushCachedEntry(key, db);
 
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        state->erase(key);
+        delta.deleteEntry(key);
+        return;
+    }
+
     std::string actIDStrKey, issuerStrKey, assetCode;
     getKeyFields(key, actIDStrKey, issuerStrKey, assetCode);
 
@@ -239,6 +253,17 @@ TrustFrame::storeChange(LedgerDelta& delta, Database& db)
 
     touch(delta);
 
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        if (!state->exists(key))
+        {
+            throw std::runtime_error("Could not update ledger state");
+        }
+        state->put(mEntry);
+        delta.modEntry(*this);
+        return;
+    }
+
     std::string actIDStrKey, issuerStrKey, assetCode;
     getKeyFields(key, actIDStrKey, issuerStrKey, assetCode);
 
@@ -283,6 +308,17 @@ TrustFrame::storeAdd(LedgerDelta& delta, Database& db)
 
     touch(delta);
 
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        if (state->exists(key))
+        {
+            throw std::runtime_error("Could not update ledger state");
+        }
+        state->put(mEntry);
+        delta.addEntry(*this);
+        return;
+    }
+
     std::string actIDStrKey, issuerStrKey, assetCode;
     unsigned int assetType = getKey().trustLine().asset.type();
     getKeyFields(getKey(), actIDStrKey, issuerStrKey, assetCode);
@@ -356,18 +392,33 @@ TrustFrame::loadTrustLine(AccountID const& accountID, Asset const& asset,
     key.type(TRUSTLINE);
     key.trustLine().accountID = accountID;
     key.trustLine().asset = asset;
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        auto p = state->get(key);
+        if (!p)
+        {
+            return nullptr;
+        }
+        pointer ret = std::make_shared<TrustFrame>(*p);
+        if (delta)
+        {
+            delta->recordEntry(*ret);
+        }
+        return ret;
+    }
     if (cachedEntryExists(key, db))
     {
         auto p = getCachedEntry(key, db);
-        if (p)
+        if (!p)
         {
-            pointer ret = std::make_shared<TrustFrame>(*p);
-            if (delta)
-            {
-                delta->recordEntry(*ret);
-            }
-            return ret;
+            return nullptr;
         }
+        pointer ret = std::make_shared<TrustFrame>(*p);
+        if (delta)
+        {
+            delta->recordEntry(*ret);
+        }
+        return ret;
     }
 
     std::string accStr, issuerStr, assetStr;
@@ -484,6 +535,17 @@ void
 TrustFrame::loadLines(AccountID const& accountID,
                       std::vector<TrustFrame::pointer>& retLines, Database& db)
 {
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        std::vector<InMemoryLedgerState::EntryPtr> lines;
+        state->loadSubEntries(accountID, TRUSTLINE, lines);
+        for (auto const& tl : lines)
+        {
+            retLines.emplace_back(make_shared<TrustFrame>(*tl));
+        }
+        return;
+    }
+
     std::string actIDStrKey;
     actIDStrKey = PubKeyUtils::toStrKey(accountID);
 
@@ -500,10 +562,76 @@ TrustFrame::loadLines(AccountID const& accountID,
               });
 }
 
+void
+TrustFrame::prefetchTrustLines(std::vector<LedgerKey> const& keys,
+                               Database& db)
+{
+    std::set<LedgerKey, LedgerEntryIdCmp> missing;
+    std::vector<std::string> ids;
+    std::unordered_set<AccountID> accounts;
+    for (auto const& key : keys)
+    {
+        auto const& tl = key.trustLine();
+        // issuers' lines are made up by loadTrustLine, never stored
+        if (tl.accountID == getIssuer(tl.asset))
+        {
+            continue;
+        }
+        missing.insert(key);
+        if (accounts.insert(tl.accountID).second)
+        {
+            ids.emplace_back(PubKeyUtils::toStrKey(tl.accountID));
+        }
+    }
+
+    auto query = std::string(trustLineColumnSelector);
+    query += " WHERE accountid IN (" + prefetchParameters() + ")";
+    for (size_t i = 0; i < ids.size(); i += PREFETCH_BATCH_SIZE)
+    {
+        auto batch = prefetchBatch(ids, i);
+        auto prep = db.getPreparedStatement(query);
+        auto& st = prep.statement();
+        for (auto const& id : batch)
+        {
+            st.exchange(use(id));
+        }
+
+        auto timer = db.getSelectTimer("trust-prefetch");
+        loadLines(prep, [&missing, &db](LedgerEntry const& trust)
+                  {
+                      // other lines of the accounts aren't cached, not to
+                      // evict entries that are needed
+                      auto it = missing.find(LedgerEntryKey(trust));
+                      if (it != missing.end())
+                      {
+                          putCachedEntry(
+                              *it, std::make_shared<LedgerEntry const>(trust),
+                              db);
+                          missing.erase(it);
+                      }
+                  });
+    }
+
+    for (auto const& key : missing)
+    {
+        putCachedEntry(key, nullptr, db);
+    }
+}
+
 std::unordered_map<AccountID, std::vector<TrustFrame::pointer>>
 TrustFrame::loadAllLines(Database& db)
 {
     std::unordered_map<AccountID, std::vector<TrustFrame::pointer>> retLines;
+    if (auto state = db.getInMemoryLedgerState())
+    {
+        state->forEachEntry(
+            TRUSTLINE, [&retLines](LedgerEntry const& cur)
+            {
+                auto& thisUserLines = retLines[cur.data.trustLine().accountID];
+                thisUserLines.emplace_back(make_shared<TrustFrame>(cur));
+            });
+        return retLines;
+    }
 
     auto query = std::string(trustLineColumnSelector);
     query += (" ORDER BY accountid");
@@ -80,6 +80,11 @@ class TrustFrame : public EntryFrame
                           std::vector<TrustFrame::pointer>& retLines,
                           Database& db);
 
+    // loads the trust lines of `keys` into the entry cache, querying them
+    // by batches of accounts: see EntryFrame::prefetch
+    static void prefetchTrustLines(std::vector<LedgerKey> const& keys,
+                                   Database& db);
+
     // loads ALL trust lines from the database (very slow!)
     static std::unordered_map<AccountID, std::vector<TrustFrame::pointer>>
     loadAllLines(Database& db);
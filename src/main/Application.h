@@ -195,6 +195,11 @@ class Application
     // with caution.
     virtual asio::io_service& getWorkerIOService() = 0;
 
+    // Get the overlay IO service, served by Config::OVERLAY_THREADS threads
+    // of its own, not run at all if there are none. Used by peers to prepare
+    // messages off the main thread, one strand per peer.
+    virtual asio::io_service& getOverlayIOService() = 0;
+
     // Perform actions necessary to transition from BOOTING_STATE to other
     // states. In particular: either reload or reinitialize the database, and
     // either restart or begin reacquiring SCP consensus (as instructed by
@@ -31,6 +31,7 @@
 #include "medida/reporting/console_reporter.h"
 #include "medida/meter.h"
 #include "medida/counter.h"
+#include "medida/histogram.h"
 #include "medida/timer.h"
 
 #include "util/TmpDir.h"
@@ -50,6 +51,8 @@ ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
     , mConfig(cfg)
     , mWorkerIOService(std::thread::hardware_concurrency())
     , mWork(make_unique<asio::io_service::work>(mWorkerIOService))
+    , mOverlayIOService(cfg.OVERLAY_THREADS)
+    , mOverlayWork(make_unique<asio::io_service::work>(mOverlayIOService))
     , mWorkerThreads()
     , mStopSignals(clock.getIOService(), SIGINT)
     , mStopping(false)
@@ -112,6 +115,13 @@ ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
                                         this->runWorkerThread(t);
                                     });
     }
+    for (uint32_t i = 0; i < cfg.OVERLAY_THREADS; ++i)
+    {
+        mOverlayThreads.emplace_back([this]()
+                                     {
+                                         mOverlayIOService.run();
+                                     });
+    }
 
     LOG(DEBUG) << "Application constructed";
 }
@@ -380,6 +390,17 @@ ApplicationImpl::joinAllThreads()
         w.join();
     }
     LOG(DEBUG) << "Joined all " << mWorkerThreads.size() << " threads";
+
+    // Same for the overlay threads: what they hand to the main thread only
+    // refers to peers weakly.
+    if (mOverlayWork)
+    {
+        mOverlayWork.reset();
+    }
+    for (auto& t : mOverlayThreads)
+    {
+        t.join();
+    }
 }
 
 bool
@@ -415,8 +436,8 @@ ApplicationImpl::getLoadGenerator()
 void
 ApplicationImpl::checkDB()
 {
-    getClock().getIOService().post(
-        [this]
+    getClock().postAction(
+        Scheduler::BACKGROUND, [this]
         {
             checkDBAgainstBuckets(this->getMetrics(), this->getBucketManager(),
                                   this->getDatabase(),
@@ -531,6 +552,43 @@ ApplicationImpl::syncOwnMetrics()
     mMetrics->NewMeter({"crypto", "verify", "total"}, "signature")
         .Mark(vhit + vmiss + vignore);
 
+    // Same for the stats of the clock, which may be shared between apps.
+    VirtualClock::CrankStats crank;
+    mVirtualClock.flushCrankStats(crank);
+    mMetrics->NewMeter({"clock", "crank", "count"}, "crank")
+        .Mark(crank.mCranks);
+    auto& handlers = mMetrics->NewHistogram({"clock", "crank", "handlers"});
+    for (auto h : crank.mHandlers)
+    {
+        handlers.Update(h);
+    }
+    auto& crankTime = mMetrics->NewTimer({"clock", "crank", "time"});
+    for (auto const& t : crank.mCrankTimes)
+    {
+        crankTime.Update(t);
+    }
+    auto& timerLag = mMetrics->NewTimer({"clock", "timer", "lag"});
+    for (auto const& t : crank.mTimerLags)
+    {
+        timerLag.Update(t);
+    }
+    std::vector<Scheduler::ClassStats> sched;
+    mVirtualClock.getScheduler().flushStats(sched);
+    for (size_t c = 0; c < sched.size(); ++c)
+    {
+        auto name =
+            Scheduler::getClassName(static_cast<Scheduler::ActionClass>(c));
+        mMetrics->NewMeter({"scheduler", name, "run"}, "action")
+            .Mark(sched[c].mRun);
+        mMetrics->NewCounter({"scheduler", name, "queue"})
+            .set_count(sched[c].mQueued);
+        auto& latency = mMetrics->NewTimer({"scheduler", name, "latency"});
+        for (auto const& t : sched[c].mLatencies)
+        {
+            latency.Update(t);
+        }
+    }
+
     // Similarly, flush global process-table stats.
     mMetrics->NewCounter({"process", "memory", "handles"}).set_count(
         mProcessManager->getNumRunningProcesses());
@@ -627,4 +685,10 @@ ApplicationImpl::getWorkerIOService()
 {
     return mWorkerIOService;
 }
+
+asio::io_service&
+ApplicationImpl::getOverlayIOService()
+{
+    return mOverlayIOService;
+}
 }
@@ -62,6 +62,7 @@ class ApplicationImpl : public Application
     virtual StatusManager& getStatusManager() override;
 
     virtual asio::io_service& getWorkerIOService() override;
+    virtual asio::io_service& getOverlayIOService() override;
 
     void newDB() override;
     virtual void start() override;
@@ -113,6 +114,8 @@ class ApplicationImpl : public Application
 
     asio::io_service mWorkerIOService;
     std::unique_ptr<asio::io_service::work> mWork;
+    asio::io_service mOverlayIOService;
+    std::unique_ptr<asio::io_service::work> mOverlayWork;
 
     std::unique_ptr<Database> mDatabase;
     std::unique_ptr<TmpDirManager> mTmpDirManager;
@@ -131,6 +134,7 @@ class ApplicationImpl : public Application
     std::unique_ptr<StatusManager> mStatusManager;
 
     std::vector<std::thread> mWorkerThreads;
+    std::vector<std::thread> mOverlayThreads;
 
     asio::signal_set mStopSignals;
 
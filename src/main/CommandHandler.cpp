@@ -5,6 +5,7 @@
 #include "crypto/Hex.h"
 #include "herder/Herder.h"
 #include "ledger/LedgerManager.h"
+#include "ledger/PathFinder.h"
 #include "lib/http/server.hpp"
 #include "lib/json/json.h"
 #include "lib/util/format.h"
@@ -19,7 +20,9 @@
 #include "StellarCoreVersion.h"
 
 #include "util/basen.h"
+#include "medida/metrics_registry.h"
 #include "medida/reporting/json_reporter.h"
+#include "medida/timer.h"
 #include "xdrpp/marshal.h"
 #include "xdrpp/printer.h"
 
@@ -34,7 +37,8 @@ using std::placeholders::_2;
 
 namespace stellar
 {
-CommandHandler::CommandHandler(Application& app) : mApp(app)
+CommandHandler::CommandHandler(Application& app)
+    : mApp(app), mAlive(std::make_shared<bool>(true))
 {
     if (mApp.getConfig().HTTP_PORT)
     {
@@ -53,13 +57,13 @@ CommandHandler::CommandHandler(Application& app) : mApp(app)
         int httpMaxClient = mApp.getConfig().HTTP_MAX_CLIENT;
 
         mServer = stellar::make_unique<http::server::server>(
-            app.getClock().getIOService(), ipStr, mApp.getConfig().HTTP_PORT, httpMaxClient);
+            mIOService, ipStr, mApp.getConfig().HTTP_PORT, httpMaxClient);
     }
     else
     {
-        mServer = stellar::make_unique<http::server::server>(
-            app.getClock().getIOService());
+        mServer = stellar::make_unique<http::server::server>(mIOService);
     }
+    mServer->setDispatcher(std::bind(&CommandHandler::dispatch, this, _1, _2));
 
     mServer->add404(std::bind(&CommandHandler::fileNotFound, this, _1, _2));
 
@@ -89,6 +93,8 @@ CommandHandler::CommandHandler(Application& app) : mApp(app)
                       std::bind(&CommandHandler::manualClose, this, _1, _2));
     mServer->addRoute("metrics",
                       std::bind(&CommandHandler::metrics, this, _1, _2));
+    mServer->addRoute("paths",
+                      std::bind(&CommandHandler::paths, this, _1, _2));
     mServer->addRoute("peers", std::bind(&CommandHandler::peers, this, _1, _2));
     mServer->addRoute("quorum",
                       std::bind(&CommandHandler::quorum, this, _1, _2));
@@ -102,6 +108,86 @@ CommandHandler::CommandHandler(Application& app) : mApp(app)
     mServer->addRoute("tx", std::bind(&CommandHandler::tx, this, _1, _2));
     mServer->addRoute("unban",
                       std::bind(&CommandHandler::unban, this, _1, _2));
+
+    // routes must all be added before the threads start
+    if (mApp.getConfig().HTTP_PORT)
+    {
+        mWork = make_unique<asio::io_service::work>(mIOService);
+        for (uint32_t i = 0; i < mApp.getConfig().HTTP_THREADS; ++i)
+        {
+            mThreads.emplace_back([this]()
+                                  {
+                                      mIOService.run();
+                                  });
+        }
+    }
+}
+
+CommandHandler::~CommandHandler()
+{
+    mWork.reset();
+    mIOService.stop();
+    for (auto& t : mThreads)
+    {
+        t.join();
+    }
+    mServer.reset();
+}
+
+void
+CommandHandler::prepare(std::string const& command)
+{
+    if (command == "metrics")
+    {
+        // counters reflecting the state of the main thread are set there,
+        // the report is built on an HTTP thread
+        mApp.syncAllMetrics();
+    }
+}
+
+void
+CommandHandler::dispatch(std::string const& command,
+                         std::function<void()> task)
+{
+    auto& timer = mApp.getMetrics().NewTimer(
+        {"http", "command", mServer->hasRoute(command) ? command : "404"});
+    auto start = std::chrono::steady_clock::now();
+    auto timed = [task, &timer, start]()
+    {
+        task();
+        timer.Update(std::chrono::steady_clock::now() - start);
+    };
+
+    std::weak_ptr<bool> alive = mAlive;
+    if (command == "metrics")
+    {
+        mApp.getClock().postAction(Scheduler::ADMIN,
+                                   [this, alive, command, timed]()
+                                   {
+                                       if (alive.expired())
+                                       {
+                                           return;
+                                       }
+                                       prepare(command);
+                                       mIOService.post(timed);
+                                   });
+    }
+    else if (!mServer->hasRoute(command) || command == "paths")
+    {
+        // paths searches a snapshot of the order books, away from the main
+        // thread
+        timed();
+    }
+    else
+    {
+        mApp.getClock().postAction(Scheduler::ADMIN, [alive, timed]()
+                                   {
+                                       if (!alive.expired())
+                                       {
+                                           timed();
+                                       }
+                                   });
+    }
 }
 
 void
@@ -110,6 +196,7 @@ CommandHandler::manualCmd(std::string const& cmd)
     http::server::reply reply;
     http::server::request request;
     request.uri = cmd;
+    prepare(cmd.substr(0, cmd.find('?')));
     mServer->handle_request(request, reply);
     LOG(INFO) << cmd << " -> " << reply.content;
 }
@@ -289,6 +376,16 @@ CommandHandler::fileNotFound(std::string const& params, std::string& retStr)
         "</p><p><h1> /metrics</h1>"
         "returns a snapshot of the metrics registry (for monitoring and "
         "debugging purpose)"
+        "</p><p><h1> "
+        "/paths?source=ASSET&dest=ASSET&amount=N[&mode=MODE][&limit=L]</h1>"
+        "returns the best paths for a payment from asset source to asset "
+        "dest, in JSON format; needs PATH_FINDING set to true.<br>"
+        "assets are 'native' or CODE:ISSUER<br>"
+        "mode is either 'send' (the default), to find the paths delivering "
+        "the most of dest for N of source, or 'receive', to find those "
+        "costing the least of source to deliver N of dest<br>"
+        "amounts are estimated from the offers of the last ledger closed; L "
+        "paths are returned at most (5 by default, 20 at most)"
         "</p><p><h1> /peers</h1>"
         "returns the list of known peers in JSON format"
         "</p><p><h1> /quorum?[node=NODE_ID][&compact=true]</h1>"
@@ -320,8 +417,9 @@ CommandHandler::fileNotFound(std::string const& params, std::string& retStr)
         "endpoint."
         "</p><p><h1> /maintenance[?queue=true]</h1> Performs maintenance tasks "
         "on the instance."
-        "<ul><li><i>queue</i> performs deletion of queue data.See setcursor "
-        "for more information</li></ul>"
+        "<ul><li><i>queue</i> starts deleting queue data, a few ledgers at a "
+        "time after each ledger closed. See setcursor for more "
+        "information</li></ul>"
         "</p><p><h1> "
         "/unban?node=NODE_ID</h1>"
         "remove ban for PEER_ID"
@@ -419,6 +517,84 @@ CommandHandler::generateLoad(std::string const& params, std::string& retStr)
     }
 }
 
+// Time a /paths search may take, after which it returns the best paths found
+// so far.
+static std::chrono::milliseconds const PATHS_SEARCH_BUDGET(200);
+// Most paths a /paths search may be asked for.
+static uint32_t const PATHS_MAX_LIMIT = 20;
+
+void
+CommandHandler::paths(std::string const& params, std::string& retStr)
+{
+    auto pathFinder = mApp.getLedgerManager().getPathFinder();
+    if (!pathFinder)
+    {
+        retStr = "Path finding is disabled, see PATH_FINDING";
+        return;
+    }
+
+    std::map<std::string, std::string> map;
+    http::server::server::parseParams(params, map);
+
+    int64 amount = 0;
+    if (!parseNumParam(map, "amount", amount, retStr,
+                       Requirement::REQUIRED) ||
+        amount <= 0)
+    {
+        retStr = "Must specify a positive amount: paths?...&amount=N";
+        return;
+    }
+    uint32_t limit = 5;
+    if (!parseNumParam(map, "limit", limit, retStr, Requirement::OPTIONAL))
+    {
+        return;
+    }
+    if (limit == 0 || limit > PATHS_MAX_LIMIT)
+    {
+        retStr = fmt::format("Limit must be between 1 and {:d}",
+                             PATHS_MAX_LIMIT);
+        return;
+    }
+    bool strictReceive = map["mode"] == "receive";
+    if (!strictReceive && !map["mode"].empty() && map["mode"] != "send")
+    {
+        retStr = "Mode should be either 'send' or 'receive'";
+        return;
+    }
+
+    Json::Value root;
+    try
+    {
+        auto source = PathFinder::assetFromString(map["source"]);
+        auto dest = PathFinder::assetFromString(map["dest"]);
+        bool complete;
+        auto found = pathFinder->findPaths(source, dest, amount, strictReceive,
+                                           limit, PATHS_SEARCH_BUDGET,
+                                           complete);
+
+        root["complete"] = complete;
+        auto& paths = root["paths"];
+        paths = Json::Value(Json::arrayValue);
+        for (auto const& p : found)
+        {
+            Json::Value path;
+            path["source_amount"] = (Json::Int64)p.mSourceAmount;
+            path["destination_amount"] = (Json::Int64)p.mDestAmount;
+            path["path"] = Json::Value(Json::arrayValue);
+            for (auto const& asset : p.mPath)
+            {
+                path["path"].append(PathFinder::assetToString(asset));
+            }
+            paths.append(path);
+        }
+    }
+    catch (std::exception& e)
+    {
+        root["exception"] = e.what();
+    }
+    retStr = root.toStyledString();
+}
+
 void
 CommandHandler::peers(std::string const& params, std::string& retStr)
 {
@@ -469,6 +645,13 @@ CommandHandler::info(std::string const& params, std::string& retStr)
     {
         info["status"][counter++] = statusMessage.second;
     }
+    for (auto const& progress : statusMessages.getProgress())
+    {
+        auto& p = info["progress"][StatusManager::categoryName(progress.first)];
+        p["done"] = (Json::UInt64)progress.second.mDone;
+        p["total"] = (Json::UInt64)progress.second.mTotal;
+        p["eta"] = (Json::Int64)progress.second.mETA;
+    }
 
     auto& herder = mApp.getHerder();
     Json::Value q;
@@ -485,7 +668,7 @@ CommandHandler::info(std::string const& params, std::string& retStr)
 void
 CommandHandler::metrics(std::string const& params, std::string& retStr)
 {
-    mApp.syncAllMetrics();
+    // runs on an HTTP thread, see prepare()
     medida::reporting::JsonReporter jr(mApp.getMetrics());
     retStr = jr.Report();
 }
@@ -4,11 +4,19 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 #include "lib/http/server.hpp"
 
 /*
 handler functions for the http commands this server supports
+
+HTTP requests are read and answered on a pool of HTTP_THREADS threads of
+their own. Commands that only read thread-safe state (metrics) run there;
+all others are posted to the main thread, so that serving requests never
+holds up consensus for longer than the handlers themselves take.
 */
 
 namespace stellar
@@ -19,10 +27,19 @@ class CommandHandler
 {
 
     Application& mApp;
+    asio::io_service mIOService;
+    std::unique_ptr<asio::io_service::work> mWork;
+    std::vector<std::thread> mThreads;
     std::unique_ptr<http::server::server> mServer;
+    // expires with this, for tasks posted to the main thread
+    std::shared_ptr<bool> mAlive;
+
+    void dispatch(std::string const& command, std::function<void()> task);
+    void prepare(std::string const& command);
 
   public:
     CommandHandler(Application& app);
+    ~CommandHandler();
 
     void manualCmd(std::string const& cmd);
 
@@ -42,6 +59,7 @@ class CommandHandler
     void maintenance(std::string const& params, std::string& retStr);
     void manualClose(std::string const& params, std::string& retStr);
     void metrics(std::string const& params, std::string& retStr);
+    void paths(std::string const& params, std::string& retStr);
     void peers(std::string const& params, std::string& retStr);
     void quorum(std::string const& params, std::string& retStr);
     void setcursor(std::string const& params, std::string& retStr);
@@ -0,0 +1,57 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "lib/catch.hpp"
+#include "lib/http/HttpClient.h"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "main/test.h"
+#include "util/Timer.h"
+
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace stellar;
+
+TEST_CASE("http commands", "[http]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    std::string metrics, info;
+    int metricsCode = 0, infoCode = 0;
+    std::atomic<bool> done{false};
+    std::thread client([&]()
+                       {
+                           metricsCode = http_request("127.0.0.1", "/metrics",
+                                                      cfg.HTTP_PORT, metrics);
+                           infoCode = http_request("127.0.0.1", "/info",
+                                                   cfg.HTTP_PORT, info);
+                           done = true;
+                       });
+
+    // info needs the main thread, metrics only to sync its counters
+    while (!done)
+    {
+        if (clock.crank(false) == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    client.join();
+
+    REQUIRE(metricsCode == 200);
+    REQUIRE(!metrics.empty());
+    REQUIRE(infoCode == 200);
+    REQUIRE(info.find("\"info\"") != std::string::npos);
+
+    // recorded on the main thread, before it could see the client done
+    auto& it = app->getMetrics().NewTimer({"http", "command", "info"});
+    REQUIRE(it.count() == 1);
+}
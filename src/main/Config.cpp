@@ -55,15 +55,24 @@ Config::Config() : NODE_SEED(SecretKey::random())
     HTTP_PORT = DEFAULT_PEER_PORT + 1;
     PUBLIC_HTTP_PORT = false;
     HTTP_MAX_CLIENT = 128;
+    HTTP_THREADS = 2;
     PEER_PORT = DEFAULT_PEER_PORT;
     TARGET_PEER_CONNECTIONS = 8;
     MAX_PEER_CONNECTIONS = 12;
+    OVERLAY_THREADS = 2;
     PREFERRED_PEERS_ONLY = false;
 
     MINIMUM_IDLE_PERCENT = 0;
 
     MAX_CONCURRENT_SUBPROCESSES = 16;
     PARANOID_MODE = false;
+    SPECULATIVE_LEDGER_CLOSE = false;
+    IN_MEMORY_LEDGER_STATE = false;
+    PARALLEL_TX_APPLY = false;
+    PATH_FINDING = false;
+    METADATA_OUTPUT_STREAM = "";
+    HISTORY_VERIFY_TX_SAMPLE_RATE = 16;
+    HISTORY_CACHE_DIR_PATH = "";
     NODE_IS_VALIDATOR = false;
 
     DATABASE = "sqlite3://:memory:";
@@ -211,6 +220,17 @@ Config::load(std::string const& filename)
                     throw std::invalid_argument("bad HTTP_MAX_CLIENT");
                 HTTP_MAX_CLIENT = static_cast<unsigned short>(maxHttpClient);
             }
+            else if (item.first == "HTTP_THREADS")
+            {
+                if (!item.second->as<int64_t>() ||
+                    item.second->as<int64_t>()->value() <= 0 ||
+                    item.second->as<int64_t>()->value() > UINT16_MAX)
+                {
+                    throw std::invalid_argument("invalid HTTP_THREADS");
+                }
+                HTTP_THREADS =
+                    static_cast<uint32_t>(item.second->as<int64_t>()->value());
+            }
             else if (item.first == "PUBLIC_HTTP_PORT")
             {
                 if (!item.second->as<bool>())
@@ -369,6 +389,16 @@ Config::load(std::string const& filename)
                 }
                 BUCKET_DIR_PATH = item.second->as<std::string>()->value();
             }
+            else if (item.first == "HISTORY_CACHE_DIR_PATH")
+            {
+                if (!item.second->as<std::string>())
+                {
+                    throw std::invalid_argument(
+                        "invalid HISTORY_CACHE_DIR_PATH");
+                }
+                HISTORY_CACHE_DIR_PATH =
+                    item.second->as<std::string>()->value();
+            }
             else if (item.first == "NODE_NAMES")
             {
                 if (!item.second->is_array())
@@ -424,6 +454,17 @@ Config::load(std::string const& filename)
                 }
                 MAX_PEER_CONNECTIONS = (int)item.second->as<int64_t>()->value();
             }
+            else if (item.first == "OVERLAY_THREADS")
+            {
+                if (!item.second->as<int64_t>() ||
+                    item.second->as<int64_t>()->value() < 0 ||
+                    item.second->as<int64_t>()->value() > UINT16_MAX)
+                {
+                    throw std::invalid_argument("invalid OVERLAY_THREADS");
+                }
+                OVERLAY_THREADS =
+                    static_cast<uint32_t>(item.second->as<int64_t>()->value());
+            }
             else if (item.first == "PREFERRED_PEERS")
             {
                 if (!item.second->is_array())
@@ -525,6 +566,8 @@ Config::load(std::string const& filename)
                                 "malformed HISTORY config block");
                         }
                         std::string get, put, mkdir;
+                        size_t maxUploads =
+                            HistoryArchive::DEFAULT_MAX_CONCURRENT_UPLOADS;
                         for (auto const& c : *tab)
                         {
                             if (c.first == "get")
@@ -539,6 +582,18 @@ Config::load(std::string const& filename)
                             {
                                 mkdir = c.second->as<std::string>()->value();
                             }
+                            else if (c.first == "max_uploads")
+                            {
+                                if (!c.second->as<int64_t>() ||
+                                    c.second->as<int64_t>()->value() <= 0)
+                                {
+                                    throw std::invalid_argument(
+                                        "invalid max_uploads within [HISTORY." +
+                                        archive.first + "]");
+                                }
+                                maxUploads =
+                                    (size_t)c.second->as<int64_t>()->value();
+                            }
                             else
                             {
                                 std::string err(
@@ -550,8 +605,8 @@ Config::load(std::string const& filename)
                             }
                         }
                         HISTORY[archive.first] =
-                            std::make_shared<HistoryArchive>(archive.first, get,
-                                                             put, mkdir);
+                            std::make_shared<HistoryArchive>(
+                                archive.first, get, put, mkdir, maxUploads);
                     }
                 }
                 else
@@ -575,6 +630,62 @@ Config::load(std::string const& filename)
                 }
                 PARANOID_MODE = item.second->as<bool>()->value();
             }
+            else if (item.first == "SPECULATIVE_LEDGER_CLOSE")
+            {
+                if (!item.second->as<bool>())
+                {
+                    throw std::invalid_argument(
+                        "invalid SPECULATIVE_LEDGER_CLOSE");
+                }
+                SPECULATIVE_LEDGER_CLOSE = item.second->as<bool>()->value();
+            }
+            else if (item.first == "IN_MEMORY_LEDGER_STATE")
+            {
+                if (!item.second->as<bool>())
+                {
+                    throw std::invalid_argument(
+                        "invalid IN_MEMORY_LEDGER_STATE");
+                }
+                IN_MEMORY_LEDGER_STATE = item.second->as<bool>()->value();
+            }
+            else if (item.first == "PARALLEL_TX_APPLY")
+            {
+                if (!item.second->as<bool>())
+                {
+                    throw std::invalid_argument("invalid PARALLEL_TX_APPLY");
+                }
+                PARALLEL_TX_APPLY = item.second->as<bool>()->value();
+            }
+            else if (item.first == "PATH_FINDING")
+            {
+                if (!item.second->as<bool>())
+                {
+                    throw std::invalid_argument("invalid PATH_FINDING");
+                }
+                PATH_FINDING = item.second->as<bool>()->value();
+            }
+            else if (item.first == "METADATA_OUTPUT_STREAM")
+            {
+                if (!item.second->as<std::string>())
+                {
+                    throw std::invalid_argument(
+                        "invalid METADATA_OUTPUT_STREAM");
+                }
+                METADATA_OUTPUT_STREAM =
+                    item.second->as<std::string>()->value();
+            }
+            else if (item.first == "HISTORY_VERIFY_TX_SAMPLE_RATE")
+            {
+                if (!item.second->as<int64_t>() ||
+                    item.second->as<int64_t>()->value() < 0 ||
+                    item.second->as<int64_t>()->value() > UINT32_MAX)
+                {
+                    throw std::invalid_argument(
+                        "invalid HISTORY_VERIFY_TX_SAMPLE_RATE");
+                }
+                HISTORY_VERIFY_TX_SAMPLE_RATE =
+                    (uint32_t)item.second->as<int64_t>()->value();
+            }
             else if (item.first == "NETWORK_PASSPHRASE")
             {
                 if (!item.second->as<std::string>())
@@ -128,12 +128,16 @@ class Config : public std::enable_shared_from_this<Config>
     unsigned short HTTP_PORT;       // what port to listen for commands
     bool PUBLIC_HTTP_PORT;          // if you accept commands from not localhost
     int HTTP_MAX_CLIENT;  // maximum number of http clients, i.e backlog
+    uint32_t HTTP_THREADS; // threads serving http requests
     std::string NETWORK_PASSPHRASE; // identifier for the network
 
     // overlay config
     unsigned short PEER_PORT;
     unsigned TARGET_PEER_CONNECTIONS;
     unsigned MAX_PEER_CONNECTIONS;
+    // threads decoding, authenticating and encoding the messages of TCP
+    // peers once they are authenticated; 0 does it on the main thread
+    uint32_t OVERLAY_THREADS;
     // Peers we will always try to stay connected to
     std::vector<std::string> PREFERRED_PEERS;
     std::vector<std::string> KNOWN_PEERS;
@@ -160,6 +164,26 @@ class Config : public std::enable_shared_from_this<Config>
     // as the rest of the network, caution is advised when using this.
     bool PARANOID_MODE;
 
+    // Apply the value SCP is balloting on ahead of time (rolling back the
+    // database changes) and reuse the result if that value is externalized.
+    bool SPECULATIVE_LEDGER_CLOSE;
+
+    // Keep the ledger entries (accounts, trust lines, offers, data) in memory
+    // only, rebuilt from the bucket list on startup, rather than in the SQL
+    // database.
+    bool IN_MEMORY_LEDGER_STATE;
+
+    // Applies transactions that have no ledger entries in common on worker
+    // threads, when IN_MEMORY_LEDGER_STATE is set.
+    bool PARALLEL_TX_APPLY;
+
+    // Keeps the order books in memory to serve the /paths command.
+    bool PATH_FINDING;
+
+    // File or named pipe the metadata of each ledger closed is streamed to,
+    // as LedgerCloseMeta records; "" for none.
+    std::string METADATA_OUTPUT_STREAM;
+
     // SCP config
     SecretKey NODE_SEED;
     bool NODE_IS_VALIDATOR;
@@ -170,6 +194,15 @@ class Config : public std::enable_shared_from_this<Config>
     // History config
     std::map<std::string, std::shared_ptr<HistoryArchive>> HISTORY;
 
+    // When publishing, check that one in HISTORY_VERIFY_TX_SAMPLE_RATE
+    // transactions read back from the database matches its result. 0 turns
+    // the check off, PARANOID_MODE checks every transaction.
+    uint32_t HISTORY_VERIFY_TX_SAMPLE_RATE;
+
+    // Directory where files downloaded from history archives are kept
+    // across restarts and catchups; empty to disable.
+    std::string HISTORY_CACHE_DIR_PATH;
+
     // Database config
     std::string DATABASE;
 
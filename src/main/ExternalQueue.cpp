@@ -94,8 +94,8 @@ ExternalQueue::deleteCursor(std::string const& resid)
     st.execute(true);
 }
 
-void
-ExternalQueue::process()
+uint32_t
+ExternalQueue::getDeletableLedger()
 {
     auto& db = mApp.getDatabase();
     int m;
@@ -134,11 +134,18 @@ ExternalQueue::process()
     // publication and the requirements of our pubsub subscribers.
     uint32_t cmin = std::min(lmin, rmin);
 
-    CLOG(INFO, "History") << "Trimming history <= ledger " << cmin
-                          << " (rmin=" << rmin << ", qmin=" << qmin
-                          << ", lmin=" << lmin << ")";
+    CLOG(DEBUG, "History") << "History <= ledger " << cmin
+                           << " can be deleted (rmin=" << rmin
+                           << ", qmin=" << qmin << ", lmin=" << lmin << ")";
+    return cmin;
+}
 
-    mApp.getLedgerManager().deleteOldEntries(mApp.getDatabase(), cmin);
+void
+ExternalQueue::process()
+{
+    uint32_t cmin = getDeletableLedger();
+    CLOG(INFO, "History") << "Trimming history <= ledger " << cmin;
+    mApp.getLedgerManager().pruneHistory(cmin);
 }
 
 void
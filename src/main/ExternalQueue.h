@@ -26,7 +26,10 @@ class ExternalQueue
     // deletes the subscription for the resource
     void deleteCursor(std::string const& resid);
 
-    // safely delete data
+    // highest ledger whose history neither subscribers nor publishing need
+    uint32_t getDeletableLedger();
+
+    // safely delete data, in the background (see HistoryPruner)
     void process();
 
   private:
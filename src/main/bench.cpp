@@ -0,0 +1,285 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "main/bench.h"
+#include "database/Database.h"
+#include "herder/Herder.h"
+#include "herder/LedgerCloseData.h"
+#include "herder/TxSetFrame.h"
+#include "ledger/LedgerManager.h"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "simulation/LoadGenerator.h"
+#include "transactions/TransactionFrame.h"
+#include "util/Logging.h"
+#include "util/Math.h"
+#include "util/Timer.h"
+#include "util/TmpDir.h"
+
+#include "medida/metrics_registry.h"
+#include "medida/stats/snapshot.h"
+#include "medida/timer.h"
+
+#include <fstream>
+#include <iostream>
+#include <json/json.h>
+
+/**
+ * Closed-loop ledger-close benchmark, run with --bench.
+ *
+ * It starts from a fresh database of its own (--benchdb), closes ledgers
+ * creating the accounts (with their trustlines, and offers for market
+ * makers) the same way the load generator does, then closes the measured
+ * ledgers, each holding a mix of native payments and credit payments along
+ * paths crossing the offers.
+ *
+ * Ledgers are closed directly through the LedgerManager, one after the
+ * other, so the figures are those of ledger close alone: no overlay, no
+ * consensus. The random engine is seeded with a constant, so runs with the
+ * same parameters close the same ledgers and can be compared across builds
+ * and databases.
+ */
+
+namespace stellar
+{
+
+namespace
+{
+
+unsigned int const kBenchSeed = 0;
+
+class LedgerCloseBench
+{
+    Application& mApp;
+    LoadGenerator mGen;
+    LoadGenerator::TxMetrics mTxMetrics;
+    medida::Timer& mCloseTimer;
+
+    size_t mSetupFailed{0};
+    size_t mTxs{0};
+    size_t mFailed{0};
+    std::chrono::nanoseconds mCloseTime{0};
+    std::chrono::nanoseconds mQueryTime{0};
+
+    size_t
+    closeLedger(std::vector<LoadGenerator::TxInfo>& txs, bool measure,
+                xdr::xvector<UpgradeType, 6> const& upgrades = {})
+    {
+        auto& lm = mApp.getLedgerManager();
+        auto const& lcl = lm.getLastClosedLedgerHeader();
+        auto baseFee = mApp.getConfig().DESIRED_BASE_FEE;
+
+        auto txSet = std::make_shared<TxSetFrame>(lcl.hash);
+        for (auto& tx : txs)
+        {
+            std::vector<TransactionFramePtr> txfs;
+            tx.toTransactionFrames(mApp.getNetworkID(), txfs, mTxMetrics);
+            for (auto f : txfs)
+            {
+                txSet->add(f);
+            }
+            tx.recordExecution(baseFee);
+        }
+        txSet->sortForHash();
+
+        // close times are derived from the previous ledger, rather than from
+        // the clock, to keep runs identical
+        StellarValue sv(txSet->getContentsHash(),
+                        lcl.header.scpValue.closeTime +
+                            Herder::EXP_LEDGER_TIMESPAN_SECONDS.count(),
+                        upgrades, 0);
+        LedgerCloseData ledgerData(lm.getLedgerNum(), txSet, sv);
+
+        auto queryStart = mApp.getDatabase().totalQueryTime();
+        std::chrono::nanoseconds elapsed;
+        if (measure)
+        {
+            auto scope = mCloseTimer.TimeScope();
+            lm.closeLedger(ledgerData);
+            elapsed = scope.Stop();
+        }
+        else
+        {
+            lm.closeLedger(ledgerData);
+        }
+        auto query = mApp.getDatabase().totalQueryTime() - queryStart;
+
+        // run whatever the close posted (bucket merges, publishing) before
+        // the next close
+        while (mApp.getClock().crank(false) > 0)
+            ;
+
+        size_t failed = 0;
+        for (auto const& f : txSet->mTransactions)
+        {
+            if (f->getResultCode() != txSUCCESS)
+            {
+                ++failed;
+            }
+        }
+        if (measure)
+        {
+            mTxs += txSet->mTransactions.size();
+            mFailed += failed;
+            mCloseTime += elapsed;
+            mQueryTime += query;
+        }
+        return failed;
+    }
+
+  public:
+    explicit LedgerCloseBench(Application& app)
+        : mApp(app)
+        , mGen(app.getNetworkID())
+        , mTxMetrics(app.getMetrics())
+        , mCloseTimer(app.getMetrics().NewTimer({"bench", "ledger", "close"}))
+    {
+    }
+
+    void
+    setup(BenchParams const& params)
+    {
+        // bring the genesis ledger to the protocol version of this build
+        LedgerUpgrade upgrade(LEDGER_UPGRADE_VERSION);
+        upgrade.newLedgerVersion() = mApp.getConfig().LEDGER_PROTOCOL_VERSION;
+        xdr::xvector<UpgradeType, 6> upgrades;
+        Value v(xdr::xdr_to_opaque(upgrade));
+        upgrades.emplace_back(v.begin(), v.end());
+        std::vector<LoadGenerator::TxInfo> none;
+        closeLedger(none, false, upgrades);
+
+        auto& lm = mApp.getLedgerManager();
+        while (mGen.mAccounts.size() <= params.mAccounts)
+        {
+            std::vector<LoadGenerator::TxInfo> txs;
+            auto ledgerNum = lm.getLedgerNum();
+            while (txs.size() < params.mTxsPerLedger &&
+                   mGen.mAccounts.size() <= params.mAccounts)
+            {
+                mGen.maybeCreateAccount(ledgerNum, txs);
+            }
+            mSetupFailed += closeLedger(txs, false);
+        }
+
+        // leave enough ledgers for all the new accounts to be usable
+        for (int i = 0; i < 4; ++i)
+        {
+            closeLedger(none, false);
+        }
+        CLOG(INFO, "Ledger") << "Created " << mGen.mAccounts.size() - 1
+                             << " accounts, " << mGen.mGateways.size()
+                             << " gateways, " << mGen.mMarketMakers.size()
+                             << " market makers";
+    }
+
+    void
+    run(BenchParams const& params)
+    {
+        auto& lm = mApp.getLedgerManager();
+        for (uint32_t i = 0; i < params.mLedgers; ++i)
+        {
+            std::vector<LoadGenerator::TxInfo> txs;
+            auto ledgerNum = lm.getLedgerNum();
+            for (uint32_t j = 0; j < params.mTxsPerLedger; ++j)
+            {
+                txs.push_back(mGen.createRandomTransaction(0.5, ledgerNum));
+            }
+            closeLedger(txs, true);
+            if ((i + 1) % 100 == 0)
+            {
+                CLOG(INFO, "Ledger") << "Closed " << (i + 1) << "/"
+                                     << params.mLedgers << " ledgers";
+            }
+        }
+    }
+
+    Json::Value
+    report(BenchParams const& params) const
+    {
+        using namespace std::chrono;
+        auto snapshot = mCloseTimer.GetSnapshot();
+        double closeSecs = duration<double>(mCloseTime).count();
+
+        Json::Value root;
+        root["database"] =
+            mApp.getDatabase().isSqlite() ? "sqlite" : "postgresql";
+        root["accounts"] = (Json::UInt64)(mGen.mAccounts.size() - 1);
+        root["gateways"] = (Json::UInt64)mGen.mGateways.size();
+        root["market_makers"] = (Json::UInt64)mGen.mMarketMakers.size();
+        root["setup_failed"] = (Json::UInt64)mSetupFailed;
+        root["ledgers"] = params.mLedgers;
+        root["txs_per_ledger"] = params.mTxsPerLedger;
+        root["transactions"] = (Json::UInt64)mTxs;
+        root["failed"] = (Json::UInt64)mFailed;
+        root["close_ms"]["p50"] = snapshot.getMedian();
+        root["close_ms"]["p99"] = snapshot.get99thPercentile();
+        root["close_ms"]["mean"] = mCloseTimer.mean();
+        root["close_ms"]["max"] = mCloseTimer.max();
+        root["tx_per_sec"] = closeSecs > 0 ? mTxs / closeSecs : 0.0;
+        root["sql_time_share"] =
+            mCloseTime.count() > 0
+                ? static_cast<double>(mQueryTime.count()) / mCloseTime.count()
+                : 0.0;
+        return root;
+    }
+};
+}
+
+int
+bench(Config const& cfg, std::string const& filename,
+      BenchParams const& params)
+{
+    if (params.mTxsPerLedger == 0)
+    {
+        throw std::invalid_argument("bench needs at least one tx per ledger");
+    }
+
+    if (params.mDatabase == cfg.DATABASE)
+    {
+        throw std::invalid_argument(
+            "bench would reset the node's database: pass another --benchdb");
+    }
+
+    // nothing the node runs on may be touched: not its database, nor its
+    // buckets, nor its archives (which would get checkpoints from genesis)
+    TmpDir buckets(cfg.BUCKET_DIR_PATH + "-bench");
+    Config benchCfg(cfg);
+    benchCfg.MANUAL_CLOSE = true;
+    benchCfg.DATABASE = params.mDatabase;
+    benchCfg.BUCKET_DIR_PATH = buckets.getName();
+    benchCfg.HISTORY.clear();
+    benchCfg.METADATA_OUTPUT_STREAM.clear();
+
+    gRandomEngine.seed(kBenchSeed);
+
+    Json::Value result;
+    {
+        VirtualClock clock;
+        CLOG(INFO, "Ledger") << "Resetting " << benchCfg.DATABASE
+                             << " to the genesis ledger";
+        Application::pointer app = Application::create(clock, benchCfg);
+        LedgerCloseBench b(*app);
+        b.setup(params);
+        b.run(params);
+        result = b.report(params);
+    }
+
+    auto out = result.toStyledString();
+    if (filename == "-")
+    {
+        std::cout << out;
+    }
+    else
+    {
+        std::ofstream f(filename, std::ofstream::trunc);
+        f << out;
+        if (!f)
+        {
+            CLOG(ERROR, "Ledger") << "Unable to write " << filename;
+            return 1;
+        }
+    }
+    return 0;
+}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include <cstdint>
+#include <string>
+
+namespace stellar
+{
+
+class Config;
+
+struct BenchParams
+{
+    uint32_t mAccounts{1000};
+    uint32_t mLedgers{100};
+    uint32_t mTxsPerLedger{100};
+    // database the benchmark resets and closes ledgers against; never the
+    // one configured for the node
+    std::string mDatabase{"sqlite3://:memory:"};
+};
+
+// Resets mDatabase to the genesis ledger, closes ledgers against it, with
+// the rest of `cfg` but its history archives and bucket directory, and
+// writes the measurements, as JSON, to `filename` ('-' for stdout). Returns
+// the process exit code.
+int bench(Config const& cfg, std::string const& filename,
+          BenchParams const& params);
+}
@@ -8,6 +8,7 @@
 #include "util/Timer.h"
 #include "util/Fs.h"
 #include "lib/util/getopt.h"
+#include "main/bench.h"
 #include "main/dumpxdr.h"
 #include "main/fuzz.h"
 #include "main/test.h"
@@ -32,6 +33,11 @@ using namespace std;
 
 enum opttag
 {
+    OPT_BENCH,
+    OPT_BENCHACCOUNTS,
+    OPT_BENCHDB,
+    OPT_BENCHLEDGERS,
+    OPT_BENCHTXS,
     OPT_CMD,
     OPT_CONF,
     OPT_CONVERTID,
@@ -58,6 +64,11 @@ enum opttag
 };
 
 static const struct option stellar_core_options[] = {
+    {"bench", required_argument, nullptr, OPT_BENCH},
+    {"benchaccounts", required_argument, nullptr, OPT_BENCHACCOUNTS},
+    {"benchdb", required_argument, nullptr, OPT_BENCHDB},
+    {"benchledgers", required_argument, nullptr, OPT_BENCHLEDGERS},
+    {"benchtxs", required_argument, nullptr, OPT_BENCHTXS},
     {"c", required_argument, nullptr, OPT_CMD},
     {"conf", required_argument, nullptr, OPT_CONF},
     {"convertid", required_argument, nullptr, OPT_CONVERTID},
@@ -89,6 +100,19 @@ usage(int err = 1)
     std::ostream& os = err ? std::cerr : std::cout;
     os << "usage: stellar-core [OPTIONS]\n"
           "where OPTIONS can be any of:\n"
+          "      --bench FILE    Benchmark ledger close on a DB of its own, "
+          "from the genesis\n"
+          "                      ledger, and write the results to FILE ('-' "
+          "for STDOUT)\n"
+          "      --benchaccounts N  Accounts created before the benchmark "
+          "(default 1000)\n"
+          "      --benchdb URL   DB the benchmark resets and uses, never the "
+          "node's one\n"
+          "                      (default in-memory SQLite)\n"
+          "      --benchledgers N   Ledgers closed by the benchmark "
+          "(default 100)\n"
+          "      --benchtxs N    Transactions per benchmark ledger "
+          "(default 100)\n"
           "      --c             Send a command to local stellar-core. try "
           "'--c help' for more information\n"
           "      --conf FILE     Specify a config file ('-' for STDIN, "
@@ -400,6 +424,8 @@ main(int argc, char* const* argv)
     std::string loadXdrBucket = "";
     std::vector<std::string> newHistories;
     std::vector<std::string> metrics;
+    std::string benchFile;
+    BenchParams benchParams;
 
     int opt;
     while ((opt = getopt_long_only(argc, argv, "c:", stellar_core_options,
@@ -407,6 +433,21 @@ main(int argc, char* const* argv)
     {
         switch (opt)
         {
+        case OPT_BENCH:
+            benchFile = std::string(optarg);
+            break;
+        case OPT_BENCHACCOUNTS:
+            benchParams.mAccounts = std::stoul(optarg);
+            break;
+        case OPT_BENCHDB:
+            benchParams.mDatabase = std::string(optarg);
+            break;
+        case OPT_BENCHLEDGERS:
+            benchParams.mLedgers = std::stoul(optarg);
+            break;
+        case OPT_BENCHTXS:
+            benchParams.mTxsPerLedger = std::stoul(optarg);
+            break;
         case 'c':
         case OPT_CMD:
             command = optarg;
@@ -550,6 +591,11 @@ main(int argc, char* const* argv)
             setNoListen(cfg);
             return initializeHistories(cfg, newHistories);
         }
+        else if (!benchFile.empty())
+        {
+            setNoListen(cfg);
+            return bench(cfg, benchFile, benchParams);
+        }
 
         if (cfg.MANUAL_CLOSE)
         {
@@ -63,8 +63,8 @@ ItemFetcher::stopFetchingBelow(uint64 slotIndex)
 {
     // only perform this cleanup from the top of the stack as it causes
     // all sorts of evil side effects
-    mApp.getClock().getIOService().post(
-        [this, slotIndex]()
+    mApp.getClock().postAction(
+        Scheduler::CONSENSUS, [this, slotIndex]()
         {
             stopFetchingBelowInternal(slotIndex);
         });
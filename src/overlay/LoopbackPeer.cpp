@@ -23,7 +23,12 @@ using namespace std;
 // LoopbackPeer
 ///////////////////////////////////////////////////////////////////////
 
-LoopbackPeer::LoopbackPeer(Application& app, PeerRole role) : Peer(app, role)
+// Linux's lower bound on the TCP retransmission timeout
+static const VirtualClock::duration MIN_RETRANSMISSION_TIMEOUT =
+    std::chrono::milliseconds(200);
+
+LoopbackPeer::LoopbackPeer(Application& app, PeerRole role)
+    : Peer(app, role), mArrivalTimer(app)
 {
 }
 
@@ -72,6 +77,7 @@ LoopbackPeer::drop()
     }
     mState = CLOSING;
     mIdleTimer.cancel();
+    mArrivalTimer.cancel();
     auto self = shared_from_this();
     getApp().getOverlayManager().dropPeer(self);
 
@@ -137,6 +143,97 @@ LoopbackPeer::processInQueue()
     }
 }
 
+VirtualClock::time_point
+LoopbackPeer::arrivalTime(size_t nBytes)
+{
+    auto now = mApp.getClock().now();
+    if (mLatency == VirtualClock::duration::zero() && mJitter == VirtualClock::duration::zero() &&
+        mBandwidth == 0 && mLossProb.p() == 0)
+    {
+        return now;
+    }
+
+    auto sent = std::max(now, mLinkFree);
+    if (mBandwidth != 0)
+    {
+        sent += chrono::duration_cast<VirtualClock::duration>(
+            chrono::duration<double>(static_cast<double>(nBytes) /
+                                     mBandwidth));
+    }
+    mLinkFree = sent;
+
+    auto delay = mLatency;
+    if (mJitter != VirtualClock::duration::zero())
+    {
+        normal_distribution<double> jitter(
+            0.0, chrono::duration<double>(mJitter).count());
+        delay += chrono::duration_cast<VirtualClock::duration>(
+            chrono::duration<double>(jitter(mGenerator)));
+        delay = std::max(delay, VirtualClock::duration::zero());
+    }
+    if (mLossProb(mGenerator))
+    {
+        mStats.messagesRetransmitted++;
+        delay += std::max(MIN_RETRANSMISSION_TIMEOUT, 2 * mLatency);
+    }
+
+    mLastArrival = std::max(sent + delay, mLastArrival);
+    return mLastArrival;
+}
+
+void
+LoopbackPeer::receive(VirtualClock::time_point when, xdr::msg_ptr&& msg)
+{
+    if (mInFlight.empty() && when <= mApp.getClock().now())
+    {
+        mInQueue.emplace(std::move(msg));
+        auto self = static_pointer_cast<LoopbackPeer>(shared_from_this());
+        mApp.getClock().getIOService().post([self]()
+                                            {
+                                                self->processInQueue();
+                                            });
+        return;
+    }
+    mInFlight.emplace_back(when, std::move(msg));
+    if (mInFlight.size() == 1)
+    {
+        startArrivalTimer();
+    }
+}
+
+void
+LoopbackPeer::startArrivalTimer()
+{
+    auto self = static_pointer_cast<LoopbackPeer>(shared_from_this());
+    mArrivalTimer.expires_at(mInFlight.front().first);
+    mArrivalTimer.async_wait([self]()
+                             {
+                                 self->arrived();
+                             },
+                             &VirtualTimer::onFailureNoop);
+}
+
+void
+LoopbackPeer::arrived()
+{
+    auto now = mApp.getClock().now();
+    bool any = false;
+    while (!mInFlight.empty() && mInFlight.front().first <= now)
+    {
+        mInQueue.emplace(std::move(mInFlight.front().second));
+        mInFlight.pop_front();
+        any = true;
+    }
+    if (any)
+    {
+        processInQueue();
+    }
+    if (!mInFlight.empty())
+    {
+        startArrivalTimer();
+    }
+}
+
 void
 LoopbackPeer::deliverOne()
 {
@@ -188,20 +285,19 @@ LoopbackPeer::deliverOne()
 
         size_t nBytes = msg->raw_size();
         mStats.bytesDelivered += nBytes;
+        auto when = arrivalTime(nBytes);
 
         // Pass ownership of a serialized XDR message buffer to a recvMesage
         // callback event against the remote Peer, posted on the remote
-        // Peer's io_service.
+        // Peer's io_service once the message has arrived.
         auto remote = mRemote.lock();
-        if (remote)
+        if (remote && mHoldDeliveries)
+        {
+            remote->mHeld.emplace_back(when, std::move(msg));
+        }
+        else if (remote)
         {
-            // move msg to remote's in queue
-            remote->mInQueue.emplace(std::move(msg));
-            remote->getApp().getClock().getIOService().post(
-                [remote]()
-                {
-                    remote->processInQueue();
-                });
+            remote->receive(when, std::move(msg));
         }
         LoadManager::PeerContext loadCtx(mApp, mPeerID);
         mLastWrite = mApp.getClock().now();
@@ -244,6 +340,30 @@ LoopbackPeer::getMessagesQueued() const
     return mOutQueue.size();
 }
 
+bool
+LoopbackPeer::getHoldDeliveries() const
+{
+    return mHoldDeliveries;
+}
+
+void
+LoopbackPeer::setHoldDeliveries(bool h)
+{
+    mHoldDeliveries = h;
+}
+
+size_t
+LoopbackPeer::releaseHeld()
+{
+    size_t n = mHeld.size();
+    for (auto& m : mHeld)
+    {
+        receive(m.first, std::move(m.second));
+    }
+    mHeld.clear();
+    return n;
+}
+
 LoopbackPeer::Stats const&
 LoopbackPeer::getStats() const
 {
@@ -359,6 +479,50 @@ LoopbackPeer::setReorderProbability(double d)
     mReorderProb = bernoulli_distribution(d);
 }
 
+VirtualClock::duration
+LoopbackPeer::getLatency() const
+{
+    return mLatency;
+}
+
+void
+LoopbackPeer::setLatency(VirtualClock::duration latency,
+                         VirtualClock::duration jitter)
+{
+    if (latency < VirtualClock::duration::zero() ||
+        jitter < VirtualClock::duration::zero())
+    {
+        throw std::runtime_error("latency out of range");
+    }
+    mLatency = latency;
+    mJitter = jitter;
+}
+
+uint64_t
+LoopbackPeer::getBandwidth() const
+{
+    return mBandwidth;
+}
+
+void
+LoopbackPeer::setBandwidth(uint64_t bytesPerSecond)
+{
+    mBandwidth = bytesPerSecond;
+}
+
+double
+LoopbackPeer::getLossProbability() const
+{
+    return mLossProb.p();
+}
+
+void
+LoopbackPeer::setLossProbability(double d)
+{
+    checkProbRange(d);
+    mLossProb = bernoulli_distribution(d);
+}
+
 LoopbackPeerConnection::LoopbackPeerConnection(Application& initiator,
                                                Application& acceptor)
     : mInitiator(make_shared<LoopbackPeer>(initiator, Peer::WE_CALLED_REMOTE))
@@ -5,8 +5,10 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "overlay/Peer.h"
+#include "util/Timer.h"
 #include <deque>
 #include <random>
+#include <vector>
 
 /*
 Another peer out there that we are connected to
@@ -28,6 +30,26 @@ class LoopbackPeer : public Peer
     std::deque<xdr::msg_ptr> mOutQueue; // sending queue
     std::queue<xdr::msg_ptr> mInQueue;  // receiving queue
 
+    typedef std::pair<VirtualClock::time_point, xdr::msg_ptr> Arrival;
+
+    // When the two ends run on different threads, messages are not handed to
+    // the remote's in queue on delivery but held here, on the remote, until
+    // releaseHeld() is called with both threads stopped.
+    bool mHoldDeliveries{false};
+    std::vector<Arrival> mHeld;
+
+    // Messages on the wire towards us, in order of arrival.
+    std::deque<Arrival> mInFlight;
+    VirtualTimer mArrivalTimer;
+
+    // Link towards the remote, see setLatency().
+    VirtualClock::duration mLatency{0};
+    VirtualClock::duration mJitter{0};
+    uint64_t mBandwidth{0};
+    std::bernoulli_distribution mLossProb{0.0};
+    VirtualClock::time_point mLinkFree;
+    VirtualClock::time_point mLastArrival;
+
     bool mCorked{false};
     size_t mMaxQueueDepth{0};
 
@@ -45,6 +67,7 @@ class LoopbackPeer : public Peer
         size_t messagesReordered{0};
         size_t messagesDamaged{0};
         size_t messagesDropped{0};
+        size_t messagesRetransmitted{0};
 
         size_t bytesDelivered{0};
         size_t messagesDelivered{0};
@@ -57,6 +80,11 @@ class LoopbackPeer : public Peer
 
     void processInQueue();
 
+    VirtualClock::time_point arrivalTime(size_t nBytes);
+    void receive(VirtualClock::time_point when, xdr::msg_ptr&& msg);
+    void startArrivalTimer();
+    void arrived();
+
   public:
     virtual ~LoopbackPeer()
     {
@@ -71,6 +99,11 @@ class LoopbackPeer : public Peer
     size_t getBytesQueued() const;
     size_t getMessagesQueued() const;
 
+    bool getHoldDeliveries() const;
+    void setHoldDeliveries(bool h);
+    // moves held messages to the in queue, returns how many there were
+    size_t releaseHeld();
+
     Stats const& getStats() const;
     std::deque<xdr::msg_ptr>& getQueue();
     std::shared_ptr<LoopbackPeer> const& getTarget() const;
@@ -99,6 +132,22 @@ class LoopbackPeer : public Peer
     double getReorderProbability() const;
     void setReorderProbability(double d);
 
+    // Model of a WAN link towards the remote, in virtual time: messages are
+    // sent one after the other, each taking its size over `bytesPerSecond`
+    // to send (0: no limit), and arrive `latency` later, give or take
+    // normally distributed `jitter`. As over TCP, they arrive in the order
+    // they were sent, and lost ones are not dropped but arrive late, after a
+    // retransmission timeout.
+    VirtualClock::duration getLatency() const;
+    void setLatency(VirtualClock::duration latency,
+                    VirtualClock::duration jitter);
+
+    uint64_t getBandwidth() const;
+    void setBandwidth(uint64_t bytesPerSecond);
+
+    double getLossProbability() const;
+    void setLossProbability(double d);
+
     using Peer::sendAuth;
 
     friend class LoopbackPeerConnection;
@@ -48,6 +48,38 @@ TEST_CASE("loopback peer hello", "[overlay]")
     REQUIRE(conn.getAcceptor()->isAuthenticated());
 }
 
+TEST_CASE("loopback peer with latency", "[overlay]")
+{
+    VirtualClock clock;
+    Config const& cfg1 = getTestConfig(0);
+    Config const& cfg2 = getTestConfig(1);
+    auto app1 = Application::create(clock, cfg1);
+    auto app2 = Application::create(clock, cfg2);
+
+    LoopbackPeerConnection conn(*app1, *app2);
+    for (auto peer : {conn.getInitiator(), conn.getAcceptor()})
+    {
+        peer->setLatency(std::chrono::milliseconds(100),
+                         std::chrono::milliseconds(10));
+        peer->setBandwidth(1000000);
+        peer->setLossProbability(0.5);
+    }
+
+    auto start = clock.now();
+    for (size_t i = 0; i < 1000 && !(conn.getInitiator()->isAuthenticated() &&
+                                     conn.getAcceptor()->isAuthenticated());
+         ++i)
+    {
+        clock.crank(false);
+    }
+
+    REQUIRE(conn.getInitiator()->isAuthenticated());
+    REQUIRE(conn.getAcceptor()->isAuthenticated());
+    // hello and auth, both ways, one after the other
+    REQUIRE(clock.now() - start >= std::chrono::milliseconds(4 * 60));
+    REQUIRE(conn.getInitiator()->getStats().messagesDropped == 0);
+}
+
 TEST_CASE("loopback peer with 0 port", "[overlay]")
 {
     VirtualClock clock;
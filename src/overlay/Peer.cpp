@@ -72,6 +72,8 @@ Peer::Peer(Application& app, PeerRole role)
           app.getMetrics().NewMeter({"overlay", "error", "write"}, "error"))
     , mTimeoutIdle(
           app.getMetrics().NewMeter({"overlay", "timeout", "idle"}, "timeout"))
+    , mReadThrottle(
+          app.getMetrics().NewMeter({"overlay", "read", "throttle"}, "read"))
 
     , mRecvErrorTimer(app.getMetrics().NewTimer({"overlay", "recv", "error"}))
     , mRecvHelloTimer(app.getMetrics().NewTimer({"overlay", "recv", "hello"}))
@@ -497,17 +499,97 @@ Peer::sendMessage(StellarMessage const& msg)
 
     AuthenticatedMessage amsg;
     amsg.v0().message = msg;
-    if (msg.type() != HELLO && msg.type() != ERROR_MSG)
+    if (msg.type() == HELLO || msg.type() == ERROR_MSG)
     {
-        amsg.v0().sequence = mSendMacSeq;
-        amsg.v0().mac =
-            hmacSha256(mSendMacKey, xdr::xdr_to_opaque(mSendMacSeq, msg));
-        ++mSendMacSeq;
+        xdr::msg_ptr xdrBytes(xdr::xdr_to_msg(amsg));
+        this->sendMessage(std::move(xdrBytes));
+        return;
     }
+    amsg.v0().sequence = mSendMacSeq++;
+    sendAuthenticatedMessage(std::move(amsg));
+}
+
+void
+Peer::sendAuthenticatedMessage(AuthenticatedMessage&& amsg)
+{
+    signMessage(amsg, mSendMacKey);
     xdr::msg_ptr xdrBytes(xdr::xdr_to_msg(amsg));
     this->sendMessage(std::move(xdrBytes));
 }
 
+void
+Peer::signMessage(AuthenticatedMessage& amsg, HmacSha256Key const& key)
+{
+    amsg.v0().mac = hmacSha256(
+        key, xdr::xdr_to_opaque(amsg.v0().sequence, amsg.v0().message));
+}
+
+Peer::MacCheck
+Peer::checkMac(AuthenticatedMessage const& msg, HmacSha256Key const& key,
+               uint64_t& seq)
+{
+    if (msg.v0().message.type() == ERROR_MSG)
+    {
+        return MAC_OK;
+    }
+    if (msg.v0().sequence != seq)
+    {
+        ++seq;
+        return MAC_BAD_SEQUENCE;
+    }
+    if (!hmacSha256Verify(
+            msg.v0().mac, key,
+            xdr::xdr_to_opaque(msg.v0().sequence, msg.v0().message)))
+    {
+        ++seq;
+        return MAC_BAD_MAC;
+    }
+    ++seq;
+    return MAC_OK;
+}
+
+void
+Peer::dropForMac(MacCheck check)
+{
+    if (check == MAC_BAD_SEQUENCE)
+    {
+        CLOG(ERROR, "Overlay") << "Unexpected message-auth sequence";
+        mDropInRecvMessageSeqMeter.Mark();
+        drop(ERR_AUTH, "unexpected auth sequence");
+    }
+    else if (check == MAC_BAD_MAC)
+    {
+        CLOG(ERROR, "Overlay") << "Message-auth check failed";
+        mDropInRecvMessageMacMeter.Mark();
+        drop(ERR_AUTH, "unexpected MAC");
+    }
+}
+
+void
+Peer::scheduleMessage(Application& app, std::weak_ptr<Peer> peer,
+                      std::shared_ptr<StellarMessage const> msg)
+{
+    app.getClock().postAction(getActionClass(msg->type()), [peer, msg]()
+                              {
+                                  auto self = peer.lock();
+                                  if (!self)
+                                  {
+                                      return;
+                                  }
+                                  LoadManager::PeerContext loadCtx(
+                                      self->mApp, self->mPeerID);
+                                  self->recvMessage(*msg);
+                                  self->messageProcessed();
+                              });
+}
+
+void
+Peer::messageProcessed()
+{
+    assert(mMessagesInFlight > 0);
+    --mMessagesInFlight;
+}
+
 void
 Peer::recvMessage(xdr::msg_ptr const& msg)
 {
@@ -560,30 +642,47 @@ Peer::recvMessage(AuthenticatedMessage const& msg)
         return;
     }
 
-    if (mState >= GOT_HELLO && msg.v0().message.type() != ERROR_MSG)
+    if (mState >= GOT_HELLO)
     {
-        if (msg.v0().sequence != mRecvMacSeq)
+        auto check = checkMac(msg, mRecvMacKey, mRecvMacSeq);
+        if (check != MAC_OK)
         {
-            CLOG(ERROR, "Overlay") << "Unexpected message-auth sequence";
-            mDropInRecvMessageSeqMeter.Mark();
-            ++mRecvMacSeq;
-            drop(ERR_AUTH, "unexpected auth sequence");
+            dropForMac(check);
             return;
         }
+    }
 
-        if (!hmacSha256Verify(
-                msg.v0().mac, mRecvMacKey,
-                xdr::xdr_to_opaque(msg.v0().sequence, msg.v0().message)))
-        {
-            CLOG(ERROR, "Overlay") << "Message-auth check failed";
-            mDropInRecvMessageMacMeter.Mark();
-            ++mRecvMacSeq;
-            drop(ERR_AUTH, "unexpected MAC");
-            return;
-        }
-        ++mRecvMacSeq;
+    auto type = msg.v0().message.type();
+    if (!isAuthenticated() || type == HELLO || type == AUTH ||
+        type == ERROR_MSG)
+    {
+        // the handshake decides how the messages after it are checked, and
+        // messages coming before its end are checked against it
+        recvMessage(msg.v0().message);
+        return;
+    }
+
+    // the rest waits its turn with the other work of its class
+    ++mMessagesInFlight;
+    scheduleMessage(mApp, shared_from_this(),
+                    std::make_shared<StellarMessage>(msg.v0().message));
+}
+
+Scheduler::ActionClass
+Peer::getActionClass(MessageType type)
+{
+    switch (type)
+    {
+    case TRANSACTION:
+        return Scheduler::OVERLAY_TX;
+    case GET_PEERS:
+    case PEERS:
+        return Scheduler::BACKGROUND;
+    default:
+        // SCP messages, and what they need to be processed: kept in one
+        // queue, in the order they came in
+        return Scheduler::CONSENSUS;
     }
-    recvMessage(msg.v0().message);
 }
 
 void
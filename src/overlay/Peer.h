@@ -83,6 +83,11 @@ class Peer : public std::enable_shared_from_this<Peer>,
     medida::Meter& mErrorRead;
     medida::Meter& mErrorWrite;
     medida::Meter& mTimeoutIdle;
+    medida::Meter& mReadThrottle;
+
+    // Authenticated messages handed off to the overlay threads or to the
+    // scheduler and not processed yet; main thread only.
+    size_t mMessagesInFlight{0};
 
     medida::Timer& mRecvErrorTimer;
     medida::Timer& mRecvHelloTimer;
@@ -136,6 +141,30 @@ class Peer : public std::enable_shared_from_this<Peer>,
     medida::Meter& mDropInRecvErrorMeter;
 
     bool shouldAbort() const;
+    static Scheduler::ActionClass getActionClass(MessageType type);
+
+    // The checks and signatures of the messages exchanged once the handshake
+    // is done; thread-safe, as they only touch what they are given.
+    enum MacCheck
+    {
+        MAC_OK,
+        MAC_BAD_SEQUENCE,
+        MAC_BAD_MAC
+    };
+    // checks `msg` is the message `seq` numbers, and moves `seq` on
+    static MacCheck checkMac(AuthenticatedMessage const& msg,
+                             HmacSha256Key const& key, uint64_t& seq);
+    static void signMessage(AuthenticatedMessage& amsg,
+                            HmacSha256Key const& key);
+    void dropForMac(MacCheck check);
+
+    // Queues `msg`, authenticated, to be processed on the main thread by
+    // `peer`, if it is still around then; thread-safe.
+    static void scheduleMessage(Application& app, std::weak_ptr<Peer> peer,
+                                std::shared_ptr<StellarMessage const> msg);
+    // called on the main thread once a message counted in
+    // mMessagesInFlight is processed, or dropped
+    virtual void messageProcessed();
     void recvMessage(StellarMessage const& msg);
     void recvMessage(AuthenticatedMessage const& msg);
     void recvMessage(xdr::msg_ptr const& xdrBytes);
@@ -171,6 +200,8 @@ class Peer : public std::enable_shared_from_this<Peer>,
     // messages somewhere else. The async write request will point _into_
     // this owned buffer. This is really the best we can do.
     virtual void sendMessage(xdr::msg_ptr&& xdrBytes) = 0;
+    // Sends `amsg`, numbered but not signed yet.
+    virtual void sendAuthenticatedMessage(AuthenticatedMessage&& amsg);
     virtual void
     connected()
     {
@@ -15,9 +15,14 @@
 #include "medida/meter.h"
 #include "main/Config.h"
 #include "util/GlobalChecks.h"
+#include "util/make_unique.h"
 
 #define MAX_UNAUTH_MESSAGE_SIZE 0x1000
 #define MAX_MESSAGE_SIZE 0x1000000
+// past this many messages read and not processed yet, the peer is not read
+// from until some are: its data waits in the socket buffers and TCP slows
+// the sender down
+#define MAX_MESSAGES_IN_FLIGHT 16
 
 using namespace soci;
 
@@ -336,7 +341,15 @@ TCPPeer::readBodyHandler(asio::error_code const& error,
         receivedBytes(bytes_transferred, true);
         recvMessage();
         mIncomingHeader.clear();
-        startRead();
+        if (mMessagesInFlight < MAX_MESSAGES_IN_FLIGHT)
+        {
+            startRead();
+        }
+        else
+        {
+            mReadThrottle.Mark();
+            mReadDeferred = true;
+        }
     }
     else
     {
@@ -353,10 +366,26 @@ TCPPeer::readBodyHandler(asio::error_code const& error,
     }
 }
 
+void
+TCPPeer::messageProcessed()
+{
+    Peer::messageProcessed();
+    if (mReadDeferred && mMessagesInFlight < MAX_MESSAGES_IN_FLIGHT)
+    {
+        mReadDeferred = false;
+        startRead();
+    }
+}
+
 void
 TCPPeer::recvMessage()
 {
     assertThreadIsMain();
+    if (isAuthenticated() && mApp.getConfig().OVERLAY_THREADS != 0)
+    {
+        recvMessageOffMainThread();
+        return;
+    }
     try
     {
         xdr::xdr_get g(mIncomingBody.data(),
@@ -372,6 +401,110 @@ TCPPeer::recvMessage()
     }
 }
 
+void
+TCPPeer::recvMessageOffMainThread()
+{
+    if (!mRecvStrand)
+    {
+        mRecvStrand = make_unique<asio::io_service::strand>(
+            mApp.getOverlayIOService());
+        mRecvAuth = make_shared<RecvAuth>(RecvAuth{mRecvMacKey, mRecvMacSeq});
+    }
+
+    // the strand's handlers only refer to the peer weakly: it must go away
+    // on the main thread
+    auto body = make_shared<std::vector<uint8_t>>(std::move(mIncomingBody));
+    mIncomingBody.clear();
+    std::weak_ptr<TCPPeer> weak =
+        static_pointer_cast<TCPPeer>(shared_from_this());
+    auto auth = mRecvAuth;
+    auto& app = mApp;
+    // counted from here, so that messages waiting for the overlay threads
+    // hold the reads back too
+    ++mMessagesInFlight;
+    mRecvStrand->post(
+        [body, weak, auth, &app]()
+        {
+            AuthenticatedMessage am;
+            bool corrupt = false;
+            MacCheck check = MAC_OK;
+            try
+            {
+                xdr::xdr_get g(body->data(), body->data() + body->size());
+                xdr::xdr_argpack_archive(g, am);
+                check = checkMac(am, auth->mKey, auth->mSeq);
+            }
+            catch (xdr::xdr_runtime_error& e)
+            {
+                CLOG(ERROR, "Overlay") << "recvMessage got a corrupt xdr: "
+                                       << e.what();
+                corrupt = true;
+            }
+
+            if (corrupt || check != MAC_OK)
+            {
+                app.getClock().getIOService().post(
+                    [weak, corrupt, check]()
+                    {
+                        auto self = weak.lock();
+                        if (!self)
+                        {
+                            return;
+                        }
+                        if (corrupt)
+                        {
+                            self->Peer::drop(ERR_DATA, "received corrupt XDR");
+                        }
+                        else
+                        {
+                            self->dropForMac(check);
+                        }
+                        self->messageProcessed();
+                    });
+                return;
+            }
+            scheduleMessage(
+                app, weak,
+                make_shared<StellarMessage>(std::move(am.v0().message)));
+        });
+}
+
+void
+TCPPeer::sendAuthenticatedMessage(AuthenticatedMessage&& amsg)
+{
+    assertThreadIsMain();
+    if (mApp.getConfig().OVERLAY_THREADS == 0)
+    {
+        Peer::sendAuthenticatedMessage(std::move(amsg));
+        return;
+    }
+    if (!mSendStrand)
+    {
+        mSendStrand = make_unique<asio::io_service::strand>(
+            mApp.getOverlayIOService());
+    }
+
+    auto msg = make_shared<AuthenticatedMessage>(std::move(amsg));
+    auto key = mSendMacKey;
+    std::weak_ptr<TCPPeer> weak =
+        static_pointer_cast<TCPPeer>(shared_from_this());
+    auto& io = mApp.getClock().getIOService();
+    mSendStrand->post(
+        [msg, key, weak, &io]()
+        {
+            signMessage(*msg, key);
+            auto bytes = make_shared<xdr::msg_ptr>(xdr::xdr_to_msg(*msg));
+            // posted in the strand's order, so written in it
+            io.post([weak, bytes]()
+                    {
+                        if (auto self = weak.lock())
+                        {
+                            self->sendMessage(std::move(*bytes));
+                        }
+                    });
+        });
+}
+
 void
 TCPPeer::drop()
 {
@@ -29,9 +29,27 @@ class TCPPeer : public Peer
 
     std::queue<std::shared_ptr<xdr::msg_ptr>> mWriteQueue;
     bool mWriting{false};
+    // set when reading stopped on too many messages in flight
+    bool mReadDeferred{false};
+
+    // Once the peer is authenticated, with Config::OVERLAY_THREADS, its
+    // messages are decoded and checked, or signed and encoded, in order on
+    // these strands of the overlay IO service. The receiving MAC state then
+    // moves to mRecvAuth, owned by mRecvStrand.
+    struct RecvAuth
+    {
+        HmacSha256Key mKey;
+        uint64_t mSeq;
+    };
+    std::unique_ptr<asio::io_service::strand> mRecvStrand;
+    std::unique_ptr<asio::io_service::strand> mSendStrand;
+    std::shared_ptr<RecvAuth> mRecvAuth;
 
     void recvMessage();
+    void recvMessageOffMainThread();
+    void messageProcessed() override;
     void sendMessage(xdr::msg_ptr&& xdrBytes) override;
+    void sendAuthenticatedMessage(AuthenticatedMessage&& amsg) override;
 
     void messageSender();
 
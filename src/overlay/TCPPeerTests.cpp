@@ -13,6 +13,9 @@
 #include "simulation/Simulation.h"
 #include "overlay/OverlayManager.h"
 
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+
 namespace stellar
 {
 
@@ -52,4 +55,72 @@ TEST_CASE("TCPPeer can communicate", "[overlay]")
     REQUIRE(p1->isAuthenticated());
     s->stopAllNodes();
 }
+
+TEST_CASE("TCPPeer messages after the handshake", "[overlay]")
+{
+    uint32_t overlayThreads = 0;
+    SECTION("prepared on the main thread")
+    {
+        overlayThreads = 0;
+    }
+    SECTION("prepared on overlay threads")
+    {
+        overlayThreads = 2;
+    }
+
+    Hash networkID = sha256(getTestConfig().NETWORK_PASSPHRASE);
+    int configCount = 0;
+    Simulation::pointer s = std::make_shared<Simulation>(
+        Simulation::OVER_TCP, networkID, [&]()
+        {
+            Config cfg = getTestConfig(configCount++);
+            cfg.OVERLAY_THREADS = overlayThreads;
+            return cfg;
+        });
+
+    auto v10SecretKey = SecretKey::fromSeed(sha256("v10"));
+    auto v11SecretKey = SecretKey::fromSeed(sha256("v11"));
+
+    SCPQuorumSet n0_qset;
+    n0_qset.threshold = 1;
+    n0_qset.validators.push_back(v10SecretKey.getPublicKey());
+    auto n0 = s->getNode(s->addNode(v10SecretKey, n0_qset, s->getClock()));
+
+    SCPQuorumSet n1_qset;
+    n1_qset.threshold = 1;
+    n1_qset.validators.push_back(v11SecretKey.getPublicKey());
+    auto n1 = s->getNode(s->addNode(v11SecretKey, n1_qset, s->getClock()));
+
+    s->addPendingConnection(v10SecretKey.getPublicKey(),
+                            v11SecretKey.getPublicKey());
+    s->startAllNodes();
+    s->crankForAtLeast(std::chrono::seconds(1), false);
+
+    auto p0 = n0->getOverlayManager().getConnectedPeer(
+        "127.0.0.1", n1->getConfig().PEER_PORT);
+    REQUIRE(p0);
+    REQUIRE(p0->isAuthenticated());
+
+    auto& recvGetPeers =
+        n1->getMetrics().NewTimer({"overlay", "recv", "get-peers"});
+    auto& recvPeers = n0->getMetrics().NewTimer({"overlay", "recv", "peers"});
+    auto getPeers = recvGetPeers.count();
+    auto peers = recvPeers.count();
+
+    // signed and checked in order, both ways
+    for (int i = 0; i < 10; i++)
+    {
+        p0->sendGetPeers();
+    }
+    s->crankUntil(
+        [&]()
+        {
+            return recvPeers.count() >= peers + 10;
+        },
+        std::chrono::seconds(5), false);
+    REQUIRE(recvGetPeers.count() >= getPeers + 10);
+    REQUIRE(recvPeers.count() >= peers + 10);
+    REQUIRE(p0->isAuthenticated());
+    s->stopAllNodes();
+}
 }
@@ -13,10 +13,13 @@
 #include "util/Logging.h"
 #include "util/types.h"
 #include "util/Math.h"
+#include "util/TmpDir.h"
 #include "herder/Herder.h"
 #include "transactions/TransactionFrame.h"
 #include "lib/util/format.h"
 #include "medida/stats/snapshot.h"
+#include "medida/meter.h"
+#include "medida/timer.h"
 #include "bucket/Bucket.h"
 #include "bucket/BucketList.h"
 #include "bucket/BucketManager.h"
@@ -25,8 +28,11 @@
 #include "ledger/LedgerManager.h"
 #include "herder/LedgerCloseData.h"
 #include "ledger/LedgerTestUtils.h"
+#include "simulation/LoadGenerator.h"
 #include "xdrpp/autocheck.h"
+#include <fstream>
 #include <sstream>
+#include <thread>
 
 using namespace stellar;
 
@@ -121,6 +127,10 @@ TEST_CASE("core topology: 4 ledgers at scales 2..4", "[simulation]")
     {
         mode = Simulation::OVER_LOOPBACK;
     }
+    SECTION("Over loopback, in parallel")
+    {
+        mode = Simulation::OVER_LOOPBACK_PARALLEL;
+    }
     SECTION("Over tcp")
     {
         mode = Simulation::OVER_TCP;
@@ -149,6 +159,50 @@ TEST_CASE("core topology: 4 ledgers at scales 2..4", "[simulation]")
     }
 }
 
+TEST_CASE("topology file with WAN links", "[simulation]")
+{
+    TmpDirManager tdm("tmp-topology");
+    TmpDir dir = tdm.tmpDir("topology");
+    std::string filename = dir.getName() + "/topology.toml";
+    {
+        std::ofstream out(filename);
+        for (auto n : {"a", "b", "c"})
+        {
+            out << "[[NODE]]\nNAME=\"" << n << "\"\n"
+                << "VALIDATORS=[\"a\", \"b\", \"c\"]\n";
+        }
+        out << "[[LINK]]\nFROM=\"a\"\nTO=\"b\"\nLATENCY_MS=50\n"
+            << "[[LINK]]\nFROM=\"b\"\nTO=\"c\"\nLATENCY_MS=100\n"
+            << "JITTER_MS=10\nBANDWIDTH_KBPS=10000\nLOSS=0.01\n"
+            << "[[LINK]]\nFROM=\"c\"\nTO=\"a\"\nLATENCY_MS=150\n";
+    }
+
+    Hash networkID = sha256(getTestConfig().NETWORK_PASSPHRASE);
+    Simulation::Mode mode = Simulation::OVER_LOOPBACK;
+    SECTION("Over loopback")
+    {
+        mode = Simulation::OVER_LOOPBACK;
+    }
+    SECTION("Over loopback, in parallel")
+    {
+        mode = Simulation::OVER_LOOPBACK_PARALLEL;
+    }
+
+    auto sim = Topologies::fromFile(filename, mode, networkID);
+    REQUIRE(sim->getNodes().size() == 3);
+    sim->startAllNodes();
+
+    int nLedgers = 3;
+    sim->crankUntil(
+        [&sim, nLedgers]()
+        {
+            return sim->haveAllExternalized(nLedgers + 1, nLedgers);
+        },
+        2 * nLedgers * Herder::EXP_LEDGER_TIMESPAN_SECONDS, true);
+
+    REQUIRE(sim->haveAllExternalized(nLedgers + 1, 5));
+}
+
 static void
 hierarchicalTopoTest(int nLedgers, int nBranches, Simulation::Mode mode,
                      Hash const& networkID)
@@ -339,6 +393,95 @@ TEST_CASE("Auto-calibrated single node load test", "[autoload][hide]")
     }
 }
 
+TEST_CASE("Open-loop load generation", "[loadgen]")
+{
+    VirtualClock clock;
+    auto appPtr = newLoadTestApp(clock);
+    auto& app = *appPtr;
+    auto& lg = app.getLoadGenerator();
+    lg.loadAccount(app, lg.mAccounts[0]);
+
+    auto& submitted =
+        app.getMetrics().NewMeter({"loadgen", "tx", "submitted"}, "tx");
+    auto& missed = app.getMetrics().NewMeter({"loadgen", "tx", "missed"}, "tx");
+    auto& latency =
+        app.getMetrics().NewTimer({"loadgen", "latency", "create-account"});
+
+    uint32_t const txRate = 50;
+    auto start = clock.now();
+
+    // Runs one step by hand and cancels the one it schedules, so that the
+    // test decides when the node gets to run the next.
+    auto step = [&]()
+    {
+        lg.generateLoad(app, 100, 10000, txRate, false);
+        lg.mLoadTimer->cancel();
+    };
+    auto waitBuilt = [&]()
+    {
+        while (!lg.allBuilt())
+        {
+            clock.crankUpTo(clock.now());
+        }
+    };
+    auto stall = [&](std::chrono::milliseconds d)
+    {
+        clock.crankUpTo(clock.now() + d);
+    };
+    auto offered = [&]()
+    {
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      clock.now() - start).count();
+        return static_cast<uint64_t>(ms) * txRate / 1000;
+    };
+
+    step();
+    waitBuilt();
+    stall(std::chrono::milliseconds(LoadGenerator::STEP_MSECS));
+    step();
+    waitBuilt();
+    REQUIRE(submitted.count() + missed.count() == offered());
+
+    SECTION("offered rate is held when the node is slow")
+    {
+        // Ten steps' worth of time between two steps: the next one offers
+        // all of it, not one step's worth.
+        auto before = submitted.count() + missed.count();
+        stall(std::chrono::seconds(1));
+        step();
+        REQUIRE(submitted.count() + missed.count() - before == txRate);
+        REQUIRE(submitted.count() + missed.count() == offered());
+    }
+
+    SECTION("transactions not built in time are missed")
+    {
+        // Longer than what is built ahead of the schedule.
+        stall(std::chrono::seconds(5));
+        step();
+        REQUIRE(missed.count() > 0);
+        REQUIRE(submitted.count() + missed.count() == offered());
+
+        // and are not sent later as a burst
+        auto before = submitted.count();
+        waitBuilt();
+        stall(std::chrono::milliseconds(LoadGenerator::STEP_MSECS));
+        step();
+        REQUIRE(submitted.count() - before <=
+                txRate * LoadGenerator::STEP_MSECS / 1000);
+    }
+
+    SECTION("externalized transactions are timed")
+    {
+        auto deadline = clock.now() + std::chrono::seconds(30);
+        while (latency.count() == 0 && clock.now() < deadline)
+        {
+            stall(std::chrono::seconds(1));
+            lg.recordExternalized(app);
+        }
+        REQUIRE(latency.count() > 0);
+    }
+}
+
 class ScaleReporter
 {
     std::vector<std::string> mColumns;
@@ -612,6 +755,129 @@ TEST_CASE("Branched-cycle nodes vs. network traffic", "[scalability][hide]")
         });
 }
 
+static void
+consensusLatencyTest(
+    std::string const& name,
+    std::function<Simulation::pointer(int numNodes, int& cfgCount)> mkSim)
+{
+    ScaleReporter r({name + "nodes", "threads", "latency-ms", "wall-ms"});
+
+    int const nLedgers = 5;
+    for (int numNodes = 10; numNodes <= 100; numNodes += 10)
+    {
+        auto cfgCount = 0;
+        auto sim = mkSim(numNodes, cfgCount);
+        sim->startAllNodes();
+
+        auto tBegin = std::chrono::steady_clock::now();
+        auto vBegin = sim->getClock().now();
+        sim->crankUntil(
+            [&sim]()
+            {
+                return sim->haveAllExternalized(nLedgers + 1, nLedgers);
+            },
+            20 * nLedgers * Herder::EXP_LEDGER_TIMESPAN_SECONDS, false);
+        auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+            sim->getClock().now() - vBegin);
+        auto wall = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - tBegin);
+
+        r.write({(double)numNodes, (double)std::thread::hardware_concurrency(),
+                 (double)latency.count() / nLedgers,
+                 (double)wall.count() / nLedgers});
+        sim->stopAllNodes();
+    }
+}
+
+static Config
+parallelSimConfig(int& cfgCount)
+{
+    Config res = getTestConfig(cfgCount++);
+    res.ARTIFICIALLY_ACCELERATE_TIME_FOR_TESTING = true;
+    res.MAX_PEER_CONNECTIONS = 1000;
+    return res;
+}
+
+TEST_CASE("Mesh nodes vs. consensus latency", "[scalability][hide]")
+{
+    consensusLatencyTest(
+        "mesh", [&](int numNodes, int& cfgCount) -> Simulation::pointer {
+            return Topologies::core(
+                numNodes, 0.67, Simulation::OVER_LOOPBACK_PARALLEL,
+                sha256(fmt::format("nodes-{:d}", numNodes)),
+                [&]() { return parallelSimConfig(cfgCount); });
+        });
+}
+
+TEST_CASE("Cycle nodes vs. consensus latency", "[scalability][hide]")
+{
+    consensusLatencyTest(
+        "cycle", [&](int numNodes, int& cfgCount) -> Simulation::pointer {
+            return Topologies::cycle(
+                numNodes, 1.0, Simulation::OVER_LOOPBACK_PARALLEL,
+                sha256(fmt::format("nodes-{:d}", numNodes)),
+                [&]() { return parallelSimConfig(cfgCount); });
+        });
+}
+
+TEST_CASE("Branched-cycle nodes vs. consensus latency", "[scalability][hide]")
+{
+    consensusLatencyTest(
+        "branchedcycle",
+        [&](int numNodes, int& cfgCount) -> Simulation::pointer {
+            return Topologies::branchedcycle(
+                numNodes, 1.0, Simulation::OVER_LOOPBACK_PARALLEL,
+                sha256(fmt::format("nodes-{:d}", numNodes)),
+                [&]() { return parallelSimConfig(cfgCount); });
+        });
+}
+
+// Runs the simulation described in the topology file named by the
+// SIMULATION_TOPOLOGY environment variable, by default the example one.
+TEST_CASE("WAN topology: ledger close latency and traffic",
+          "[scalability][hide]")
+{
+    char const* env = getenv("SIMULATION_TOPOLOGY");
+    std::string filename =
+        env ? env : "../docs/simulation_topology_example.toml";
+    Hash networkID = sha256(getTestConfig().NETWORK_PASSPHRASE);
+
+    int cfgCount = 0;
+    auto sim = Topologies::fromFile(
+        filename, Simulation::OVER_LOOPBACK_PARALLEL, networkID,
+        [&]() { return parallelSimConfig(cfgCount); });
+    sim->startAllNodes();
+
+    int const nLedgers = 10;
+    auto tBegin = std::chrono::steady_clock::now();
+    auto vBegin = sim->getClock().now();
+    sim->crankUntil(
+        [&sim]()
+        {
+            return sim->haveAllExternalized(nLedgers + 1, nLedgers);
+        },
+        20 * nLedgers * Herder::EXP_LEDGER_TIMESPAN_SECONDS, false);
+    auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+        sim->getClock().now() - vBegin);
+    auto wall = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - tBegin);
+
+    ScaleReporter r({"node", "latency-ms", "wall-ms", "in-byte", "out-byte"});
+    int i = 0;
+    for (auto const& app : sim->getNodes())
+    {
+        auto& inbyte =
+            app->getMetrics().NewMeter({"overlay", "byte", "read"}, "byte");
+        auto& outbyte =
+            app->getMetrics().NewMeter({"overlay", "byte", "write"}, "byte");
+        r.write({(double)i++, (double)latency.count() / nLedgers,
+                 (double)wall.count() / nLedgers, (double)inbyte.count(),
+                 (double)outbyte.count()});
+    }
+    LOG(INFO) << sim->metricsSummary("scp");
+    sim->stopAllNodes();
+}
+
 TEST_CASE("Bucket-list entries vs. write throughput", "[scalability][hide]")
 {
     VirtualClock clock;
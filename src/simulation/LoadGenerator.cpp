@@ -31,6 +31,8 @@
 #include "medida/metrics_registry.h"
 #include "medida/meter.h"
 
+#include <algorithm>
+#include <chrono>
 #include <set>
 #include <iomanip>
 #include <cmath>
@@ -52,6 +54,20 @@ static const uint64_t LOADGEN_TRUSTLINE_LIMIT = 1000 * LOADGEN_ACCOUNT_BALANCE;
 // Units of load are is scheduled at 100ms intervals.
 const uint32_t LoadGenerator::STEP_MSECS = 100;
 
+// Transactions handed to a worker thread at a time.
+const size_t LoadGenerator::BUILD_BATCH_SIZE = 64;
+
+struct LoadGenerator::BuildBatch
+{
+    std::vector<TxInfo> mInfos;
+    std::vector<SequenceNumber> mSeqs;
+    // Written by the worker thread before mDone is set on the main thread.
+    std::vector<std::vector<TransactionFramePtr>> mFrames;
+    bool mDone{false};
+    // Next transaction to submit.
+    size_t mNext{0};
+};
+
 LoadGenerator::LoadGenerator(Hash const& networkID)
     : mMinBalance(0), mLastSecond(0)
 {
@@ -223,12 +239,20 @@ LoadGenerator::clear()
     mAccounts.clear();
     mGateways.clear();
     mMarketMakers.clear();
+    mBuilding.clear();
+    mInFlight.clear();
+    mRateTxRate = 0;
 }
 
 // Generate one "step" worth of load (assuming 1 step per STEP_MSECS) at a
 // given target number of accounts and txs, and a given target tx/s rate.
 // If work remains after the current step, call scheduleLoadGeneration()
 // with the remainder.
+//
+// Load is open-loop: each step submits the transactions the schedule says
+// are due by now, whatever happened to the earlier ones. Transactions are
+// chosen ahead of time here and signed on the worker threads, so that the
+// main thread, shared with the node being loaded, only submits them.
 void
 LoadGenerator::generateLoad(Application& app, uint32_t nAccounts, uint32_t nTxs,
                             uint32_t txRate, bool autoRate)
@@ -237,43 +261,32 @@ LoadGenerator::generateLoad(Application& app, uint32_t nAccounts, uint32_t nTxs,
     app.getDatabase().setCurrentTransactionReadOnly();
 
     updateMinBalance(app);
+    recordExternalized(app);
 
     if (txRate == 0)
     {
         txRate = 1;
     }
 
-    // txRate is "per second"; we're running one "step" worth which is a
-    // fraction of txRate determined by STEP_MSECS. For example if txRate
-    // is 200 and STEP_MSECS is 100, then we want to do 20 tx per step.
-    uint32_t txPerStep = (txRate * STEP_MSECS / 1000);
-
-    // There is a wrinkle here though which is that the tx-apply phase might
-    // well block timers for up to half the close-time; plus we'll be probably
-    // not be scheduled quite as often as we want due to the time it takes to
-    // run and the time the network is exchanging packets. So instead of a naive
-    // calculation based _just_ on target rate and STEP_MSECS, we also adjust
-    // based on how often we seem to be waking up and taking loadgen steps in
-    // reality.
-    auto& stepMeter =
-        app.getMetrics().NewMeter({"loadgen", "step", "count"}, "step");
-    stepMeter.Mark();
-    auto stepsPerSecond = stepMeter.one_minute_rate();
-    if (stepMeter.count() > 10 && stepsPerSecond != 0)
+    auto now = app.getClock().now();
+    if (txRate != mRateTxRate)
     {
-        txPerStep = static_cast<uint32_t>(txRate / stepsPerSecond);
+        mRateStart = now;
+        mRateTxRate = txRate;
+        mRateScheduled = 0;
     }
+    auto sinceStart = std::chrono::duration_cast<std::chrono::microseconds>(
+                          now - mRateStart).count();
+    uint64_t scheduled =
+        static_cast<uint64_t>(sinceStart) * txRate / 1000000;
+    size_t due = static_cast<size_t>(scheduled - mRateScheduled);
+    mRateScheduled = scheduled;
 
-    // If we have a very low tx rate (eg. 2/sec) then the previous division will
-    // be zero and we'll never issue anything; what we need to do instead is
-    // dispatch 1 tx every "few steps" (eg. every 5 steps). We do this by random
-    // choice, weighted to the desired frequency.
-    if (txPerStep == 0)
-    {
-        txPerStep = rand_uniform(0U, 1000U) < (txRate * STEP_MSECS) ? 1 : 0;
-    }
+    auto& stepMeter =
+        app.getMetrics().NewMeter({"loadgen", "step", "count"}, "step");
+    stepMeter.Mark();
 
-    if (txPerStep > nTxs)
+    if (nTxs == 0 && mBuilding.empty())
     {
         // We're done.
         CLOG(INFO, "LoadGen") << "Load generation complete.";
@@ -286,74 +299,34 @@ LoadGenerator::generateLoad(Application& app, uint32_t nAccounts, uint32_t nTxs,
             app.getMetrics().NewTimer({"loadgen", "step", "build"});
         auto& recvTimer =
             app.getMetrics().NewTimer({"loadgen", "step", "recv"});
+        auto& missedMeter =
+            app.getMetrics().NewMeter({"loadgen", "tx", "missed"}, "tx");
 
-        uint32_t ledgerNum = app.getLedgerManager().getLedgerNum();
-        vector<TxInfo> txs;
-
+        // Keep about a second's worth of transactions built ahead of the
+        // schedule.
         auto buildScope = buildTimer.TimeScope();
-        for (uint32_t i = 0; i < txPerStep; ++i)
-        {
-            if (maybeCreateAccount(ledgerNum, txs))
-            {
-                if (nAccounts > 0)
-                {
-                    nAccounts--;
-                }
-            }
-            else
-            {
-                txs.push_back(createRandomTransaction(0.5, ledgerNum));
-                if (nTxs > 0)
-                {
-                    nTxs--;
-                }
-            }
-        }
+        buildAhead(app, nAccounts, nTxs,
+                   due + std::max<size_t>(txRate, BUILD_BATCH_SIZE));
         auto build = buildScope.Stop();
 
         auto recvScope = recvTimer.TimeScope();
-        auto multinode = app.getOverlayManager().getPeers().size() > 1;
-        for (auto& tx : txs)
+        size_t submitted = submitBuilt(app, due);
+        auto recv = recvScope.Stop();
+
+        // Transactions that were not built in time are not made up for
+        // later: that would turn the missed schedule into a burst.
+        if (submitted < due && (nTxs != 0 || !mBuilding.empty()))
         {
-            if (multinode && tx.mFrom != mAccounts[0])
-            {
-                // Reload the from-account if we're in multinode testing;
-                // odds of sequence-number skew due seems to be high enough to
-                // make this worthwhile.
-                loadAccount(app, tx.mFrom);
-            }
-            if (!tx.execute(app))
-            {
-                // Hopefully the rejection was just a bad seq number.
-                std::vector<AccountInfoPtr> accs{tx.mFrom, tx.mTo};
-                if (!tx.mPath.empty())
-                {
-                    accs.insert(accs.end(), tx.mPath.begin(), tx.mPath.end());
-                }
-                for (auto i : accs)
-                {
-                    loadAccount(app, i);
-                    if (i)
-                    {
-                        loadAccount(app, i->mBuyCredit);
-                        loadAccount(app, i->mSellCredit);
-                        for (auto const& tl : i->mTrustLines)
-                        {
-                            loadAccount(app, tl.mIssuer);
-                        }
-                    }
-                }
-            }
+            missedMeter.Mark(due - submitted);
         }
-        auto recv = recvScope.Stop();
 
-        uint64_t now = static_cast<uint64_t>(
+        uint64_t nowSecs = static_cast<uint64_t>(
             VirtualClock::to_time_t(app.getClock().now()));
-        bool secondBoundary = now != mLastSecond;
+        bool secondBoundary = nowSecs != mLastSecond;
 
         if (autoRate && secondBoundary)
         {
-            mLastSecond = now;
+            mLastSecond = nowSecs;
 
             // Automatic tx rate calculation involves taking the temperature
             // of the program and deciding if there's "room" to increase the
@@ -362,6 +335,7 @@ LoadGenerator::generateLoad(Application& app, uint32_t nAccounts, uint32_t nTxs,
             auto& ledgerCloseTimer = m.NewTimer({"ledger", "ledger", "close"});
             auto& ledgerAgeClosedTimer =
                 m.NewTimer({"ledger", "age", "closed"});
+            uint32_t ledgerNum = app.getLedgerManager().getLedgerNum();
 
             if (ledgerNum > 10 && ledgerCloseTimer.count() > 5)
             {
@@ -462,6 +436,206 @@ LoadGenerator::generateLoad(Application& app, uint32_t nAccounts, uint32_t nTxs,
     }
 }
 
+void
+LoadGenerator::buildAhead(Application& app, uint32_t& nAccounts,
+                          uint32_t& nTxs, size_t target)
+{
+    size_t queued = 0;
+    for (auto const& b : mBuilding)
+    {
+        queued += b->mInfos.size() - b->mNext;
+    }
+
+    auto ledgerNum = app.getLedgerManager().getLedgerNum();
+    auto baseFee = app.getConfig().DESIRED_BASE_FEE;
+    auto networkID = app.getNetworkID();
+    auto& signTimer = app.getMetrics().NewTimer({"loadgen", "batch", "sign"});
+    auto& mainIO = app.getClock().getIOService();
+    auto multinode = app.getOverlayManager().getPeers().size() > 1;
+
+    while (queued < target && nTxs > 0)
+    {
+        auto batch = std::make_shared<BuildBatch>();
+        while (batch->mInfos.size() < BUILD_BATCH_SIZE && nTxs > 0)
+        {
+            std::vector<TxInfo> txs;
+            if (maybeCreateAccount(ledgerNum, txs))
+            {
+                if (nAccounts > 0)
+                {
+                    nAccounts--;
+                }
+            }
+            else
+            {
+                txs.push_back(createRandomTransaction(0.5, ledgerNum));
+                nTxs--;
+            }
+            // Sequence numbers are taken here, where account state lives;
+            // the accounts are then charged as if the transaction succeeded.
+            for (auto& tx : txs)
+            {
+                if (multinode && tx.mFrom != mAccounts[0])
+                {
+                    // Reload the from-account if we're in multinode testing;
+                    // odds of sequence-number skew due seems to be high
+                    // enough to make this worthwhile. Transactions built
+                    // ahead are neither in the database nor in the herder
+                    // yet, so never move the sequence number back.
+                    auto seq = tx.mFrom->mSeq;
+                    loadAccount(app, tx.mFrom);
+                    tx.mFrom->mSeq = std::max(seq, tx.mFrom->mSeq);
+                }
+                batch->mSeqs.push_back(tx.mFrom->mSeq + 1);
+                tx.recordExecution(baseFee);
+                batch->mInfos.push_back(tx);
+            }
+        }
+        queued += batch->mInfos.size();
+        mBuilding.push_back(batch);
+
+        TxMetrics txm(app.getMetrics());
+        app.getWorkerIOService().post(
+            [batch, networkID, txm, &signTimer, &mainIO]() mutable
+            {
+                auto signScope = signTimer.TimeScope();
+                batch->mFrames.resize(batch->mInfos.size());
+                for (size_t i = 0; i < batch->mInfos.size(); ++i)
+                {
+                    batch->mInfos[i].toTransactionFrames(
+                        networkID, batch->mSeqs[i], batch->mFrames[i], txm);
+                }
+                signScope.Stop();
+                mainIO.post([batch]()
+                            {
+                                batch->mDone = true;
+                            });
+            });
+    }
+}
+
+bool
+LoadGenerator::allBuilt() const
+{
+    return std::all_of(mBuilding.begin(), mBuilding.end(),
+                       [](std::shared_ptr<BuildBatch> const& b)
+                       {
+                           return b->mDone;
+                       });
+}
+
+size_t
+LoadGenerator::submitBuilt(Application& app, size_t due)
+{
+    TxMetrics txm(app.getMetrics());
+    auto& submittedMeter =
+        app.getMetrics().NewMeter({"loadgen", "tx", "submitted"}, "tx");
+    size_t submitted = 0;
+    while (submitted < due && !mBuilding.empty() && mBuilding.front()->mDone)
+    {
+        auto batch = mBuilding.front();
+        auto i = batch->mNext++;
+        if (batch->mNext == batch->mInfos.size())
+        {
+            mBuilding.pop_front();
+        }
+
+        auto& tx = batch->mInfos[i];
+        auto now = app.getClock().now();
+        if (!tx.submit(app, batch->mFrames[i], txm))
+        {
+            // Hopefully the rejection was just a bad seq number.
+            std::vector<AccountInfoPtr> accs{tx.mFrom, tx.mTo};
+            accs.insert(accs.end(), tx.mPath.begin(), tx.mPath.end());
+            flushBuilding(app, accs);
+            break;
+        }
+        for (auto const& f : batch->mFrames[i])
+        {
+            mInFlight[f->getContentsHash()] = InFlightTx{tx.typeName(), now};
+        }
+        submittedMeter.Mark();
+        ++submitted;
+    }
+    return submitted;
+}
+
+void
+LoadGenerator::flushBuilding(Application& app, std::vector<AccountInfoPtr> accs)
+{
+    // Batches still on the worker threads finish into nothing.
+    for (auto const& b : mBuilding)
+    {
+        for (size_t i = b->mNext; i < b->mInfos.size(); ++i)
+        {
+            accs.push_back(b->mInfos[i].mFrom);
+        }
+    }
+    mBuilding.clear();
+
+    std::sort(accs.begin(), accs.end());
+    accs.erase(std::unique(accs.begin(), accs.end()), accs.end());
+    for (auto i : accs)
+    {
+        loadAccount(app, i);
+        if (i)
+        {
+            loadAccount(app, i->mBuyCredit);
+            loadAccount(app, i->mSellCredit);
+            for (auto const& tl : i->mTrustLines)
+            {
+                loadAccount(app, tl.mIssuer);
+            }
+        }
+    }
+}
+
+void
+LoadGenerator::recordExternalized(Application& app)
+{
+    auto lcl = app.getLedgerManager().getLastClosedLedgerNum();
+    if (mInFlight.empty())
+    {
+        mLastCheckedLedger = lcl;
+        return;
+    }
+
+    auto now = app.getClock().now();
+    for (auto seq = std::max(mLastCheckedLedger + 1, lcl > 8 ? lcl - 8 : 1);
+         seq <= lcl; ++seq)
+    {
+        auto results = TransactionFrame::getTransactionHistoryResults(
+            app.getDatabase(), seq);
+        for (auto const& r : results.results)
+        {
+            auto i = mInFlight.find(r.transactionHash);
+            if (i != mInFlight.end())
+            {
+                app.getMetrics()
+                    .NewTimer({"loadgen", "latency", i->second.mType})
+                    .Update(now - i->second.mSubmitted);
+                mInFlight.erase(i);
+            }
+        }
+    }
+    mLastCheckedLedger = lcl;
+
+    // Forget transactions the network dropped.
+    auto& lost = app.getMetrics().NewMeter({"loadgen", "tx", "lost"}, "tx");
+    for (auto i = mInFlight.begin(); i != mInFlight.end();)
+    {
+        if (now - i->second.mSubmitted > std::chrono::minutes(1))
+        {
+            lost.Mark();
+            i = mInFlight.erase(i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
 void
 LoadGenerator::updateMinBalance(Application& app)
 {
@@ -748,6 +922,7 @@ LoadGenerator::AccountInfo::createDirectly(Application& app)
     LedgerDelta delta(app.getLedgerManager().getCurrentLedgerHeader(),
                       app.getDatabase());;
     a.storeAdd(delta, app.getDatabase());
+    delta.commit();
 }
 
 void
@@ -771,6 +946,7 @@ LoadGenerator::AccountInfo::debitDirectly(Application& app,
     LedgerDelta delta(app.getLedgerManager().getCurrentLedgerHeader(),
                       app.getDatabase());;
     existing->storeChange(delta, app.getDatabase());
+    delta.commit();
 }
 
 void
@@ -885,6 +1061,19 @@ LoadGenerator::TxInfo::execute(Application& app)
     std::vector<TransactionFramePtr> txfs;
     TxMetrics txm(app.getMetrics());
     toTransactionFrames(app.getNetworkID(), txfs, txm);
+    if (!submit(app, txfs, txm))
+    {
+        return false;
+    }
+    recordExecution(app.getConfig().DESIRED_BASE_FEE);
+    return true;
+}
+
+bool
+LoadGenerator::TxInfo::submit(Application& app,
+                              std::vector<TransactionFramePtr> const& txfs,
+                              TxMetrics& txm)
+{
     for (auto f : txfs)
     {
         txm.mTxnAttempted.Mark();
@@ -909,14 +1098,35 @@ LoadGenerator::TxInfo::execute(Application& app)
             return false;
         }
     }
-    recordExecution(app.getConfig().DESIRED_BASE_FEE);
     return true;
 }
 
+std::string
+LoadGenerator::TxInfo::typeName() const
+{
+    switch (mType)
+    {
+    case TX_CREATE_ACCOUNT:
+        return "create-account";
+    case TX_TRANSFER_NATIVE:
+        return "native-payment";
+    default:
+        return mPath.size() > 1 ? "path-payment" : "credit-payment";
+    }
+}
+
 void
 LoadGenerator::TxInfo::toTransactionFrames(
     Hash const& networkID, std::vector<TransactionFramePtr>& txs,
     TxMetrics& txm)
+{
+    toTransactionFrames(networkID, mFrom->mSeq + 1, txs, txm);
+}
+
+void
+LoadGenerator::TxInfo::toTransactionFrames(
+    Hash const& networkID, SequenceNumber seq,
+    std::vector<TransactionFramePtr>& txs, TxMetrics& txm)
 {
     switch (mType)
     {
@@ -928,7 +1138,7 @@ LoadGenerator::TxInfo::toTransactionFrames(
 
             e.tx.sourceAccount = mFrom->mKey.getPublicKey();
             signingAccounts.insert(mFrom);
-            e.tx.seqNum = mFrom->mSeq + 1;
+            e.tx.seqNum = seq;
 
             // Add a CREATE_ACCOUNT op
             Operation createOp;
@@ -1008,7 +1218,7 @@ LoadGenerator::TxInfo::toTransactionFrames(
         txm.mPayment.Mark();
         txm.mNativePayment.Mark();
         txs.push_back(txtest::createPaymentTx(networkID, mFrom->mKey, mTo->mKey,
-                                              mFrom->mSeq + 1, mAmount));
+                                              seq, mAmount));
         break;
 
     case TxInfo::TX_TRANSFER_CREDIT:
@@ -1027,7 +1237,7 @@ LoadGenerator::TxInfo::toTransactionFrames(
             txm.mCreditPayment.Mark();
             txs.emplace_back(txtest::createCreditPaymentTx(
                 networkID, mFrom->mKey, mTo->mKey.getPublicKey(), assetPath.front(),
-                mFrom->mSeq + 1, mAmount));
+                seq, mAmount));
         }
         else
         {
@@ -1051,7 +1261,7 @@ LoadGenerator::TxInfo::toTransactionFrames(
             auto sendMax = mAmount * 10;
             txs.emplace_back(txtest::createPathPaymentTx(
                 networkID, mFrom->mKey, mTo->mKey.getPublicKey(), sendAsset, sendMax,
-                recvAsset, mAmount, mFrom->mSeq + 1, assetPath));
+                recvAsset, mAmount, seq, assetPath));
         }
     }
     break;
@@ -7,7 +7,10 @@
 #include "main/Application.h"
 #include "crypto/SecretKey.h"
 #include "test/TxTests.h"
+#include "util/Timer.h"
 #include "xdr/Stellar-types.h"
+#include <deque>
+#include <map>
 #include <vector>
 
 namespace medida
@@ -21,8 +24,6 @@ class Timer;
 namespace stellar
 {
 
-class VirtualTimer;
-
 class LoadGenerator
 {
   public:
@@ -36,6 +37,7 @@ class LoadGenerator
 
     static std::string pickRandomAsset();
     static const uint32_t STEP_MSECS;
+    static const size_t BUILD_BATCH_SIZE;
 
     // Primary store of accounts.
     std::vector<AccountInfoPtr> mAccounts;
@@ -50,6 +52,26 @@ class LoadGenerator
     int64 mMinBalance;
     uint64_t mLastSecond;
 
+    // Transactions chosen on the main thread, in submission order, and built
+    // and signed ahead of time on the worker threads.
+    struct BuildBatch;
+    std::deque<std::shared_ptr<BuildBatch>> mBuilding;
+
+    // Open-loop schedule: at mRateTxRate tx/s since mRateStart, of which
+    // mRateScheduled are already past due.
+    VirtualClock::time_point mRateStart;
+    uint32_t mRateTxRate{0};
+    uint64_t mRateScheduled{0};
+
+    // Submitted transactions not yet seen in a closed ledger, by hash.
+    struct InFlightTx
+    {
+        std::string mType;
+        VirtualClock::time_point mSubmitted;
+    };
+    std::map<Hash, InFlightTx> mInFlight;
+    uint32_t mLastCheckedLedger{0};
+
     // Schedule a callback to generateLoad() STEP_MSECS miliseconds from now.
     void scheduleLoadGeneration(Application& app, uint32_t nAccounts,
                                 uint32_t nTxs, uint32_t txRate, bool autoRate);
@@ -61,6 +83,25 @@ class LoadGenerator
     void generateLoad(Application& app, uint32_t nAccounts, uint32_t nTxs,
                       uint32_t txRate, bool autoRate);
 
+    // Chooses transactions until `target` are waiting to be submitted, and
+    // hands them to the worker threads to build and sign.
+    void buildAhead(Application& app, uint32_t& nAccounts, uint32_t& nTxs,
+                    size_t target);
+
+    // Whether the worker threads are done with every batch handed to them.
+    bool allBuilt() const;
+
+    // Submits up to `due` built transactions, in order; returns how many.
+    size_t submitBuilt(Application& app, size_t due);
+
+    // Drops every transaction not submitted yet and reloads the accounts
+    // involved, after a rejection left their sequence numbers unknown.
+    void flushBuilding(Application& app, std::vector<AccountInfoPtr> accs);
+
+    // Records submit-to-externalize latency of the transactions in ledgers
+    // closed since the last call.
+    void recordExternalized(Application& app);
+
     bool maybeCreateAccount(uint32_t ledgerNum, std::vector<TxInfo>& txs);
 
     std::vector<TxInfo> accountCreationTransactions(size_t n);
@@ -169,10 +210,20 @@ class LoadGenerator
 
         void touchAccounts(uint32_t ledger);
         bool execute(Application& app);
+        bool submit(Application& app,
+                    std::vector<TransactionFramePtr> const& txs,
+                    TxMetrics& metrics);
+        std::string typeName() const;
 
         void toTransactionFrames(Hash const& networkID,
                                  std::vector<TransactionFramePtr>& txs,
                                  TxMetrics& metrics);
+        // Same, with the source account's sequence number taken by the
+        // caller; does not read mutable account state, so it can run off the
+        // main thread.
+        void toTransactionFrames(Hash const& networkID, SequenceNumber seq,
+                                 std::vector<TransactionFramePtr>& txs,
+                                 TxMetrics& metrics);
         void recordExecution(int64_t baseFee);
     };
 };
@@ -10,13 +10,16 @@
 #include "main/test.h"
 #include "overlay/OverlayManager.h"
 #include "overlay/PeerRecord.h"
+#include "util/GlobalChecks.h"
 #include "util/Logging.h"
 #include "util/Math.h"
+#include "util/make_unique.h"
 #include "util/types.h"
 
 #include "medida/medida.h"
 #include "medida/reporting/console_reporter.h"
 
+#include <algorithm>
 #include <thread>
 
 namespace stellar
@@ -32,12 +35,15 @@ Simulation::Simulation(Mode mode, Hash const& networkID,
     , mMode(mode)
     , mConfigCount(0)
     , mConfigGen(confGen)
+    , mNumThreads(std::thread::hardware_concurrency())
+    , mEpochLength(std::chrono::milliseconds(10))
 {
     mIdleApp = Application::create(mClock, newConfig());
 }
 
 Simulation::~Simulation()
 {
+    stopThreads();
 
     // tear down
     mClock.getIOService().poll_one();
@@ -67,11 +73,23 @@ Simulation::addNode(SecretKey nodeKey, SCPQuorumSet qSet, VirtualClock& clock,
     }
     cfg->NODE_SEED = nodeKey;
     cfg->QUORUM_SET = qSet;
-    cfg->RUN_STANDALONE = (mMode == OVER_LOOPBACK);
-
-    Application::pointer result = Application::create(clock, *cfg, newDB);
+    cfg->RUN_STANDALONE = isLoopback();
 
     NodeID nodeID = nodeKey.getPublicKey();
+    VirtualClock* nodeClock = &clock;
+    if (mMode == OVER_LOOPBACK_PARALLEL)
+    {
+        auto& c = mNodeClocks[nodeID];
+        if (!c)
+        {
+            c = make_unique<VirtualClock>(VirtualClock::VIRTUAL_TIME);
+            c->setCurrentTime(mClock.now());
+        }
+        nodeClock = c.get();
+    }
+
+    Application::pointer result = Application::create(*nodeClock, *cfg, newDB);
+
     mConfigs[nodeID] = cfg;
     mNodes[nodeID] = result;
 
@@ -102,15 +120,45 @@ Simulation::getNodeIDs()
 
 void
 Simulation::addPendingConnection(NodeID const& initiator,
-                                 NodeID const& acceptor)
+                                 NodeID const& acceptor,
+                                 LinkConditions const& link)
 {
     mPendingConnections.push_back(std::make_pair(initiator, acceptor));
+    setLinkConditions(initiator, acceptor, link);
+}
+
+void
+Simulation::setLinkConditions(NodeID const& initiator, NodeID const& acceptor,
+                              LinkConditions const& link)
+{
+    mLinkConditions[std::make_pair(initiator, acceptor)] = link;
+}
+
+void
+Simulation::setParallelism(size_t nThreads, VirtualClock::duration epoch)
+{
+    if (mMode != OVER_LOOPBACK_PARALLEL || !mThreads.empty())
+    {
+        throw runtime_error("Cannot set the parallelism of this simulation");
+    }
+    if (epoch <= VirtualClock::duration::zero())
+    {
+        throw runtime_error("Simulation epochs must be positive");
+    }
+    mNumThreads = nThreads;
+    mEpochLength = epoch;
+}
+
+bool
+Simulation::isLoopback() const
+{
+    return mMode == OVER_LOOPBACK || mMode == OVER_LOOPBACK_PARALLEL;
 }
 
 void
 Simulation::addConnection(NodeID initiator, NodeID acceptor)
 {
-    if (mMode == OVER_LOOPBACK)
+    if (isLoopback())
         addLoopbackConnection(initiator, acceptor);
     else
         addTCPConnection(initiator, acceptor);
@@ -123,6 +171,17 @@ Simulation::addLoopbackConnection(NodeID initiator, NodeID acceptor)
     {
         auto conn = std::make_shared<LoopbackPeerConnection>(
             *getNode(initiator), *getNode(acceptor));
+        auto link = mLinkConditions.find(std::make_pair(initiator, acceptor));
+        for (auto peer : {conn->getInitiator(), conn->getAcceptor()})
+        {
+            if (link != mLinkConditions.end())
+            {
+                peer->setLatency(link->second.mLatency, link->second.mJitter);
+                peer->setBandwidth(link->second.mBandwidth);
+                peer->setLossProbability(link->second.mLossProbability);
+            }
+            peer->setHoldDeliveries(mMode == OVER_LOOPBACK_PARALLEL);
+        }
         mLoopbackConnections.push_back(conn);
     }
 }
@@ -159,6 +218,166 @@ Simulation::startAllNodes()
         addConnection(pair.first, pair.second);
     }
     mPendingConnections.clear();
+
+    if (mMode == OVER_LOOPBACK_PARALLEL && mThreads.empty())
+    {
+        startThreads();
+    }
+}
+
+void
+Simulation::startThreads()
+{
+    size_t n = std::max<size_t>(1, std::min(mNumThreads, mNodeClocks.size()));
+    mThreadClocks.assign(n, {});
+    size_t i = 0;
+    for (auto const& c : mNodeClocks)
+    {
+        mThreadClocks[i++ % n].push_back(c.second.get());
+    }
+    for (i = 0; i < n; ++i)
+    {
+        mThreads.emplace_back([this, i]()
+                              {
+                                  runThread(i);
+                              });
+    }
+    LOG(INFO) << "Simulating " << mNodeClocks.size() << " nodes on " << n
+              << " threads";
+}
+
+void
+Simulation::stopThreads()
+{
+    {
+        std::lock_guard<std::mutex> lock(mEpochMutex);
+        mStopping = true;
+    }
+    mEpochStarted.notify_all();
+    for (auto& t : mThreads)
+    {
+        t.join();
+    }
+    mThreads.clear();
+}
+
+void
+Simulation::runThread(size_t i)
+{
+    markThreadAsMain();
+    gRandomEngine.seed(static_cast<unsigned int>(i + 1));
+
+    uint64_t epoch = 0;
+    for (;;)
+    {
+        VirtualClock::time_point end;
+        {
+            std::unique_lock<std::mutex> lock(mEpochMutex);
+            mEpochStarted.wait(lock, [&]()
+                               {
+                                   return mStopping || mEpoch != epoch;
+                               });
+            if (mStopping)
+            {
+                return;
+            }
+            epoch = mEpoch;
+            end = mEpochEnd;
+        }
+
+        size_t nWorkDone = 0;
+        std::exception_ptr error;
+        try
+        {
+            for (auto c : mThreadClocks[i])
+            {
+                if (!c->getIOService().stopped())
+                {
+                    nWorkDone += c->crankUpTo(end);
+                }
+            }
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mEpochMutex);
+            mEpochWork += nWorkDone;
+            if (error && !mThreadError)
+            {
+                mThreadError = error;
+            }
+            if (++mThreadsDone == mThreadClocks.size())
+            {
+                mEpochDone.notify_one();
+            }
+        }
+    }
+}
+
+size_t
+Simulation::crankEpoch()
+{
+    // The node threads are waiting for the next epoch: deliver the messages
+    // sent during the last one.
+    size_t released = 0;
+    for (auto const& conn : mLoopbackConnections)
+    {
+        released += conn->getInitiator()->releaseHeld();
+        released += conn->getAcceptor()->releaseHeld();
+    }
+
+    bool running = false;
+    auto next = mClock.next();
+    for (auto const& c : mNodeClocks)
+    {
+        if (!c.second->getIOService().stopped())
+        {
+            running = true;
+            next = std::min(next, c.second->next());
+        }
+    }
+    if (!running && !mNodeClocks.empty())
+    {
+        return 0;
+    }
+
+    auto end = mClock.now() + mEpochLength;
+    if (released == 0 && next > end && next != VirtualClock::time_point::max())
+    {
+        // nothing in flight: skip to the next timer, as crank() does when
+        // idle
+        end = next;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mEpochMutex);
+        mEpochEnd = end;
+        mThreadsDone = 0;
+        mEpochWork = 0;
+        ++mEpoch;
+    }
+    mEpochStarted.notify_all();
+
+    size_t nWorkDone = released;
+    {
+        std::unique_lock<std::mutex> lock(mEpochMutex);
+        mEpochDone.wait(lock, [this]()
+                        {
+                            return mThreadsDone == mThreadClocks.size();
+                        });
+        nWorkDone += mEpochWork;
+        if (mThreadError)
+        {
+            auto error = mThreadError;
+            mThreadError = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    return nWorkDone + mClock.crankUpTo(end);
 }
 
 void
@@ -183,7 +402,14 @@ Simulation::crankAllNodes(int nbTicks)
         {
             return 0;
         }
-        count += mClock.crank(false);
+        if (mMode == OVER_LOOPBACK_PARALLEL)
+        {
+            count += crankEpoch();
+        }
+        else
+        {
+            count += mClock.crank(false);
+        }
     }
     return count;
 }
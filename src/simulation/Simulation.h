@@ -16,6 +16,11 @@
 #include "xdr/Stellar-types.h"
 #include "simulation/LoadGenerator.h"
 
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
 #define SIMULATION_CREATE_NODE(N)                                              \
     const Hash v##N##VSeed = sha256("NODE_SEED_" #N);                          \
     const SecretKey v##N##SecretKey = SecretKey::fromSeed(v##N##VSeed);        \
@@ -32,24 +37,52 @@ class Simulation : public LoadGenerator
     enum Mode
     {
         OVER_TCP,
-        OVER_LOOPBACK
+        OVER_LOOPBACK,
+        // Loopback, with each node on a clock of its own, and the nodes
+        // cranked by a pool of threads in epochs of virtual time: all clocks
+        // advance to the end of an epoch, then the messages sent during it
+        // are delivered, so a message sent at t is received at the end of the
+        // epoch holding t, or later if the link has a latency (messages are
+        // then on time as long as epochs are no longer than the smallest
+        // latency). Nodes and connections should be added before
+        // startAllNodes(), which starts the threads; between two calls to
+        // crankAllNodes() the threads are stopped and nodes may be accessed.
+        OVER_LOOPBACK_PARALLEL
     };
 
     typedef std::shared_ptr<Simulation> pointer;
 
+    // Network conditions of a loopback connection, in both directions; see
+    // LoopbackPeer::setLatency().
+    struct LinkConditions
+    {
+        VirtualClock::duration mLatency{0};
+        VirtualClock::duration mJitter{0};
+        uint64_t mBandwidth{0}; // bytes per second, 0 for no limit
+        double mLossProbability{0.0};
+    };
+
     Simulation(Mode mode, Hash const& networkID,
                std::function<Config()> confGen = nullptr);
     ~Simulation();
 
     VirtualClock& getClock();
 
+    // in OVER_LOOPBACK_PARALLEL mode, `clock` is ignored and the node gets
+    // a clock of its own
     NodeID addNode(SecretKey nodeKey, SCPQuorumSet qSet, VirtualClock& clock,
                    Config const* cfg = nullptr, bool newDB = true);
     Application::pointer getNode(NodeID nodeID);
     std::vector<Application::pointer> getNodes();
     std::vector<NodeID> getNodeIDs();
 
-    void addPendingConnection(NodeID const& initiator, NodeID const& acceptor);
+    void addPendingConnection(NodeID const& initiator, NodeID const& acceptor,
+                              LinkConditions const& link = LinkConditions());
+
+    // OVER_LOOPBACK_PARALLEL only, before startAllNodes(): number of threads
+    // (default: one per core, at most one per node) and length of an epoch,
+    // which bounds the latency added to messages (default: 10ms).
+    void setParallelism(size_t nThreads, VirtualClock::duration epoch);
     void startAllNodes();
     void stopAllNodes();
 
@@ -78,21 +111,48 @@ class Simulation : public LoadGenerator
     std::string metricsSummary(std::string domain = "");
 
     void addConnection(NodeID initiator, NodeID acceptor);
+    void setLinkConditions(NodeID const& initiator, NodeID const& acceptor,
+                           LinkConditions const& link);
 
   private:
     void addLoopbackConnection(NodeID initiator, NodeID acceptor);
     void addTCPConnection(NodeID initiator, NodeID acception);
 
+    bool isLoopback() const;
+    void startThreads();
+    void stopThreads();
+    void runThread(size_t i);
+    size_t crankEpoch();
+
     VirtualClock mClock;
     Mode mMode;
     int mConfigCount;
     Application::pointer mIdleApp;
     std::map<NodeID, Config::pointer> mConfigs;
+    // declared before mNodes, which refer to them
+    std::map<NodeID, std::unique_ptr<VirtualClock>> mNodeClocks;
     std::map<NodeID, Application::pointer> mNodes;
     std::vector<std::pair<NodeID, NodeID>> mPendingConnections;
+    std::map<std::pair<NodeID, NodeID>, LinkConditions> mLinkConditions;
     std::vector<std::shared_ptr<LoopbackPeerConnection>> mLoopbackConnections;
 
     Config newConfig();                 // generates a new config
     std::function<Config()> mConfigGen; // config generator
+
+    // OVER_LOOPBACK_PARALLEL: clocks cranked by each thread, and the epoch
+    // they are cranked up to, handed over under mEpochMutex
+    size_t mNumThreads;
+    VirtualClock::duration mEpochLength;
+    std::vector<std::vector<VirtualClock*>> mThreadClocks;
+    std::vector<std::thread> mThreads;
+    std::mutex mEpochMutex;
+    std::condition_variable mEpochStarted;
+    std::condition_variable mEpochDone;
+    uint64_t mEpoch{0};
+    VirtualClock::time_point mEpochEnd;
+    size_t mThreadsDone{0};
+    size_t mEpochWork{0};
+    bool mStopping{false};
+    std::exception_ptr mThreadError;
 };
 }
@@ -4,11 +4,57 @@
 
 #include "simulation/Topologies.h"
 #include "crypto/SHA.h"
+#include "lib/util/cpptoml.h"
 
 namespace stellar
 {
 using namespace std;
 
+static string
+topologyString(cpptoml::toml_group const& g, string const& key)
+{
+    if (!g.contains(key) || !g.get(key)->as<string>())
+    {
+        throw invalid_argument("missing " + key + " in topology file");
+    }
+    return g.get(key)->as<string>()->value();
+}
+
+static double
+topologyNumber(cpptoml::toml_group const& g, string const& key, double def)
+{
+    if (!g.contains(key))
+    {
+        return def;
+    }
+    auto v = g.get(key);
+    double d;
+    if (v->as<int64_t>())
+    {
+        d = static_cast<double>(v->as<int64_t>()->value());
+    }
+    else if (v->as<double>())
+    {
+        d = v->as<double>()->value();
+    }
+    else
+    {
+        throw invalid_argument("invalid " + key + " in topology file");
+    }
+    if (d < 0)
+    {
+        throw invalid_argument("negative " + key + " in topology file");
+    }
+    return d;
+}
+
+static VirtualClock::duration
+topologyMilliseconds(cpptoml::toml_group const& g, string const& key)
+{
+    return chrono::duration_cast<VirtualClock::duration>(
+        chrono::duration<double, milli>(topologyNumber(g, key, 0)));
+}
+
 Simulation::pointer
 Topologies::pair(Simulation::Mode mode, Hash const& networkID,
                  std::function<Config()> confGen)
@@ -239,6 +285,100 @@ Simulation::pointer Topologies::hierarchicalQuorum(
     return sim;
 }
 
+Simulation::pointer
+Topologies::fromFile(string const& filename, Simulation::Mode mode,
+                     Hash const& networkID, function<Config()> confGen)
+{
+    auto g = cpptoml::parse_file(filename);
+    auto nodes = g.get_group_array("NODE");
+    if (!nodes || nodes->array().empty())
+    {
+        throw invalid_argument("no NODE in topology file " + filename);
+    }
+
+    auto keyOf = [](string const& name)
+    {
+        return SecretKey::fromSeed(sha256("NODE_SEED_" + name));
+    };
+    map<string, NodeID> ids;
+    for (auto const& n : nodes->array())
+    {
+        auto name = topologyString(*n, "NAME");
+        if (!ids.emplace(name, keyOf(name).getPublicKey()).second)
+        {
+            throw invalid_argument("node " + name +
+                                   " defined twice in topology file");
+        }
+    }
+    auto idOf = [&ids](string const& name)
+    {
+        auto i = ids.find(name);
+        if (i == ids.end())
+        {
+            throw invalid_argument("unknown node " + name +
+                                   " in topology file");
+        }
+        return i->second;
+    };
+
+    Simulation::pointer simulation =
+        make_shared<Simulation>(mode, networkID, confGen);
+
+    for (auto const& n : nodes->array())
+    {
+        auto name = topologyString(*n, "NAME");
+        auto validators = n->get_array("VALIDATORS");
+        if (!validators || validators->array().empty())
+        {
+            throw invalid_argument("missing VALIDATORS for node " + name +
+                                   " in topology file");
+        }
+        SCPQuorumSet qSet;
+        for (auto const& v : validators->array())
+        {
+            if (!v->as<string>())
+            {
+                throw invalid_argument("invalid VALIDATORS for node " + name +
+                                       " in topology file");
+            }
+            qSet.validators.push_back(idOf(v->as<string>()->value()));
+        }
+        auto percent = static_cast<size_t>(
+            topologyNumber(*n, "THRESHOLD_PERCENT", 67));
+        if (percent == 0 || percent > 100)
+        {
+            throw invalid_argument("invalid THRESHOLD_PERCENT for node " +
+                                   name + " in topology file");
+        }
+        // round up, as for QUORUM_SET
+        qSet.threshold =
+            uint32(1 + (qSet.validators.size() * percent - 1) / 100);
+        simulation->addNode(keyOf(name), qSet, simulation->getClock());
+    }
+
+    auto links = g.get_group_array("LINK");
+    if (links)
+    {
+        for (auto const& l : links->array())
+        {
+            Simulation::LinkConditions link;
+            link.mLatency = topologyMilliseconds(*l, "LATENCY_MS");
+            link.mJitter = topologyMilliseconds(*l, "JITTER_MS");
+            link.mBandwidth = static_cast<uint64_t>(
+                topologyNumber(*l, "BANDWIDTH_KBPS", 0) * 1000 / 8);
+            link.mLossProbability = topologyNumber(*l, "LOSS", 0);
+            if (link.mLossProbability > 1)
+            {
+                throw invalid_argument("invalid LOSS in topology file");
+            }
+            simulation->addPendingConnection(idOf(topologyString(*l, "FROM")),
+                                             idOf(topologyString(*l, "TO")),
+                                             link);
+        }
+    }
+    return simulation;
+}
+
 Simulation::pointer
 Topologies::hierarchicalQuorumSimplified(int coreSize, int nbOuterNodes,
                                          Simulation::Mode mode,
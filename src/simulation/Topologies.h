@@ -44,6 +44,13 @@ class Topologies
     hierarchicalQuorum(int nBranches, Simulation::Mode mode,
                        Hash const& networkID,
                        std::function<Config()> confGen = nullptr);
+    // Reads nodes, their quorum sets and the connections between them, with
+    // their network conditions, from a TOML file; see
+    // docs/simulation_topology_example.toml.
+    static Simulation::pointer
+    fromFile(std::string const& filename, Simulation::Mode mode,
+             Hash const& networkID, std::function<Config()> confGen = nullptr);
+
     static Simulation::pointer
     hierarchicalQuorumSimplified(int coreSize, int nbOuterNodes,
                                  Simulation::Mode mode, Hash const& networkID,
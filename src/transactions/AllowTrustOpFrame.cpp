@@ -25,6 +25,24 @@ AllowTrustOpFrame::getNeededThreshold() const
     return mSourceAccount->getLowThreshold();
 }
 
+Asset
+AllowTrustOpFrame::getAsset() const
+{
+    Asset ci;
+    ci.type(mAllowTrust.asset.type());
+    if (mAllowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM4)
+    {
+        ci.alphaNum4().assetCode = mAllowTrust.asset.assetCode4();
+        ci.alphaNum4().issuer = getSourceID();
+    }
+    else if (mAllowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM12)
+    {
+        ci.alphaNum12().assetCode = mAllowTrust.asset.assetCode12();
+        ci.alphaNum12().issuer = getSourceID();
+    }
+    return ci;
+}
+
 bool
 AllowTrustOpFrame::doApply(Application& app, LedgerDelta& delta,
                            LedgerManager& ledgerManager)
@@ -46,18 +64,7 @@ AllowTrustOpFrame::doApply(Application& app, LedgerDelta& delta,
         return false;
     }
 
-    Asset ci;
-    ci.type(mAllowTrust.asset.type());
-    if (mAllowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM4)
-    {
-        ci.alphaNum4().assetCode = mAllowTrust.asset.assetCode4();
-        ci.alphaNum4().issuer = getSourceID();
-    }
-    else if (mAllowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM12)
-    {
-        ci.alphaNum12().assetCode = mAllowTrust.asset.assetCode12();
-        ci.alphaNum12().issuer = getSourceID();
-    }
+    Asset ci = getAsset();
 
     Database& db = ledgerManager.getDatabase();
     TrustFrame::pointer trustLine;
@@ -93,18 +100,7 @@ AllowTrustOpFrame::doCheckValid(Application& app)
         innerResult().code(ALLOW_TRUST_MALFORMED);
         return false;
     }
-    Asset ci;
-    ci.type(mAllowTrust.asset.type());
-    if (mAllowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM4)
-    {
-        ci.alphaNum4().assetCode = mAllowTrust.asset.assetCode4();
-        ci.alphaNum4().issuer = getSourceID();
-    }
-    else if (mAllowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM12)
-    {
-        ci.alphaNum12().assetCode = mAllowTrust.asset.assetCode12();
-        ci.alphaNum12().issuer = getSourceID();
-    }
+    Asset ci = getAsset();
 
     if (!isAssetValid(ci))
     {
@@ -117,4 +113,16 @@ AllowTrustOpFrame::doCheckValid(Application& app)
 
     return true;
 }
+
+bool
+AllowTrustOpFrame::getFootprint(std::vector<LedgerKey>& reads,
+                                std::vector<LedgerKey>& writes) const
+{
+    reads.emplace_back(accountKey(getSourceID()));
+    if (mAllowTrust.asset.type() != ASSET_TYPE_NATIVE)
+    {
+        writes.emplace_back(trustLineKey(mAllowTrust.trustor, getAsset()));
+    }
+    return true;
+}
 }
@@ -19,6 +19,9 @@ class AllowTrustOpFrame : public OperationFrame
 
     AllowTrustOp const& mAllowTrust;
 
+    // the asset of the trust line, issued by the source account
+    Asset getAsset() const;
+
   public:
     AllowTrustOpFrame(Operation const& op, OperationResult& res,
                       TransactionFrame& parentTx);
@@ -26,6 +29,8 @@ class AllowTrustOpFrame : public OperationFrame
     bool doApply(Application& app, LedgerDelta& delta,
                  LedgerManager& ledgerManager) override;
     bool doCheckValid(Application& app) override;
+    bool getFootprint(std::vector<LedgerKey>& reads,
+                      std::vector<LedgerKey>& writes) const override;
 
     static AllowTrustResultCode
     getInnerCode(OperationResult const& res)
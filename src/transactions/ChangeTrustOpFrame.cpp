@@ -130,4 +130,19 @@ ChangeTrustOpFrame::doCheckValid(Application& app)
     }
     return true;
 }
+
+bool
+ChangeTrustOpFrame::getFootprint(std::vector<LedgerKey>& reads,
+                                 std::vector<LedgerKey>& writes) const
+{
+    // the number of sub entries of the source account changes with its
+    // trust lines
+    writes.emplace_back(accountKey(getSourceID()));
+    if (mChangeTrust.line.type() != ASSET_TYPE_NATIVE)
+    {
+        reads.emplace_back(accountKey(getIssuer(mChangeTrust.line)));
+        writes.emplace_back(trustLineKey(getSourceID(), mChangeTrust.line));
+    }
+    return true;
+}
 }
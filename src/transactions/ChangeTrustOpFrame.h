@@ -24,6 +24,8 @@ class ChangeTrustOpFrame : public OperationFrame
     bool doApply(Application& app, LedgerDelta& delta,
                  LedgerManager& ledgerManager) override;
     bool doCheckValid(Application& app) override;
+    bool getFootprint(std::vector<LedgerKey>& reads,
+                      std::vector<LedgerKey>& writes) const override;
 
     static ChangeTrustResultCode
     getInnerCode(OperationResult const& res)
@@ -113,4 +113,13 @@ CreateAccountOpFrame::doCheckValid(Application& app)
 
     return true;
 }
+
+bool
+CreateAccountOpFrame::getFootprint(std::vector<LedgerKey>& reads,
+                                   std::vector<LedgerKey>& writes) const
+{
+    writes.emplace_back(accountKey(getSourceID()));
+    writes.emplace_back(accountKey(mCreateAccount.destination));
+    return true;
+}
 }
@@ -25,6 +25,8 @@ class CreateAccountOpFrame : public OperationFrame
     bool doApply(Application& app, LedgerDelta& delta,
                  LedgerManager& ledgerManager) override;
     bool doCheckValid(Application& app) override;
+    bool getFootprint(std::vector<LedgerKey>& reads,
+                      std::vector<LedgerKey>& writes) const override;
 
     static CreateAccountResultCode
     getInnerCode(OperationResult const& res)
@@ -114,4 +114,16 @@ ManageDataOpFrame::doCheckValid(Application& app)
     return true;
 }
 
+bool
+ManageDataOpFrame::getFootprint(std::vector<LedgerKey>& reads,
+                                std::vector<LedgerKey>& writes) const
+{
+    writes.emplace_back(accountKey(getSourceID()));
+    LedgerKey key;
+    key.type(DATA);
+    key.data().accountID = getSourceID();
+    key.data().dataName = mManageData.dataName;
+    writes.emplace_back(key);
+    return true;
+}
 }
@@ -29,6 +29,8 @@ class ManageDataOpFrame : public OperationFrame
     bool doApply(Application& app, LedgerDelta& delta,
                  LedgerManager& ledgerManager) override;
     bool doCheckValid(Application& app) override;
+    bool getFootprint(std::vector<LedgerKey>& reads,
+                      std::vector<LedgerKey>& writes) const override;
 
     static ManageDataResultCode
     getInnerCode(OperationResult const& res)
@@ -401,6 +401,27 @@ ManageOfferOpFrame::doCheckValid(Application& app)
     return true;
 }
 
+bool
+ManageOfferOpFrame::getFootprint(std::vector<LedgerKey>& reads,
+                                 std::vector<LedgerKey>& writes) const
+{
+    // the offers crossed depend on the order book, only the source's own
+    // entries are known
+    writes.emplace_back(accountKey(getSourceID()));
+    for (auto const& asset : {mManageOffer.selling, mManageOffer.buying})
+    {
+        if (asset.type() != ASSET_TYPE_NATIVE)
+        {
+            reads.emplace_back(accountKey(getIssuer(asset)));
+            if (!(getIssuer(asset) == getSourceID()))
+            {
+                writes.emplace_back(trustLineKey(getSourceID(), asset));
+            }
+        }
+    }
+    return false;
+}
+
 OfferEntry
 ManageOfferOpFrame::buildOffer(AccountID const& account,
                                ManageOfferOp const& op, uint32 flags)
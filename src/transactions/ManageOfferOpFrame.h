@@ -41,6 +41,8 @@ class ManageOfferOpFrame : public OperationFrame
     bool doApply(Application& app, LedgerDelta& delta,
                  LedgerManager& ledgerManager) override;
     bool doCheckValid(Application& app) override;
+    bool getFootprint(std::vector<LedgerKey>& reads,
+                      std::vector<LedgerKey>& writes) const override;
 
     static ManageOfferResultCode
     getInnerCode(OperationResult const& res)
@@ -91,4 +91,14 @@ MergeOpFrame::doCheckValid(Application& app)
     }
     return true;
 }
+
+bool
+MergeOpFrame::getFootprint(std::vector<LedgerKey>& reads,
+                           std::vector<LedgerKey>& writes) const
+{
+    // the source account can only be merged without sub entries left
+    writes.emplace_back(accountKey(getSourceID()));
+    writes.emplace_back(accountKey(mOperation.body.destination()));
+    return true;
+}
 }
@@ -94,6 +94,32 @@ OperationFrame::getNeededThreshold() const
     return mSourceAccount->getMediumThreshold();
 }
 
+bool
+OperationFrame::getFootprint(std::vector<LedgerKey>& reads,
+                             std::vector<LedgerKey>& writes) const
+{
+    return false;
+}
+
+LedgerKey
+OperationFrame::accountKey(AccountID const& accountID)
+{
+    LedgerKey key;
+    key.type(ACCOUNT);
+    key.account().accountID = accountID;
+    return key;
+}
+
+LedgerKey
+OperationFrame::trustLineKey(AccountID const& accountID, Asset const& asset)
+{
+    LedgerKey key;
+    key.type(TRUSTLINE);
+    key.trustLine().accountID = accountID;
+    key.trustLine().asset = asset;
+    return key;
+}
+
 bool
 OperationFrame::checkSignature() const
 {
@@ -38,6 +38,10 @@ class OperationFrame
                          LedgerManager& ledgerManager) = 0;
     virtual int32_t getNeededThreshold() const;
 
+    static LedgerKey accountKey(AccountID const& accountID);
+    static LedgerKey trustLineKey(AccountID const& accountID,
+                                  Asset const& asset);
+
   public:
     static std::shared_ptr<OperationFrame>
     makeHelper(Operation const& op, OperationResult& res,
@@ -79,6 +83,14 @@ class OperationFrame
 
     bool apply(LedgerDelta& delta, Application& app);
 
+    // Adds the keys of the ledger entries applying the operation may read to
+    // `reads`, and of those it may change to `writes`. Returns false when
+    // they can't be known ahead of applying it, as for operations crossing
+    // offers, whose sellers depend on the order book; the keys added then
+    // are only some of them, still worth prefetching.
+    virtual bool getFootprint(std::vector<LedgerKey>& reads,
+                              std::vector<LedgerKey>& writes) const;
+
     Operation const&
     getOperation() const
     {
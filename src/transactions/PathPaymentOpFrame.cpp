@@ -323,4 +323,55 @@ PathPaymentOpFrame::doCheckValid(Application& app)
     }
     return true;
 }
+
+bool
+PathPaymentOpFrame::getFootprint(std::vector<LedgerKey>& reads,
+                                 std::vector<LedgerKey>& writes) const
+{
+    // converting from one asset to another crosses offers: only the ends
+    // of the payment are known, as if it were made in either asset
+    if (!mPathPayment.path.empty() ||
+        !(mPathPayment.sendAsset == mPathPayment.destAsset))
+    {
+        getDirectFootprint(getSourceID(), mPathPayment.destination,
+                           mPathPayment.sendAsset, reads, writes);
+        getDirectFootprint(getSourceID(), mPathPayment.destination,
+                           mPathPayment.destAsset, reads, writes);
+        return false;
+    }
+    getDirectFootprint(getSourceID(), mPathPayment.destination,
+                       mPathPayment.destAsset, reads, writes);
+    return true;
+}
+
+void
+PathPaymentOpFrame::getDirectFootprint(AccountID const& source,
+                                       AccountID const& destination,
+                                       Asset const& asset,
+                                       std::vector<LedgerKey>& reads,
+                                       std::vector<LedgerKey>& writes)
+{
+    if (asset.type() == ASSET_TYPE_NATIVE)
+    {
+        writes.emplace_back(accountKey(source));
+        writes.emplace_back(accountKey(destination));
+    }
+    else
+    {
+        // only trust lines change: the accounts are checked for existence,
+        // and the issuer for its flags. The issuer has no trust line.
+        auto issuer = getIssuer(asset);
+        reads.emplace_back(accountKey(source));
+        reads.emplace_back(accountKey(destination));
+        reads.emplace_back(accountKey(issuer));
+        if (!(source == issuer))
+        {
+            writes.emplace_back(trustLineKey(source, asset));
+        }
+        if (!(destination == issuer))
+        {
+            writes.emplace_back(trustLineKey(destination, asset));
+        }
+    }
+}
 }
@@ -25,6 +25,16 @@ class PathPaymentOpFrame : public OperationFrame
     bool doApply(Application& app, LedgerDelta& delta,
                  LedgerManager& ledgerManager) override;
     bool doCheckValid(Application& app) override;
+    bool getFootprint(std::vector<LedgerKey>& reads,
+                      std::vector<LedgerKey>& writes) const override;
+
+    // footprint of a payment of `asset` that doesn't cross offers, as made
+    // by PaymentOpFrame and by path payments without conversion
+    static void getDirectFootprint(AccountID const& source,
+                                   AccountID const& destination,
+                                   Asset const& asset,
+                                   std::vector<LedgerKey>& reads,
+                                   std::vector<LedgerKey>& writes);
 
     static PathPaymentResultCode
     getInnerCode(OperationResult const& res)
@@ -146,4 +146,13 @@ PaymentOpFrame::doCheckValid(Application& app)
     }
     return true;
 }
+
+bool
+PaymentOpFrame::getFootprint(std::vector<LedgerKey>& reads,
+                             std::vector<LedgerKey>& writes) const
+{
+    PathPaymentOpFrame::getDirectFootprint(
+        getSourceID(), mPayment.destination, mPayment.asset, reads, writes);
+    return true;
+}
 }
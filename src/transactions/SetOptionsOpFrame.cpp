@@ -281,4 +281,16 @@ SetOptionsOpFrame::doCheckValid(Application& app)
 
     return true;
 }
+
+bool
+SetOptionsOpFrame::getFootprint(std::vector<LedgerKey>& reads,
+                                std::vector<LedgerKey>& writes) const
+{
+    writes.emplace_back(accountKey(getSourceID()));
+    if (mSetOptions.inflationDest)
+    {
+        reads.emplace_back(accountKey(*mSetOptions.inflationDest));
+    }
+    return true;
+}
 }
@@ -7,6 +7,7 @@
 #include "OperationFrame.h"
 #include "main/Application.h"
 #include "xdrpp/marshal.h"
+#include <algorithm>
 #include <string>
 #include "util/Logging.h"
 #include "util/XDRStream.h"
@@ -17,6 +18,7 @@
 #include "herder/TxSetFrame.h"
 #include "crypto/Hex.h"
 #include "util/basen.h"
+#include "util/make_unique.h"
 
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
@@ -46,7 +48,7 @@ TransactionFrame::getFullHash() const
 {
     if (isZero(mFullHash))
     {
-        mFullHash = sha256(xdr::xdr_to_opaque(mEnvelope));
+        mFullHash = sha256(getEnvelopeBytes());
     }
     return (mFullHash);
 }
@@ -56,18 +58,44 @@ TransactionFrame::getContentsHash() const
 {
     if (isZero(mContentsHash))
     {
-        mContentsHash = sha256(
-            xdr::xdr_to_opaque(mNetworkID, ENVELOPE_TYPE_TX, mEnvelope.tx));
+        if (mEnvelopeBytes.empty())
+        {
+            // don't serialize the whole envelope just for this: while
+            // signing, signatures are still being added to it
+            mContentsHash = sha256(xdr::xdr_to_opaque(
+                mNetworkID, ENVELOPE_TYPE_TX, mEnvelope.tx));
+        }
+        else
+        {
+            // the envelope starts with the transaction itself
+            auto hasher = SHA256::create();
+            hasher->add(mNetworkID);
+            hasher->add(xdr::xdr_to_opaque(ENVELOPE_TYPE_TX));
+            hasher->add(ByteSlice(mEnvelopeBytes.data(),
+                                  xdr::xdr_size(mEnvelope.tx)));
+            mContentsHash = hasher->finish();
+        }
     }
     return (mContentsHash);
 }
 
+xdr::opaque_vec<> const&
+TransactionFrame::getEnvelopeBytes() const
+{
+    if (mEnvelopeBytes.empty())
+    {
+        mEnvelopeBytes = xdr::xdr_to_opaque(mEnvelope);
+    }
+    return mEnvelopeBytes;
+}
+
 void
 TransactionFrame::clearCached()
 {
     Hash zero;
     mContentsHash = zero;
     mFullHash = zero;
+    mEnvelopeBytes.clear();
 }
 
 TransactionResultPair
@@ -176,6 +204,18 @@ TransactionFrame::loadAccount(LedgerDelta* delta, Database& db,
     {
         res = mSigningAccount;
     }
+    else if (mPreloadedAccounts)
+    {
+        auto it = mPreloadedAccounts->find(accountID);
+        if (it == mPreloadedAccounts->end())
+        {
+            throw std::runtime_error("account was not preloaded");
+        }
+        if (it->second)
+        {
+            res = std::make_shared<AccountFrame>(*it->second);
+        }
+    }
     else if (delta)
     {
         res = AccountFrame::loadAccount(*delta, accountID, db);
@@ -423,6 +463,62 @@ TransactionFrame::checkValid(Application& app, SequenceNumber current)
     return res;
 }
 
+std::vector<AccountID>
+TransactionFrame::getValidationAccounts() const
+{
+    std::vector<AccountID> res{getSourceID()};
+    for (auto const& op : mEnvelope.tx.operations)
+    {
+        if (op.sourceAccount)
+        {
+            res.push_back(*op.sourceAccount);
+        }
+    }
+    return res;
+}
+
+bool
+TransactionFrame::getFootprint(std::vector<LedgerKey>& reads,
+                               std::vector<LedgerKey>& writes) const
+{
+    // signatures are checked against every source account
+    for (auto const& id : getValidationAccounts())
+    {
+        LedgerKey key;
+        key.type(ACCOUNT);
+        key.account().accountID = id;
+        reads.emplace_back(key);
+    }
+    bool complete = true;
+    for (auto const& op : mOperations)
+    {
+        if (!op->getFootprint(reads, writes))
+        {
+            complete = false;
+        }
+    }
+    return complete;
+}
+
+bool
+TransactionFrame::checkValid(Application& app, SequenceNumber current,
+                             AccountEntries const& accounts)
+{
+    mPreloadedAccounts = &accounts;
+    bool res;
+    try
+    {
+        res = checkValid(app, current);
+    }
+    catch (...)
+    {
+        mPreloadedAccounts = nullptr;
+        throw;
+    }
+    mPreloadedAccounts = nullptr;
+    return res;
+}
+
 void
 TransactionFrame::markResultFailed()
 {
@@ -467,7 +563,14 @@ TransactionFrame::apply(LedgerDelta& delta, TransactionMeta& meta,
     {
         // shield outer scope of any side effects by using
         // a sql transaction for ledger state and LedgerDelta
-        soci::transaction sqlTx(app.getDatabase().getSession());
+        // (LedgerDelta alone takes care of a ledger state held in memory,
+        // which may be applied to on a worker thread)
+        std::unique_ptr<soci::transaction> sqlTx;
+        auto& db = app.getDatabase();
+        if (!db.getInMemoryLedgerState())
+        {
+            sqlTx = make_unique<soci::transaction>(db.getSession());
+        }
         LedgerDelta thisTxDelta(delta);
 
         auto& opTimer =
@@ -496,7 +599,10 @@ TransactionFrame::apply(LedgerDelta& delta, TransactionMeta& meta,
                 return false;
             }
 
-            sqlTx.commit();
+            if (sqlTx)
+            {
+                sqlTx->commit();
+            }
             thisTxDelta.commit();
         }
     }
@@ -524,7 +630,7 @@ TransactionFrame::storeTransaction(LedgerManager& ledgerManager,
                                    TransactionMeta& tm, int txindex,
                                    TransactionResultSet& resultSet) const
 {
-    auto txBytes(xdr::xdr_to_opaque(mEnvelope));
+    auto const& txBytes = getEnvelopeBytes();
 
     resultSet.results.emplace_back(getResultPair());
     auto txResultBytes(xdr::xdr_to_opaque(resultSet.results.back()));
@@ -602,27 +708,74 @@ TransactionFrame::storeTransactionFee(LedgerManager& ledgerManager,
     }
 }
 
-static void
-saveTransactionHelper(Database& db, soci::session& sess, uint32 ledgerSeq,
-                      TxSetFrame& txSet, TransactionHistoryResultEntry& results,
-                      XDROutputFileStream& txOut,
+namespace
+{
+// Encoded history rows of one ledger, accumulated while streaming txhistory
+// and written out as a TransactionHistoryEntry and a
+// TransactionHistoryResultEntry without going through their XDR types.
+struct LedgerHistoryRows
+{
+    uint32_t mLedgerSeq{0};
+    // (full hash, encoded TransactionEnvelope)
+    std::vector<std::pair<Hash, std::vector<uint8_t>>> mTxs;
+    // encoded TransactionResultPairs, in apply order
+    std::vector<uint8_t> mResults;
+    uint32_t mResultCount{0};
+};
+
+void
+putUint32(std::vector<uint8_t>& buf, uint32_t v)
+{
+    buf.push_back(static_cast<uint8_t>((v >> 24) & 0xFF));
+    buf.push_back(static_cast<uint8_t>((v >> 16) & 0xFF));
+    buf.push_back(static_cast<uint8_t>((v >> 8) & 0xFF));
+    buf.push_back(static_cast<uint8_t>(v & 0xFF));
+}
+
+void
+saveTransactionHelper(soci::session& sess, LedgerHistoryRows& rows,
+                      std::vector<uint8_t>& buf, XDROutputFileStream& txOut,
                       XDROutputFileStream& txResultOut)
 {
-    // prepare the txset for saving
-    LedgerHeaderFrame::pointer lh =
-        LedgerHeaderFrame::loadBySequence(ledgerSeq, db, sess);
-    if (!lh)
+    std::string prevHash;
+    soci::indicator prevHashIndicator;
+    sess << "SELECT prevhash FROM ledgerheaders WHERE ledgerseq = :seq",
+        soci::into(prevHash, prevHashIndicator), soci::use(rows.mLedgerSeq);
+    if (!sess.got_data() || prevHashIndicator != soci::i_ok)
     {
         throw std::runtime_error("Could not find ledger");
     }
-    txSet.previousLedgerHash() = lh->mHeader.previousLedgerHash;
-    txSet.sortForHash();
-    TransactionHistoryEntry hist;
-    hist.ledgerSeq = ledgerSeq;
-    txSet.toXDR(hist.txSet);
-    txOut.writeOne(hist);
 
-    txResultOut.writeOne(results);
+    // the transaction set is saved sorted for hashing, see
+    // TxSetFrame::sortForHash
+    std::sort(rows.mTxs.begin(), rows.mTxs.end(),
+              [](std::pair<Hash, std::vector<uint8_t>> const& l,
+                 std::pair<Hash, std::vector<uint8_t>> const& r)
+              {
+                  return l.first < r.first;
+              });
+
+    // TransactionHistoryEntry
+    buf.clear();
+    putUint32(buf, rows.mLedgerSeq);
+    Hash h = hexToBin256(prevHash);
+    buf.insert(buf.end(), h.begin(), h.end());
+    putUint32(buf, static_cast<uint32_t>(rows.mTxs.size()));
+    for (auto const& tx : rows.mTxs)
+    {
+        buf.insert(buf.end(), tx.second.begin(), tx.second.end());
+    }
+    putUint32(buf, 0); // ext
+    txOut.writeEncoded(buf);
+
+    // TransactionHistoryResultEntry
+    buf.clear();
+    putUint32(buf, rows.mLedgerSeq);
+    putUint32(buf, rows.mResultCount);
+    buf.insert(buf.end(), rows.mResults.begin(), rows.mResults.end());
+    putUint32(buf, 0); // ext
+    txResultOut.writeEncoded(buf);
+}
 }
 
 TransactionResultSet
@@ -689,14 +842,14 @@ TransactionFrame::copyTransactionsToStream(Hash const& networkID, Database& db,
                                            uint32_t ledgerSeq,
                                            uint32_t ledgerCount,
                                            XDROutputFileStream& txOut,
-                                           XDROutputFileStream& txResultOut)
+                                           XDROutputFileStream& txResultOut,
+                                           uint32_t verifyEvery)
 {
     auto timer = db.getSelectTimer("txhistory");
-    std::string txBody, txResult, txMeta;
+    std::string txBody, txResult;
     uint32_t begin = ledgerSeq, end = ledgerSeq + ledgerCount;
     size_t n = 0;
 
-    TransactionEnvelope tx;
     uint32_t curLedgerSeq;
 
     assert(begin <= end);
@@ -707,26 +860,26 @@ TransactionFrame::copyTransactionsToStream(Hash const& networkID, Database& db,
          soci::into(curLedgerSeq), soci::into(txBody), soci::into(txResult),
          soci::use(begin), soci::use(end));
 
-    Hash h;
-    TxSetFrame txSet(h); // we're setting the hash later
-    TransactionHistoryResultEntry results;
+    LedgerHistoryRows rows;
+    std::vector<uint8_t> buf;
 
     st.execute(true);
 
-    uint32_t lastLedgerSeq = curLedgerSeq;
-    results.ledgerSeq = curLedgerSeq;
+    rows.mLedgerSeq = curLedgerSeq;
 
+    // rows are copied as stored: the envelopes are only hashed (to order the
+    // transaction set) and a sample of them is decoded to check that they
+    // match their results
     while (st.got_data())
     {
-        if (curLedgerSeq != lastLedgerSeq)
+        if (curLedgerSeq != rows.mLedgerSeq)
         {
-            saveTransactionHelper(db, sess, lastLedgerSeq, txSet, results,
-                                  txOut, txResultOut);
+            saveTransactionHelper(sess, rows, buf, txOut, txResultOut);
             // reset state
-            txSet.mTransactions.clear();
-            results.ledgerSeq = curLedgerSeq;
-            results.txResultSet.results.clear();
-            lastLedgerSeq = curLedgerSeq;
+            rows.mTxs.clear();
+            rows.mResults.clear();
+            rows.mResultCount = 0;
+            rows.mLedgerSeq = curLedgerSeq;
         }
 
         std::vector<uint8_t> body;
@@ -735,31 +888,38 @@ TransactionFrame::copyTransactionsToStream(Hash const& networkID, Database& db,
         std::vector<uint8_t> result;
         bn::decode_b64(txResult, result);
 
-        xdr::xdr_get g1(&body.front(), &body.back() + 1);
-        xdr_argpack_archive(g1, tx);
-
-        TransactionFramePtr txFrame =
-            make_shared<TransactionFrame>(networkID, tx);
-        txSet.add(txFrame);
-
-        xdr::xdr_get g2(&result.front(), &result.back() + 1);
-        results.txResultSet.results.emplace_back();
-
-        TransactionResultPair& p = results.txResultSet.results.back();
-        xdr_argpack_archive(g2, p);
+        // a TransactionResultPair starts with the contents hash
+        if (result.size() < sizeof(Hash) || body.empty())
+        {
+            throw std::runtime_error("malformed transaction history");
+        }
 
-        if (p.transactionHash != txFrame->getContentsHash())
+        if (verifyEvery != 0 && n % verifyEvery == 0)
         {
-            throw std::runtime_error("transaction mismatch");
+            TransactionEnvelope tx;
+            xdr::xdr_from_opaque(body, tx);
+            TransactionFrame txFrame(networkID, tx);
+            Hash const& contentsHash = txFrame.getContentsHash();
+            if (!std::equal(contentsHash.begin(), contentsHash.end(),
+                            result.begin()))
+            {
+                throw std::runtime_error("transaction mismatch");
+            }
         }
 
+        rows.mResults.insert(rows.mResults.end(), result.begin(),
+                             result.end());
+        ++rows.mResultCount;
+
+        Hash fullHash = sha256(body);
+        rows.mTxs.emplace_back(fullHash, std::move(body));
+
         ++n;
         st.fetch();
     }
     if (n != 0)
     {
-        saveTransactionHelper(db, sess, lastLedgerSeq, txSet, results, txOut,
-                              txResultOut);
+        saveTransactionHelper(sess, rows, buf, txOut, txResultOut);
     }
     return n;
 }
@@ -792,11 +952,13 @@ TransactionFrame::dropAll(Database& db)
     db.getSession() << "CREATE INDEX histfeebyseq ON txfeehistory (ledgerseq);";
 }
 
-void
-TransactionFrame::deleteOldEntries(Database& db, uint32_t ledgerSeq)
+size_t
+TransactionFrame::deleteOldEntries(soci::session& sess, uint32_t ledgerSeq,
+                                   uint32_t count)
 {
-    db.getSession() << "DELETE FROM txhistory WHERE ledgerseq <= " << ledgerSeq;
-    db.getSession() << "DELETE FROM txfeehistory WHERE ledgerseq <= "
-                    << ledgerSeq;
+    return Database::deleteOldEntriesHelper(sess, "txhistory", "ledgerseq",
+                                            ledgerSeq, count) +
+           Database::deleteOldEntriesHelper(sess, "txfeehistory", "ledgerseq",
+                                            ledgerSeq, count);
 }
 }
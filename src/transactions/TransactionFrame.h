@@ -44,9 +44,20 @@ class TransactionFrame
     Hash const& mNetworkID;     // used to change the way we compute signatures
     mutable Hash mContentsHash; // the hash of the contents
     mutable Hash mFullHash;     // the hash of the contents and the sig.
+    mutable xdr::opaque_vec<> mEnvelopeBytes; // mEnvelope, serialized
 
     std::vector<std::shared_ptr<OperationFrame>> mOperations;
 
+  public:
+    // Accounts loaded ahead of validation, keyed by ID (null for accounts
+    // that do not exist).
+    typedef std::unordered_map<AccountID, std::shared_ptr<LedgerEntry const>>
+        AccountEntries;
+
+  protected:
+    // set for the duration of checkValid(app, current, accounts)
+    AccountEntries const* mPreloadedAccounts = nullptr;
+
     bool loadAccount(LedgerDelta* delta, Database& app);
     bool commonValid(Application& app, LedgerDelta* delta,
                      SequenceNumber current);
@@ -69,6 +80,10 @@ class TransactionFrame
     Hash const& getFullHash() const;
     Hash const& getContentsHash() const;
 
+    // XDR encoding of the envelope, computed once and kept for hashing the
+    // transaction and the sets containing it.
+    xdr::opaque_vec<> const& getEnvelopeBytes() const;
+
     AccountFrame::pointer
     getSourceAccountPtr() const
     {
@@ -136,6 +151,23 @@ class TransactionFrame
 
     bool checkValid(Application& app, SequenceNumber current);
 
+    // IDs of the accounts checkValid reads: the source accounts of the
+    // transaction and of its operations.
+    std::vector<AccountID> getValidationAccounts() const;
+
+    // Keys of the ledger entries apply may read and change, as given by
+    // OperationFrame::getFootprint. Returns false if they can't be known
+    // ahead of applying the transaction, for any of its operations, having
+    // added the keys that are known anyway.
+    bool getFootprint(std::vector<LedgerKey>& reads,
+                      std::vector<LedgerKey>& writes) const;
+
+    // Same as checkValid, but reads accounts from `accounts`, which must hold
+    // all of getValidationAccounts(), rather than from the database. Does not
+    // touch the Database, so may be called from a worker thread.
+    bool checkValid(Application& app, SequenceNumber current,
+                    AccountEntries const& accounts);
+
     // collect fee, consume sequence number
     void processFeeSeqNum(LedgerDelta& delta, LedgerManager& ledgerManager);
 
@@ -169,15 +201,20 @@ class TransactionFrame
     /*
     txOut: stream of TransactionHistoryEntry
     txResultOut: stream of TransactionHistoryResultEntry
+    verifyEvery: check the contents hash of one in verifyEvery transactions
+    against its result (0: none)
     */
     static size_t copyTransactionsToStream(Hash const& networkID, Database& db,
                                            soci::session& sess,
                                            uint32_t ledgerSeq,
                                            uint32_t ledgerCount,
                                            XDROutputFileStream& txOut,
-                                           XDROutputFileStream& txResultOut);
+                                           XDROutputFileStream& txResultOut,
+                                           uint32_t verifyEvery = 1);
     static void dropAll(Database& db);
 
-    static void deleteOldEntries(Database& db, uint32_t ledgerSeq);
+    // see Database::deleteOldEntriesHelper
+    static size_t deleteOldEntries(soci::session& sess, uint32_t ledgerSeq,
+                                   uint32_t count);
 };
 }
@@ -16,6 +16,7 @@
 #endif
 
 #include <cstdio>
+#include <fstream>
 
 namespace stellar
 {
@@ -139,6 +140,12 @@ processExists(long pid)
     }
 }
 
+static bool
+hardLink(std::string const& from, std::string const& to)
+{
+    return CreateHardLink(to.c_str(), from.c_str(), NULL) != 0;
+}
+
 #else
 #include <ftw.h>
 #include <unistd.h>
@@ -260,8 +267,34 @@ processExists(long pid)
     return (kill(pid, 0) == 0);
 }
 
+static bool
+hardLink(std::string const& from, std::string const& to)
+{
+    return link(from.c_str(), to.c_str()) == 0;
+}
+
 #endif
 
+bool
+linkOrCopy(std::string const& from, std::string const& to)
+{
+    std::remove(to.c_str());
+    if (hardLink(from, to))
+    {
+        return true;
+    }
+    std::ifstream in(from, std::ifstream::binary);
+    std::ofstream out(to, std::ofstream::binary | std::ofstream::trunc);
+    if (!in || !out || !(out << in.rdbuf()))
+    {
+        CLOG(WARNING, "Fs") << "failed to copy " << from << " to " << to;
+        out.close();
+        std::remove(to.c_str());
+        return false;
+    }
+    return true;
+}
+
 PathSplitter::PathSplitter(std::string path) :
     mPath{std::move(path)},
     mPos{0}
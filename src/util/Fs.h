@@ -40,6 +40,10 @@ bool mkdir(std::string const& path);
 // Make a dir path like mkdir -p, i.e. recursive, uses '/' as dir separator
 bool mkpath(std::string const& path);
 
+// Hard link `from` to `to`, replacing it, or copy it if that fails (eg. across
+// file systems)
+bool linkOrCopy(std::string const& from, std::string const& to);
+
 class PathSplitter
 {
 public:
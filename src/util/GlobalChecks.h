@@ -8,6 +8,11 @@ namespace stellar
 {
 void assertThreadIsMain();
 
+// Lets the calling thread pass assertThreadIsMain(); for threads that run the
+// main loop of an application of their own, such as the node threads of a
+// parallel Simulation.
+void markThreadAsMain();
+
 void dbgAbort();
 
 #ifdef NDEBUG
@@ -8,7 +8,7 @@
 namespace stellar
 {
 
-std::default_random_engine gRandomEngine;
+thread_local std::default_random_engine gRandomEngine;
 std::uniform_real_distribution<double> uniformFractionDistribution(0.0, 1.0);
 std::bernoulli_distribution bernoulliDistribution{0.5};
 
@@ -16,7 +16,9 @@ size_t rand_pareto(float alpha, size_t max);
 
 bool rand_flip();
 
-extern std::default_random_engine gRandomEngine;
+// one per thread, so that node threads of a parallel Simulation neither
+// race on it nor perturb each other's sequences
+extern thread_local std::default_random_engine gRandomEngine;
 
 template <typename T>
 T
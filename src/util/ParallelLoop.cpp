@@ -0,0 +1,103 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/ParallelLoop.h"
+
+namespace stellar
+{
+
+ParallelLoop::ParallelLoop(size_t size) : mSize(size)
+{
+}
+
+bool
+ParallelLoop::next(size_t& i)
+{
+    if (mStopped)
+    {
+        return false;
+    }
+    i = mNext++;
+    return i < mSize;
+}
+
+void
+ParallelLoop::stop()
+{
+    mStopped = true;
+}
+
+bool
+ParallelLoop::stopped() const
+{
+    return mStopped;
+}
+
+void
+ParallelLoop::fail(std::exception_ptr error)
+{
+    mStopped = true;
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mError)
+    {
+        mError = error;
+    }
+}
+
+void
+ParallelLoop::help(asio::io_service& io, size_t nWorkers,
+                   std::function<void()> loop)
+{
+    auto self = shared_from_this();
+    for (size_t w = 0; w < nWorkers; ++w)
+    {
+        io.post([self, loop]()
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(self->mMutex);
+                        if (self->mClosed)
+                        {
+                            return;
+                        }
+                        ++self->mActive;
+                    }
+                    try
+                    {
+                        loop();
+                    }
+                    catch (...)
+                    {
+                        self->fail(std::current_exception());
+                    }
+                    std::lock_guard<std::mutex> lock(self->mMutex);
+                    --self->mActive;
+                    self->mCond.notify_all();
+                });
+    }
+}
+
+void
+ParallelLoop::run(std::function<void()> const& loop)
+{
+    try
+    {
+        loop();
+    }
+    catch (...)
+    {
+        fail(std::current_exception());
+    }
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mClosed = true;
+    mCond.wait(lock, [this]()
+               {
+                   return mActive == 0;
+               });
+    if (mError)
+    {
+        std::rethrow_exception(mError);
+    }
+}
+}
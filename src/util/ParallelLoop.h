@@ -0,0 +1,68 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include "util/asio.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace stellar
+{
+
+/**
+ * A loop over the items [0, size), run by one thread and helped out by
+ * worker threads. Every thread taking part takes the next item with next()
+ * until there is none left, so items run once each, in no particular order.
+ *
+ * Helpers only run while counted in mActive, and run() doesn't return before
+ * mActive drops to 0: once run() returns, no helper touches anything
+ * anymore, so the items, and whatever the loop refers to, can live on the
+ * stack of the thread calling run(). Helpers that start later do nothing.
+ *
+ * The first exception thrown by the loop, on any thread, stops it and is
+ * rethrown by run().
+ */
+class ParallelLoop : public std::enable_shared_from_this<ParallelLoop>,
+                     NonMovableOrCopyable
+{
+    size_t const mSize;
+    std::atomic<size_t> mNext{0};
+    std::atomic<bool> mStopped{false};
+
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    size_t mActive{0};
+    bool mClosed{false};
+    std::exception_ptr mError;
+
+    void fail(std::exception_ptr error);
+
+  public:
+    explicit ParallelLoop(size_t size);
+
+    // Takes the next item to run into `i`; false once none are left or the
+    // loop was stopped.
+    bool next(size_t& i);
+
+    // Hands out no more items; those running finish.
+    void stop();
+    bool stopped() const;
+
+    // Posts `nWorkers` helpers running `loop` to `io`; the loop must be owned
+    // by a shared_ptr.
+    void help(asio::io_service& io, size_t nWorkers,
+              std::function<void()> loop);
+
+    // Runs `loop` on this thread, then waits for the helpers that started.
+    void run(std::function<void()> const& loop);
+};
+}
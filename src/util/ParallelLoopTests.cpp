@@ -0,0 +1,94 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/ParallelLoop.h"
+#include "lib/catch.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace stellar;
+
+TEST_CASE("parallel loop", "[parallelloop]")
+{
+    asio::io_service io;
+    int const size = 1000;
+    std::vector<int> ran(size, 0);
+    auto loop = std::make_shared<ParallelLoop>(size);
+    auto body = [&]()
+    {
+        size_t i;
+        while (loop->next(i))
+        {
+            ++ran[i];
+        }
+    };
+
+    SECTION("helped by worker threads")
+    {
+        std::vector<std::thread> workers;
+        {
+            asio::io_service::work work(io);
+            for (int w = 0; w < 3; ++w)
+            {
+                workers.emplace_back([&io]()
+                                     {
+                                         io.run();
+                                     });
+            }
+            loop->help(io, 3, body);
+            loop->run(body);
+        }
+        for (auto& w : workers)
+        {
+            w.join();
+        }
+        REQUIRE(std::count(ran.begin(), ran.end(), 1) == size);
+    }
+
+    SECTION("helpers starting after run do nothing")
+    {
+        bool helped = false;
+        loop->help(io, 2, [&]()
+                   {
+                       helped = true;
+                   });
+        loop->run(body);
+        io.run();
+        REQUIRE(!helped);
+        REQUIRE(std::count(ran.begin(), ran.end(), 1) == size);
+    }
+
+    SECTION("an exception stops the loop")
+    {
+        loop->help(io, 1, []()
+                   {
+                       throw std::runtime_error("helper");
+                   });
+        // the helper runs first and its exception is the one rethrown
+        io.run();
+        REQUIRE(loop->stopped());
+        REQUIRE_THROWS_AS(loop->run(body), std::runtime_error);
+        REQUIRE(std::count(ran.begin(), ran.end(), 0) == size);
+    }
+
+    SECTION("stopped loop hands out no more items")
+    {
+        loop->run([&]()
+                  {
+                      size_t i;
+                      while (loop->next(i))
+                      {
+                          ++ran[i];
+                          if (i == 9)
+                          {
+                              loop->stop();
+                          }
+                      }
+                  });
+        REQUIRE(std::count(ran.begin(), ran.end(), 1) == 10);
+    }
+}
@@ -0,0 +1,144 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/Scheduler.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace stellar
+{
+
+size_t const Scheduler::MAX_LATENCY_SAMPLES = 4096;
+
+char const*
+Scheduler::getClassName(ActionClass c)
+{
+    switch (c)
+    {
+    case CONSENSUS:
+        return "consensus";
+    case LEDGER:
+        return "ledger";
+    case ADMIN:
+        return "admin";
+    case OVERLAY_TX:
+        return "overlay-tx";
+    case BACKGROUND:
+        return "background";
+    default:
+        assert(false);
+        return "unknown";
+    }
+}
+
+uint32_t
+Scheduler::getClassWeight(ActionClass c)
+{
+    switch (c)
+    {
+    case CONSENSUS:
+        return 16;
+    case LEDGER:
+        return 8;
+    case ADMIN:
+        return 4;
+    case OVERLAY_TX:
+        return 2;
+    case BACKGROUND:
+        return 1;
+    default:
+        assert(false);
+        return 1;
+    }
+}
+
+Scheduler::Scheduler() : mSize(0)
+{
+    std::fill(std::begin(mCredits), std::end(mCredits), 0);
+}
+
+void
+Scheduler::enqueue(ActionClass c, std::function<void()>&& action)
+{
+    assert(c < ACTION_CLASS_COUNT);
+    std::lock_guard<std::mutex> lock(mMutex);
+    mQueues[c].emplace_back(
+        Action{std::move(action), std::chrono::steady_clock::now()});
+    ++mSize;
+}
+
+bool
+Scheduler::runOne()
+{
+    Action action;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        // every class waiting earns its weight, the richest runs and pays
+        // for all of them
+        int64_t total = 0;
+        int best = -1;
+        for (int c = 0; c < ACTION_CLASS_COUNT; ++c)
+        {
+            if (mQueues[c].empty())
+            {
+                continue;
+            }
+            auto weight = getClassWeight(static_cast<ActionClass>(c));
+            mCredits[c] += weight;
+            total += weight;
+            if (best < 0 || mCredits[c] > mCredits[best])
+            {
+                best = c;
+            }
+        }
+        if (best < 0)
+        {
+            return false;
+        }
+        mCredits[best] -= total;
+
+        auto& queue = mQueues[best];
+        action = std::move(queue.front());
+        queue.pop_front();
+        --mSize;
+        if (queue.empty())
+        {
+            // a class that ran dry starts afresh
+            mCredits[best] = 0;
+        }
+
+        auto& stats = mStats[best];
+        ++stats.mRun;
+        if (stats.mLatencies.size() < MAX_LATENCY_SAMPLES)
+        {
+            stats.mLatencies.emplace_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - action.mQueuedAt));
+        }
+    }
+    action.mFunc();
+    return true;
+}
+
+size_t
+Scheduler::size() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mSize;
+}
+
+void
+Scheduler::flushStats(std::vector<ClassStats>& stats)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    stats.clear();
+    for (int c = 0; c < ACTION_CLASS_COUNT; ++c)
+    {
+        stats.emplace_back(std::move(mStats[c]));
+        stats.back().mQueued = mQueues[c].size();
+        mStats[c] = ClassStats();
+    }
+}
+}
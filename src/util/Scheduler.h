@@ -0,0 +1,92 @@
+#pragma once
+
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace stellar
+{
+
+/**
+ * Queues of the work waiting to run on the main thread, one per class of
+ * work. When several classes have work waiting, each gets a share of the runs
+ * in proportion to its weight (smooth weighted round robin), so that a flood
+ * of work of one class -- transactions, typically -- delays the work of the
+ * others by a few actions, not by the whole flood. Within a class, actions
+ * run in the order they were queued.
+ *
+ * Actions are queued through VirtualClock::postAction, which also posts to
+ * the IO service a handler running the next action, whichever it is by then:
+ * the IO service's FIFO order no longer decides what runs first.
+ *
+ * Actions may be queued from any thread; they run on the main thread.
+ */
+class Scheduler : NonMovableOrCopyable
+{
+  public:
+    enum ActionClass
+    {
+        // SCP messages, and the tx sets and quorum sets they refer to
+        CONSENSUS,
+        // follow-ups of ledger close
+        LEDGER,
+        // HTTP commands
+        ADMIN,
+        // transactions flooded by peers or submitted locally
+        OVERLAY_TX,
+        // Work, peer lists, checks
+        BACKGROUND,
+        ACTION_CLASS_COUNT
+    };
+
+    static char const* getClassName(ActionClass c);
+    static uint32_t getClassWeight(ActionClass c);
+
+    // What a class did since the last flushStats.
+    struct ClassStats
+    {
+        uint64_t mRun{0};
+        // time actions waited in the queue, up to MAX_LATENCY_SAMPLES of them
+        std::vector<std::chrono::nanoseconds> mLatencies;
+        // actions waiting at the time of the flush
+        size_t mQueued{0};
+    };
+    static size_t const MAX_LATENCY_SAMPLES;
+
+    Scheduler();
+
+    void enqueue(ActionClass c, std::function<void()>&& action);
+
+    // Runs the next action, if any is waiting; returns whether one ran.
+    bool runOne();
+
+    size_t size() const;
+
+    // moves the stats gathered since the last call into `stats`, one entry
+    // per class
+    void flushStats(std::vector<ClassStats>& stats);
+
+  private:
+    struct Action
+    {
+        std::function<void()> mFunc;
+        std::chrono::steady_clock::time_point mQueuedAt;
+    };
+
+    mutable std::mutex mMutex;
+    std::deque<Action> mQueues[ACTION_CLASS_COUNT];
+    // round robin credit of each class with actions waiting
+    int64_t mCredits[ACTION_CLASS_COUNT];
+    size_t mSize;
+    ClassStats mStats[ACTION_CLASS_COUNT];
+};
+}
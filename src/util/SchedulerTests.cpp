@@ -0,0 +1,117 @@
+// Copyright 2016 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/Scheduler.h"
+#include "lib/catch.hpp"
+#include "util/Timer.h"
+
+#include <map>
+
+using namespace stellar;
+
+TEST_CASE("scheduler drains classes by weight", "[scheduler]")
+{
+    Scheduler sched;
+    std::vector<std::pair<Scheduler::ActionClass, int>> ran;
+    auto post = [&](Scheduler::ActionClass c, int i)
+    {
+        sched.enqueue(c, [&ran, c, i]()
+                      {
+                          ran.emplace_back(c, i);
+                      });
+    };
+
+    SECTION("consensus goes ahead of a transaction flood")
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            post(Scheduler::OVERLAY_TX, i);
+        }
+        post(Scheduler::CONSENSUS, 0);
+        post(Scheduler::CONSENSUS, 1);
+        REQUIRE(sched.size() == 1002);
+
+        REQUIRE(sched.runOne());
+        REQUIRE(ran.back() == std::make_pair(Scheduler::CONSENSUS, 0));
+        // the flood still gets its share
+        while (ran.back() != std::make_pair(Scheduler::CONSENSUS, 1))
+        {
+            REQUIRE(sched.runOne());
+        }
+        REQUIRE(ran.size() <= 4);
+
+        while (sched.runOne())
+            ;
+        REQUIRE(ran.size() == 1002);
+        REQUIRE(sched.size() == 0);
+        // in order within the class
+        for (size_t i = 0; i < ran.size(); i++)
+        {
+            if (ran[i].first == Scheduler::OVERLAY_TX && i > 0 &&
+                ran[i - 1].first == Scheduler::OVERLAY_TX)
+            {
+                REQUIRE(ran[i].second == ran[i - 1].second + 1);
+            }
+        }
+    }
+
+    SECTION("busy classes share the runs by weight")
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            post(Scheduler::CONSENSUS, i);
+            post(Scheduler::OVERLAY_TX, i);
+            post(Scheduler::BACKGROUND, i);
+        }
+        for (int i = 0; i < 19; i++)
+        {
+            REQUIRE(sched.runOne());
+        }
+        std::map<Scheduler::ActionClass, int> runs;
+        for (auto const& r : ran)
+        {
+            runs[r.first]++;
+        }
+        REQUIRE(runs[Scheduler::CONSENSUS] == 16);
+        REQUIRE(runs[Scheduler::OVERLAY_TX] == 2);
+        REQUIRE(runs[Scheduler::BACKGROUND] == 1);
+    }
+
+    SECTION("stats")
+    {
+        post(Scheduler::ADMIN, 0);
+        post(Scheduler::ADMIN, 1);
+        post(Scheduler::LEDGER, 0);
+        REQUIRE(sched.runOne());
+        REQUIRE(sched.runOne());
+
+        std::vector<Scheduler::ClassStats> stats;
+        sched.flushStats(stats);
+        REQUIRE(stats.size() == Scheduler::ACTION_CLASS_COUNT);
+        REQUIRE(stats[Scheduler::LEDGER].mRun == 1);
+        REQUIRE(stats[Scheduler::ADMIN].mRun == 1);
+        REQUIRE(stats[Scheduler::ADMIN].mLatencies.size() == 1);
+        REQUIRE(stats[Scheduler::ADMIN].mQueued == 1);
+        sched.flushStats(stats);
+        REQUIRE(stats[Scheduler::ADMIN].mRun == 0);
+    }
+}
+
+TEST_CASE("clock runs posted actions", "[scheduler][timer]")
+{
+    VirtualClock clock;
+    std::vector<int> ran;
+    clock.postAction(Scheduler::BACKGROUND, [&]()
+                     {
+                         ran.push_back(0);
+                     });
+    clock.postAction(Scheduler::CONSENSUS, [&]()
+                     {
+                         ran.push_back(1);
+                     });
+    while (clock.crank(false) > 0)
+        ;
+    std::vector<int> expected{1, 0};
+    REQUIRE(ran == expected);
+}
@@ -17,6 +17,19 @@ StatusManager::~StatusManager()
 {
 }
 
+std::string StatusManager::categoryName(StatusCategory issue)
+{
+    switch (issue)
+    {
+    case StatusCategory::HISTORY:
+        return "history";
+    case StatusCategory::NTP:
+        return "ntp";
+    default:
+        return "unknown";
+    }
+}
+
 void StatusManager::setStatusMessage(StatusCategory issue, std::string message)
 {
     mStatusMessages[issue] = std::move(message);
@@ -40,4 +53,14 @@ std::string StatusManager::getStatusMessage(StatusCategory issue) const
     }
 }
 
+void StatusManager::setProgress(StatusCategory issue, StatusProgress progress)
+{
+    mProgress[issue] = progress;
+}
+
+void StatusManager::removeProgress(StatusCategory issue)
+{
+    mProgress.erase(issue);
+}
+
 }
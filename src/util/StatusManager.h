@@ -4,6 +4,7 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include <cstdint>
 #include <map>
 #include <string>
 
@@ -20,29 +21,49 @@ enum class StatusCategory
     NUM
 };
 
+/*
+ * Progress of a long running task, in units of work done and in total, with
+ * an estimate of the seconds left (-1 when unknown).
+ */
+struct StatusProgress
+{
+    uint64_t mDone;
+    uint64_t mTotal;
+    int64_t mETA;
+};
+
 /*
  * Class for managing status message of different categories.
- * This list is used for "status" array in info json.
+ * This list is used for "status" array in info json, progress of the
+ * categories having some goes in its "progress" object.
  */
 class StatusManager
 {
   public:
     using storage = std::map<StatusCategory, std::string>;
     using const_iterator = storage::const_iterator;
+    using progress_storage = std::map<StatusCategory, StatusProgress>;
 
     explicit StatusManager();
     ~StatusManager();
 
+    static std::string categoryName(StatusCategory issue);
+
     void setStatusMessage(StatusCategory issue, std::string message);
     void removeStatusMessage(StatusCategory issue);
     std::string getStatusMessage(StatusCategory issue) const;
 
+    void setProgress(StatusCategory issue, StatusProgress progress);
+    void removeProgress(StatusCategory issue);
+    progress_storage const& getProgress() const { return mProgress; }
+
     const_iterator begin() const { return mStatusMessages.begin(); }
     const_iterator end() const { return mStatusMessages.end(); }
     std::size_t size() const { return mStatusMessages.size(); }
 
   private:
     storage mStatusMessages;
+    progress_storage mProgress;
 };
 
 }
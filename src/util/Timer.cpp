@@ -3,6 +3,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "util/Timer.h"
+#include <algorithm>
 #include <chrono>
 #include "main/Application.h"
 #include "util/Logging.h"
@@ -16,16 +17,61 @@ using namespace std;
 
 static const uint32_t RECENT_CRANK_WINDOW = 1024;
 
+size_t const VirtualClock::CrankStats::MAX_CRANK_SAMPLES = 4096;
+
+// index of the lowest bit set in `x`, which isn't 0
+static size_t
+lowestBit(uint64_t x)
+{
+    size_t n = 0;
+    if ((x & 0xFFFFFFFFULL) == 0)
+    {
+        n += 32;
+        x >>= 32;
+    }
+    if ((x & 0xFFFF) == 0)
+    {
+        n += 16;
+        x >>= 16;
+    }
+    if ((x & 0xFF) == 0)
+    {
+        n += 8;
+        x >>= 8;
+    }
+    if ((x & 0xF) == 0)
+    {
+        n += 4;
+        x >>= 4;
+    }
+    if ((x & 0x3) == 0)
+    {
+        n += 2;
+        x >>= 2;
+    }
+    if ((x & 0x1) == 0)
+    {
+        n += 1;
+    }
+    return n;
+}
+
 VirtualClock::VirtualClock(Mode mode)
     : mRealTimer(mIOService)
     , mMode(mode)
     , mRecentCrankCount(RECENT_CRANK_WINDOW >> 1)
     , mRecentIdleCrankCount(RECENT_CRANK_WINDOW >> 1)
+    , mPendingTimers(0)
+    , mEnqueueCount(0)
+    , mNextCache(time_point::max())
+    , mNextCacheValid(true)
 {
     if (mMode == REAL_TIME)
     {
         mNow = std::chrono::system_clock::now();
     }
+    std::fill(std::begin(mWheelOccupied), std::end(mWheelOccupied), 0);
+    mWheelTick = toTick(mNow);
 }
 
 VirtualClock::time_point
@@ -62,25 +108,230 @@ VirtualClock::maybeSetRealtimer()
     }
 }
 
-bool VirtualClockEventCompare::operator()(shared_ptr<VirtualClockEvent> a,
-                                          shared_ptr<VirtualClockEvent> b)
+VirtualClock::time_point
+VirtualClock::next()
 {
-    return *a < *b;
+    assertThreadIsMain();
+    if (!mNextCacheValid)
+    {
+        // the earliest timer is in the earliest slot
+        mNextCache = time_point::max();
+        size_t level, index;
+        if (auto slot = earliestSlot(level, index))
+        {
+            for (auto t = slot->mHead; t; t = t->mNext)
+            {
+                mNextCache = std::min(mNextCache, t->mExpiryTime);
+            }
+        }
+        mNextCacheValid = true;
+    }
+    return mNextCache;
 }
 
-VirtualClock::time_point
-VirtualClock::next()
+uint64_t
+VirtualClock::toTick(time_point t)
 {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  t.time_since_epoch()).count();
+    return ms < 0 ? 0 : static_cast<uint64_t>(ms);
+}
+
+void
+VirtualClock::link(VirtualTimer& timer)
+{
+    // timers armed in the past go with those of the current tick
+    uint64_t tick = std::max(toTick(timer.mExpiryTime), mWheelTick);
+    uint64_t diff = tick ^ mWheelTick;
+    size_t level = 0;
+    while (level + 1 < WHEEL_LEVELS &&
+           (diff >> (WHEEL_BITS * (level + 1))) != 0)
+    {
+        ++level;
+    }
+    size_t index = (tick >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+
+    auto& slot = mWheel[level][index];
+    timer.mSlot = &slot;
+    timer.mPrev = slot.mTail;
+    timer.mNext = nullptr;
+    if (slot.mTail)
+    {
+        slot.mTail->mNext = &timer;
+    }
+    else
+    {
+        slot.mHead = &timer;
+    }
+    slot.mTail = &timer;
+    mWheelOccupied[level] |= uint64_t(1) << index;
+    ++mPendingTimers;
+
+    if (mNextCacheValid && timer.mExpiryTime < mNextCache)
+    {
+        mNextCache = timer.mExpiryTime;
+    }
+}
+
+void
+VirtualClock::unlink(VirtualTimer& timer)
+{
+    auto slot = timer.mSlot;
+    assert(slot);
+    if (timer.mPrev)
+    {
+        timer.mPrev->mNext = timer.mNext;
+    }
+    else
+    {
+        slot->mHead = timer.mNext;
+    }
+    if (timer.mNext)
+    {
+        timer.mNext->mPrev = timer.mPrev;
+    }
+    else
+    {
+        slot->mTail = timer.mPrev;
+    }
+    if (!slot->mHead)
+    {
+        size_t pos = static_cast<size_t>(slot - &mWheel[0][0]);
+        mWheelOccupied[pos / WHEEL_SLOTS] &=
+            ~(uint64_t(1) << (pos % WHEEL_SLOTS));
+    }
+    timer.mSlot = nullptr;
+    timer.mPrev = nullptr;
+    timer.mNext = nullptr;
+    --mPendingTimers;
+
+    if (mNextCacheValid && timer.mExpiryTime <= mNextCache)
+    {
+        mNextCacheValid = false;
+    }
+}
+
+VirtualClock::WheelSlot*
+VirtualClock::earliestSlot(size_t& level, size_t& index)
+{
+    for (level = 0; level < WHEEL_LEVELS; ++level)
+    {
+        if (mWheelOccupied[level] != 0)
+        {
+            index = lowestBit(mWheelOccupied[level]);
+            return &mWheel[level][index];
+        }
+    }
+    return nullptr;
+}
+
+// Takes the timers expiring up to `n` off the wheel, into `due`, and moves
+// the wheel on to `n`.
+void
+VirtualClock::takeDue(time_point n, std::vector<VirtualTimer*>& due)
+{
+    uint64_t target = std::max(toTick(n), mWheelTick);
+    size_t level, index;
+    while (auto slot = earliestSlot(level, index))
+    {
+        size_t shift = WHEEL_BITS * level;
+        uint64_t start =
+            ((mWheelTick >> (shift + WHEEL_BITS)) << (shift + WHEEL_BITS)) |
+            (uint64_t(index) << shift);
+        if (start > target)
+        {
+            break;
+        }
+
+        auto t = slot->mHead;
+        if (level == 0)
+        {
+            // a tick before `n`'s expires entirely, `n`'s only up to `n`
+            bool last = start == target;
+            while (t)
+            {
+                auto next = t->mNext;
+                if (!last || t->mExpiryTime <= n)
+                {
+                    unlink(*t);
+                    t->mDue = true;
+                    due.emplace_back(t);
+                }
+                t = next;
+            }
+            if (last)
+            {
+                break;
+            }
+        }
+        else
+        {
+            // no timer is earlier than this slot: spread it over the levels
+            // below
+            mWheelTick = start;
+            while (t)
+            {
+                auto next = t->mNext;
+                unlink(*t);
+                link(*t);
+                t = next;
+            }
+        }
+    }
+    mWheelTick = target;
+}
+
+void
+VirtualClock::enqueue(VirtualTimer& timer)
+{
+    if (mDestructing)
+    {
+        return;
+    }
     assertThreadIsMain();
-    VirtualClock::time_point least = time_point::max();
-    if (!mEvents.empty())
+    timer.mEnqueueSeq = mEnqueueCount++;
+    link(timer);
+    maybeSetRealtimer();
+}
+
+void
+VirtualClock::dequeue(VirtualTimer& timer)
+{
+    if (timer.mSlot)
+    {
+        unlink(timer);
+    }
+    if (timer.mDue)
     {
-        if (mEvents.top()->mWhen < least)
+        timer.mDue = false;
+        for (auto batch : mDispatching)
         {
-            least = mEvents.top()->mWhen;
+            std::replace(batch->begin(), batch->end(), &timer,
+                         static_cast<VirtualTimer*>(nullptr));
         }
     }
-    return least;
+}
+
+void
+VirtualClock::flushCrankStats(CrankStats& stats)
+{
+    stats = std::move(mCrankStats);
+    mCrankStats = CrankStats();
+}
+
+void
+VirtualClock::recordCrank(size_t nWorkDone,
+                          std::chrono::steady_clock::time_point start)
+{
+    ++mCrankStats.mCranks;
+    if (nWorkDone != 0 &&
+        mCrankStats.mHandlers.size() < CrankStats::MAX_CRANK_SAMPLES)
+    {
+        mCrankStats.mHandlers.emplace_back(static_cast<uint32_t>(nWorkDone));
+        mCrankStats.mCrankTimes.emplace_back(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start));
+    }
 }
 
 VirtualClock::time_point
@@ -145,69 +396,20 @@ VirtualClock::pointToISOString(time_point point)
     return tmToISOString(pointToTm(point));
 }
 
-void
-VirtualClock::enqueue(shared_ptr<VirtualClockEvent> ve)
-{
-    if (mDestructing)
-    {
-        return;
-    }
-    assertThreadIsMain();
-    // LOG(DEBUG) << "VirtualClock::enqueue";
-    mEvents.emplace(ve);
-    maybeSetRealtimer();
-}
-
-void
-VirtualClock::flushCancelledEvents()
-{
-    if (mDestructing)
-    {
-        return;
-    }
-    if (mFlushesIgnored <= mEvents.size())
-    {
-        // Flushing all the canceled events immediately can lead to
-        // a O(n^2) loop if many events in the queue are canceled one a time.
-        //
-        // By ignoring O(n) flushes, we batch the iterations together and
-        // restore O(n) performance.
-        mFlushesIgnored++;
-        return;
-    }
-    assertThreadIsMain();
-    // LOG(DEBUG) << "VirtualClock::cancelAllEventsFrom";
-
-    auto toKeep = vector<shared_ptr<VirtualClockEvent>>();
-    toKeep.reserve(mEvents.size());
-
-    while (!mEvents.empty())
-    {
-        auto const& e = mEvents.top();
-        if (!e->getTriggered())
-        {
-            toKeep.emplace_back(e);
-        }
-        mEvents.pop();
-    }
-    mFlushesIgnored = 0;
-    mEvents = PrQueue(toKeep.begin(), toKeep.end());
-    maybeSetRealtimer();
-}
-
 bool
 VirtualClock::cancelAllEvents()
 {
     assertThreadIsMain();
 
-    bool wasEmpty = mEvents.empty();
-    while (!mEvents.empty())
+    bool wasEmpty = mPendingTimers == 0;
+    size_t level, index;
+    while (auto slot = earliestSlot(level, index))
     {
-        auto ev = mEvents.top();
-        mEvents.pop();
-        ev->cancel();
+        // the timers stay armed: they may be waited on again
+        auto t = slot->mHead;
+        unlink(*t);
+        t->fire(asio::error::operation_aborted);
     }
-    mEvents = PrQueue();
     return !wasEmpty;
 }
 
@@ -236,6 +438,7 @@ VirtualClock::crank(bool block)
     {
         return 0;
     }
+    auto start = std::chrono::steady_clock::now();
     nRealTimerCancelEvents = 0;
     size_t nWorkDone = 0;
 
@@ -266,6 +469,8 @@ VirtualClock::crank(bool block)
         nWorkDone += advanceToNext();
     }
 
+    recordCrank(nWorkDone, start);
+
     if (block && nWorkDone == 0)
     {
         nWorkDone += mIOService.run_one();
@@ -276,6 +481,36 @@ VirtualClock::crank(bool block)
     return nWorkDone;
 }
 
+size_t
+VirtualClock::crankUpTo(time_point limit)
+{
+    if (mDestructing)
+    {
+        return 0;
+    }
+    assert(mMode == VIRTUAL_TIME);
+    size_t nWorkDone = 0;
+    for (;;)
+    {
+        size_t lastPoll = mIOService.poll_one();
+        nWorkDone += lastPoll;
+        if (lastPoll == 0)
+        {
+            if (mPendingTimers == 0 || next() > limit)
+            {
+                break;
+            }
+            nWorkDone += advanceTo(next());
+        }
+        noteCrankOccurred(lastPoll == 0);
+    }
+    if (mNow < limit)
+    {
+        mNow = limit;
+    }
+    return nWorkDone;
+}
+
 void
 VirtualClock::noteCrankOccurred(bool hadIdle)
 {
@@ -331,6 +566,23 @@ VirtualClock::getIOService()
     return mIOService;
 }
 
+void
+VirtualClock::postAction(Scheduler::ActionClass c, std::function<void()>&& f)
+{
+    mScheduler.enqueue(c, std::move(f));
+    // one handler per action, each running whichever action is next by then
+    mIOService.post([this]()
+                    {
+                        mScheduler.runOne();
+                    });
+}
+
+Scheduler&
+VirtualClock::getScheduler()
+{
+    return mScheduler;
+}
+
 VirtualClock::~VirtualClock()
 {
     mDestructing = true;
@@ -346,27 +598,58 @@ VirtualClock::advanceTo(time_point n)
     }
     assertThreadIsMain();
 
-    // LOG(DEBUG) << "VirtualClock::advanceTo("
-    //            << n.time_since_epoch().count() << ")";
     mNow = n;
-    vector<shared_ptr<VirtualClockEvent>> toDispatch;
-    while (!mEvents.empty())
+    vector<VirtualTimer*> toDispatch;
+    takeDue(n, toDispatch);
+    std::sort(toDispatch.begin(), toDispatch.end(),
+              [](VirtualTimer const* a, VirtualTimer const* b)
+              {
+                  return a->mExpiryTime < b->mExpiryTime ||
+                         (a->mExpiryTime == b->mExpiryTime &&
+                          a->mEnqueueSeq < b->mEnqueueSeq);
+              });
+
+    // Keep the dispatch loop separate from taking timers off the wheel so
+    // that callbacks arming timers can't have them fire right away. Those
+    // cancelling or destroying timers of toDispatch take them out of it.
+    size_t const nDispatched = toDispatch.size();
+    mDispatching.emplace_back(&toDispatch);
+    try
     {
-        if (mEvents.top()->mWhen > mNow)
-            break;
-        toDispatch.push_back(mEvents.top());
-        mEvents.pop();
+        for (auto& t : toDispatch)
+        {
+            if (t)
+            {
+                auto timer = t;
+                t = nullptr;
+                if (mNow > timer->mExpiryTime &&
+                    mCrankStats.mTimerLags.size() <
+                        CrankStats::MAX_CRANK_SAMPLES)
+                {
+                    mCrankStats.mTimerLags.emplace_back(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            mNow - timer->mExpiryTime));
+                }
+                timer->fire(asio::error_code());
+            }
+        }
     }
-    // Keep the dispatch loop separate from the pop()-ing loop
-    // so the triggered events can't mutate the priority queue
-    // from underneat us while we are looping.
-    for (auto ev : toDispatch)
+    catch (...)
     {
-        ev->trigger();
+        // the timers left keep their callbacks, as if never armed
+        for (auto t : toDispatch)
+        {
+            if (t)
+            {
+                t->mDue = false;
+            }
+        }
+        mDispatching.pop_back();
+        throw;
     }
-    // LOG(DEBUG) << "VirtualClock::advanceTo done";
+    mDispatching.pop_back();
     maybeSetRealtimer();
-    return toDispatch.size();
+    return nDispatched;
 }
 
 size_t
@@ -378,61 +661,13 @@ VirtualClock::advanceToNext()
     }
     assert(mMode == VIRTUAL_TIME);
     assertThreadIsMain();
-    if (mEvents.empty())
+    if (mPendingTimers == 0)
     {
         return 0;
     }
     return advanceTo(next());
 }
 
-VirtualClockEvent::VirtualClockEvent(
-    VirtualClock::time_point when,
-    size_t seq,
-    std::function<void(asio::error_code)> callback)
-    : mCallback(callback), mTriggered(false), mWhen(when), mSeq(seq)
-{
-}
-
-bool
-VirtualClockEvent::getTriggered()
-{
-    return mTriggered;
-}
-void
-VirtualClockEvent::trigger()
-{
-    if (!mTriggered)
-    {
-        mTriggered = true;
-        mCallback(asio::error_code());
-        mCallback = nullptr;
-    }
-}
-
-void
-VirtualClockEvent::cancel()
-{
-    if (!mTriggered)
-    {
-        mTriggered = true;
-        mCallback(asio::error::operation_aborted);
-        mCallback = nullptr;
-    }
-}
-
-bool VirtualClockEvent::operator<(VirtualClockEvent const& other) const
-{
-    // For purposes of priority queue, a timer is "less than"
-    // another timer if it occurs in the future (has a higher
-    // expiry time). The "greatest" timer is timer 0.
-    // To break time-based ties (but preserve the ordering in which
-    // events were enqueued) we add an event-sequence number as well,
-    // such that a higher sequence number makes an event "less than"
-    // another.
-    return mWhen > other.mWhen || (mWhen == other.mWhen &&
-                                   mSeq > other.mSeq);
-}
-
 VirtualTimer::VirtualTimer(Application& app) : VirtualTimer(app.getClock())
 {
 }
@@ -442,6 +677,11 @@ VirtualTimer::VirtualTimer(VirtualClock& clock)
     , mExpiryTime(mClock.now())
     , mCancelled(false)
     , mDeleting(false)
+    , mSlot(nullptr)
+    , mPrev(nullptr)
+    , mNext(nullptr)
+    , mDue(false)
+    , mEnqueueSeq(0)
 {
 }
 
@@ -451,18 +691,31 @@ VirtualTimer::~VirtualTimer()
     cancel();
 }
 
+void
+VirtualTimer::fire(asio::error_code const& ec)
+{
+    mDue = false;
+    // callbacks may arm this timer again, or destroy it
+    std::vector<std::function<void(asio::error_code)>> callbacks;
+    callbacks.swap(mCallbacks);
+    for (auto const& cb : callbacks)
+    {
+        cb(ec);
+    }
+}
+
 void
 VirtualTimer::cancel()
 {
     if (!mCancelled)
     {
         mCancelled = true;
-        for (auto ev : mEvents)
+        // a timer with nothing waiting may outlive its clock
+        if (mSlot || mDue)
         {
-            ev->cancel();
+            mClock.dequeue(*this);
         }
-        mClock.flushCancelledEvents();
-        mEvents.clear();
+        fire(asio::error::operation_aborted);
     }
 }
 
@@ -472,12 +725,6 @@ VirtualTimer::expiry_time() const
     return mExpiryTime;
 }
 
-size_t
-VirtualTimer::seq() const
-{
-    return mEvents.empty() ? 0 : mEvents.back()->mSeq + 1;
-}
-
 void
 VirtualTimer::expires_at(VirtualClock::time_point t)
 {
@@ -500,9 +747,11 @@ VirtualTimer::async_wait(function<void(asio::error_code)> const& fn)
     if (!mCancelled)
     {
         assert(!mDeleting);
-        auto ve = make_shared<VirtualClockEvent>(mExpiryTime, seq(), fn);
-        mClock.enqueue(ve);
-        mEvents.push_back(ve);
+        mCallbacks.emplace_back(fn);
+        if (!mSlot && !mDue)
+        {
+            mClock.enqueue(*this);
+        }
     }
 }
 
@@ -510,20 +759,12 @@ void
 VirtualTimer::async_wait(std::function<void()> const& onSuccess,
                          std::function<void(asio::error_code)> const& onFailure)
 {
-    if (!mCancelled)
-    {
-        assert(!mDeleting);
-        auto ve = make_shared<VirtualClockEvent>(
-            mExpiryTime, seq(),
-            [onSuccess, onFailure](asio::error_code error)
-            {
-                if (error)
-                    onFailure(error);
-                else
-                    onSuccess();
-            });
-        mClock.enqueue(ve);
-        mEvents.push_back(ve);
-    }
+    async_wait([onSuccess, onFailure](asio::error_code error)
+               {
+                   if (error)
+                       onFailure(error);
+                   else
+                       onSuccess();
+               });
 }
 }
@@ -9,13 +9,16 @@
 // else.
 #include "util/asio.h"
 #include "util/NonCopyable.h"
+#include "util/Scheduler.h"
 
 #include <chrono>
+#include <cstdint>
 #include <queue>
 #include <map>
 #include <memory>
 #include <functional>
 #include <ctime>
+#include <vector>
 
 namespace stellar
 {
@@ -47,13 +50,6 @@ namespace stellar
 
 class VirtualTimer;
 class Application;
-class VirtualClockEvent;
-class VirtualClockEventCompare
-{
-  public:
-    bool operator()(std::shared_ptr<VirtualClockEvent> a,
-                    std::shared_ptr<VirtualClockEvent> b);
-};
 
 class VirtualClock
 {
@@ -101,6 +97,23 @@ class VirtualClock
         VIRTUAL_TIME
     };
 
+    // What the clock did since the last call to flushCrankStats: kept here as
+    // the clock may be shared by several applications, the first one to
+    // flush claims them (see ApplicationImpl::syncOwnMetrics). Samples past
+    // MAX_CRANK_SAMPLES are dropped until the next flush.
+    struct CrankStats
+    {
+        static size_t const MAX_CRANK_SAMPLES;
+
+        uint64_t mCranks{0};
+        // handlers (IO and timers) run by each crank that ran any
+        std::vector<uint32_t> mHandlers;
+        // time each crank that ran handlers took, waiting for work excluded
+        std::vector<std::chrono::nanoseconds> mCrankTimes;
+        // how late each timer fired
+        std::vector<std::chrono::nanoseconds> mTimerLags;
+    };
+
   private:
     asio::io_service mIOService;
     asio::basic_waitable_timer<std::chrono::system_clock> mRealTimer;
@@ -112,21 +125,56 @@ class VirtualClock
     size_t nRealTimerCancelEvents;
     time_point mNow;
 
-    using PrQueue =
-        std::priority_queue<std::shared_ptr<VirtualClockEvent>,
-                            std::vector<std::shared_ptr<VirtualClockEvent>>,
-                            VirtualClockEventCompare>;
-    PrQueue mEvents;
-    size_t mFlushesIgnored = 0;
+    // Timers with callbacks waiting, in a hierarchical timing wheel: level l
+    // has WHEEL_SLOTS slots of WHEEL_SLOTS^l ticks (milliseconds) each. A
+    // timer sits at the lowest level at which its tick and mWheelTick share
+    // all the higher digits (base WHEEL_SLOTS), in the slot of its own digit
+    // at that level: lower levels hold earlier timers, lower slots earlier
+    // ones, and no slot ever holds timers from before mWheelTick. Arming and
+    // cancelling a timer links and unlinks it from a slot's list; advancing
+    // the clock moves those of the slots it reaches down to lower levels.
+    static size_t const WHEEL_BITS = 6;
+    static size_t const WHEEL_SLOTS = size_t(1) << WHEEL_BITS;
+    static size_t const WHEEL_LEVELS = 9;
+    struct WheelSlot
+    {
+        VirtualTimer* mHead{nullptr};
+        VirtualTimer* mTail{nullptr};
+    };
+    WheelSlot mWheel[WHEEL_LEVELS][WHEEL_SLOTS];
+    // for each level, which of its slots hold timers
+    uint64_t mWheelOccupied[WHEEL_LEVELS];
+    uint64_t mWheelTick;
+    size_t mPendingTimers;
+    uint64_t mEnqueueCount;
+    // next() as last computed, if still valid
+    time_point mNextCache;
+    bool mNextCacheValid;
+    // timers taken off the wheel by advanceTo and not fired yet
+    std::vector<std::vector<VirtualTimer*>*> mDispatching;
+
+    CrankStats mCrankStats;
+    Scheduler mScheduler;
 
     bool mDestructing{false};
 
-    time_point next();
     void maybeSetRealtimer();
     size_t advanceTo(time_point n);
     size_t advanceToNext();
     size_t advanceToNow();
 
+    static uint64_t toTick(time_point t);
+    void link(VirtualTimer& timer);
+    void unlink(VirtualTimer& timer);
+    WheelSlot* earliestSlot(size_t& level, size_t& index);
+    void takeDue(time_point n, std::vector<VirtualTimer*>& due);
+    void recordCrank(size_t nWorkDone,
+                     std::chrono::steady_clock::time_point start);
+
+    friend class VirtualTimer;
+    void enqueue(VirtualTimer& timer);
+    void dequeue(VirtualTimer& timer);
+
   public:
     // A VirtualClock is instantiated in either real or virtual mode. In real
     // mode, crank() sleeps until the next event, either timer or IO; in virtual
@@ -136,41 +184,40 @@ class VirtualClock
     VirtualClock(Mode mode = VIRTUAL_TIME);
     ~VirtualClock();
     size_t crank(bool block = true);
+
+    // only valid with VIRTUAL_TIME: runs IO work and timers until there is
+    // no IO work left and the next timer is past `limit`, then sets the
+    // clock to `limit`. Unlike crank(), never skips past `limit`; used to
+    // advance clocks in lockstep.
+    size_t crankUpTo(time_point limit);
     void noteCrankOccurred(bool hadIdle);
     uint32_t recentIdleCrankPercent() const;
     asio::io_service& getIOService();
 
+    // Queues `f` to run on the main thread as work of class `c`, ahead of the
+    // work of lighter classes queued before (see Scheduler). May be called
+    // from any thread.
+    void postAction(Scheduler::ActionClass c, std::function<void()>&& f);
+    Scheduler& getScheduler();
+
     // Note: this is not a static method, which means that VirtualClock is
     // not an implementation of the C++ `Clock` concept; there is no global
     // virtual time. Each virtual clock has its own time.
     time_point now() noexcept;
 
-    void enqueue(std::shared_ptr<VirtualClockEvent> ve);
-    void flushCancelledEvents();
+    // time of the earliest pending event, time_point::max() if none
+    time_point next();
+
     bool cancelAllEvents();
 
+    // moves the stats gathered since the last call into `stats`
+    void flushCrankStats(CrankStats& stats);
+
     // only valid with VIRTUAL_TIME: sets the current value
     // of the clock
     void setCurrentTime(time_point t);
 };
 
-class VirtualClockEvent : public NonMovableOrCopyable
-{
-    std::function<void(asio::error_code)> mCallback;
-    bool mTriggered;
-
-  public:
-    VirtualClock::time_point mWhen;
-    size_t mSeq;
-    VirtualClockEvent(VirtualClock::time_point when,
-                      size_t seq,
-                      std::function<void(asio::error_code)> callback);
-    bool getTriggered();
-    void trigger();
-    void cancel();
-    bool operator<(VirtualClockEvent const& other) const;
-};
-
 /**
  * This is the class you probably want to use: it is coupled with a
  * VirtualClock, so advances with per-VirtualClock simulated time, and therefore
@@ -178,19 +225,32 @@ class VirtualClockEvent : public NonMovableOrCopyable
  */
 class VirtualTimer : private NonMovableOrCopyable
 {
+    friend class VirtualClock;
+
     VirtualClock& mClock;
     VirtualClock::time_point mExpiryTime;
-    std::vector<std::shared_ptr<VirtualClockEvent>> mEvents;
+    // waiting for mExpiryTime, in async_wait order
+    std::vector<std::function<void(asio::error_code)>> mCallbacks;
     bool mCancelled;
     bool mDeleting;
 
+    // while callbacks are waiting: the wheel slot of the clock this timer is
+    // linked in, or mDue once advanceTo took it off to fire it
+    VirtualClock::WheelSlot* mSlot;
+    VirtualTimer* mPrev;
+    VirtualTimer* mNext;
+    bool mDue;
+    // order of arming, breaking ties between timers expiring together
+    uint64_t mEnqueueSeq;
+
+    void fire(asio::error_code const& ec);
+
   public:
     VirtualTimer(Application& app);
     VirtualTimer(VirtualClock& app);
     ~VirtualTimer();
 
     VirtualClock::time_point const& expiry_time() const;
-    size_t seq() const;
     void expires_at(VirtualClock::time_point t);
     void expires_from_now(VirtualClock::duration d);
     template <typename R, typename P>
@@ -242,3 +242,65 @@ TEST_CASE("timer cancels", "[timer]")
     REQUIRE(timerFired == 8);
     REQUIRE(timerCancelled == 2);
 }
+
+TEST_CASE("timers fire in order at their exact time", "[timer]")
+{
+    VirtualClock clock;
+    auto start = clock.now();
+
+    // from under a millisecond to years away, some expiring together
+    std::vector<VirtualClock::duration> delays;
+    for (auto d : {0, 1, 999, 1000, 1001, 63999, 64000, 4096000})
+    {
+        delays.emplace_back(std::chrono::microseconds(d));
+        delays.emplace_back(std::chrono::seconds(d));
+    }
+    delays.emplace_back(std::chrono::hours(24 * 365 * 20));
+    delays.emplace_back(std::chrono::nanoseconds(1));
+
+    std::vector<std::unique_ptr<VirtualTimer>> timers;
+    std::vector<std::pair<VirtualClock::time_point, size_t>> fired;
+    auto arm = [&](size_t i)
+    {
+        timers[i]->expires_at(start + delays[i]);
+        timers[i]->async_wait([&, i](asio::error_code const& ec)
+                              {
+                                  if (!ec)
+                                  {
+                                      fired.emplace_back(clock.now(), i);
+                                  }
+                              });
+    };
+    for (size_t i = 0; i < delays.size(); i++)
+    {
+        timers.push_back(make_unique<VirtualTimer>(clock));
+        arm(i);
+    }
+    // the earliest, cancelled, is not waited for
+    timers.back()->cancel();
+    REQUIRE(clock.next() == start);
+    // re-arming takes the timer out of where it was
+    arm(2);
+    arm(2);
+
+    while (clock.crank(false) > 0)
+        ;
+    REQUIRE(fired.size() == delays.size() - 1);
+    for (size_t j = 0; j < fired.size(); j++)
+    {
+        auto i = fired[j].second;
+        REQUIRE(fired[j].first == start + delays[i]);
+        if (j > 0)
+        {
+            REQUIRE(fired[j - 1].first <= fired[j].first);
+        }
+    }
+    REQUIRE(clock.next() == VirtualClock::time_point::max());
+
+    VirtualClock::CrankStats stats;
+    clock.flushCrankStats(stats);
+    REQUIRE(stats.mCranks > 0);
+    REQUIRE(!stats.mHandlers.empty());
+    clock.flushCrankStats(stats);
+    REQUIRE(stats.mCranks == 0);
+}
@@ -99,9 +99,11 @@ class XDROutputFileStream
     }
 
     void
-    open(std::string const& filename)
+    open(std::string const& filename, bool append = false)
     {
-        mOut.open(filename, std::ofstream::binary | std::ofstream::trunc);
+        mOut.open(filename, std::ofstream::binary |
+                                (append ? std::ofstream::app
+                                        : std::ofstream::trunc));
         if (!mOut)
         {
             std::string msg("failed to open XDR file: ");
@@ -118,6 +120,12 @@ class XDROutputFileStream
         return mOut.good();
     }
 
+    bool
+    flush()
+    {
+        return static_cast<bool>(mOut.flush());
+    }
+
     template <typename T>
     bool
     writeOne(T const& t, SHA256* hasher = nullptr, size_t* bytesPut = nullptr)
@@ -154,5 +162,38 @@ class XDROutputFileStream
         }
         return true;
     }
+
+    // Same framing as writeOne, for a record the caller already holds in its
+    // XDR-encoded form.
+    bool
+    writeEncoded(ByteSlice const& encoded, SHA256* hasher = nullptr,
+                 size_t* bytesPut = nullptr)
+    {
+        uint32_t sz = (uint32_t)encoded.size();
+        assert(sz < 0x80000000);
+        assert(sz % 4 == 0);
+
+        char szBuf[4];
+        szBuf[0] = static_cast<char>((sz >> 24) & 0xFF) | '\x80';
+        szBuf[1] = static_cast<char>((sz >> 16) & 0xFF);
+        szBuf[2] = static_cast<char>((sz >> 8) & 0xFF);
+        szBuf[3] = static_cast<char>(sz & 0xFF);
+
+        if (!mOut.write(szBuf, 4) ||
+            !mOut.write(reinterpret_cast<char const*>(encoded.data()), sz))
+        {
+            return false;
+        }
+        if (hasher)
+        {
+            hasher->add(ByteSlice(szBuf, 4));
+            hasher->add(encoded);
+        }
+        if (bytesPut)
+        {
+            *bytesPut += (sz + 4);
+        }
+        return true;
+    }
 };
 }
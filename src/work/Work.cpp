@@ -5,6 +5,7 @@
 #include "main/Application.h"
 #include "work/Work.h"
 #include "work/WorkParent.h"
+#include "work/WorkManager.h"
 #include "lib/util/format.h"
 #include "util/Logging.h"
 #include "util/make_unique.h"
@@ -24,6 +25,7 @@ Work::Work(Application& app, WorkParent& parent, std::string uniqueName,
     , mParent(parent.shared_from_this())
     , mUniqueName(uniqueName)
     , mMaxRetries(maxRetries)
+    , mCreatedAt(app.getClock().now())
 {
 }
 
@@ -135,18 +137,23 @@ Work::callComplete()
 void
 Work::scheduleRun()
 {
+    if (mRunScheduled)
+    {
+        return;
+    }
+    mRunScheduled = true;
     std::weak_ptr<Work> weak(
         std::static_pointer_cast<Work>(shared_from_this()));
     CLOG(DEBUG, "Work") << "scheduling run of " << getUniqueName();
-    mApp.getClock().getIOService().post([weak]()
-                                        {
-                                            auto self = weak.lock();
-                                            if (!self)
-                                            {
-                                                return;
-                                            }
-                                            self->run();
-                                        });
+    mApp.getClock().postAction(Scheduler::BACKGROUND, [weak]()
+                               {
+                                   auto self = weak.lock();
+                                   if (!self)
+                                   {
+                                       return;
+                                   }
+                                   self->run();
+                               });
 }
 
 void
@@ -155,15 +162,15 @@ Work::scheduleComplete(asio::error_code ec)
     std::weak_ptr<Work> weak(
         std::static_pointer_cast<Work>(shared_from_this()));
     CLOG(DEBUG, "Work") << "scheduling completion of " << getUniqueName();
-    mApp.getClock().getIOService().post([weak, ec]()
-                                        {
-                                            auto self = weak.lock();
-                                            if (!self)
-                                            {
-                                                return;
-                                            }
-                                            self->complete(ec);
-                                        });
+    mApp.getClock().postAction(Scheduler::BACKGROUND, [weak, ec]()
+                               {
+                                   auto self = weak.lock();
+                                   if (!self)
+                                   {
+                                       return;
+                                   }
+                                   self->complete(ec);
+                               });
 }
 
 void
@@ -209,10 +216,89 @@ void
 Work::reset()
 {
     CLOG(DEBUG, "Work") << "resetting " << getUniqueName();
+    releaseResource();
     setState(WORK_PENDING);
     onReset();
 }
 
+bool
+Work::isReady() const
+{
+    return true;
+}
+
+void
+Work::getProgress(uint64_t& done, uint64_t& total) const
+{
+    done = 0;
+    total = 1;
+    for (auto const& c : mChildren)
+    {
+        uint64_t d, t;
+        c.second->getProgress(d, t);
+        done += d;
+        total += t;
+    }
+    if (mState == WORK_SUCCESS)
+    {
+        done = total;
+    }
+}
+
+bool
+Work::getETA(uint64_t& seconds) const
+{
+    uint64_t done, total;
+    getProgress(done, total);
+    if (done == 0 || total < done)
+    {
+        return false;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+        mApp.getClock().now() - mCreatedAt);
+    seconds = static_cast<uint64_t>(elapsed.count()) * (total - done) / done;
+    return true;
+}
+
+void
+Work::addDependency(std::shared_ptr<Work> other)
+{
+    assert(other.get() != this);
+    assert(other->mParent.lock() == mParent.lock());
+    mDependencies.push_back(other);
+}
+
+bool
+Work::dependenciesSuccessful() const
+{
+    for (auto const& d : mDependencies)
+    {
+        auto w = d.lock();
+        if (w && w->getState() != WORK_SUCCESS)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+Work::acquireResource()
+{
+    if (mResource == RESOURCE_NONE || mResourceToken)
+    {
+        return true;
+    }
+    mResourceToken = mApp.getWorkManager().tryAcquireResource(mResource);
+    return static_cast<bool>(mResourceToken);
+}
+
+void
+Work::releaseResource()
+{
+    mResourceToken.reset();
+}
+
 void
 Work::advance()
 {
@@ -221,10 +307,22 @@ Work::advance()
         return;
     }
 
+    if (!dependenciesSuccessful() || !isReady())
+    {
+        CLOG(DEBUG, "Work") << getUniqueName() << " not ready to advance";
+        return;
+    }
+
     CLOG(DEBUG, "Work") << "advancing " << getUniqueName();
     advanceChildren();
     if (allChildrenSuccessful())
     {
+        if (!acquireResource())
+        {
+            CLOG(DEBUG, "Work") << getUniqueName()
+                                << " waiting for resource " << mResource;
+            return;
+        }
         CLOG(DEBUG, "Work") << "all " << mChildren.size()
                             << " children of " << getUniqueName()
                             << " successful, scheduling run";
@@ -242,6 +340,7 @@ Work::advance()
 void
 Work::run()
 {
+    mRunScheduled = false;
     if (getState() == WORK_PENDING)
     {
         CLOG(DEBUG, "Work") << "starting " << getUniqueName();
@@ -272,6 +371,12 @@ Work::complete(asio::error_code const& ec)
         setState(onSuccess());
     }
 
+    // keep the resource only while running in steps
+    if (getState() != WORK_RUNNING)
+    {
+        releaseResource();
+    }
+
     switch (getState())
     {
     case WORK_SUCCESS:
@@ -393,8 +498,8 @@ Work::notify(std::string const& child)
         CLOG(ERROR, "Work") << "work " << getUniqueName()
                             << " notified by unknown child " << child;
     }
-    CLOG(DEBUG, "Work") << "notified " << getUniqueName()
-                        << " of completed child " << child;
+    CLOG(DEBUG, "Work") << "notified " << getUniqueName() << " by child "
+                        << child;
     advance();
 }
 }
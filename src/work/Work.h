@@ -9,6 +9,7 @@
 #include <memory>
 #include <string>
 #include <map>
+#include <vector>
 
 namespace stellar
 {
@@ -28,6 +29,20 @@ class WorkParent;
  * copies of each of these facets of work-management. 'Work' is an attempt
  * to make those facets uniform, systematic, and out-of-the-way of the
  * logic of each piece of work.
+ *
+ * Beyond the parent/child relation, work forms a DAG:
+ *
+ *  - A work can depend on siblings (addDependency): it is not started before
+ *    they all succeeded, while unrelated siblings run in parallel.
+ *  - A work can wait on partial results of a sibling (isReady), which
+ *    signals progress by notifying its parent (see BatchDownloadWork and
+ *    ApplyLedgerChainWork), so that stages can overlap.
+ *  - A work can claim a unit of a resource class (mResource) while it runs;
+ *    the WorkManager holds a budget per class and starts waiting work as
+ *    units are released.
+ *
+ * Progress is accounted in abstract units (getProgress), from which the
+ * time left is extrapolated (getETA).
  */
 
 class Work : public WorkParent
@@ -48,6 +63,16 @@ class Work : public WorkParent
         WORK_FAILURE_RAISE
     };
 
+    enum Resource
+    {
+        RESOURCE_NONE,
+        RESOURCE_NETWORK,
+        RESOURCE_CPU,
+        RESOURCE_DISK,
+        RESOURCE_DB,
+        RESOURCE_COUNT
+    };
+
     Work(Application& app, WorkParent& parent, std::string uniqueName,
          size_t maxRetries = RETRY_A_FEW);
 
@@ -80,6 +105,22 @@ class Work : public WorkParent
     // passed, WORK_FAILURE_RETRY means WORK_FAILURE_RAISE anyways.
     virtual State onSuccess();
 
+    // Whether this work can start (or go on, after returning WORK_PENDING
+    // from onSuccess) regardless of its children and dependencies; override
+    // to wait on partial results of another work.
+    virtual bool isReady() const;
+
+    // Units of work done and in total. By default: one unit for this work,
+    // plus those of its current children.
+    virtual void getProgress(uint64_t& done, uint64_t& total) const;
+
+    // Seconds left, extrapolated from the progress made since this work was
+    // created. Returns false if no progress was made yet.
+    bool getETA(uint64_t& seconds) const;
+
+    // Do not start this work before `other` (a sibling) succeeded.
+    void addDependency(std::shared_ptr<Work> other);
+
     static std::string stateName(State st);
     State getState() const;
     bool isDone() const;
@@ -92,9 +133,18 @@ class Work : public WorkParent
     size_t mMaxRetries{RETRY_A_FEW};
     size_t mRetries{0};
     State mState{WORK_PENDING};
+    Resource mResource{RESOURCE_NONE};
+    std::shared_ptr<void> mResourceToken;
+    std::vector<std::weak_ptr<Work>> mDependencies;
+    VirtualClock::time_point mCreatedAt;
+    bool mRunScheduled{false};
 
     std::unique_ptr<VirtualTimer> mRetryTimer;
 
+    bool dependenciesSuccessful() const;
+    bool acquireResource();
+    void releaseResource();
+
     std::function<void(asio::error_code const& ec)> callComplete();
     void run();
     void complete(asio::error_code const& ec);
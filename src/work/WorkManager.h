@@ -21,10 +21,25 @@ namespace stellar
  */
 class WorkManager : public WorkParent
 {
+    struct ResourceBudgets;
+    std::shared_ptr<ResourceBudgets> mResourceBudgets;
+
   public:
     WorkManager(Application& app);
     virtual ~WorkManager();
     static std::shared_ptr<WorkManager> create(Application& app);
     virtual void notify(std::string const& changed) = 0;
+
+    // Number of work items of class `res` allowed to run at the same time.
+    // Defaults: MAX_CONCURRENT_SUBPROCESSES for the network, one per core for
+    // CPU, 2 for disk and 1 for the database.
+    void setResourceBudget(Work::Resource res, size_t budget);
+    size_t getResourceBudget(Work::Resource res) const;
+    size_t getResourceUsage(Work::Resource res) const;
+
+    // Returns a token holding a unit of `res` until it is destroyed, or
+    // nullptr if the budget is used up; in that case all work is advanced
+    // again once a unit is released.
+    std::shared_ptr<void> tryAcquireResource(Work::Resource res);
 };
 }
@@ -2,6 +2,7 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "main/Config.h"
 #include "work/Work.h"
 #include "work/WorkParent.h"
 #include "work/WorkManager.h"
@@ -14,17 +15,114 @@
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
 
+#include <algorithm>
+#include <array>
+#include <thread>
+
 namespace stellar
 {
 
-WorkManager::WorkManager(Application& app) : WorkParent(app)
+// Shared with the resource tokens handed out, which can outlive the
+// WorkManager.
+struct WorkManager::ResourceBudgets
+{
+    asio::io_service& mIOService;
+    std::weak_ptr<WorkParent> mManager;
+    std::array<size_t, Work::RESOURCE_COUNT> mBudget;
+    std::array<size_t, Work::RESOURCE_COUNT> mUsed;
+    std::array<bool, Work::RESOURCE_COUNT> mContended;
+
+    explicit ResourceBudgets(asio::io_service& ioService)
+        : mIOService(ioService)
+    {
+        mBudget.fill(0);
+        mUsed.fill(0);
+        mContended.fill(false);
+    }
+
+    void
+    release(Work::Resource res)
+    {
+        assert(mUsed[res] > 0);
+        --mUsed[res];
+        if (mContended[res])
+        {
+            mContended[res] = false;
+            std::weak_ptr<WorkParent> weak(mManager);
+            mIOService.post([weak]()
+                            {
+                                auto self = weak.lock();
+                                if (self)
+                                {
+                                    self->advanceChildren();
+                                }
+                            });
+        }
+    }
+};
+
+WorkManager::WorkManager(Application& app)
+    : WorkParent(app)
+    , mResourceBudgets(
+          std::make_shared<ResourceBudgets>(app.getClock().getIOService()))
 {
+    auto& budget = mResourceBudgets->mBudget;
+    budget[Work::RESOURCE_NETWORK] =
+        std::max<size_t>(1, app.getConfig().MAX_CONCURRENT_SUBPROCESSES);
+    budget[Work::RESOURCE_CPU] =
+        std::max<size_t>(1, std::thread::hardware_concurrency());
+    budget[Work::RESOURCE_DISK] = 2;
+    budget[Work::RESOURCE_DB] = 1;
 }
 
 WorkManager::~WorkManager()
 {
 }
 
+void
+WorkManager::setResourceBudget(Work::Resource res, size_t budget)
+{
+    assert(res != Work::RESOURCE_NONE && res < Work::RESOURCE_COUNT);
+    assert(budget > 0);
+    mResourceBudgets->mBudget[res] = budget;
+    advanceChildren();
+}
+
+size_t
+WorkManager::getResourceBudget(Work::Resource res) const
+{
+    return mResourceBudgets->mBudget[res];
+}
+
+size_t
+WorkManager::getResourceUsage(Work::Resource res) const
+{
+    return mResourceBudgets->mUsed[res];
+}
+
+std::shared_ptr<void>
+WorkManager::tryAcquireResource(Work::Resource res)
+{
+    assert(res != Work::RESOURCE_NONE && res < Work::RESOURCE_COUNT);
+    auto budgets = mResourceBudgets;
+    if (budgets->mUsed[res] >= budgets->mBudget[res])
+    {
+        budgets->mContended[res] = true;
+        return nullptr;
+    }
+    if (budgets->mManager.expired())
+    {
+        budgets->mManager = shared_from_this();
+    }
+    ++budgets->mUsed[res];
+    // the token points to the budgets only to be non-null, releasing is
+    // done by the deleter
+    return std::shared_ptr<void>(budgets.get(), [budgets, res](void*)
+                                 {
+                                     budgets->release(res);
+                                 });
+}
+
 WorkManagerImpl::WorkManagerImpl(Application& app) : WorkManager(app)
 {
 }
@@ -10,6 +10,7 @@
 #include "util/Fs.h"
 #include "process/ProcessManager.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <xdrpp/autocheck.h>
 #include <fstream>
@@ -96,3 +97,126 @@ TEST_CASE("work steps", "[work]")
         clock.crank();
     }
 }
+
+class RecordingWork : public Work
+{
+    std::vector<std::string>& mRecord;
+    size_t mSteps;
+
+  public:
+    RecordingWork(Application& app, WorkParent& parent, std::string name,
+                  std::vector<std::string>& record,
+                  Work::Resource resource = RESOURCE_NONE, size_t steps = 1)
+        : Work(app, parent, name), mRecord(record), mSteps(steps)
+    {
+        mResource = resource;
+    }
+
+    virtual void
+    onRun() override
+    {
+        scheduleComplete();
+    }
+
+    virtual Work::State
+    onSuccess() override
+    {
+        if (--mSteps > 0)
+        {
+            return WORK_RUNNING;
+        }
+        mRecord.push_back(getUniqueName());
+        return WORK_SUCCESS;
+    }
+};
+
+TEST_CASE("work dependencies", "[work]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer appPtr = Application::create(clock, cfg);
+    auto& wm = appPtr->getWorkManager();
+
+    std::vector<std::string> record;
+    auto w = wm.addWork<CountDownWork>(0);
+    auto c = w->addWork<RecordingWork>("c", record, Work::RESOURCE_NONE, 2);
+    auto b = w->addWork<RecordingWork>("b", record, Work::RESOURCE_NONE, 5);
+    auto a = w->addWork<RecordingWork>("a", record, Work::RESOURCE_NONE, 10);
+    c->addDependency(b);
+    b->addDependency(a);
+    wm.advanceChildren();
+    while (!wm.allChildrenSuccessful())
+    {
+        clock.crank();
+    }
+    REQUIRE(record == std::vector<std::string>{"a", "b", "c"});
+}
+
+TEST_CASE("work resource budget", "[work]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer appPtr = Application::create(clock, cfg);
+    auto& wm = appPtr->getWorkManager();
+
+    size_t budget = 0;
+    SECTION("one at a time")
+    {
+        budget = 1;
+    }
+    SECTION("two at a time")
+    {
+        budget = 2;
+    }
+    wm.setResourceBudget(Work::RESOURCE_DB, budget);
+
+    std::vector<std::string> record;
+    auto w = wm.addWork<CountDownWork>(0);
+    for (size_t i = 0; i < 5; ++i)
+    {
+        w->addWork<RecordingWork>(std::to_string(i), record,
+                                  Work::RESOURCE_DB, 3);
+    }
+    w->addWork<RecordingWork>("free", record, Work::RESOURCE_NONE, 3);
+    wm.advanceChildren();
+    size_t maxUsage = 0;
+    while (!wm.allChildrenSuccessful())
+    {
+        clock.crank();
+        maxUsage =
+            std::max(maxUsage, wm.getResourceUsage(Work::RESOURCE_DB));
+    }
+    REQUIRE(record.size() == 6);
+    REQUIRE(maxUsage == budget);
+    REQUIRE(wm.getResourceUsage(Work::RESOURCE_DB) == 0);
+}
+
+TEST_CASE("work progress", "[work]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer appPtr = Application::create(clock, cfg);
+    auto& wm = appPtr->getWorkManager();
+
+    std::vector<std::string> record;
+    auto w = wm.addWork<CountDownWork>(0);
+    w->addWork<RecordingWork>("a", record);
+    w->addWork<RecordingWork>("b", record);
+    w->addWork<RecordingWork>("c", record);
+
+    uint64_t done, total, eta;
+    w->getProgress(done, total);
+    REQUIRE(done == 0);
+    REQUIRE(total == 4);
+    REQUIRE(!w->getETA(eta));
+
+    wm.advanceChildren();
+    while (!wm.allChildrenSuccessful())
+    {
+        clock.crank();
+    }
+    w->getProgress(done, total);
+    REQUIRE(done == total);
+    REQUIRE(w->getETA(eta));
+    REQUIRE(eta == 0);
+}
@@ -266,4 +266,30 @@ union TransactionMeta switch (int v)
 case 0:
     OperationMeta operations<>;
 };
+
+// metadata of ledgers closed, as streamed to METADATA_OUTPUT_STREAM
+
+struct TransactionResultMeta
+{
+    TransactionResultPair result;
+    LedgerEntryChanges feeProcessing;
+    TransactionMeta txApplyProcessing;
+};
+
+struct LedgerCloseMetaV0
+{
+    LedgerHeaderHistoryEntry ledgerHeader;
+    // transactions in hash order
+    TransactionSet txSet;
+
+    // transactions in application order: the fees of all of them are
+    // charged before the first one is applied
+    TransactionResultMeta txProcessing<>;
+};
+
+union LedgerCloseMeta switch (int v)
+{
+case 0:
+    LedgerCloseMetaV0 v0;
+};
 }